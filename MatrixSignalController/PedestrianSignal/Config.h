@@ -27,9 +27,15 @@
 #define STOP 13   // ESP8266 (ESP-WROOM-02) IO13
 #define STATUS 14 // ESP8266 (ESP-WROOM-02) IO14
 
+#ifndef TRANSITION_COUNT   // the host cycle benchmark shortens it
 #define TRANSITION_COUNT 14   // second
+#endif
 #define TRANSITION_TIME 500   // 500msec (must fixed)
 
+#define NODE_ADDRESS 3   // 192.168.4.x, unique for each signal head of the intersection
+
+#define BENCHMARK_ON_BOOT 0   // 1: print microbenchmarks of the node as JSON lines at boot
+
 // your network SSID (name)
 #define WIFI_SSID "MatrixSignalDemo"
 // your network password
@@ -23,177 +23,21 @@
 #include <Wire.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
-#include <Ticker.h>
 
-#include <functional>
+#include <SignalLogger.h>
+#include <SignalNodeController.h>
 
 #include "Config.h"
+#include "PedestrianSignalHead.h"
 
 ////////////////////////////////////////////////
 
-class PedestrianSignalController
-{
-private:
-    ESP8266WebServer* pServer;
-    HardwareSerial* pSerial;
-
-    Ticker ticker;
-
-    volatile bool tickStatus;
-    volatile uint8_t blinkingRemains;
-
-    enum States
-    {
-        Stopped,
-        Walking,
-        BlinkOn,
-        BlinkOff
-    } volatile currentState;
-
-    enum RequestStates
-    {
-        None,
-        Stop,
-        Walk
-    } volatile requestState;
-
-    void requestStatus()
-    {
-        String result;
-        switch (currentState)
-        {
-            case States::Stopped:
-                result = "Stopped";
-                break;
-            case States::Walking:
-                result = "Walking";
-                break;
-            case States::BlinkOn:
-            case States::BlinkOff:
-                result = "Blinking ";
-                result += blinkingRemains;
-                break;
-        }
-
-        pServer->send(200, "text/plain", result.c_str());
-    }
-
-    void requestWalk()
-    {
-        requestState = RequestStates::Walk;
-        pServer->send(200, "text/plain", "Walk requested.");
-        pSerial->println("Walk requested.");
-    }
-
-    void requestStop()
-    {
-        requestState = RequestStates::Stop;
-        pServer->send(200, "text/plain", "Stop requested.");
-        pSerial->println("Stop requested.");
-    }
-
-    void requestNotFound()
-    {
-        pServer->send(404, "text/plain", "Invalid resource path.");
-    }
-
-    void tick()
-    {
-        switch (currentState)
-        {
-            case States::Stopped:
-                switch (requestState)
-                {
-                    case RequestStates::Stop:
-                        requestState = None;
-                        break;
-                    case RequestStates::Walk:
-                        digitalWrite(STOP, LOW);
-                        digitalWrite(WALK, HIGH);
-                        currentState = States::Walking;
-                        requestState = None;
-                        break;
-                    default:
-                        break;
-                }
-                break;
-            case States::Walking:
-                switch (requestState)
-                {
-                    case RequestStates::Stop:
-                        digitalWrite(WALK, LOW);
-                        digitalWrite(STOP, HIGH);
-                        blinkingRemains = TRANSITION_COUNT;
-                        currentState = States::BlinkOff;
-                        requestState = None;
-                       break;
-                    case RequestStates::Walk:
-                        requestState = None;
-                        break;
-                    default:
-                        break;
-                }
-                break;
-            case States::BlinkOff:
-                digitalWrite(STOP, LOW);
-                currentState = States::BlinkOn;
-                break;
-            case States::BlinkOn:
-                digitalWrite(STOP, HIGH);
-                blinkingRemains--;
-                if (blinkingRemains == 0)
-                {
-                    currentState = States::Stopped;
-                }
-                else
-                {
-                    currentState = States::BlinkOff;
-                }
-                break;
-        }
-
-        digitalWrite(STATUS, tickStatus ? HIGH : LOW);
-        tickStatus = !tickStatus;
-    }
-
-    static void tickHandler(PedestrianSignalController* pThis)
-    {
-        pThis->tick();
-    }
-
-public:
-    PedestrianSignalController()
-        : pServer(nullptr), pSerial(nullptr), tickStatus(false)
-        , currentState(States::Stopped), blinkingRemains(0), requestState(RequestStates::None)
-    {
-    }
-
-    void Init(ESP8266WebServer* pServer, HardwareSerial* pSerial)
-    {
-        this->pServer = pServer;
-        this->pSerial = pSerial;
-
-        pinMode(WALK, OUTPUT);
-        pinMode(STOP, OUTPUT);
-        pinMode(STATUS, OUTPUT);
-
-        delay(100);
-
-        digitalWrite(WALK, LOW);
-        digitalWrite(STOP, HIGH);
-        digitalWrite(STATUS, LOW);
-
-        pServer->on("/api/status", HTTP_GET, [&]() { requestStatus(); });
-        pServer->on("/api/walk", HTTP_GET, [&]() { requestWalk(); });
-        pServer->on("/api/stop", HTTP_GET, [&]() { requestStop(); });
-        pServer->onNotFound([&]() { requestNotFound(); });
-
-        ticker.attach_ms(TRANSITION_TIME, tickHandler, this);
-    }
-};
+typedef SignalNodeController<PedestrianSignalHead> PedestrianSignalController;
 
 ////////////////////////////////////////////////
 
+SignalLogger logger;
+
 ESP8266WebServer server(80);
 
 PedestrianSignalController controller;
@@ -201,6 +45,7 @@ PedestrianSignalController controller;
 void setup(void)
 {
     Serial.begin(115200);
+    logger.begin(&Serial, LogInfo);
     Wire.begin();
 
     delay(500);
@@ -208,7 +53,7 @@ void setup(void)
     Serial.println("    ");
     Serial.println("PedestrianSignal start.");
 
-    const auto localIP = IPAddress(192, 168, 4, 3);
+    const auto localIP = IPAddress(192, 168, 4, NODE_ADDRESS);
     const auto gatewayIP = IPAddress(192, 168, 4, 1);
     const auto netmask = IPAddress(255, 255, 255, 0);
 
@@ -233,6 +78,12 @@ void setup(void)
     Serial.println("]");
 
     controller.Init(&server, &Serial);
+
+#if BENCHMARK_ON_BOOT
+    SignalBenchmark benchmark(&Serial, "PedestrianSignal");
+    controller.benchmark(benchmark);
+#endif
+
     server.begin();
 
     Serial.println("HTTP server started.");
@@ -241,4 +92,6 @@ void setup(void)
 void loop(void)
 {
     server.handleClient();
+    controller.handle();
+    logger.drain();
 }
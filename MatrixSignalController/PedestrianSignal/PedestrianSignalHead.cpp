@@ -0,0 +1,46 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// PedestrianSignal - Matrix signal controller demonstration at NT NAGOYA 2018.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "PedestrianSignalHead.h"
+
+////////////////////////////////////////////////
+
+const uint8_t PedestrianSignalHead::lampPins[] = { WALK, STOP };
+
+const SignalPhase PedestrianSignalHead::phases[] PROGMEM =
+{
+    // lamps, duration, next, repeatTo, repeat, hook
+    { SIGNAL_LAMP(STOP), 0, PedestrianSignalHead::Stopped, 0, 0, 0 },
+    { SIGNAL_LAMP(WALK), 0, PedestrianSignalHead::Walking, 0, 0, 0 },
+    { SIGNAL_LAMP(STOP), TRANSITION_TIME, PedestrianSignalHead::BlinkOff, 0, 0, 0 },
+    { 0, TRANSITION_TIME, PedestrianSignalHead::Stopped,
+        PedestrianSignalHead::BlinkOn, TRANSITION_COUNT - 1, 0 },
+};
+
+const SignalPhaseRule PedestrianSignalHead::rules[] =
+{
+    // name, state, countdown, next phase by command: query, stop, go
+    { "Stopped", SignalStateStopped, 0, { SIGNAL_STAY, SIGNAL_STAY, PedestrianSignalHead::Walking } },
+    { "Walking", SignalStateGoing, 0, { SIGNAL_STAY, PedestrianSignalHead::BlinkOn, SIGNAL_STAY } },
+    { "Blinking", SignalStateTransition, TRANSITION_COUNT, { SIGNAL_STAY, SIGNAL_STAY, SIGNAL_STAY } },
+    { "Blinking", SignalStateTransition, TRANSITION_COUNT, { SIGNAL_STAY, SIGNAL_STAY, SIGNAL_STAY } },
+};
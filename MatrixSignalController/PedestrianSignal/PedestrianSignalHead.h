@@ -0,0 +1,64 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// PedestrianSignal - Matrix signal controller demonstration at NT NAGOYA 2018.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PEDESTRIAN_SIGNAL_HEAD_H
+#define PEDESTRIAN_SIGNAL_HEAD_H
+
+#include <SignalHeadMachine.h>
+
+#include "Config.h"
+
+////////////////////////////////////////////////
+
+// Phase and rule tables of the head, run by SignalHeadMachine.
+// The tables are defined in PedestrianSignalHead.cpp.
+struct PedestrianSignalHead
+{
+    // Phase indexes of the phases and rules tables.
+    enum Phases
+    {
+        Stopped,
+        Walking,
+        BlinkOn,
+        BlinkOff
+    };
+
+    static const SignalNodes Node = SignalNodePedestrian;
+    static const uint16_t TickInterval = TRANSITION_TIME;
+    static const uint8_t StatusPin = STATUS;
+    static const uint8_t LampCount = 2;
+    static const uint8_t lampPins[LampCount];
+    static const SignalPhase phases[];
+    static const SignalPhaseRule rules[];
+
+    static const char* getGoPath()
+    {
+        return "/api/walk";
+    }
+
+    static const char* getGoName()
+    {
+        return "Walk";
+    }
+};
+
+#endif
@@ -38,8 +38,14 @@
 // your network password
 #define WIFI_PASSWORD "li2u3yr9fbi2uh4"
 
-#define WIFI_ROAD_SIGNAL_NAME "192.168.4.2"
-#define WIFI_PEDESTRIAN_SIGNAL_NAME "192.168.4.3"
+// Signal heads known in advance as { address, group }, others join when their status is heard.
+#define SIGNAL_NODE_TABLE \
+    { "192.168.4.2", SignalNodeRoad }, \
+    { "192.168.4.3", SignalNodePedestrian }
+
+#define ROAD_TRANSITION_WILLSTOP 4       // second, TRANSITION_WILLSTOP of RoadSignal
+#define PLAN_LEAD 500                    // msec from sending a plan to its first step
+#define PLAN_COPIES 2                    // plans go over UDP, resent copies are dropped by the nodes
 
 #define CHIRP_SOUND 1
 #define CUCKOO_SOUND 2
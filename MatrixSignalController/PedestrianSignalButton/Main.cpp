@@ -23,30 +23,55 @@
 #include <Wire.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
-#include <ESP8266HTTPClient.h>
 #include <SoftwareSerial.h>
 #include <DFRobotDFPlayerMini.h>    // https://github.com/DFRobot/DFRobotDFPlayerMini
 #include <EasyButton.h>             // https://github.com/evert-arias/EasyButton
 
 #include <functional>
 
+#include <SignalLogger.h>
+#include <SignalBroadcast.h>
+#include <SignalMetrics.h>
+#include <SignalClock.h>
+#include <SignalFanout.h>
+
 #include "Config.h"
 
 ////////////////////////////////////////////////
 
+struct SignalNodeEntry
+{
+    const char* pAddress;
+    SignalNodes group;
+};
+
+// Signal heads known in advance, others join when their status is heard.
+static const SignalNodeEntry nodeTable[] = { SIGNAL_NODE_TABLE };
+
+////////////////////////////////////////////////
+
 class PedestrianSignalButton
 {
 private:
     DFRobotDFPlayerMini* pPlayer;
     EasyButton requestButton;
 
+    SignalStateListener listener;
+    SignalGroupCommander commander;
+    SignalMetrics metrics;
+    SignalClockMaster clock;
+
     uint32_t lastTickCount;
+    uint32_t tickOverruns;   // ticks later than half a second
     uint32_t delayCount;
     uint32_t cuckooCount;
     uint32_t demoCount;
+    uint32_t requestedAt;
+    uint32_t playedAt;
 
     enum States
     {
+        Starting,
         Waiting1,
         Waiting2,
         WillWalk,
@@ -72,123 +97,224 @@ private:
         Blinking
     };
 
-    bool sendTo(const char* pHost, int port, bool isPost, const char* pResourcePath, String& result)
+    // A status poll finished, its answers are in the listener.
+    bool polled;
+
+    bool roadReady;
+    bool pedestrianReady;
+
+    // Walk plan: the road stops at planStart, the pedestrian walk follows at the master clock time
+    // its WillStop ends, sent once the road is seen stopping.
+    uint32_t planStart;
+    bool roadPlanned;
+    bool walkPlanned;
+
+    static bool logResult(const char* pDescription, const SignalFanoutResult& result)
     {
-        String url("http://");
-        url += pHost;
-        url += ":";
-        url += port;
-        url += pResourcePath;
-
-        HTTPClient client;
-        if (!client.begin(url))
-        {
-            Serial.println(" failed.");
-            return false;
-        }
+        const bool success = (result.expected != 0) && (result.answered == result.expected);
+        logger.log(success ? LogInfo : LogWarning, "%s ... %s %u/%u %lumsec.",
+            pDescription, success ? "success" : "failed", result.answered, result.expected,
+            static_cast<unsigned long>(result.elapsedMillisecond));
 
-        const auto statusCode = isPost ? client.POST("") : client.GET();
-        result = client.getString();
+        return success;
+    }
 
-        if (statusCode >= 400)
-        {
-            Serial.print(" failed:");
-        }
-        else
-        {
-            Serial.print(" success:");
-        }
+    // Context is the description.
+    static void commandHandler(void* pContext, const SignalFanoutResult& result)
+    {
+        logResult(static_cast<const char*>(pContext), result);
+    }
+
+    static void roadReadyHandler(void* pContext, const SignalFanoutResult& result)
+    {
+        static_cast<PedestrianSignalButton*>(pContext)->roadReady =
+            logResult("Send 'Go' to RoadSignal", result);
+    }
 
-        Serial.print(statusCode);
-        Serial.print(" [");
-        Serial.print(result.c_str());
-        Serial.println("].");
+    static void pedestrianReadyHandler(void* pContext, const SignalFanoutResult& result)
+    {
+        static_cast<PedestrianSignalButton*>(pContext)->pedestrianReady =
+            logResult("Send 'Stop' to PedestrianSignal", result);
+    }
 
-        return statusCode < 400;
+    static void statusHandler(void* pContext, const SignalFanoutResult& result)
+    {
+        static_cast<PedestrianSignalButton*>(pContext)->polled = true;
+        logResult((result.group == SignalNodeRoad) ? "Getting RoadSignal status" : "Getting PedestrianSignal status", result);
     }
 
-    bool sendStopToRoadSignal()
+    // To every head of the group at once.
+    void sendCommand(const SignalNodes group, const SignalCommands command, const char* pDescription)
     {
-        Serial.print("Send 'Stop' to RoadSignal ...");
+        if (!commander.send(group, command, commandHandler, const_cast<char*>(pDescription)))
+        {
+            logger.warning("%s ... failed, busy.", pDescription);
+        }
+    }
 
-        String result;
-        return sendTo(WIFI_ROAD_SIGNAL_NAME, 80, false, "/api/stop", result);
+    void sendStopToRoadSignal()
+    {
+        sendCommand(SignalNodeRoad, SignalCommandStop, "Send 'Stop' to RoadSignal");
     }
 
-    bool sendGoToRoadSignal()
+    void sendGoToRoadSignal()
     {
-        Serial.print("Send 'Go' to RoadSignal ...");
+        sendCommand(SignalNodeRoad, SignalCommandGo, "Send 'Go' to RoadSignal");
+    }
 
-        String result;
-        return sendTo(WIFI_ROAD_SIGNAL_NAME, 80, false, "/api/go", result);
+    void sendWalkToPedestrianSignal()
+    {
+        sendCommand(SignalNodePedestrian, SignalCommandGo, "Send 'Walk' to PedestrianSignal");
     }
 
-    RoadSignalStates getRoadSignal()
+    void sendStopToPedestrianSignal()
     {
-        Serial.print("Getting RoadSignal status ...");
+        sendCommand(SignalNodePedestrian, SignalCommandStop, "Send 'Stop' to PedestrianSignal");
+    }
 
-        String result;
-        if (!sendTo(WIFI_ROAD_SIGNAL_NAME, 80, false, "/api/status", result))
+    void sendPlan(const SignalNodes group, const SignalCommands command, const uint32_t at)
+    {
+        SignalMessage step;
+        memset(&step, 0, sizeof step);
+        step.type = SignalMessagePlan;
+        step.node = group;
+        step.command = command;
+        step.sequence = at;
+
+        for (uint8_t copy = 0; copy < PLAN_COPIES; copy++)
         {
-            return RoadSignalStates::Unknown_Road;
+            for (uint8_t index = 0; index < listener.getNodeCount(); index++)
+            {
+                if (listener.getGroup(index) == group)
+                {
+                    clock.sendPlan(listener.getAddress(index), &step, 1);
+                }
+            }
         }
+    }
 
-        if (result == "Stopped")
+    // Both nodes follow the master clock: stop the road by a plan, otherwise by a command.
+    void stopRoadSignal()
+    {
+        roadPlanned = listener.isSynchronized(SignalNodeRoad) && listener.isSynchronized(SignalNodePedestrian);
+        walkPlanned = false;
+        if (!roadPlanned)
         {
-            return RoadSignalStates::Stopped_Road;
+            sendStopToRoadSignal();
+            return;
         }
-        if (result == "Going")
+
+        planStart = clock.getTime() + PLAN_LEAD;
+        sendPlan(SignalNodeRoad, SignalCommandStop, planStart);
+        logger.info("Plan 'Stop' to RoadSignal at %lu.", static_cast<unsigned long>(planStart));
+    }
+
+    // The road's own phase ends WillStop, the pedestrians walk at that same moment.
+    void planWalkIfRoadStopping()
+    {
+        if (!roadPlanned || walkPlanned || (getRoadSignal() != RoadSignalStates::WillStop))
         {
-            return RoadSignalStates::Going;
+            return;
         }
-        if (result.startsWith("WillStop "))
+
+        const uint32_t at = planStart + (ROAD_TRANSITION_WILLSTOP * 1000);
+        sendPlan(SignalNodePedestrian, SignalCommandGo, at);
+        walkPlanned = true;
+        logger.info("Plan 'Walk' to PedestrianSignal at %lu.", static_cast<unsigned long>(at));
+    }
+
+    // Pushed by the heads or answered to a poll, unknown while any of them is silent.
+    RoadSignalStates getRoadSignal()
+    {
+        if (listener.isAlive(SignalNodeRoad))
         {
-            return RoadSignalStates::WillStop;
+            switch (listener.getState(SignalNodeRoad))
+            {
+                case SignalStateStopped:
+                    return RoadSignalStates::Stopped_Road;
+                case SignalStateGoing:
+                    return RoadSignalStates::Going;
+                default:
+                    return RoadSignalStates::WillStop;
+            }
         }
 
         return RoadSignalStates::Unknown_Road;
     }
 
-    bool sendWalkToPedestrianSignal()
+    PedestrianSignalStates getPedestrianSignal()
     {
-        Serial.print("Send 'Walk' to PedestrianSignal ...");
+        if (listener.isAlive(SignalNodePedestrian))
+        {
+            switch (listener.getState(SignalNodePedestrian))
+            {
+                case SignalStateStopped:
+                    return PedestrianSignalStates::Stopped_Pedestrian;
+                case SignalStateGoing:
+                    return PedestrianSignalStates::Walking_Pedestrian;
+                default:
+                    return PedestrianSignalStates::Blinking;
+            }
+        }
 
-        String result;
-        return sendTo(WIFI_PEDESTRIAN_SIGNAL_NAME, 80, false, "/api/walk", result);
+        return PedestrianSignalStates::Unknown_Pedestrian;
     }
 
-    bool sendStopToPedestrianSignal()
+    void pollRoadSignal()
     {
-        Serial.print("Send 'Stop' to PedestrianSignal ...");
-
-        String result;
-        return sendTo(WIFI_PEDESTRIAN_SIGNAL_NAME, 80, false, "/api/stop", result);
+        if (!listener.isAlive(SignalNodeRoad) && !commander.isBusy(SignalNodeRoad))
+        {
+            commander.send(SignalNodeRoad, SignalCommandQuery, statusHandler, this);
+        }
     }
 
-    PedestrianSignalStates getPedestrianSignal()
+    void pollPedestrianSignal()
     {
-        Serial.print("Getting PedestrianSignal status ...");
-
-        String result;
-        if (!sendTo(WIFI_PEDESTRIAN_SIGNAL_NAME, 80, false, "/api/status", result))
+        if (!listener.isAlive(SignalNodePedestrian) && !commander.isBusy(SignalNodePedestrian))
         {
-            return PedestrianSignalStates::Unknown_Pedestrian;
+            commander.send(SignalNodePedestrian, SignalCommandQuery, statusHandler, this);
         }
+    }
 
-        if (result == "Stopped")
+    bool walkIfRoadStopped()
+    {
+        if (getRoadSignal() != RoadSignalStates::Stopped_Road)
         {
-            return PedestrianSignalStates::Stopped_Pedestrian;
+            return false;
         }
-        if (result == "Going")
+
+        logger.info("RoadSignal stopped in %lumsec.", static_cast<unsigned long>(signalMillis() - requestedAt));
+        signalWritePin(PUMPED, false);
+        sendWalkToPedestrianSignal();   // no-op after a planned walk, covers a lost plan
+        roadPlanned = false;
+        walkPlanned = false;
+        delayCount = signalMillis();
+        currentState = States::Walking1;
+        return true;
+    }
+
+    bool waitIfPedestrianStopped()
+    {
+        if (getPedestrianSignal() != PedestrianSignalStates::Stopped_Pedestrian)
         {
-            return PedestrianSignalStates::Walking_Pedestrian;
+            return false;
         }
-        if (result.startsWith("Blinking "))
+
+        logger.info("PedestrianSignal stopped in %lumsec.", static_cast<unsigned long>(signalMillis() - requestedAt));
+        delayCount = signalMillis();
+        currentState = States::Waiting0;
+        return true;
+    }
+
+    // The player needs a moment between commands, skip instead of waiting for it.
+    void play(const uint8_t sound)
+    {
+        const auto now = signalMillis();
+        if ((now - playedAt) >= 300)
         {
-            return PedestrianSignalStates::Blinking;
+            playedAt = now;
+            pPlayer->play(sound);
         }
-
-        return PedestrianSignalStates::Unknown_Pedestrian;
     }
 
     void requested()
@@ -196,17 +322,15 @@ private:
         switch (currentState)
         {
             case States::Waiting1:
-                digitalWrite(PUMPED, HIGH);
-                delayCount = millis();
+                signalWritePin(PUMPED, true);
+                delayCount = signalMillis();
                 currentState = States::Waiting2;
-                pPlayer->play(WAIT_SOUND);
-                delay(300);
+                play(WAIT_SOUND);
                 break;
 
             // Fall through
             case States::Waiting2:
-                pPlayer->play(WAIT_SOUND);
-                delay(300);
+                play(WAIT_SOUND);
                 break;
         }
     }
@@ -215,50 +339,72 @@ private:
     {
         switch (currentState)
         {
+            case States::Starting:
+                if (!roadReady && !commander.isBusy(SignalNodeRoad))
+                {
+                    commander.send(SignalNodeRoad, SignalCommandGo, roadReadyHandler, this);
+                }
+                if (!pedestrianReady && !commander.isBusy(SignalNodePedestrian))
+                {
+                    commander.send(SignalNodePedestrian, SignalCommandStop, pedestrianReadyHandler, this);
+                }
+                if (roadReady && pedestrianReady)
+                {
+                    currentState = States::Waiting1;
+                }
+                break;
+
             case States::Waiting1:
                 demoCount--;
                 if (demoCount == 0)
                 {
-                    digitalWrite(PUMPED, HIGH);
-                    delayCount = millis();
+                    signalWritePin(PUMPED, true);
+                    delayCount = signalMillis();
                     currentState = States::Waiting2;
-                    pPlayer->play(WAIT_SOUND);
-                    delay(300);
+                    play(WAIT_SOUND);
                 }
                 break;
 
             case States::Waiting2:
                 {
-                    const auto now = millis();
+                    const auto now = signalMillis();
                     if ((now - delayCount) >= (TRANSITION_WAITING2 * 1000))
                     {
-                        sendStopToRoadSignal();
+                        stopRoadSignal();
+                        requestedAt = signalMillis();
                         currentState = States::WillWalk;
                     }
                 }
                 break;
 
             case States::WillWalk:
-                if (getRoadSignal() == RoadSignalStates::Stopped_Road)
+                // A lost plan leaves the road going, fall back to the command.
+                if (roadPlanned && !walkPlanned && (getRoadSignal() == RoadSignalStates::Going) &&
+                    (static_cast<int32_t>(clock.getTime() - planStart) >= 1000))
                 {
-                    digitalWrite(PUMPED, LOW);
-                    sendWalkToPedestrianSignal();
-                    delayCount = millis();
-                    currentState = States::Walking1;
+                    logger.warning("Plan 'Stop' to RoadSignal lost.");
+                    roadPlanned = false;
+                    sendStopToRoadSignal();
+                }
+                planWalkIfRoadStopping();
+                if (!walkIfRoadStopped())
+                {
+                    pollRoadSignal();
                 }
                 break;
 
             case States::Walking1:
                 {
-                    const auto now = millis();
+                    const auto now = signalMillis();
                     if ((now - delayCount) >= (TRANSITION_WALKING * 1000))
                     {
                         sendStopToPedestrianSignal();
+                        requestedAt = signalMillis();
                         currentState = States::WillWait;
                     }
                     else
                     {
-                        cuckooCount = millis();
+                        cuckooCount = signalMillis();
                         currentState = States::Walking2;
                     }
                 }
@@ -266,29 +412,31 @@ private:
 
             case States::Walking2:
                 {
-                    const auto now = millis();
+                    const auto now = signalMillis();
                     if ((now - cuckooCount) >= 1000)
                     {
-                        pPlayer->play(CUCKOO_SOUND);
+                        play(CUCKOO_SOUND);
                         currentState = States::Walking1;
                     }
                 }
                 break;
 
             case States::WillWait:
-                if (getPedestrianSignal() == PedestrianSignalStates::Stopped_Pedestrian)
+                if (!waitIfPedestrianStopped())
                 {
-                    delayCount = millis();
-                    currentState = States::Waiting0;
+                    pollPedestrianSignal();
                 }
                 break;
 
             case States::Waiting0:
                 {
-                    const auto now = millis();
+                    const auto now = signalMillis();
                     if ((now - delayCount) >= (TRANSITION_WAITING0 * 1000))
                     {
                         sendGoToRoadSignal();
+                        commander.printStatistics("Fan-out");
+                        metrics.print("Button", tickOverruns);
+                        metrics.resetLoop();
                         demoCount = TRANSITION_DEMO;
                         currentState = States::Waiting1;
                     }
@@ -299,8 +447,12 @@ private:
 
 public:
     PedestrianSignalButton()
-        : pPlayer(nullptr), currentState(States::Waiting1), requestButton(REQUEST)
-        , lastTickCount(0), delayCount(0), cuckooCount(0), demoCount(TRANSITION_DEMO)
+        : pPlayer(nullptr), requestButton(REQUEST)
+        , lastTickCount(0), tickOverruns(0), delayCount(0), cuckooCount(0), demoCount(TRANSITION_DEMO), requestedAt(0), playedAt(0)
+        , currentState(States::Starting)
+        , polled(false)
+        , roadReady(false), pedestrianReady(false)
+        , planStart(0), roadPlanned(false), walkPlanned(false)
     {
     }
 
@@ -308,20 +460,52 @@ public:
     {
         this->pPlayer = pPlayer;
 
-        while (!sendGoToRoadSignal());
-        while (!sendStopToPedestrianSignal());
+        listener.begin();
+        for (uint8_t index = 0; index < (sizeof nodeTable / sizeof nodeTable[0]); index++)
+        {
+            IPAddress address;
+            address.fromString(nodeTable[index].pAddress);
+            listener.add(address, nodeTable[index].group);
+        }
+        commander.begin(&listener);
+        clock.begin();
 
         requestButton.onPressed([&]() { requested(); });
         requestButton.begin();
     }
 
+    // Never waits on the network: the peers advance their requests by step(),
+    // and answers (pushed or polled) are acted on as soon as they arrive.
     void handle()
     {
+        metrics.mark();
+
         requestButton.read();
 
-        const auto now = millis();
+        clock.handle();
+
+        const bool pushed = listener.poll();
+        commander.handle();
+
+        if (pushed || polled)
+        {
+            polled = false;
+            switch (currentState)
+            {
+                case States::WillWalk:
+                    planWalkIfRoadStopping();
+                    walkIfRoadStopped();
+                    break;
+                case States::WillWait:
+                    waitIfPedestrianStopped();
+                    break;
+            }
+        }
+
+        const auto now = signalMillis();
         if ((now - lastTickCount) >= 1000)
         {
+            tickOverruns += ((lastTickCount != 0) && ((now - lastTickCount) >= 1500)) ? 1 : 0;
             lastTickCount = now;
             tick();
         }
@@ -330,6 +514,8 @@ public:
 
 ////////////////////////////////////////////////
 
+SignalLogger logger;
+
 SoftwareSerial softwareSerial(DFPLAYER_RX, DFPLAYER_TX);
 DFRobotDFPlayerMini player;
 
@@ -338,6 +524,7 @@ PedestrianSignalButton button;
 void setup(void)
 {
     Serial.begin(115200);
+    logger.begin(&Serial, LogInfo);
     softwareSerial.begin(9600);
     Wire.begin();
 
@@ -391,4 +578,5 @@ void setup(void)
 void loop(void)
 {
     button.handle();
+    logger.drain();
 }
@@ -29,7 +29,13 @@
 #define STOP 14       // ESP8266 (ESP-WROOM-02) IO14
 #define STATUS 4      // ESP8266 (ESP-WROOM-02) IO4
 
+#ifndef TRANSITION_WILLSTOP   // the host cycle benchmark shortens it
 #define TRANSITION_WILLSTOP 4      // second
+#endif
+
+#define NODE_ADDRESS 2   // 192.168.4.x, unique for each signal head of the intersection
+
+#define BENCHMARK_ON_BOOT 0   // 1: print microbenchmarks of the node as JSON lines at boot
 
 // your network SSID (name)
 #define WIFI_SSID "MatrixSignalDemo"
@@ -24,169 +24,21 @@
 #include <Wire.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
-#include <Ticker.h>
 
-#include <functional>
+#include <SignalLogger.h>
+#include <SignalNodeController.h>
 
 #include "Config.h"
+#include "RoadSignalHead.h"
 
 ////////////////////////////////////////////////
 
-class RoadSignalController
-{
-private:
-    ESP8266WebServer* pServer;
-    HardwareSerial* pSerial;
-
-    Ticker ticker;
-
-    volatile bool tickStatus;
-    volatile uint8_t stopRemains;
-
-    enum States
-    {
-        Stopped,
-        Going,
-        WillStop
-    } volatile currentState;
-
-    enum RequestStates
-    {
-        None,
-        Stop,
-        Go
-    } volatile requestState;
-
-    void requestStatus()
-    {
-        String result;
-        switch (currentState)
-        {
-            case States::Stopped:
-                result = "Stopped";
-                break;
-            case States::Going:
-                result = "Going";
-                break;
-            case States::WillStop:
-                result = "WillStop";
-                break;
-        }
-
-        pServer->send(200, "text/plain", result.c_str());
-    }
-
-    void requestGo()
-    {
-        requestState = RequestStates::Go;
-        pServer->send(200, "text/plain", "Go requested.");
-        pSerial->println("Go requested.");
-    }
-
-    void requestStop()
-    {
-        requestState = RequestStates::Stop;
-        pServer->send(200, "text/plain", "Stop requested.");
-        pSerial->println("Stop requested.");
-    }
-
-    void requestNotFound()
-    {
-        pServer->send(404, "text/plain", "Invalid resource path.");
-    }
-
-    void tick()
-    {
-        switch (currentState)
-        {
-            case States::Stopped:
-                switch (requestState)
-                {
-                    case RequestStates::Stop:
-                        requestState = None;
-                        break;
-                    case RequestStates::Go:
-                        digitalWrite(STOP, LOW);
-                        digitalWrite(GO, HIGH);
-                        currentState = States::Going;
-                        requestState = None;
-                        break;
-                    default:
-                        break;
-                }
-                break;
-            case States::Going:
-                switch (requestState)
-                {
-                    case RequestStates::Stop:
-                        digitalWrite(GO, LOW);
-                        digitalWrite(WILLSTOP, HIGH);
-                        stopRemains = TRANSITION_WILLSTOP;
-                        currentState = States::WillStop;
-                        requestState = None;
-                       break;
-                    case RequestStates::Go:
-                        requestState = None;
-                        break;
-                    default:
-                        break;
-                }
-                break;
-            case States::WillStop:
-                stopRemains--;
-                if (stopRemains == 0)
-                {
-                    digitalWrite(WILLSTOP, LOW);
-                    digitalWrite(STOP, HIGH);
-                    currentState = States::Stopped;
-                }
-                break;
-        }
-
-        digitalWrite(STATUS, tickStatus ? HIGH : LOW);
-        tickStatus = !tickStatus;
-    }
-
-    static void tickHandler(RoadSignalController* pThis)
-    {
-        pThis->tick();
-    }
-
-public:
-    RoadSignalController()
-        : pServer(nullptr), pSerial(nullptr), tickStatus(false)
-        , currentState(States::Stopped), stopRemains(0), requestState(RequestStates::None)
-    {
-    }
-
-    void Init(ESP8266WebServer* pServer, HardwareSerial* pSerial)
-    {
-        this->pServer = pServer;
-        this->pSerial = pSerial;
-
-        pinMode(GO, OUTPUT);
-        pinMode(WILLSTOP, OUTPUT);
-        pinMode(STOP, OUTPUT);
-        pinMode(STATUS, OUTPUT);
-
-        delay(100);
-
-        digitalWrite(GO, LOW);
-        digitalWrite(WILLSTOP, LOW);
-        digitalWrite(STOP, HIGH);
-        digitalWrite(STATUS, LOW);
-
-        pServer->on("/api/status", HTTP_GET, [&]() { requestStatus(); });
-        pServer->on("/api/go", HTTP_GET, [&]() { requestGo(); });
-        pServer->on("/api/stop", HTTP_GET, [&]() { requestStop(); });
-        pServer->onNotFound([&]() { requestNotFound(); });
-
-        ticker.attach_ms(1000, tickHandler, this);
-    }
-};
+typedef SignalNodeController<RoadSignalHead> RoadSignalController;
 
 ////////////////////////////////////////////////
 
+SignalLogger logger;
+
 ESP8266WebServer server(80);
 
 RoadSignalController controller;
@@ -194,6 +46,7 @@ RoadSignalController controller;
 void setup(void)
 {
     Serial.begin(115200);
+    logger.begin(&Serial, LogInfo);
     Wire.begin();
 
     delay(500);
@@ -201,7 +54,7 @@ void setup(void)
     Serial.println("    ");
     Serial.println("RoadSignal start.");
 
-    const auto localIP = IPAddress(192, 168, 4, 2);
+    const auto localIP = IPAddress(192, 168, 4, NODE_ADDRESS);
     const auto gatewayIP = IPAddress(192, 168, 4, 1);
     const auto netmask = IPAddress(255, 255, 255, 0);
 
@@ -226,6 +79,12 @@ void setup(void)
     Serial.println("]");
 
     controller.Init(&server, &Serial);
+
+#if BENCHMARK_ON_BOOT
+    SignalBenchmark benchmark(&Serial, "RoadSignal");
+    controller.benchmark(benchmark);
+#endif
+
     server.begin();
 
     Serial.println("HTTP server started.");
@@ -234,4 +93,6 @@ void setup(void)
 void loop(void)
 {
     server.handleClient();
+    controller.handle();
+    logger.drain();
 }
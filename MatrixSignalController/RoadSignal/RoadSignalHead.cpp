@@ -0,0 +1,44 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// RoadSignal - Matrix signal controller demonstration at NT NAGOYA 2018.
+// This is part of PedestrianController.
+// It's from the ExtremeFeedbackDevice project: https://github.com/kekyo/ExtremeFeedbackDevice
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "RoadSignalHead.h"
+
+////////////////////////////////////////////////
+
+const uint8_t RoadSignalHead::lampPins[] = { GO, WILLSTOP, STOP };
+
+const SignalPhase RoadSignalHead::phases[] PROGMEM =
+{
+    // lamps, duration, next, repeatTo, repeat, hook
+    { SIGNAL_LAMP(STOP), 0, RoadSignalHead::Stopped, 0, 0, 0 },
+    { SIGNAL_LAMP(GO), 0, RoadSignalHead::Going, 0, 0, 0 },
+    { SIGNAL_LAMP(WILLSTOP), TRANSITION_WILLSTOP * 1000, RoadSignalHead::Stopped, 0, 0, 0 },
+};
+
+const SignalPhaseRule RoadSignalHead::rules[] =
+{
+    // name, state, countdown, next phase by command: query, stop, go
+    { "Stopped", SignalStateStopped, 0, { SIGNAL_STAY, SIGNAL_STAY, RoadSignalHead::Going } },
+    { "Going", SignalStateGoing, 0, { SIGNAL_STAY, RoadSignalHead::WillStop, SIGNAL_STAY } },
+    { "WillStop", SignalStateTransition, 0, { SIGNAL_STAY, SIGNAL_STAY, SIGNAL_STAY } },
+};
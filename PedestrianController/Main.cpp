@@ -3,45 +3,22 @@
 #include <user_interface.h>
 
 #include "PedestrianControllerConfig.h"
+#include "Scheduler.h"
+#include "NtpClient.h"
+#include "NtpPacket.h"
+#include "RtcController.h"
+#include "Schedule.h"
+#include "TimeUtility.h"
 
-// https://github.com/NorthernWidget/DS3231
-#include <DS3231.h>
+#include <SignalLogger.h>
+#include <SignalSequence.h>
+#include <SignalBenchmark.h>
+#include <SignalMetrics.h>
 
-bool getNtpTimeValue(DateTime& time, bool retry);
-DateTime getRtcTimeValue();
-void setRtcTimeValue(const DateTime& time);
+SignalLogger logger;
 
 ////////////////////////////////////////////////
 
-static String formatTime(const DateTime& time)
-{
-    auto timeString = String(time.month(), DEC);
-    timeString += "/";
-    timeString += String(time.day(), DEC);
-    timeString += "/";
-    timeString += String(time.year(), DEC);
-    timeString += " ";
-    timeString += String(time.hour(), DEC);
-    timeString += ":";
-    timeString += String(time.minute(), DEC);
-    timeString += ":";
-    timeString += String(time.second(), DEC);
-
-    return timeString;
-}
-
-static uint32_t calculateTimeDifferent(const uint32_t start, const uint32_t end)
-{
-    if (end >= start)
-    {
-        return end - start;
-    }
-    else
-    {
-        return UINT32_MAX - start + end;
-    }
-}
-
 static void ChangeBlinkState()
 {
     static uint8_t currentState = 3;
@@ -84,155 +61,568 @@ void BlinkStatus(const uint16_t msec)
 
 ////////////////////////////////////////////////
 
-static uint8_t lastUpdatedDay = 0;
+static constexpr ScheduleWindow scheduleWindows[] = { SCHEDULE_WINDOWS };
+static const ScheduleHoliday scheduleHolidays[] = { SCHEDULE_HOLIDAYS };
+
+static WeeklySchedule<SCHEDULE_SLOT_MINUTES> schedule;
+
+static_assert(WeeklySchedule<SCHEDULE_SLOT_MINUTES>::isValid(scheduleWindows, sizeof scheduleWindows / sizeof scheduleWindows[0]),
+    "SCHEDULE_WINDOWS times must be on SCHEDULE_SLOT_MINUTES boundaries.");
 
-static uint32_t getSleepingSecond(const uint32_t timeoutMillisecond, bool firstTime)
+// Milliseconds until the schedule turns on, or 0 while it is on.
+// Pure calculation without any I/O (Schedule.h), so it can be driven by any clock source.
+static uint32_t getScheduleRemainsMillisecond(const DateTime& currentTime)
 {
-    const uint32_t start = millis();
-    DateTime currentTime = getRtcTimeValue();
+    return schedule.getRemainsMillisecond(currentTime.unixtime());
+}
+
+////////////////////////////////////////////////
+
+static Scheduler scheduler;
+static SignalMetrics metrics;
+
+static uint8_t sequenceTaskId;
+static uint8_t scheduleTaskId;
+static uint8_t ntpTaskId;
+static uint8_t housekeepingTaskId;
+static uint8_t rtcTaskId;
+
+////////////////////////////////////////////////
+
+static uint8_t lastUpdatedDay = 0;
 
-    String currentTimeString = formatTime(currentTime);
+static void printNtpSyncStatistics()
+{
+    const NtpSyncStatistics& statistics = getNtpSyncStatistics();
+
+    logger.info("NTP sync: attempts=%u, requests=%u, servers=%u, delay=%lumsec, error=%lumsec",
+        statistics.attempts,
+        statistics.requests,
+        statistics.servers,
+        static_cast<unsigned long>(statistics.roundTripMillisecond),
+        static_cast<unsigned long>(statistics.errorMillisecond));
+    logger.info("NTP sync: %s association=%lumsec, dns=%lumsec, wifi on=%lumsec",
+        statistics.fastConnected ? "fast" : "full",
+        static_cast<unsigned long>(statistics.associationMillisecond),
+        static_cast<unsigned long>(statistics.dnsMillisecond),
+        static_cast<unsigned long>(statistics.wifiOnMillisecond));
+    logger.info("WiFi connect: p50=%lumsec, p90=%lumsec, max=%lumsec",
+        static_cast<unsigned long>(statistics.connectP50Millisecond),
+        static_cast<unsigned long>(statistics.connectP90Millisecond),
+        static_cast<unsigned long>(statistics.connectMaxMillisecond));
+}
 
-    Serial.print("Current time from RTC: ");
-    Serial.println(currentTimeString);
+static bool rtcUpdatePending = false;
+static uint8_t rtcUpdateRetries = 0;
+static int64_t ntpOffsetMillisecond = 0;
 
-    if (currentTime.day() != lastUpdatedDay)
+// Advance the daily NTP sync while it is running.
+// The RTC is written on the next second boundary, so it is set to millisecond accuracy
+// (writing the seconds register resets the DS3231 countdown chain).
+static uint32_t ntpTask()
+{
+    if (rtcUpdatePending)
     {
-        Serial.println();
-        Serial.println("======================");
-        Serial.println("Time update start:");
+        // Woken a few msec early, wait out the rest to hit the boundary.
+        uint32_t phase = static_cast<uint32_t>((static_cast<int64_t>(millis()) + ntpOffsetMillisecond) % 1000);
+        while (phase >= 500)
+        {
+            delayMicroseconds(100);
+            phase = static_cast<uint32_t>((static_cast<int64_t>(millis()) + ntpOffsetMillisecond) % 1000);
+        }
 
-        DateTime ntpTime;
-        if (getNtpTimeValue(ntpTime, firstTime))
+        // Woken past the boundary (another task ran long): writing now would set the RTC
+        // late by the phase, so retry at the next boundary instead.
+        if (phase > NTP_RTC_WRITE_TOLERANCE)
         {
-            setRtcTimeValue(ntpTime);
+            if (rtcUpdateRetries < NTP_RTC_WRITE_RETRIES)
+            {
+                rtcUpdateRetries++;
+                const uint32_t remains = 1000 - phase;
+                return (remains > 5) ? (remains - 5) : (remains + 995);
+            }
+
+            logger.warning("RTC written %lu msec late", static_cast<unsigned long>(phase));
+        }
 
-            currentTime = ntpTime;
-            currentTimeString = formatTime(currentTime);
+        rtcUpdatePending = false;
 
-            Serial.print("Got and updated time from NTP: ");
-            Serial.println(currentTimeString);
-        }
+        const int64_t unixMillisecond = static_cast<int64_t>(millis()) + ntpOffsetMillisecond;
+        const DateTime ntpTime(static_cast<uint32_t>(unixMillisecond / 1000) + LOCAL_TIMEZONE_FROM_UTC * 3600);
 
-        lastUpdatedDay = currentTime.day();
+        setRtcTimeValue(ntpTime);
+        lastUpdatedDay = ntpTime.day();
+
+        char timeString[TIME_STRING_SIZE];
+        logger.info("Got and updated time from NTP: %s", formatTime(ntpTime, timeString));
+        logger.info("======================");
 
-        Serial.println("======================");
-        Serial.println();
+        return Scheduler::Suspend;
     }
 
-    const uint32_t end = millis();
-    const uint32_t differ = calculateTimeDifferent(start, end);
-    if (differ < timeoutMillisecond)
+    NtpTimeValue ntpTime;
+    switch (stepNtpSync(ntpTime))
     {
-        delay(timeoutMillisecond - differ);
+        case NtpSyncRunning:
+            return getNtpPollInterval();
+
+        case NtpSyncCompleted:
+            printNtpSyncStatistics();
+
+            rtcUpdatePending = true;
+            rtcUpdateRetries = 0;
+            ntpOffsetMillisecond = ntpTime.offsetMillisecond;
+            {
+                const int64_t unixMillisecond = static_cast<int64_t>(millis()) + ntpOffsetMillisecond;
+                const uint32_t remains = 1000 - static_cast<uint32_t>(unixMillisecond % 1000);
+                return (remains > 5) ? (remains - 5) : (remains + 995);
+            }
+
+        default:
+            printNtpSyncStatistics();
+            logger.info("======================");
+            return Scheduler::Suspend;
     }
+}
+
+static uint32_t getSleepingSecond(bool firstTime)
+{
+    const DateTime currentTime = getRtcTimeValue();
 
-    const uint8_t hour = currentTime.hour();
+    char timeString[TIME_STRING_SIZE];
+    logger.info("Current time from RTC: %s", formatTime(currentTime, timeString));
 
-#if (TIME_SCHEDULE_ON >= TIME_SCHEDULE_OFF)
-    if ((hour >= TIME_SCHEDULE_ON) || (hour < TIME_SCHEDULE_OFF))
+    if ((currentTime.day() != lastUpdatedDay) && !isNtpSyncRunning())
     {
-        return 0;
+        logger.info("======================");
+        logger.info("Time update start:");
+
+        // Runs in background: the sequence goes on and the RTC is updated when the reply arrives.
+        lastUpdatedDay = currentTime.day();
+        beginNtpSync(firstTime);
+        scheduler.wake(ntpTaskId);
     }
-#else
-    if ((hour >= TIME_SCHEDULE_ON) && (hour < TIME_SCHEDULE_OFF))
+
+    return getScheduleRemainsMillisecond(currentTime);
+}
+
+////////////////////////////////////////////////
+
+static bool firstTime = true;
+static uint32_t requireMillisecond = 0;
+static uint32_t scheduleCheckedMillisecond = 0;
+
+// Evaluate the schedule (and the daily NTP sync), woken by the sequence at each cycle start.
+static uint32_t scheduleTask()
+{
+    requireMillisecond = getSleepingSecond(firstTime);
+    scheduleCheckedMillisecond = millis();
+    firstTime = false;
+
+    return Scheduler::Suspend;
+}
+
+////////////////////////////////////////////////
+
+enum SignalPhases
+{
+    PhaseDark,
+    PhaseStopped,
+    PhaseWalking,
+    PhaseTransitionOn,
+    PhaseTransitionOff
+};
+
+enum SignalHooks
+{
+    HookNone,
+    HookDark,
+    HookStopped,
+    HookWalking,
+    HookTransitionOn,
+    HookTransitionOff
+};
+
+static constexpr SignalPhase signalPhases[] PROGMEM =
+{
+    // lamps, duration, next, repeatTo, repeat, hook
+    { 0, 0, PhaseDark, 0, 0, HookDark },
+    { SIGNAL_LAMP(STOP), 0, PhaseStopped, 0, 0, HookStopped },
+    { SIGNAL_LAMP(WALK), WALK_TIME, PhaseTransitionOn, 0, 0, HookWalking },
+    { SIGNAL_LAMP(STOP), TRANSITION_TIME, PhaseTransitionOff, 0, 0, HookTransitionOn },
+    { 0, TRANSITION_TIME, PhaseStopped, PhaseTransitionOn, TRANSITION_COUNT - 1, HookTransitionOff },
+};
+
+static SignalSequence signalSequence;
+
+static void signalHook(void*, const uint8_t hook)
+{
+#if TRACE_SIGNAL_EDGES
+    logger.debug("WALK %s STOP %s",
+        (hook == HookWalking) ? "HIGH" : "LOW",
+        ((hook == HookStopped) || (hook == HookTransitionOn)) ? "HIGH" : "LOW");
+#endif
+
+    switch (hook)
     {
-        return 0;
+        case HookWalking:
+            logger.info("Walking ...");
+            break;
+        case HookTransitionOn:
+            logger.info("Transition %d", TRANSITION_COUNT - signalSequence.getRepeated());
+            break;
+        case HookStopped:
+            logger.info("Done");
+            break;
+        default:
+            break;
     }
-#endif
+}
 
-    const DateTime next = DateTime(
-        currentTime.year(),
-        currentTime.month(),
-        ((hour > TIME_SCHEDULE_ON) ? 1 : 0) + currentTime.day(),
-        TIME_SCHEDULE_ON,
-        0,
-        0);
+////////////////////////////////////////////////
+
+enum SequencePhases
+{
+    Checking,
+    Deciding,
+    Running
+};
 
-    return (next.unixtime() - currentTime.unixtime()) * 1000;
+static SequencePhases sequencePhase = SequencePhases::Checking;
+
+static uint32_t getRemainsMillisecond()
+{
+    const uint32_t elapsed = calculateTimeDifferent(scheduleCheckedMillisecond, millis());
+    return (requireMillisecond > elapsed) ? (requireMillisecond - elapsed) : 0;
 }
 
 ////////////////////////////////////////////////
 
-void setup()
+#if DEEP_SLEEP_ENABLED
+
+#define DEEP_SLEEP_MAGIC 0x50434453UL   // "PCDS"
+
+// Kept in RTC user memory across deep sleep.
+struct DeepSleepMemory
 {
-    Serial.begin(115200);
+    uint32_t magic;
+    uint32_t wakeUnixTime;
+    uint32_t lastUpdatedDay;
+    uint32_t checksum;
+};
 
-    Wire.begin();
+static uint32_t calculateChecksum(const DeepSleepMemory& memory)
+{
+    return (memory.magic ^ memory.wakeUnixTime ^ memory.lastUpdatedDay) + 0x5AA5UL;
+}
 
-    delay(500);
+static void deepSleepUntil(const uint32_t wakeUnixTime, const uint32_t nowUnixTime)
+{
+    // Timer wakeup is limited by deepSleepMax() (about 3 hours), then we sleep again from setup().
+    // With DEEP_SLEEP_RTC_ALARM the DS3231 alarm pulse wakes us exactly on time.
+    const uint64_t requestMicrosecond = static_cast<uint64_t>(wakeUnixTime - nowUnixTime) * 1000000ULL;
+    const uint64_t maxMicrosecond = ESP.deepSleepMax();
 
-    digitalWrite(WALK, LOW);
-    digitalWrite(STOP, LOW);
+    while (!logger.isEmpty())
+    {
+        logger.drain();
+        yield();
+    }
+    Serial.flush();
 
-    BlinkStatus(UINT16_MAX);
+    ESP.deepSleep((requestMicrosecond < maxMicrosecond) ? requestMicrosecond : maxMicrosecond, RF_DEFAULT);
+}
 
-    delay(100);
+static void enterDeepSleep(const uint32_t remainsMillisecond)
+{
+    const uint32_t nowUnixTime = getRtcTimeValue().unixtime();
+    const uint32_t wakeUnixTime = nowUnixTime + (remainsMillisecond / 1000);
 
-    pinMode(WALK, OUTPUT);
-    pinMode(STOP, OUTPUT);
-    pinMode(STATUS, OUTPUT);
+#if DEEP_SLEEP_RTC_ALARM
+    setRtcAlarmValue(DateTime(wakeUnixTime));
+#endif
 
-    Serial.println("    ");
+    DeepSleepMemory memory;
+    memory.magic = DEEP_SLEEP_MAGIC;
+    memory.wakeUnixTime = wakeUnixTime;
+    memory.lastUpdatedDay = lastUpdatedDay;
+    memory.checksum = calculateChecksum(memory);
+    ESP.rtcUserMemoryWrite(0, reinterpret_cast<uint32_t*>(&memory), sizeof memory);
 
-    wifi_set_sleep_type(LIGHT_SLEEP_T);
+    signalSequence.jump(PhaseDark);
+    BlinkStatus(0);
+
+    // 64bit: a weekly schedule with holidays can sleep for days.
+    const uint64_t savedMicroAmpereHour =
+        static_cast<uint64_t>(MODEL_IDLE_CURRENT - MODEL_DEEP_SLEEP_CURRENT) * (remainsMillisecond / 1000) / 3600;
+
+    char timeString[TIME_STRING_SIZE];
+    logger.info("Deep sleeping until %s, modeled energy saved: %lu.%03lu mAh",
+        formatTime(DateTime(wakeUnixTime), timeString),
+        static_cast<unsigned long>(savedMicroAmpereHour / 1000),
+        static_cast<unsigned long>(savedMicroAmpereHour % 1000));
+
+    deepSleepUntil(wakeUnixTime, nowUnixTime);
+}
+
+// Restore state after deep sleep wakeup, so the first WALK starts without
+// the boot delays and the NTP sync. Goes back to sleep if woken too early.
+static bool resumeFromDeepSleep()
+{
+    DeepSleepMemory memory;
+    if (!ESP.rtcUserMemoryRead(0, reinterpret_cast<uint32_t*>(&memory), sizeof memory) ||
+        (memory.magic != DEEP_SLEEP_MAGIC) ||
+        (memory.checksum != calculateChecksum(memory)))
+    {
+        return false;
+    }
+
+    const uint32_t nowUnixTime = getRtcTimeValue().unixtime();
+    if ((nowUnixTime + 1) < memory.wakeUnixTime)
+    {
+        deepSleepUntil(memory.wakeUnixTime, nowUnixTime);
+    }
+
+    memory.magic = 0;
+    ESP.rtcUserMemoryWrite(0, reinterpret_cast<uint32_t*>(&memory), sizeof memory);
+
+#if DEEP_SLEEP_RTC_ALARM
+    clearRtcAlarm();
+#endif
+
+    lastUpdatedDay = memory.lastUpdatedDay;
+    firstTime = false;
+
+    // requireMillisecond is still 0: start from WALK right away.
+    sequencePhase = SequencePhases::Deciding;
+
+    logger.info("Resumed from deep sleep.");
+
+    return true;
+}
+
+#endif
 
-    delay(200);
+// Cycle phases. Each case runs at the deadline of the previous phase and returns
+// the duration of the phase it enters.
+static uint32_t sequenceTask()
+{
+    switch (sequencePhase)
+    {
+        case SequencePhases::Checking:
+            scheduler.wake(scheduleTaskId);
+            sequencePhase = SequencePhases::Deciding;
+            return STOP_TIME;
+
+        case SequencePhases::Deciding:
+            {
+                const uint32_t remains = getRemainsMillisecond();
+                if (remains == 0)
+                {
+                    BlinkStatus(0);
+
+                    sequencePhase = SequencePhases::Running;
+                    return signalSequence.jump(PhaseWalking);
+                }
+
+#if DEEP_SLEEP_ENABLED
+                if ((remains >= DEEP_SLEEP_MINIMUM_TIME) && !isNtpSyncRunning())
+                {
+                    enterDeepSleep(remains);
+                }
+#endif
+
+                const uint32_t sleepMillisecond =
+                    (remains < (10 * 60 * 1000))
+                        ? remains
+                        : (10 * 60 * 1000);
+
+                signalSequence.jump(PhaseDark);
+
+                logger.info("Sleeping %lu", static_cast<unsigned long>(sleepMillisecond / (60 * 1000)));
+
+                BlinkStatus(3000);
+
+                sequencePhase = SequencePhases::Checking;
+                return sleepMillisecond;
+            }
+
+        default:
+            {
+                // Walk, transition and back to stop, driven by the phase table.
+                const uint16_t duration = signalSequence.step();
+                if (signalSequence.isHolding())
+                {
+                    sequencePhase = SequencePhases::Checking;
+                }
+                return duration;
+            }
+    }
 }
 
 ////////////////////////////////////////////////
 
-static bool firstTime = true;
+static void printRtcClockStatistics()
+{
+    const RtcClockStatistics& statistics = getRtcClockStatistics();
 
-void loop()
+    logger.info("RTC clock: i2c reads=%lu, saved=%lu, drift=%ldmsec, rate=%ldppm",
+        static_cast<unsigned long>(statistics.transactions),
+        static_cast<unsigned long>(statistics.transactionsSaved),
+        static_cast<long>(statistics.lastDriftMillisecond),
+        static_cast<long>(statistics.ratePpm));
+}
+
+// Keeps the software clock disciplined to the RTC second edges.
+static uint32_t rtcTask()
 {
-    const uint32_t requireMillisecond = getSleepingSecond(STOP_TIME, firstTime);
-    firstTime = false;
-    if (requireMillisecond == 0)
+    return stepRtcClock();
+}
+
+// Periodic housekeeping: report missed phase deadlines, clock statistics and node health.
+static uint32_t housekeepingTask()
+{
+    const uint32_t lateness = scheduler.getMaxLateness();
+    if (lateness > 1)
     {
-        BlinkStatus(0);
+        logger.warning("Deadline missed by %lu msec", static_cast<unsigned long>(lateness));
+    }
 
-        Serial.print("Walking ...");
+    scheduler.resetMaxLateness();
 
-        digitalWrite(STOP, LOW);
-        digitalWrite(WALK, HIGH);
-        delay(WALK_TIME);
+    static uint8_t count = 0;
+    if (++count >= 10)
+    {
+        count = 0;
+        printRtcClockStatistics();
 
-        Serial.println(" Done");
-        Serial.print("Transition ...");
+        logger.info("Logger: dropped=%lu, worst=%luusec",
+            static_cast<unsigned long>(logger.getDroppedCount()),
+            static_cast<unsigned long>(logger.getWorstMicrosecond()));
 
-        digitalWrite(WALK, LOW);
+        // WiFi only runs for the NTP syncs, so each sync counts as a reconnect.
+        metrics.print("Controller", scheduler.getOverrunCount());
+        metrics.resetLoop();
+    }
 
-        for (int i = 0; i < TRANSITION_COUNT; i++)
-        {
-            Serial.print(" ");
-            Serial.print(TRANSITION_COUNT - i, DEC);
-        
-            digitalWrite(STOP, HIGH);
-            delay(TRANSITION_TIME);
-            digitalWrite(STOP, LOW);
-            delay(TRANSITION_TIME);
-        }
+    return 60 * 1000;
+}
+
+////////////////////////////////////////////////
+
+#if BENCHMARK_ON_BOOT
+// The per-cycle path, printed as JSON lines before the tasks start.
+// Inputs are volatile, so the calls can't be folded into constants.
+static void runBenchmarks()
+{
+    SignalBenchmark benchmark(&Serial, "PedestrianController");
+
+    const DateTime time(2018, 5, 19, 3, 45, 30);
+    char buffer[TIME_STRING_SIZE];
+    benchmark.run("formatTime", 200, [&]() { SignalBenchmark::keep(formatTime(time, buffer)); });
+
+    volatile uint32_t start = UINT32_MAX - 1000;
+    volatile uint32_t end = 2000;
+    benchmark.run("calculateTimeDifferent", 1000, [&]()
+    {
+        SignalBenchmark::keep(calculateTimeDifferent(start, end));
+    });
+
+    // A server response to our own request, as received.
+    const uint32_t cookieHigh = 0x12345678;
+    const uint32_t cookieLow = 0x9abcdef0;
+    uint8_t packet[NTP_PACKET_SIZE];
+    encodeNtpRequest(packet, cookieHigh, cookieLow);
+    packet[0] = 0x24;   // LI 0, version 4, mode 4 (server)
+    packet[1] = 2;
+    writeNtpWord(packet + 24, cookieHigh);
+    writeNtpWord(packet + 28, cookieLow);
+    writeNtpWord(packet + 32, NTP_UNIX_EPOCH + time.unixtime());
+    writeNtpWord(packet + 36, 0x40000000);
+    writeNtpWord(packet + 40, NTP_UNIX_EPOCH + time.unixtime());
+    writeNtpWord(packet + 44, 0x40100000);
+    volatile uint32_t t1 = 100000;
+    volatile uint32_t t4 = 100040;
+    benchmark.run("decodeNtpTimestamp", 1000, [&]() { SignalBenchmark::keep(decodeNtpTimestamp(packet + 40)); });
+    benchmark.run("decodeNtpResponse", 1000, [&]()
+    {
+        NtpSample sample;
+        SignalBenchmark::keep(decodeNtpResponse(packet, cookieHigh, cookieLow, t1, t4, sample));
+        SignalBenchmark::keep(sample);
+    });
+
+    // Off at that time, so the next window is searched.
+    benchmark.run("getScheduleRemainsMillisecond", 200, [&]()
+    {
+        SignalBenchmark::keep(getScheduleRemainsMillisecond(time));
+    });
+    volatile uint32_t localUnixTime = time.unixtime();
+    benchmark.run("scheduleIsOn", 1000, [&]() { SignalBenchmark::keep(schedule.isOn(localUnixTime)); });
+}
+#endif
+
+void setup()
+{
+    Serial.begin(115200);
+    logger.begin(&Serial, TRACE_SIGNAL_EDGES ? LogDebug : LogInfo);
 
-        Serial.println(" Done");
+    Wire.begin();
+
+#if DEEP_SLEEP_ENABLED
+    const bool resumed = resumeFromDeepSleep();
+#else
+    const bool resumed = false;
+#endif
 
-        digitalWrite(STOP, HIGH);
+    if (!resumed)
+    {
+        delay(500);
     }
-    else
+
+    digitalWrite(WALK, LOW);
+    digitalWrite(STOP, LOW);
+
+    BlinkStatus(UINT16_MAX);
+
+    if (!resumed)
     {
-        const uint32_t sleepMillisecond =
-            (requireMillisecond < (10 * 60 * 1000))
-                ? requireMillisecond
-                : (10 * 60 * 1000);
+        delay(100);
+    }
 
-        Serial.print("Sleeping ");
-        Serial.println(sleepMillisecond / (60 * 1000), DEC);
+    pinMode(WALK, OUTPUT);
+    pinMode(STOP, OUTPUT);
+    pinMode(STATUS, OUTPUT);
 
-        digitalWrite(WALK, LOW);
-        digitalWrite(STOP, LOW);
+    signalSequence.begin(signalPhases, SIGNAL_LAMP(WALK) | SIGNAL_LAMP(STOP), PhaseDark, signalHook);
 
-        BlinkStatus(3000);
+    Serial.println("    ");
 
-        delay(sleepMillisecond);
+    wifi_set_sleep_type(LIGHT_SLEEP_T);
+
+    if (!resumed)
+    {
+        delay(200);
     }
+
+    schedule.build(
+        scheduleWindows, sizeof scheduleWindows / sizeof scheduleWindows[0],
+        scheduleHolidays, sizeof scheduleHolidays / sizeof scheduleHolidays[0]);
+
+#if BENCHMARK_ON_BOOT
+    runBenchmarks();
+#endif
+
+    sequenceTaskId = scheduler.add(sequenceTask, true);
+    scheduleTaskId = scheduler.add(scheduleTask, false);
+    ntpTaskId = scheduler.add(ntpTask, false);
+    housekeepingTaskId = scheduler.add(housekeepingTask, true);
+    rtcTaskId = scheduler.add(rtcTask, true);
+}
+
+void loop()
+{
+    scheduler.runAndSleep(logger.isEmpty() ? 1000 : 10);
+    metrics.record(scheduler.getLastRunMicrosecond());
+
+    logger.drain();
 }
@@ -3,6 +3,8 @@
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
 #include <user_interface.h>
+#include <lwip/dns.h>
+#include <lwip/dhcp.h>
 
 // https://github.com/NorthernWidget/DS3231
 #include <DS3231.h>
@@ -10,200 +12,651 @@
 ////////////////////////////////////////////////
 
 #include "PedestrianControllerConfig.h"
+#include "NtpClient.h"
+#include "NtpPacket.h"
+#include "RtcController.h"
+
+#include <SignalLogger.h>
 
-static const int NTP_PACKET_SIZE = 48; // NTP time stamp is in the first 48 bytes of the message
 static byte packetBuffer[NTP_PACKET_SIZE]; //buffer to hold incoming and outgoing packets
 
+static const char* const serverNames[] = { SNTP_SERVER_FQDNS };
+static const uint8_t serverCount = sizeof serverNames / sizeof serverNames[0];
+
 void BlinkStatus(const uint16_t msec);
 
 ////////////////////////////////////////////////
 
-// send an NTP request to the time server at the given address
-static void sendNtpPacket(WiFiUDP &udp, const IPAddress &address)
+static const char* getWiFiStatusName(const int status)
+{
+    switch (status)
+    {
+        case WL_CONNECTED:
+            return "WL_CONNECTED";
+        case WL_IDLE_STATUS:
+            return "WL_IDLE_STATUS";
+        case WL_NO_SSID_AVAIL:
+            return "WL_NO_SSID_AVAIL";
+        case WL_SCAN_COMPLETED:
+            return "WL_SCAN_COMPLETED";
+        case WL_CONNECT_FAILED:
+            return "WL_CONNECT_FAILED";
+        case WL_CONNECTION_LOST:
+            return "WL_CONNECTION_LOST";
+        case WL_DISCONNECTED:
+            return "WL_DISCONNECTED";
+        default:
+            return "(Unknow)";
+    }
+}
+
+////////////////////////////////////////////////
+
+enum NtpSyncStates
 {
-    Serial.println("sending NTP packet...");
+    Idle,
+    Associating,
+    Resolving,
+    ResolveWaiting,
+    Requesting,
+    Receiving,
+    Backoff
+};
+
+static NtpSyncStates state = NtpSyncStates::Idle;
+static bool retrying = false;
+static int lastStatus = -1;
+static uint32_t syncStarted = 0;
+static uint32_t stateStarted = 0;
+static uint32_t backoffMillisecond = 0;
+
+static WiFiUDP udp;
+static NtpSyncStatistics statistics;
+
+static IPAddress serverAddresses[serverCount];
+static bool serverResolved[serverCount];
+static uint32_t serverSent[serverCount];   // T1 of the outstanding request, 0 when answered
+static uint8_t burstRound = 0;
+
+// Lookups in flight, answered by onDnsFound() from the lwIP context between loop() calls.
+// The generation in the callback argument drops answers that arrive after a timeout.
+static uint8_t dnsPending = 0;
+static uint8_t dnsGeneration = 0;
+
+static NtpClockFilter<serverCount> filter;
 
-    // set all bytes in the buffer to 0
-    memset(packetBuffer, 0, NTP_PACKET_SIZE);
+////////////////////////////////////////////////
 
-    // Initialize values needed to form NTP request
-    // (see URL above for details on the packets)
-    packetBuffer[0] = 0b11100011; // LI, Version, Mode
-    packetBuffer[1] = 0;          // Stratum, or type of clock
-    packetBuffer[2] = 6;          // Polling Interval
-    packetBuffer[3] = 0xEC;       // Peer Clock Precision
-    // 8 bytes of zero for Root Delay & Root Dispersion
-    packetBuffer[12] = 49;
-    packetBuffer[13] = 0x4E;
-    packetBuffer[14] = 49;
-    packetBuffer[15] = 52;
+#define WIFI_CACHE_MAGIC 0x50435732UL   // "PCW2"
+#define WIFI_CACHE_MAX_SERVERS 4
 
-    // all NTP fields have been given values, now
-    // you can send a packet requesting a timestamp:
-    udp.beginPacket(address, 123); //NTP requests are to port 123
-    udp.write(packetBuffer, NTP_PACKET_SIZE);
-    udp.endPacket();
+// Last good association and DNS results, kept in RTC user memory (survives deep sleep),
+// so the next sync can join the known BSSID/channel with a static IP and skip DNS.
+// The static IP is ours only while the DHCP lease lasts, and fast reconnects never renew it,
+// so the cache expires a lease after the full connect that got the address.
+struct WiFiCache
+{
+    uint32_t magic;
+    uint32_t leasedUnixTime;     // RTC time of the full (DHCP) connect
+    uint32_t leaseSecond;
+    uint32_t localIP;
+    uint32_t gatewayIP;
+    uint32_t subnetMask;
+    uint32_t dnsIP;
+    uint32_t serverIPs[WIFI_CACHE_MAX_SERVERS];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t serversValid;
+    uint32_t checksum;
+};
+
+static_assert(serverCount <= WIFI_CACHE_MAX_SERVERS, "Too many SNTP_SERVER_FQDNS.");
+
+static WiFiCache cache;
+static bool fastConnecting = false;
+
+// Connection times of the recent syncs, for percentiles.
+static uint16_t connectHistory[WIFI_CONNECT_HISTORY];
+static uint8_t connectHistoryCount = 0;
+static uint8_t connectHistoryIndex = 0;
+
+static uint32_t calculateCacheChecksum(const WiFiCache& value)
+{
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(&value);
+    uint32_t checksum = 0x5AA5UL;
+    for (size_t index = 0; index < (offsetof(WiFiCache, checksum) / sizeof(uint32_t)); index++)
+    {
+        checksum = ((checksum << 5) | (checksum >> 27)) ^ p[index];
+    }
+    return checksum;
 }
 
-////////////////////////////////////////////////
+static bool loadWiFiCache()
+{
+    if ((cache.magic != WIFI_CACHE_MAGIC) &&
+        !ESP.rtcUserMemoryRead(WIFI_CACHE_RTC_OFFSET, reinterpret_cast<uint32_t*>(&cache), sizeof cache))
+    {
+        return false;
+    }
+
+    if ((cache.magic != WIFI_CACHE_MAGIC) || (cache.checksum != calculateCacheChecksum(cache)))
+    {
+        cache.magic = 0;
+        return false;
+    }
+
+    const uint32_t age = getRtcTimeValue().unixtime() - cache.leasedUnixTime;
+    if ((age >= WIFI_CACHE_LIFETIME) || (age >= cache.leaseSecond))
+    {
+        cache.magic = 0;
+        return false;
+    }
 
-bool getNtpTimeValue(DateTime& time, bool retry)
+    return true;
+}
+
+// Persist the RAM copy, it only leaves RTC user memory out of date otherwise.
+static void storeWiFiCache()
 {
-    wifi_set_sleep_type(NONE_SLEEP_T);
+    cache.checksum = calculateCacheChecksum(cache);
 
-    // We start by connecting to a WiFi network
-    Serial.print("Connecting to ");
-    Serial.println(WIFI_SSID);
+    ESP.rtcUserMemoryWrite(WIFI_CACHE_RTC_OFFSET, reinterpret_cast<uint32_t*>(&cache), sizeof cache);
+}
 
-    BlinkStatus(600);
+static void invalidateWiFiCache()
+{
+    cache.magic = 0;
+    cache.checksum = 0;
 
-    WiFi.mode(WIFI_STA);
+    ESP.rtcUserMemoryWrite(WIFI_CACHE_RTC_OFFSET, reinterpret_cast<uint32_t*>(&cache), sizeof cache);
+}
+
+static void beginFullConnect()
+{
+    fastConnecting = false;
+
+    // Back to DHCP.
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+}
+
+static void beginFastConnect()
+{
+    fastConnecting = true;
+
+    WiFi.config(IPAddress(cache.localIP), IPAddress(cache.gatewayIP), IPAddress(cache.subnetMask), IPAddress(cache.dnsIP));
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, cache.channel, cache.bssid);
+}
+
+static void recordConnectTime(const uint32_t elapsed)
+{
+    connectHistory[connectHistoryIndex] = (elapsed < UINT16_MAX) ? static_cast<uint16_t>(elapsed) : UINT16_MAX;
+    connectHistoryIndex = (connectHistoryIndex + 1) % WIFI_CONNECT_HISTORY;
+    if (connectHistoryCount < WIFI_CONNECT_HISTORY)
+    {
+        connectHistoryCount++;
+    }
 
-    // 45sec
-    auto connected = false;
-    int lastStatus = -1;
-    for (int i = 0; i < 450; i++)
+    uint16_t sorted[WIFI_CONNECT_HISTORY];
+    for (uint8_t index = 0; index < connectHistoryCount; index++)
     {
-        const int status = WiFi.status();
-        if (lastStatus != status)
+        // Insertion sort, a few entries.
+        uint8_t position = index;
+        while ((position > 0) && (sorted[position - 1] > connectHistory[index]))
         {
-            Serial.print("  status = ");
-            switch (status)
-            {
-                case WL_CONNECTED:
-                    Serial.println("WL_CONNECTED");
-                    break;
-                case WL_IDLE_STATUS:
-                    Serial.println("WL_IDLE_STATUS");
-                    break;
-                case WL_NO_SSID_AVAIL:
-                    Serial.println("WL_NO_SSID_AVAIL");
-                    break;
-                case WL_SCAN_COMPLETED:
-                    Serial.println("WL_SCAN_COMPLETED");
-                    break;
-                case WL_CONNECT_FAILED:
-                    Serial.println("WL_CONNECT_FAILED");
-                    break;
-                case WL_CONNECTION_LOST:
-                    Serial.println("WL_CONNECTION_LOST");
-                    break;
-                case WL_DISCONNECTED:
-                    Serial.println("WL_DISCONNECTED");
-                    break;
-                default:
-                    Serial.println("(Unknow)");
-                    break;
-            }
+            sorted[position] = sorted[position - 1];
+            position--;
+        }
+        sorted[position] = connectHistory[index];
+    }
 
-            lastStatus = status;
+    statistics.connectP50Millisecond = sorted[(connectHistoryCount - 1) / 2];
+    statistics.connectP90Millisecond = sorted[((connectHistoryCount - 1) * 9) / 10];
+    statistics.connectMaxMillisecond = sorted[connectHistoryCount - 1];
+}
 
-            if (status == WL_CONNECTED)
-            {
-                connected = true;
-                break;
-            }
-        }
+static void resolvedServer(const uint8_t server, const IPAddress& address)
+{
+    serverAddresses[server] = address;
+    serverResolved[server] = true;
+    cache.serverIPs[server] = address;
+    cache.serversValid |= 1 << server;
+}
 
-        delay(100);
+static void onDnsFound(const char* name, const ip_addr_t* ipaddr, void* callbackArg)
+{
+    const uintptr_t value = reinterpret_cast<uintptr_t>(callbackArg);
+    const uint8_t server = static_cast<uint8_t>(value & 0xff);
+    if ((static_cast<uint8_t>(value >> 8) != dnsGeneration) || ((dnsPending & (1 << server)) == 0))
+    {
+        return;
     }
 
-    if (!connected)
+    dnsPending &= ~(1 << server);
+    if (ipaddr != nullptr)
+    {
+        resolvedServer(server, IPAddress(ipaddr));
+    }
+    else
     {
-        BlinkStatus(300);
+        logger.warning("  DNS lookup failed: %s", name);
+    }
+}
 
-        //WiFi.mode(WIFI_OFF);
-        //WiFi.forceSleepBegin();
+// Starts all lookups without waiting, cached names complete right here.
+static void beginResolve()
+{
+    dnsGeneration++;
+    dnsPending = 0;
 
-        wifi_set_sleep_type(LIGHT_SLEEP_T);
+    for (uint8_t server = 0; server < serverCount; server++)
+    {
+        serverResolved[server] = false;
 
-        Serial.println("Timeout, give up.");
+        ip_addr_t address;
+        const err_t result = dns_gethostbyname(serverNames[server], &address, onDnsFound,
+            reinterpret_cast<void*>((static_cast<uintptr_t>(dnsGeneration) << 8) | server));
+        if (result == ERR_OK)
+        {
+            resolvedServer(server, IPAddress(&address));
+        }
+        else if (result == ERR_INPROGRESS)
+        {
+            dnsPending |= 1 << server;
+        }
+        else
+        {
+            logger.warning("  DNS lookup failed: %s", serverNames[server]);
+        }
+    }
+}
 
-        delay(3000);
+static void enterState(const NtpSyncStates newState)
+{
+    state = newState;
+    stateStarted = millis();
+}
 
-        BlinkStatus(UINT16_MAX);
+static uint32_t getStateElapsed()
+{
+    return millis() - stateStarted;
+}
 
-        return false;
-    }
+static void enterBackoff()
+{
+    BlinkStatus(100);
+    enterState(NtpSyncStates::Backoff);
+}
 
-    Serial.println("WiFi connected.");
-    Serial.print("  IP address: ");
-    Serial.println(WiFi.localIP());
+static NtpSyncResults finishNtpSync(const NtpSyncResults result)
+{
+    udp.stop();
 
-    Serial.println("Starting UDP");
+    WiFi.disconnect();
+    WiFi.mode(WIFI_OFF);
+    WiFi.forceSleepBegin();
 
-    do
+    wifi_set_sleep_type(LIGHT_SLEEP_T);
+
+    BlinkStatus(UINT16_MAX);
+
+    statistics.wifiOnMillisecond = millis() - syncStarted;
+    state = NtpSyncStates::Idle;
+
+    return result;
+}
+
+////////////////////////////////////////////////
+
+void beginNtpSync(bool retry)
+{
+    wifi_set_sleep_type(NONE_SLEEP_T);
+
+    // We start by connecting to a WiFi network
+    logger.info("Connecting to %s", WIFI_SSID);
+
+    BlinkStatus(600);
+
+    WiFi.forceSleepWake();
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+
+    const NtpSyncStatistics last = statistics;
+    memset(&statistics, 0, sizeof statistics);
+    statistics.connectP50Millisecond = last.connectP50Millisecond;
+    statistics.connectP90Millisecond = last.connectP90Millisecond;
+    statistics.connectMaxMillisecond = last.connectMaxMillisecond;
+
+    if (loadWiFiCache())
+    {
+        beginFastConnect();
+    }
+    else
     {
-        WiFiUDP udp;
-        udp.begin(SNTP_SERVER_PORT);
+        beginFullConnect();
+    }
 
-        Serial.print("Local port: ");
-        Serial.println(udp.localPort());
+    retrying = retry;
+    lastStatus = -1;
+    backoffMillisecond = NTP_BACKOFF_INITIAL;
+    syncStarted = millis();
 
-        //get a random server from the pool
-        IPAddress timeServerIP;
-        WiFi.hostByName(SNTP_SERVER_FQDN, timeServerIP);
+    enterState(NtpSyncStates::Associating);
+}
 
-        sendNtpPacket(udp, timeServerIP); // send an NTP packet to a time server
+bool isNtpSyncRunning()
+{
+    return state != NtpSyncStates::Idle;
+}
 
-        delay(1000);
+uint32_t getNtpPollInterval()
+{
+    return (state == NtpSyncStates::Receiving) ? NTP_RECEIVE_POLL_INTERVAL : NTP_POLL_INTERVAL;
+}
 
-        const int cb = udp.parsePacket();
-        if (cb)
-        {
-            Serial.print("  packet received, length=");
-            Serial.println(cb);
+const NtpSyncStatistics& getNtpSyncStatistics()
+{
+    return statistics;
+}
 
-            // We've received a packet, read the data from it
-            udp.read(packetBuffer, NTP_PACKET_SIZE); // read the packet into the buffer
+static void sendRound()
+{
+    burstRound++;
 
-            WiFi.disconnect();
-            WiFi.mode(WIFI_OFF);
-            WiFi.forceSleepBegin();
+    for (uint8_t server = 0; server < serverCount; server++)
+    {
+        if (!serverResolved[server])
+        {
+            continue;
+        }
 
-            wifi_set_sleep_type(LIGHT_SLEEP_T);
+        // T1 and the round go into the cookie, receivePacket() expects them back.
+        uint32_t t1 = millis();
+        t1 = (t1 != 0) ? t1 : 1;   // 0 marks an answered server
+        encodeNtpRequest(packetBuffer, t1, (static_cast<uint32_t>(server) << 8) | burstRound);
 
-            BlinkStatus(UINT16_MAX);
+        udp.beginPacket(serverAddresses[server], 123); //NTP requests are to port 123
+        udp.write(packetBuffer, NTP_PACKET_SIZE);
+        udp.endPacket();
 
-            //the timestamp starts at byte 40 of the received packet and is four bytes,
-            // or two words, long. First, esxtract the two words:
-            const uint32_t highWord = word(packetBuffer[40], packetBuffer[41]);
-            const uint32_t lowWord = word(packetBuffer[42], packetBuffer[43]);
+        serverSent[server] = t1;
+        statistics.requests++;
+    }
 
-            // combine the four bytes (two words) into a long integer
-            // this is NTP time (seconds since Jan 1 1900):
-            const uint32_t secsSince1900 = highWord << 16 | lowWord;
+    logger.info("sending NTP packets, round %u", burstRound);
+}
 
-            // Unix time starts on Jan 1 1970. In seconds, that's 2208988800:
-            const uint32_t seventyYears = 2208988800UL;
+static void receivePacket(const uint32_t t4, const int size)
+{
+    if (size < NTP_PACKET_SIZE)
+    {
+        udp.flush();
+        return;
+    }
 
-            // subtract seventy years:
-            const uint32_t epoch = secsSince1900 - seventyYears;
-            
-            const uint32_t localTime = epoch + LOCAL_TIMEZONE_FROM_UTC * 3600;
+    // We've received a packet, read the data from it
+    udp.read(packetBuffer, NTP_PACKET_SIZE); // read the packet into the buffer
 
-            time = DateTime(localTime);
-            return true;
+    const IPAddress remoteIP = udp.remoteIP();
+    for (uint8_t server = 0; server < serverCount; server++)
+    {
+        if (!serverResolved[server] || (serverAddresses[server] != remoteIP))
+        {
+            continue;
         }
 
-        BlinkStatus(100);
+        // Only the reply to the outstanding request: the originate must echo the cookie
+        // sent to this server this round, a stale, repeated or forged one is dropped.
+        const uint32_t t1 = serverSent[server];
+        if (t1 == 0)
+        {
+            break;
+        }
+        const uint32_t cookieLow = (static_cast<uint32_t>(server) << 8) | burstRound;
 
-        Serial.println("  no packet yet");
+        NtpSample sample;
+        if (decodeNtpResponse(packetBuffer, t1, cookieLow, t1, t4, sample))
+        {
+            serverSent[server] = 0;
+            filter.add(server, sample);
+
+            logger.info("  %s: offset=%ldmsec, delay=%lumsec, stratum=%u",
+                serverNames[server],
+                static_cast<long>(sample.offsetMillisecond % 1000000),
+                static_cast<unsigned long>(sample.delayMillisecond),
+                sample.stratum);
+        }
+        break;
+    }
+}
 
-        delay(1000);
-        
-        BlinkStatus(UINT16_MAX);
+static bool isRoundCompleted()
+{
+    for (uint8_t server = 0; server < serverCount; server++)
+    {
+        if (serverResolved[server] && (serverSent[server] != 0))
+        {
+            return false;
+        }
     }
-    while (retry);
+    return true;
+}
 
-    WiFi.disconnect();
-    WiFi.mode(WIFI_OFF);
-    WiFi.forceSleepBegin();
+////////////////////////////////////////////////
 
-    wifi_set_sleep_type(LIGHT_SLEEP_T);
+// Advance the sync by one non-blocking step.
+NtpSyncResults stepNtpSync(NtpTimeValue& time)
+{
+    switch (state)
+    {
+        case NtpSyncStates::Associating:
+            {
+                const int status = WiFi.status();
+                if (lastStatus != status)
+                {
+                    logger.info("  status = %s", getWiFiStatusName(status));
+                    lastStatus = status;
+                }
+
+                if (status == WL_CONNECTED)
+                {
+                    statistics.associationMillisecond = millis() - syncStarted;
+                    statistics.fastConnected = fastConnecting;
+                    recordConnectTime(statistics.associationMillisecond);
+
+                    if (!fastConnecting)
+                    {
+                        const dhcp* pDhcp = netif_dhcp_data(netif_default);
+                        const uint32_t leaseSecond = (pDhcp != nullptr) ? pDhcp->offered_t0_lease : 0;
+
+                        cache.magic = WIFI_CACHE_MAGIC;
+                        cache.leasedUnixTime = getRtcTimeValue().unixtime();
+                        cache.leaseSecond = (leaseSecond != 0) ? leaseSecond : WIFI_CACHE_LIFETIME;
+
+                        const uint8_t* pBssid = WiFi.BSSID();
+                        memcpy(cache.bssid, pBssid, sizeof cache.bssid);
+                        cache.channel = static_cast<uint8_t>(WiFi.channel());
+                        cache.localIP = WiFi.localIP();
+                        cache.gatewayIP = WiFi.gatewayIP();
+                        cache.subnetMask = WiFi.subnetMask();
+                        cache.dnsIP = WiFi.dnsIP();
+                        cache.serversValid = 0;
+                        storeWiFiCache();
+                    }
+
+                    const IPAddress localIP = WiFi.localIP();
+                    logger.info("WiFi connected.");
+                    logger.info("  IP address: %u.%u.%u.%u", localIP[0], localIP[1], localIP[2], localIP[3]);
+
+                    logger.info("Starting UDP");
+
+                    udp.begin(SNTP_SERVER_PORT);
+
+                    logger.info("Local port: %u", udp.localPort());
+
+                    enterState(NtpSyncStates::Resolving);
+                }
+                else if (fastConnecting && (getStateElapsed() >= WIFI_FAST_CONNECT_TIMEOUT))
+                {
+                    logger.warning("Fast reconnect failed, fallback to full connect.");
+
+                    invalidateWiFiCache();
+                    WiFi.disconnect();
+                    beginFullConnect();
+
+                    enterState(NtpSyncStates::Associating);
+                }
+                else if (getStateElapsed() >= NTP_CONNECT_TIMEOUT)
+                {
+                    logger.warning("Timeout, give up.");
+                    return finishNtpSync(NtpSyncFailed);
+                }
+            }
+            break;
+
+        case NtpSyncStates::Resolving:
+            {
+                if (cache.serversValid != 0)
+                {
+                    for (uint8_t server = 0; server < serverCount; server++)
+                    {
+                        serverResolved[server] = (cache.serversValid & (1 << server)) != 0;
+                        serverAddresses[server] = IPAddress(cache.serverIPs[server]);
+                    }
+
+                    enterState(NtpSyncStates::Requesting);
+                    break;
+                }
+
+                beginResolve();
+                enterState(NtpSyncStates::ResolveWaiting);
+            }
+            break;
+
+        case NtpSyncStates::ResolveWaiting:
+            {
+                if ((dnsPending != 0) && (getStateElapsed() < NTP_DNS_TIMEOUT))
+                {
+                    break;
+                }
+
+                statistics.dnsMillisecond += getStateElapsed();
+
+                uint8_t resolvedCount = 0;
+                for (uint8_t server = 0; server < serverCount; server++)
+                {
+                    if (dnsPending & (1 << server))
+                    {
+                        logger.warning("  DNS lookup timeout: %s", serverNames[server]);
+                    }
+                    if (serverResolved[server])
+                    {
+                        resolvedCount++;
+                    }
+                }
+
+                // Late answers are for an old generation from here on.
+                dnsPending = 0;
+                dnsGeneration++;
+
+                if (resolvedCount == 0)
+                {
+                    statistics.attempts++;
+                    enterBackoff();
+                    break;
+                }
+
+                enterState(NtpSyncStates::Requesting);
+            }
+            break;
+
+        case NtpSyncStates::Requesting:
+            statistics.attempts++;
 
-    delay(1000);
+            // Drop stale replies from a previous attempt.
+            while (udp.parsePacket() > 0)
+            {
+                udp.flush();
+            }
+
+            filter.clear();
+            burstRound = 0;
+            sendRound();
+
+            enterState(NtpSyncStates::Receiving);
+            break;
+
+        case NtpSyncStates::Receiving:
+            {
+                const int cb = udp.parsePacket();
+                if (cb > 0)
+                {
+                    receivePacket(millis(), cb);
+                }
+
+                const bool completed = isRoundCompleted();
+                if (!completed && (getStateElapsed() < NTP_RESPONSE_TIMEOUT))
+                {
+                    break;
+                }
+
+                // Another round lets the clock filter pick a less delayed sample.
+                NtpSample selected = NtpSample();
+                const bool hasSelected = filter.select(selected);
+                if ((burstRound < NTP_BURST_ROUNDS) &&
+                    (!hasSelected || (selected.distanceMillisecond > NTP_TARGET_ERROR)))
+                {
+                    if (getStateElapsed() >= NTP_BURST_INTERVAL)
+                    {
+                        sendRound();
+                        enterState(NtpSyncStates::Receiving);
+                    }
+                    break;
+                }
+
+                if (!hasSelected)
+                {
+                    // Cached server addresses may be stale, resolve again next time.
+                    logger.warning("  no packet yet");
+                    cache.serversValid = 0;
+                    storeWiFiCache();
+                    enterBackoff();
+                    break;
+                }
+
+                // Keeps the resolved addresses, the lease time is left as it was.
+                storeWiFiCache();
+
+                statistics.servers = filter.getCount();
+                statistics.roundTripMillisecond = selected.delayMillisecond;
+                statistics.errorMillisecond = selected.distanceMillisecond;
+
+                time.offsetMillisecond = selected.offsetMillisecond;
+                time.errorMillisecond = selected.distanceMillisecond;
+                return finishNtpSync(NtpSyncCompleted);
+            }
+
+        case NtpSyncStates::Backoff:
+            if (!retrying || (statistics.attempts >= NTP_MAX_ATTEMPTS))
+            {
+                return finishNtpSync(NtpSyncFailed);
+            }
+
+            if (getStateElapsed() >= backoffMillisecond)
+            {
+                backoffMillisecond = (backoffMillisecond < (NTP_BACKOFF_MAX / 2))
+                    ? (backoffMillisecond * 2)
+                    : NTP_BACKOFF_MAX;
+
+                BlinkStatus(600);
+
+                enterState(NtpSyncStates::Resolving);
+            }
+            break;
+
+        default:
+            return NtpSyncFailed;
+    }
 
-    return false;
+    return NtpSyncRunning;
 }
@@ -0,0 +1,51 @@
+#ifndef PEDESTRIAN_CONTROLLER_NTP_CLIENT_H
+#define PEDESTRIAN_CONTROLLER_NTP_CLIENT_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////
+
+enum NtpSyncResults
+{
+    NtpSyncRunning,
+    NtpSyncCompleted,
+    NtpSyncFailed
+};
+
+// Result of a sync: unix msec = millis() + offsetMillisecond.
+struct NtpTimeValue
+{
+    int64_t offsetMillisecond;
+    uint32_t errorMillisecond;
+};
+
+// Timing of the last (or current) sync, all in msec.
+struct NtpSyncStatistics
+{
+    uint8_t attempts;
+    uint8_t requests;
+    uint8_t servers;
+    uint32_t associationMillisecond;
+    uint32_t dnsMillisecond;
+    uint32_t roundTripMillisecond;
+    uint32_t errorMillisecond;
+    uint32_t wifiOnMillisecond;
+    bool fastConnected;                // joined from the cached BSSID/channel/IP
+    uint32_t connectP50Millisecond;    // over the recent syncs
+    uint32_t connectP90Millisecond;
+    uint32_t connectMaxMillisecond;
+};
+
+// Start a sync. It then advances by stepNtpSync() calls from the main loop,
+// each of which returns without waiting.
+void beginNtpSync(bool retry);
+NtpSyncResults stepNtpSync(NtpTimeValue& time);
+bool isNtpSyncRunning();
+
+// msec until the next stepNtpSync() is useful: short only while a reply is due,
+// since the receive time of a reply is taken when it is polled.
+uint32_t getNtpPollInterval();
+
+const NtpSyncStatistics& getNtpSyncStatistics();
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef PEDESTRIAN_CONTROLLER_NTP_PACKET_H
+#define PEDESTRIAN_CONTROLLER_NTP_PACKET_H
+
+#include <stdint.h>
+#include <string.h>
+
+// NTP packet encoding and RFC 5905 style sample filtering.
+// Pure calculation without Arduino APIs, local time is any millisecond counter (millis()).
+
+////////////////////////////////////////////////
+
+#define NTP_PACKET_SIZE 48         // NTP time stamp is in the first 48 bytes of the message
+#define NTP_UNIX_EPOCH 2208988800UL   // Unix time starts on Jan 1 1970. In seconds, that's 2208988800
+
+// One server response, reduced to what the filter needs.
+struct NtpSample
+{
+    int64_t offsetMillisecond;     // unix msec minus local msec
+    uint32_t delayMillisecond;     // round trip minus server processing
+    uint32_t distanceMillisecond;  // error bound: delay / 2 + root delay / 2 + root dispersion
+    uint8_t stratum;
+};
+
+static inline uint32_t readNtpWord(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+        (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void writeNtpWord(uint8_t* p, const uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+// 64bit timestamp (seconds since 1900 . 32bit fraction) to unix msec.
+static inline int64_t decodeNtpTimestamp(const uint8_t* p)
+{
+    const uint32_t seconds = readNtpWord(p);
+    const uint32_t fraction = readNtpWord(p + 4);
+
+    return (static_cast<int64_t>(seconds) - NTP_UNIX_EPOCH) * 1000 +
+        static_cast<int64_t>((static_cast<uint64_t>(fraction) * 1000) >> 32);
+}
+
+// 32bit short format (seconds . 16bit fraction) to msec.
+static inline uint32_t decodeNtpShort(const uint8_t* p)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(readNtpWord(p)) * 1000) >> 16);
+}
+
+// Build a client request. The transmit timestamp carries an opaque cookie,
+// the server echoes it back as the originate timestamp.
+static inline void encodeNtpRequest(uint8_t* pPacket, const uint32_t cookieHigh, const uint32_t cookieLow)
+{
+    // set all bytes in the buffer to 0
+    memset(pPacket, 0, NTP_PACKET_SIZE);
+
+    pPacket[0] = 0b11100011; // LI, Version, Mode
+    pPacket[1] = 0;          // Stratum, or type of clock
+    pPacket[2] = 6;          // Polling Interval
+    pPacket[3] = 0xEC;       // Peer Clock Precision
+    // 8 bytes of zero for Root Delay & Root Dispersion
+    pPacket[12] = 49;
+    pPacket[13] = 0x4E;
+    pPacket[14] = 49;
+    pPacket[15] = 52;
+
+    writeNtpWord(pPacket + 40, cookieHigh);
+    writeNtpWord(pPacket + 44, cookieLow);
+}
+
+// Decode a server response using all four timestamps:
+//   T1 = local transmit, T2 = server receive, T3 = server transmit, T4 = local receive.
+static inline bool decodeNtpResponse(
+    const uint8_t* pPacket, const uint32_t cookieHigh, const uint32_t cookieLow,
+    const uint32_t t1, const uint32_t t4, NtpSample& sample)
+{
+    const uint8_t leap = pPacket[0] >> 6;
+    const uint8_t mode = pPacket[0] & 0x07;
+    const uint8_t stratum = pPacket[1];
+    if ((leap == 3) || (mode != 4) || (stratum == 0) || (stratum >= 16))
+    {
+        return false;
+    }
+
+    // Originate must be our cookie, otherwise it's stale or spoofed.
+    if ((readNtpWord(pPacket + 24) != cookieHigh) || (readNtpWord(pPacket + 28) != cookieLow))
+    {
+        return false;
+    }
+    if (readNtpWord(pPacket + 40) == 0)
+    {
+        return false;
+    }
+
+    const int64_t t2 = decodeNtpTimestamp(pPacket + 32);
+    const int64_t t3 = decodeNtpTimestamp(pPacket + 40);
+
+    int64_t delay = static_cast<int64_t>(static_cast<uint32_t>(t4 - t1)) - (t3 - t2);
+    if (delay < 0)
+    {
+        delay = 0;
+    }
+
+    // offset = ((T2 - T1) + (T3 - T4)) / 2, with T1/T4 on the local scale.
+    sample.offsetMillisecond = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.delayMillisecond = static_cast<uint32_t>(delay);
+    sample.distanceMillisecond = static_cast<uint32_t>(delay / 2) +
+        decodeNtpShort(pPacket + 4) / 2 + decodeNtpShort(pPacket + 8) + 1;
+    sample.stratum = stratum;
+
+    return true;
+}
+
+////////////////////////////////////////////////
+
+// Keeps the best sample per server (clock filter: minimum delay),
+// then selects across servers discarding falsetickers.
+template <uint8_t MaxServers>
+class NtpClockFilter
+{
+private:
+    NtpSample samples[MaxServers];
+    bool valid[MaxServers];
+
+public:
+    NtpClockFilter()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        memset(valid, 0, sizeof valid);
+    }
+
+    void add(const uint8_t server, const NtpSample& sample)
+    {
+        if (!valid[server] || (sample.delayMillisecond < samples[server].delayMillisecond))
+        {
+            samples[server] = sample;
+            valid[server] = true;
+        }
+    }
+
+    uint8_t getCount() const
+    {
+        uint8_t count = 0;
+        for (uint8_t index = 0; index < MaxServers; index++)
+        {
+            count += valid[index] ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Pick the survivor with the smallest distance. A server is a falseticker
+    // when its interval [offset +- distance] misses the median offset.
+    bool select(NtpSample& result) const
+    {
+        int64_t offsets[MaxServers];
+        uint8_t count = 0;
+        for (uint8_t index = 0; index < MaxServers; index++)
+        {
+            if (valid[index])
+            {
+                // Insertion sort, a handful of servers.
+                uint8_t position = count++;
+                while ((position > 0) && (offsets[position - 1] > samples[index].offsetMillisecond))
+                {
+                    offsets[position] = offsets[position - 1];
+                    position--;
+                }
+                offsets[position] = samples[index].offsetMillisecond;
+            }
+        }
+        if (count == 0)
+        {
+            return false;
+        }
+
+        const int64_t median = offsets[count / 2];
+
+        bool found = false;
+        for (uint8_t index = 0; index < MaxServers; index++)
+        {
+            if (!valid[index])
+            {
+                continue;
+            }
+
+            const NtpSample& sample = samples[index];
+            const int64_t difference = sample.offsetMillisecond - median;
+            const int64_t distance = sample.distanceMillisecond;
+            if ((count >= 3) && ((difference > distance) || (difference < -distance)))
+            {
+                continue;
+            }
+
+            if (!found || (sample.distanceMillisecond < result.distanceMillisecond))
+            {
+                result = sample;
+                found = true;
+            }
+        }
+
+        return found;
+    }
+};
+
+#endif
@@ -15,14 +15,69 @@
 #define TIME_SCHEDULE_ON 21
 #define TIME_SCHEDULE_OFF 2
 
+// Weekly windows: { days, on hour, on minute, off hour, off minute }, see Schedule.h.
+#define SCHEDULE_WINDOWS \
+    { SCHEDULE_EVERYDAY, TIME_SCHEDULE_ON, 0, TIME_SCHEDULE_OFF, 0 }
+// Dates the signal stays off: { month, day }, { 0, 0 } for none.
+#define SCHEDULE_HOLIDAYS \
+    { 0, 0 }
+#define SCHEDULE_SLOT_MINUTES 15   // resolution of the windows
+
+#define RTC_DISCIPLINE_INTERVAL 300000    // 5min, DS3231 read interval
+#define RTC_RATE_MINIMUM_SPAN 3600000ULL   // 1hour, the edges are found to RTC_EDGE_POLL_INTERVAL
+#define RTC_EDGE_MARGIN 50                 // msec before the predicted second edge to start polling
+#define RTC_EDGE_POLL_INTERVAL 2           // msec between seconds register reads around the edge
+
+// Deep sleep outside the schedule, woken by the ESP8266 timer (IO16 wired to RST).
+// The timer reaches about 3 hours at most, longer sleeps are chained.
+// Keep 0 unless the board is wired so. The host simulator builds both.
+#ifndef DEEP_SLEEP_ENABLED
+#define DEEP_SLEEP_ENABLED 0
+#endif
+// 1: also wake exactly on time by the DS3231 alarm. INT/SQW stays low until the alarm
+// flag is cleared over I2C, so wired straight to RST it holds the ESP8266 in reset for good.
+// It needs a pulse circuit between INT/SQW and RST: an RC differentiator (100nF in series,
+// 10k pull-up at RST, diode to VCC) or a transistor one-shot. Keep 0 without one.
+#ifndef DEEP_SLEEP_RTC_ALARM
+#define DEEP_SLEEP_RTC_ALARM 0
+#endif
+#define DEEP_SLEEP_MINIMUM_TIME 1800000   // 30min
+
+// Modeled supply current for the energy estimate, in microampere.
+#define MODEL_IDLE_CURRENT 15000       // 15mA, modem sleep with status blink
+#define MODEL_DEEP_SLEEP_CURRENT 100   // 0.1mA, ESP8266 deep sleep and DS3231
+
+#define TRACE_SIGNAL_EDGES 0   // 1: print every WALK/STOP edge with millis()
+#define BENCHMARK_ON_BOOT 0    // 1: print microbenchmarks of the control path as JSON lines at boot
+
 //  your network SSID (name)
 #define WIFI_SSID "******"
 // your network password
 #define WIFI_PASSWORD "******"
 
-#define SNTP_SERVER_FQDN "time.nist.gov"
+// Queried in parallel, the best sample is selected.
+#define SNTP_SERVER_FQDNS "time.nist.gov", "time.google.com", "pool.ntp.org"
 #define SNTP_SERVER_PORT 2390
 
+#define NTP_CONNECT_TIMEOUT 45000     // 45sec
+#define NTP_RESPONSE_TIMEOUT 1500     // 1.5sec
+#define NTP_DNS_TIMEOUT 5000          // 5sec for all lookups, they run in parallel
+#define NTP_BURST_ROUNDS 3            // requests per server at most
+#define NTP_BURST_INTERVAL 1000       // 1sec between requests to the same server
+#define NTP_TARGET_ERROR 30           // 30msec, stop the burst once the error is below
+#define NTP_BACKOFF_INITIAL 1000      // 1sec, doubles on each retry
+#define NTP_BACKOFF_MAX 16000         // 16sec
+#define NTP_MAX_ATTEMPTS 8            // when retrying
+#define NTP_POLL_INTERVAL 20          // 20msec, while associating, resolving and backing off
+#define NTP_RECEIVE_POLL_INTERVAL 2   // 2msec while a reply is due, it adds to the sample delay
+#define NTP_RTC_WRITE_TOLERANCE 2     // msec past the second boundary the RTC is still written
+#define NTP_RTC_WRITE_RETRIES 5       // boundaries to try before writing late anyway
+
+#define WIFI_CACHE_LIFETIME 604800     // 7days (or the DHCP lease if shorter), then associate and resolve from scratch
+#define WIFI_CACHE_RTC_OFFSET 16       // RTC user memory block (after the deep sleep state)
+#define WIFI_FAST_CONNECT_TIMEOUT 3000 // 3sec, then fallback to the full path
+#define WIFI_CONNECT_HISTORY 16        // syncs kept for connection time percentiles
+
 #define LOCAL_TIMEZONE_FROM_UTC 9
 
 #endif
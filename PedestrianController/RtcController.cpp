@@ -3,11 +3,161 @@
 // https://github.com/NorthernWidget/DS3231
 #include <DS3231.h>
 
+#include "PedestrianControllerConfig.h"
+#include "RtcController.h"
+
 ////////////////////////////////////////////////
 
+// Software clock on millis(), disciplined against the DS3231 every RTC_DISCIPLINE_INTERVAL.
+// Between corrections a time query costs a few arithmetic operations instead of an I2C read.
+// The reference is taken on a DS3231 second edge, found by polling the seconds register,
+// so the software clock carries the RTC's sub-second phase instead of truncating it.
+
+static bool clockValid = false;
+static uint32_t baseUnixTime = 0;         // RTC time at the last correction
+static uint32_t baseMillisecond = 0;      // millis() at the second edge of the last correction
+static int32_t ratePpm = 0;               // millis() rate error against the RTC, + is fast
+
+// Rate is measured over the whole span since the clock was (re)started.
+static uint32_t spanUnixTime = 0;
+static uint64_t spanMillisecond = 0;
+
+enum DisciplineStates
+{
+    DisciplineIdle,
+    DisciplineWaiting,    // until RTC_EDGE_MARGIN before the predicted edge
+    DisciplinePolling     // reading the seconds register until it changes
+};
+
+static DisciplineStates disciplineState = DisciplineIdle;
+static uint8_t pollSecond = 0;
+static uint32_t pollStarted = 0;
+
+static RtcClockStatistics statistics;
+
+static uint32_t getCorrectedElapsed(const uint32_t elapsed)
+{
+    return elapsed - static_cast<int32_t>((static_cast<int64_t>(elapsed) * ratePpm) / 1000000);
+}
+
+static uint8_t readRtcSecond()
+{
+    DS3231 ds3231;
+
+    statistics.transactions++;
+    return ds3231.getSecond();
+}
+
+static uint32_t readRtcUnixTime()
+{
+    statistics.transactions++;
+    return RTClib::now().unixtime();
+}
+
+// rtcUnixTime has just begun at edgeMillisecond.
+static void takeReference(const uint32_t rtcUnixTime, const uint32_t edgeMillisecond)
+{
+    if (clockValid)
+    {
+        const uint32_t elapsed = edgeMillisecond - baseMillisecond;
+        const int64_t predicted = static_cast<int64_t>(baseUnixTime) * 1000 + getCorrectedElapsed(elapsed);
+        statistics.lastDriftMillisecond = static_cast<int32_t>(static_cast<int64_t>(rtcUnixTime) * 1000 - predicted);
+
+        spanMillisecond += elapsed;
+        if (spanMillisecond >= RTC_RATE_MINIMUM_SPAN)
+        {
+            const int64_t rtcSpan = static_cast<int64_t>(rtcUnixTime - spanUnixTime) * 1000;
+            ratePpm = static_cast<int32_t>(((static_cast<int64_t>(spanMillisecond) - rtcSpan) * 1000000) /
+                static_cast<int64_t>(spanMillisecond));
+            statistics.ratePpm = ratePpm;
+        }
+    }
+    else
+    {
+        spanUnixTime = rtcUnixTime;
+        spanMillisecond = 0;
+        clockValid = true;
+    }
+
+    baseUnixTime = rtcUnixTime;
+    baseMillisecond = edgeMillisecond;
+}
+
+// Waits for the next second edge, up to a second. Only when the clock (re)starts.
+static void startClock()
+{
+    const uint8_t before = readRtcSecond();
+    const uint32_t started = millis();
+    while ((readRtcSecond() == before) && ((millis() - started) < 1100))
+    {
+        delayMicroseconds(RTC_EDGE_POLL_INTERVAL * 1000);
+    }
+
+    const uint32_t edgeMillisecond = millis();
+    disciplineState = DisciplineIdle;
+    takeReference(readRtcUnixTime(), edgeMillisecond);
+}
+
+// Discipline step from the scheduler, returns msec until it wants to run again.
+// The edge is predicted by the software clock, so polling only spans the margin around it.
+uint32_t stepRtcClock()
+{
+    if (!clockValid)
+    {
+        startClock();
+        return RTC_DISCIPLINE_INTERVAL;
+    }
+
+    const uint32_t now = millis();
+    switch (disciplineState)
+    {
+        case DisciplineIdle:
+            {
+                const uint32_t elapsed = now - baseMillisecond;
+                if (elapsed < RTC_DISCIPLINE_INTERVAL)
+                {
+                    return RTC_DISCIPLINE_INTERVAL - elapsed;
+                }
+
+                const uint32_t toEdge = 1000 - (getCorrectedElapsed(elapsed) % 1000);
+                disciplineState = DisciplineWaiting;
+                return (toEdge > RTC_EDGE_MARGIN) ? (toEdge - RTC_EDGE_MARGIN) : (toEdge + 1000 - RTC_EDGE_MARGIN);
+            }
+
+        case DisciplineWaiting:
+            pollSecond = readRtcSecond();
+            pollStarted = now;
+            disciplineState = DisciplinePolling;
+            return RTC_EDGE_POLL_INTERVAL;
+
+        default:
+            // A stopped RTC never changes, take it as it is after a second.
+            if ((readRtcSecond() == pollSecond) && ((now - pollStarted) < 1100))
+            {
+                return RTC_EDGE_POLL_INTERVAL;
+            }
+
+            disciplineState = DisciplineIdle;
+            takeReference(readRtcUnixTime(), now);
+            return RTC_DISCIPLINE_INTERVAL;
+    }
+}
+
 DateTime getRtcTimeValue()
 {
-    return RTClib::now();
+    if (!clockValid)
+    {
+        startClock();
+    }
+
+    statistics.transactionsSaved++;
+
+    return DateTime(baseUnixTime + getCorrectedElapsed(millis() - baseMillisecond) / 1000);
+}
+
+const RtcClockStatistics& getRtcClockStatistics()
+{
+    return statistics;
 }
 
 ////////////////////////////////////////////////
@@ -16,6 +166,11 @@ void setRtcTimeValue(const DateTime& time)
 {
     DS3231 ds3231;
 
+    // Writing the seconds register resets the countdown chain, so the new second
+    // begins right here: write it first and take it as the edge of the software clock.
+    ds3231.setSecond(time.second());
+    const uint32_t edgeMillisecond = millis();
+
     ds3231.setClockMode(false); // set to 24h
 
     ds3231.setYear(time.year() % 100);
@@ -23,5 +178,34 @@ void setRtcTimeValue(const DateTime& time)
     ds3231.setDate(time.day());
     ds3231.setHour(time.hour());
     ds3231.setMinute(time.minute());
-    ds3231.setSecond(time.second());
+
+    // Restart the software clock and its rate measurement from the new time.
+    clockValid = false;
+    disciplineState = DisciplineIdle;
+    takeReference(time.unixtime(), edgeMillisecond);
+}
+
+////////////////////////////////////////////////
+
+// Program Alarm 1 to fire at the given date and time (the INT/SQW pin goes low).
+void setRtcAlarmValue(const DateTime& time)
+{
+    DS3231 ds3231;
+
+    ds3231.turnOffAlarm(1);
+
+    // 0x0: match date, hours, minutes and seconds; the day is the date, not the day of week.
+    ds3231.setA1Time(time.day(), time.hour(), time.minute(), time.second(), 0x0, false, false, false);
+
+    // Clear a stale flag so INT/SQW is released until the new match.
+    ds3231.checkIfAlarm(1);
+    ds3231.turnOnAlarm(1);
+}
+
+void clearRtcAlarm()
+{
+    DS3231 ds3231;
+
+    ds3231.turnOffAlarm(1);
+    ds3231.checkIfAlarm(1);
 }
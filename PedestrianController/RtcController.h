@@ -0,0 +1,27 @@
+#ifndef PEDESTRIAN_CONTROLLER_RTC_CONTROLLER_H
+#define PEDESTRIAN_CONTROLLER_RTC_CONTROLLER_H
+
+#include <Arduino.h>
+
+// https://github.com/NorthernWidget/DS3231
+#include <DS3231.h>
+
+////////////////////////////////////////////////
+
+struct RtcClockStatistics
+{
+    uint32_t transactions;         // I2C reads of the DS3231
+    uint32_t transactionsSaved;    // queries answered by the software clock
+    int32_t lastDriftMillisecond;  // RTC minus software clock at the last correction (RTC_EDGE_POLL_INTERVAL resolution)
+    int32_t ratePpm;               // measured millis() rate error, + is fast
+};
+
+DateTime getRtcTimeValue();
+uint32_t stepRtcClock();
+void setRtcTimeValue(const DateTime& time);
+void setRtcAlarmValue(const DateTime& time);
+void clearRtcAlarm();
+
+const RtcClockStatistics& getRtcClockStatistics();
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef PEDESTRIAN_CONTROLLER_SCHEDULE_H
+#define PEDESTRIAN_CONTROLLER_SCHEDULE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Weekly schedule with several on/off windows per weekday and holiday exceptions.
+// Windows are compiled into a per-slot bitmap with the distance to the next change
+// precomputed for every slot, so a query is a couple of table lookups.
+// Pure calculation on local unix time, without Arduino APIs.
+
+////////////////////////////////////////////////
+
+#define SCHEDULE_SUNDAY    0x01
+#define SCHEDULE_MONDAY    0x02
+#define SCHEDULE_TUESDAY   0x04
+#define SCHEDULE_WEDNESDAY 0x08
+#define SCHEDULE_THURSDAY  0x10
+#define SCHEDULE_FRIDAY    0x20
+#define SCHEDULE_SATURDAY  0x40
+#define SCHEDULE_WEEKDAYS  0x3e
+#define SCHEDULE_WEEKENDS  0x41
+#define SCHEDULE_EVERYDAY  0x7f
+
+// Turns on at on time of each day in days, turns off at off time.
+// If off is before on, the window runs past midnight into the next day, if both are
+// the same it is empty. The minutes are multiples of the slot (SCHEDULE_SLOT_MINUTES).
+struct ScheduleWindow
+{
+    uint8_t days;
+    uint8_t onHour;
+    uint8_t onMinute;
+    uint8_t offHour;
+    uint8_t offMinute;
+};
+
+// The signal stays off through the whole date.
+struct ScheduleHoliday
+{
+    uint8_t month;
+    uint8_t day;
+};
+
+template <uint8_t SlotMinutes>
+class WeeklySchedule
+{
+public:
+    static const uint16_t SlotsPerDay = (24 * 60) / SlotMinutes;
+    static const uint16_t Slots = 7 * SlotsPerDay;
+    static const uint32_t SlotSeconds = static_cast<uint32_t>(SlotMinutes) * 60;
+
+private:
+    uint8_t bitmap[(Slots + 7) / 8];
+    uint16_t nextChange[Slots];   // slots until the state changes, 0 if it never does
+
+    const ScheduleHoliday* pHolidays;
+    uint8_t holidayCount;
+
+    bool getSlot(const uint16_t slot) const
+    {
+        return (bitmap[slot / 8] & (1 << (slot % 8))) != 0;
+    }
+
+    void setSlot(const uint16_t slot)
+    {
+        bitmap[slot / 8] |= 1 << (slot % 8);
+    }
+
+    // 1970/1/1 was Thursday, 0 is Sunday.
+    static uint8_t getWeekday(const uint32_t localUnixTime)
+    {
+        return static_cast<uint8_t>(((localUnixTime / 86400) + 4) % 7);
+    }
+
+    static uint16_t getSlotIndex(const uint32_t localUnixTime)
+    {
+        return getWeekday(localUnixTime) * SlotsPerDay + (localUnixTime % 86400) / SlotSeconds;
+    }
+
+    static uint32_t getRemainsOfDay(const uint32_t localUnixTime)
+    {
+        return 86400 - (localUnixTime % 86400);
+    }
+
+public:
+    WeeklySchedule()
+        : pHolidays(nullptr), holidayCount(0)
+    {
+        memset(bitmap, 0, sizeof bitmap);
+        memset(nextChange, 0, sizeof nextChange);
+    }
+
+    // A time of day on a slot boundary. constexpr, so a window table can be checked by a static_assert.
+    static constexpr bool isValid(const uint8_t hour, const uint8_t minute)
+    {
+        return (hour < 24) && (minute < 60) && ((minute % SlotMinutes) == 0);
+    }
+
+    static constexpr bool isValid(const ScheduleWindow* pWindows, const uint8_t windowCount)
+    {
+        return (windowCount == 0) ||
+            (isValid(pWindows[0].onHour, pWindows[0].onMinute) && isValid(pWindows[0].offHour, pWindows[0].offMinute) &&
+            isValid(pWindows + 1, windowCount - 1));
+    }
+
+    // False if a window isn't valid, it is left out rather than rounded to slots.
+    bool build(const ScheduleWindow* pWindows, const uint8_t windowCount,
+        const ScheduleHoliday* pHolidays, const uint8_t holidayCount)
+    {
+        this->pHolidays = pHolidays;
+        this->holidayCount = holidayCount;
+
+        memset(bitmap, 0, sizeof bitmap);
+
+        bool valid = true;
+        for (uint8_t index = 0; index < windowCount; index++)
+        {
+            const ScheduleWindow& window = pWindows[index];
+            if (!isValid(&window, 1))
+            {
+                valid = false;
+                continue;
+            }
+
+            const uint16_t on = (window.onHour * 60 + window.onMinute) / SlotMinutes;
+            const uint16_t off = (window.offHour * 60 + window.offMinute) / SlotMinutes;
+            if (on == off)
+            {
+                continue;
+            }
+            const uint16_t length = (off > on) ? (off - on) : (off + SlotsPerDay - on);
+
+            for (uint8_t weekday = 0; weekday < 7; weekday++)
+            {
+                if ((window.days & (1 << weekday)) == 0)
+                {
+                    continue;
+                }
+
+                const uint16_t start = weekday * SlotsPerDay + on;
+                for (uint16_t offset = 0; offset < length; offset++)
+                {
+                    setSlot((start + offset) % Slots);
+                }
+            }
+        }
+
+        // Walk the week backwards twice, so wrapped distances are resolved too.
+        uint16_t distance = 0;
+        bool found = false;
+        for (int32_t step = (2 * Slots) - 1; step >= 0; step--)
+        {
+            const uint16_t slot = step % Slots;
+            const uint16_t next = (slot + 1) % Slots;
+            if (getSlot(slot) != getSlot(next))
+            {
+                distance = 1;
+                found = true;
+            }
+            else if (found)
+            {
+                distance++;
+            }
+            nextChange[slot] = found ? distance : 0;
+        }
+
+        return valid;
+    }
+
+    bool isHoliday(const uint8_t month, const uint8_t day) const
+    {
+        for (uint8_t index = 0; index < holidayCount; index++)
+        {
+            if ((pHolidays[index].month == month) && (pHolidays[index].day == day))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Month and day of a local unix time, the civil calendar from 1970 (days to date).
+    static void getDate(const uint32_t localUnixTime, uint8_t& month, uint8_t& day)
+    {
+        const uint32_t days = localUnixTime / 86400 + 719468;   // from 0000/3/1
+        const uint32_t era = days / 146097;
+        const uint32_t dayOfEra = days - era * 146097;
+        const uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        const uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        const uint32_t shiftedMonth = (5 * dayOfYear + 2) / 153;   // 0 is March
+
+        day = static_cast<uint8_t>(dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+        month = static_cast<uint8_t>((shiftedMonth < 10) ? (shiftedMonth + 3) : (shiftedMonth - 9));
+    }
+
+    bool isHoliday(const uint32_t localUnixTime) const
+    {
+        uint8_t month;
+        uint8_t day;
+        getDate(localUnixTime, month, day);
+        return isHoliday(month, day);
+    }
+
+    // Weekly state, without holidays.
+    bool isOn(const uint32_t localUnixTime) const
+    {
+        return getSlot(getSlotIndex(localUnixTime));
+    }
+
+    // Seconds until the weekly state changes, or 0 if it never does.
+    uint32_t getNextChangeSecond(const uint32_t localUnixTime) const
+    {
+        const uint16_t slots = nextChange[getSlotIndex(localUnixTime)];
+        if (slots == 0)
+        {
+            return 0;
+        }
+
+        return static_cast<uint32_t>(slots) * SlotSeconds - (localUnixTime % SlotSeconds);
+    }
+
+    // Milliseconds until the schedule turns on, or 0 while it is on, holidays included.
+    // Works on unix time, so month and year ends need no special care. A wall clock jump
+    // (DST, a corrected RTC) is picked up by the next query, callers re-query in steps.
+    uint32_t getRemainsMillisecond(const uint32_t localUnixTime) const
+    {
+        if (isHoliday(localUnixTime))
+        {
+            // Evaluate again at midnight.
+            return getRemainsOfDay(localUnixTime) * 1000;
+        }
+
+        if (isOn(localUnixTime))
+        {
+            return 0;
+        }
+
+        uint32_t remains = getNextChangeSecond(localUnixTime);
+        if (remains == 0)
+        {
+            // No window at all, evaluate again at midnight.
+            return getRemainsOfDay(localUnixTime) * 1000;
+        }
+
+        // If it turns on at a holiday, wake at that midnight instead and skip the day from there.
+        const uint32_t next = localUnixTime + remains;
+        if (isHoliday(next))
+        {
+            remains -= next % 86400;
+        }
+
+        return remains * 1000;
+    }
+};
+
+#endif
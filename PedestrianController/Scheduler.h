@@ -0,0 +1,162 @@
+#ifndef PEDESTRIAN_CONTROLLER_SCHEDULER_H
+#define PEDESTRIAN_CONTROLLER_SCHEDULER_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////
+
+// Cooperative deadline scheduler.
+// Each task handler runs when its deadline is reached and returns the interval
+// to the next deadline, counted from the current deadline (not from now) so that
+// phase edges don't drift. Return Scheduler::Suspend to stop until wake().
+class Scheduler
+{
+public:
+    typedef uint32_t (*TaskHandler)();
+
+    static const uint32_t Suspend = UINT32_MAX;
+    static const uint8_t MaxTasks = 8;
+
+private:
+    struct Task
+    {
+        TaskHandler handler;
+        uint32_t deadline;
+        bool active;
+    };
+
+    Task tasks[MaxTasks];
+    uint8_t taskCount;
+    uint32_t maxLateness;
+    uint32_t overrunCount;         // handler calls more than 1msec after their deadline
+    uint32_t lastRunMicrosecond;   // busy time of the last run()
+
+    static bool isReached(const uint32_t deadline, const uint32_t now)
+    {
+        return static_cast<int32_t>(now - deadline) >= 0;
+    }
+
+public:
+    Scheduler()
+        : taskCount(0), maxLateness(0), overrunCount(0), lastRunMicrosecond(0)
+    {
+    }
+
+    uint8_t add(const TaskHandler handler, const bool active)
+    {
+        Task& task = tasks[taskCount];
+        task.handler = handler;
+        task.deadline = millis();
+        task.active = active;
+
+        return taskCount++;
+    }
+
+    void wake(const uint8_t id)
+    {
+        tasks[id].deadline = millis();
+        tasks[id].active = true;
+    }
+
+    void suspend(const uint8_t id)
+    {
+        tasks[id].active = false;
+    }
+
+    // Largest observed delay between a deadline and its handler call.
+    uint32_t getMaxLateness() const
+    {
+        return maxLateness;
+    }
+
+    void resetMaxLateness()
+    {
+        maxLateness = 0;
+    }
+
+    uint32_t getOverrunCount() const
+    {
+        return overrunCount;
+    }
+
+    uint32_t getLastRunMicrosecond() const
+    {
+        return lastRunMicrosecond;
+    }
+
+    // Run all due tasks once and return milliseconds until the next deadline.
+    uint32_t run()
+    {
+        const uint32_t startedAt = micros();
+        for (uint8_t id = 0; id < taskCount; id++)
+        {
+            Task& task = tasks[id];
+            const uint32_t now = millis();
+            if (!task.active || !isReached(task.deadline, now))
+            {
+                continue;
+            }
+
+            const uint32_t lateness = now - task.deadline;
+            if (lateness > maxLateness)
+            {
+                maxLateness = lateness;
+            }
+            overrunCount += (lateness > 1) ? 1 : 0;
+
+            const uint32_t interval = task.handler();
+            if (interval == Suspend)
+            {
+                task.active = false;
+                continue;
+            }
+
+            // Re-anchor to now if the handler (or a previous one) overran a whole interval,
+            // so we don't fire a burst of stale edges to catch up.
+            task.deadline += interval;
+            if ((interval != 0) && isReached(task.deadline, millis()))
+            {
+                task.deadline = millis() + interval;
+            }
+        }
+
+        lastRunMicrosecond = micros() - startedAt;
+
+        const uint32_t now = millis();
+        uint32_t wait = Suspend;
+        for (uint8_t id = 0; id < taskCount; id++)
+        {
+            const Task& task = tasks[id];
+            if (!task.active)
+            {
+                continue;
+            }
+            if (isReached(task.deadline, now))
+            {
+                return 0;
+            }
+
+            const uint32_t remains = task.deadline - now;
+            if (remains < wait)
+            {
+                wait = remains;
+            }
+        }
+
+        return wait;
+    }
+
+    // Run due tasks, then sleep until the next deadline.
+    // ESP8266 delay() suspends the loop task and lets the SDK enter light sleep,
+    // so the CPU is idle between deadlines instead of polling.
+    void runAndSleep(const uint32_t maxSleepMillisecond)
+    {
+        const uint32_t wait = run();
+        if (wait != 0)
+        {
+            delay((wait < maxSleepMillisecond) ? wait : maxSleepMillisecond);
+        }
+    }
+};
+
+#endif
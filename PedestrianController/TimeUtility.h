@@ -0,0 +1,37 @@
+#ifndef PEDESTRIAN_CONTROLLER_TIME_UTILITY_H
+#define PEDESTRIAN_CONTROLLER_TIME_UTILITY_H
+
+#include <Arduino.h>
+
+// https://github.com/NorthernWidget/DS3231
+#include <DS3231.h>
+
+// Time text for the log and millis() intervals.
+// Pure calculation without I/O, so the host benchmarks call the same code.
+
+////////////////////////////////////////////////
+
+#define TIME_STRING_SIZE 26   // the widest fields: "255/255/65535 255:255:255"
+
+static inline const char* formatTime(const DateTime& time, char* pBuffer)
+{
+    snprintf(pBuffer, TIME_STRING_SIZE, "%u/%u/%u %u:%u:%u",
+        time.month(), time.day(), time.year(),
+        time.hour(), time.minute(), time.second());
+
+    return pBuffer;
+}
+
+static inline uint32_t calculateTimeDifferent(const uint32_t start, const uint32_t end)
+{
+    if (end >= start)
+    {
+        return end - start;
+    }
+    else
+    {
+        return UINT32_MAX - start + end;
+    }
+}
+
+#endif
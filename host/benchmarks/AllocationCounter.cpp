@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Counts every operator new for AllocationCounter.h. Linked into each host benchmark.
+
+#include <stdlib.h>
+
+#include <new>
+
+#include "AllocationCounter.h"
+
+////////////////////////////////////////////////
+
+int64_t hostAllocations = 0;
+int64_t hostAllocatedBytes = 0;
+
+static void* allocate(const size_t size)
+{
+    hostAllocations++;
+    hostAllocatedBytes += size;
+
+    void* p = malloc((size != 0) ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(const size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](const size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_ALLOCATION_COUNTER_H
+#define HOST_ALLOCATION_COUNTER_H
+
+#include <stdint.h>
+
+#include <benchmark/benchmark.h>
+
+////////////////////////////////////////////////
+
+// Every operator new of the program, see AllocationCounter.cpp. String is std::string
+// on the host, so this sees what the Arduino String would allocate.
+extern int64_t hostAllocations;
+extern int64_t hostAllocatedBytes;
+
+// Put before the timed loop: adds the allocations and allocated bytes per call as the
+// "allocs" and "allocBytes" counters of the result, zero on an allocation free path.
+class AllocationCounter
+{
+private:
+    benchmark::State& state;
+    const int64_t allocations;
+    const int64_t allocatedBytes;
+
+public:
+    explicit AllocationCounter(benchmark::State& state)
+        : state(state), allocations(hostAllocations), allocatedBytes(hostAllocatedBytes)
+    {
+    }
+
+    // Read both first, adding a counter allocates.
+    ~AllocationCounter()
+    {
+        const double calls = static_cast<double>(hostAllocations - allocations);
+        const double bytes = static_cast<double>(hostAllocatedBytes - allocatedBytes);
+        state.counters["allocs"] = benchmark::Counter(calls, benchmark::Counter::kAvgIterations);
+        state.counters["allocBytes"] = benchmark::Counter(bytes, benchmark::Counter::kAvgIterations);
+    }
+};
+
+#endif
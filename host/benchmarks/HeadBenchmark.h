@@ -0,0 +1,124 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HEAD_BENCHMARK_H
+#define HEAD_BENCHMARK_H
+
+#include <SignalHeadMachine.h>
+
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+
+// A head's state machine as the node runs it, table driven (SignalHeadMachine) or the
+// legacy switch logic: transitions per second through whole cycles, and the per loop()
+// status calls. Lamps are written to the host pins without reporting them.
+
+static void ignorePin(const uint8_t, const bool)
+{
+}
+
+template <typename Machine>
+static void BM_transitions(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    Machine machine;
+    machine.begin();
+
+    uint64_t transitions = 0;
+    // Its own scope, so the counters below are not counted as allocations.
+    {
+        const AllocationCounter allocations(state);
+        for (auto _ : state)
+        {
+            // Go, stop, then the transition to its end, as the tick drives it.
+            uint8_t phase = machine.getPhase();
+            machine.apply(SignalCommandGo);
+            machine.apply(SignalCommandStop);
+            transitions += 2;
+            while (!machine.isHolding())
+            {
+                phase = machine.getPhase();
+                machine.tick();
+                transitions += (machine.getPhase() != phase) ? 1 : 0;
+            }
+            benchmark::DoNotOptimize(phase);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(transitions));
+    state.counters["transitions"] = benchmark::Counter(static_cast<double>(transitions), benchmark::Counter::kIsRate);
+}
+
+// A command that doesn't apply in the phase, the usual case while queued commands drain.
+template <typename Machine>
+static void BM_applyIgnored(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    Machine machine;
+    machine.begin();
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        machine.apply(SignalCommandStop);
+        benchmark::DoNotOptimize(machine);
+    }
+}
+
+// What every loop() pass asks for the broadcast.
+template <typename Machine>
+static void BM_stateAndRemains(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    Machine machine;
+    machine.begin();
+    machine.apply(SignalCommandGo);
+    machine.apply(SignalCommandStop);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(machine.getSignalState());
+        benchmark::DoNotOptimize(machine.getRemainsTicks());
+    }
+}
+
+template <typename Machine>
+static void BM_statusText(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    Machine machine;
+    machine.begin();
+    machine.apply(SignalCommandGo);
+    machine.apply(SignalCommandStop);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(machine.getStatusText());
+    }
+}
+
+#define HEAD_BENCHMARKS(Machine) \
+    BENCHMARK_TEMPLATE(BM_transitions, Machine); \
+    BENCHMARK_TEMPLATE(BM_applyIgnored, Machine); \
+    BENCHMARK_TEMPLATE(BM_stateAndRemains, Machine); \
+    BENCHMARK_TEMPLATE(BM_statusText, Machine)
+
+#endif
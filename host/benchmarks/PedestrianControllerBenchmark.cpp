@@ -0,0 +1,167 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The per-cycle path of PedestrianController, the host side of its on-device
+// BENCHMARK_ON_BOOT suite with the same names (BM_ prefixed).
+// host/tools/compare_benchmarks.py compares the JSON of two builds.
+
+#include "PedestrianControllerConfig.h"
+#include "NtpPacket.h"
+#include "Schedule.h"
+#include "TimeUtility.h"
+
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+
+////////////////////////////////////////////////
+
+static const DateTime benchmarkTime(2018, 5, 19, 3, 45, 30);
+
+static void BM_formatTime(benchmark::State& state)
+{
+    DateTime time = benchmarkTime;
+    char buffer[TIME_STRING_SIZE];
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(time);
+        benchmark::DoNotOptimize(formatTime(time, buffer));
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_formatTime);
+
+// Across the millis() wrap.
+static void BM_calculateTimeDifferent(benchmark::State& state)
+{
+    uint32_t start = UINT32_MAX - 1000;
+    uint32_t end = 2000;
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(start);
+        benchmark::DoNotOptimize(end);
+        benchmark::DoNotOptimize(calculateTimeDifferent(start, end));
+    }
+}
+BENCHMARK(BM_calculateTimeDifferent);
+
+////////////////////////////////////////////////
+
+static const uint32_t cookieHigh = 0x12345678;
+static const uint32_t cookieLow = 0x9abcdef0;
+
+// A server response to our own request, as received.
+static void encodeResponse(uint8_t* pPacket)
+{
+    encodeNtpRequest(pPacket, cookieHigh, cookieLow);
+    pPacket[0] = 0x24;   // LI 0, version 4, mode 4 (server)
+    pPacket[1] = 2;
+    writeNtpWord(pPacket + 24, cookieHigh);
+    writeNtpWord(pPacket + 28, cookieLow);
+    writeNtpWord(pPacket + 32, NTP_UNIX_EPOCH + benchmarkTime.unixtime());
+    writeNtpWord(pPacket + 36, 0x40000000);
+    writeNtpWord(pPacket + 40, NTP_UNIX_EPOCH + benchmarkTime.unixtime());
+    writeNtpWord(pPacket + 44, 0x40100000);
+}
+
+static void BM_decodeNtpTimestamp(benchmark::State& state)
+{
+    uint8_t packet[NTP_PACKET_SIZE];
+    encodeResponse(packet);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(packet);
+        benchmark::DoNotOptimize(decodeNtpTimestamp(packet + 40));
+    }
+}
+BENCHMARK(BM_decodeNtpTimestamp);
+
+static void BM_decodeNtpResponse(benchmark::State& state)
+{
+    uint8_t packet[NTP_PACKET_SIZE];
+    encodeResponse(packet);
+    uint32_t t1 = 100000;
+    uint32_t t4 = 100040;
+    NtpSample sample;
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(packet);
+        benchmark::DoNotOptimize(t1);
+        benchmark::DoNotOptimize(t4);
+        benchmark::DoNotOptimize(decodeNtpResponse(packet, cookieHigh, cookieLow, t1, t4, sample));
+        benchmark::DoNotOptimize(sample);
+    }
+}
+BENCHMARK(BM_decodeNtpResponse);
+
+////////////////////////////////////////////////
+
+static const ScheduleWindow scheduleWindows[] = { SCHEDULE_WINDOWS };
+static const ScheduleHoliday scheduleHolidays[] = { SCHEDULE_HOLIDAYS };
+
+// Built once as in setup(), the queries are what getSleepingSecond() runs.
+static const WeeklySchedule<SCHEDULE_SLOT_MINUTES>& getSchedule()
+{
+    static WeeklySchedule<SCHEDULE_SLOT_MINUTES> schedule;
+    static bool built = false;
+    if (!built)
+    {
+        schedule.build(
+            scheduleWindows, sizeof scheduleWindows / sizeof scheduleWindows[0],
+            scheduleHolidays, sizeof scheduleHolidays / sizeof scheduleHolidays[0]);
+        built = true;
+    }
+    return schedule;
+}
+
+// Off at that time, so the next window is searched.
+static void BM_getScheduleRemainsMillisecond(benchmark::State& state)
+{
+    const WeeklySchedule<SCHEDULE_SLOT_MINUTES>& schedule = getSchedule();
+    uint32_t localUnixTime = benchmarkTime.unixtime();
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(localUnixTime);
+        benchmark::DoNotOptimize(schedule.getRemainsMillisecond(localUnixTime));
+    }
+}
+BENCHMARK(BM_getScheduleRemainsMillisecond);
+
+static void BM_scheduleIsOn(benchmark::State& state)
+{
+    const WeeklySchedule<SCHEDULE_SLOT_MINUTES>& schedule = getSchedule();
+    uint32_t localUnixTime = benchmarkTime.unixtime();
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(localUnixTime);
+        benchmark::DoNotOptimize(schedule.isOn(localUnixTime));
+    }
+}
+BENCHMARK(BM_scheduleIsOn);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,36 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// PedestrianSignalHead, generated, against the switch logic of the controller it replaced.
+
+#include "PedestrianSignalHead.h"
+
+#include <LegacyPedestrianSignal.h>
+
+#include "HeadBenchmark.h"
+
+typedef SignalHeadMachine<PedestrianSignalHead> PedestrianSignalMachine;
+
+HEAD_BENCHMARKS(PedestrianSignalMachine);
+HEAD_BENCHMARKS(LegacyPedestrianSignal);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,225 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A crossing cycle from the button, end to end: road stopped, a walk, road going again.
+// The per command flow (stop, poll until stopped, walk, poll, stop the walk, poll, go,
+// poll) against two conditional batches sent together and the road's event stream.
+// RoadSignal and PedestrianSignal run as sketches on loopback, built with short
+// transitions (1 sec will stop, 2 sec blink) so the flows dominate. The link is
+// simulated on the button side: every way costs oneWay, a connection a round trip
+// before its request goes, as TCP does. requests counts the HTTP requests per cycle.
+
+#include <SignalLogger.h>
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include "HostNode.h"
+
+////////////////////////////////////////////////
+
+#define CYCLE_WAIT "30000"   // msec a batch command may wait for its condition
+
+SignalLogger logger;
+
+static const IPAddress roadAddress(192, 168, 4, 2);
+static const IPAddress pedestrianAddress(192, 168, 4, 3);
+
+static uint64_t oneWay = 0;   // usec of the simulated link
+static uint32_t requests = 0;
+
+static void waitLink(const uint32_t ways)
+{
+    usleep(static_cast<useconds_t>(ways * oneWay));
+}
+
+// A request and its answer over the link: the handshake, the request, the answer.
+static HostHttpResponse linkGet(const IPAddress& address, const char* pTarget)
+{
+    requests++;
+    const int fd = connectNode(address, 80, 5000);
+    waitLink(3);
+    HostHttpResponse response = { -1, std::string(), std::string() };
+    if ((fd >= 0) && sendRequest(fd, pTarget))
+    {
+        response = readResponse(fd);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    waitLink(1);
+    return response;
+}
+
+static bool pollUntil(const IPAddress& address, const char* pText)
+{
+    for (int index = 0; index < 10000; index++)
+    {
+        const HostHttpResponse response = linkGet(address, "/api/status");
+        if (response.status != 200)
+        {
+            return false;
+        }
+        if (response.body == pText)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool runCommandCycle()
+{
+    return (linkGet(roadAddress, "/api/stop").status == 200) && pollUntil(roadAddress, "Stopped") &&
+        (linkGet(pedestrianAddress, "/api/walk").status == 200) && pollUntil(pedestrianAddress, "Walking") &&
+        (linkGet(pedestrianAddress, "/api/stop").status == 200) && pollUntil(pedestrianAddress, "Stopped") &&
+        (linkGet(roadAddress, "/api/go").status == 200) && pollUntil(roadAddress, "Going");
+}
+
+// Reads the stream until it holds text after position, returns where it ends or npos.
+static size_t readStream(const int fd, std::string& stream, const size_t position, const char* pText)
+{
+    char buffer[256];
+    ssize_t size;
+    while ((stream.find(pText, position) == std::string::npos) && ((size = recv(fd, buffer, sizeof buffer, 0)) > 0))
+    {
+        stream.append(buffer, static_cast<size_t>(size));
+    }
+    const size_t found = stream.find(pText, position);
+    return (found == std::string::npos) ? found : (found + strlen(pText));
+}
+
+// The road stops, goes again once the walk has blinked out; the walk waits for the road.
+static bool runBatchCycle()
+{
+    requests += 3;
+    const int stream = connectNode(roadAddress, SIGNAL_EVENT_PORT, 5000);
+    const int road = connectNode(roadAddress, 80, 5000);
+    const int pedestrian = connectNode(pedestrianAddress, 80, 5000);
+    waitLink(3);
+    bool done = (stream >= 0) && (road >= 0) && (pedestrian >= 0) &&
+        sendRequest(stream, "/api/events") &&
+        sendRequest(road, "/api/batch?steps=stop,query:pedestrian=transition,go:pedestrian=stopped&wait=" CYCLE_WAIT) &&
+        sendRequest(pedestrian, "/api/batch?steps=walk:road=stopped,stop&wait=" CYCLE_WAIT) &&
+        (readResponse(road).status == 200) && (readResponse(pedestrian).status == 200);
+
+    std::string events;
+    const size_t stopped = done ? readStream(stream, events, 0, "data: Stopped\n\n") : std::string::npos;
+    done = (stopped != std::string::npos) && (readStream(stream, events, stopped, "data: Going\n\n") != std::string::npos);
+    waitLink(1);
+
+    for (const int fd : { stream, road, pedestrian })
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    return done;
+}
+
+// Road going, walk stopped, off the clock.
+static bool prepare()
+{
+    const uint64_t end = signalHostMonotonicMicros() + 30000000ULL;
+    while (signalHostMonotonicMicros() < end)
+    {
+        const std::string road = httpGet(roadAddress, "/api/status").body;
+        if ((road == "Going") && (httpGet(pedestrianAddress, "/api/status").body == "Stopped"))
+        {
+            return true;
+        }
+        if (road == "Stopped")
+        {
+            httpGet(roadAddress, "/api/go");
+        }
+        usleep(50000);
+    }
+    return false;
+}
+
+static void BM_cycle(benchmark::State& state)
+{
+    const bool batch = state.range(0) != 0;
+    oneWay = static_cast<uint64_t>(state.range(1)) * 1000;
+    requests = 0;
+    for (auto _ : state)
+    {
+        if (!prepare())
+        {
+            state.SkipWithError("The nodes don't come back to road going.");
+            break;
+        }
+
+        const uint64_t start = signalHostMonotonicMicros();
+        if (!(batch ? runBatchCycle() : runCommandCycle()))
+        {
+            state.SkipWithError("The cycle didn't complete.");
+            break;
+        }
+        state.SetIterationTime(static_cast<double>(signalHostMonotonicMicros() - start) / 1000000.0);
+    }
+    state.counters["requests"] = benchmark::Counter(static_cast<double>(requests), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_cycle)->ArgNames({ "batch", "oneWay" })->ArgsProduct({ { 0, 1 }, { 5, 20, 100 } })
+    ->UseManualTime()->Iterations(3)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////
+
+static pid_t startSketch(const char* pPath)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr);
+        execl(pPath, pPath, static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    return pid;
+}
+
+int main(int argc, char* argv[])
+{
+    setenv("SIGNAL_HOST_PORT_OFFSET", "32000", 1);   // away from the loopback tests
+    setenv("SIGNAL_HOST_RUN_SECONDS", "900", 1);     // ends the nodes if we don't
+
+    const pid_t road = startSketch(ROAD_SIGNAL_PATH);
+    const pid_t pedestrian = startSketch(PEDESTRIAN_SIGNAL_PATH);
+    if (!waitForNode(roadAddress) || !waitForNode(pedestrianAddress))
+    {
+        fprintf(stderr, "The nodes don't answer.\n");
+        stopNode(road);
+        stopNode(pedestrian);
+        return EXIT_FAILURE;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    stopNode(road);
+    stopNode(pedestrian);
+    return EXIT_SUCCESS;
+}
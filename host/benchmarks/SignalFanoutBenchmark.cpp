@@ -0,0 +1,201 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A group command to 2 up to 32 signal heads on loopback, from the registry's group:
+// SignalGroupCommander sending to every member at once and gathering the answers, against
+// the same command sent to one member after the other, each answer awaited. The heads are
+// RoadSignal nodes in their own processes; the command is a query, so every iteration
+// leaves them as they were. On loopback the nodes' own loops dominate, a link of oneWay
+// is simulated on the commander's side: a round trip before the answers are read, as
+// they arrive meanwhile.
+
+#include <SignalBroadcast.h>
+#include <SignalFanout.h>
+#include <SignalLogger.h>
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include "Config.h"
+#include "RoadSignalHead.h"
+
+#include "HostNode.h"
+
+////////////////////////////////////////////////
+
+#define FANOUT_NODES SIGNAL_REGISTRY_SIZE
+#define FANOUT_SEQUENTIAL_PORT 4214   // UDP port of the one after the other commander
+
+SignalLogger logger;
+
+static const IPAddress commanderAddress(192, 168, 83, 100);
+static const IPAddress gatewayAddress(192, 168, 83, 1);
+
+// Node index at 192.168.83.2 and up.
+static IPAddress getNodeAddress(const uint8_t index)
+{
+    return IPAddress(192, 168, 83, 2 + index);
+}
+
+static SignalGroupCommander commander;
+static WiFiUDP sequential;
+static uint64_t oneWay = 0;   // usec of the simulated link
+
+static void waitRoundTrip()
+{
+    usleep(static_cast<useconds_t>(2 * oneWay));
+}
+
+static void finishHandler(void* pContext, const SignalFanoutResult& result)
+{
+    *static_cast<SignalFanoutResult*>(pContext) = result;
+}
+
+// One round: answered members, all of them unless the deadline passed.
+static uint8_t sendFanout()
+{
+    SignalFanoutResult result = {};
+    result.expected = 0xff;
+    if (!commander.send(SignalNodeRoad, SignalCommandQuery, finishHandler, &result))
+    {
+        return 0;
+    }
+    waitRoundTrip();
+    while (result.expected == 0xff)
+    {
+        commander.handle();
+        usleep(20);
+    }
+    return result.answered;
+}
+
+// A round trip per member, with the fan-out deadline each.
+static uint8_t sendSequential(const uint8_t count)
+{
+    SignalMessage command;
+    memset(&command, 0, sizeof command);
+    command.type = SignalMessageCommand;
+    command.node = SignalNodeRoad;
+    command.command = SignalCommandQuery;
+    uint8_t packet[SIGNAL_MESSAGE_SIZE];
+    encodeSignalMessage(packet, command);
+
+    uint8_t answered = 0;
+    for (uint8_t index = 0; index < count; index++)
+    {
+        const IPAddress address = getNodeAddress(index);
+        sequential.beginPacket(address, SIGNAL_COMMAND_PORT);
+        sequential.write(packet, sizeof packet);
+        sequential.endPacket();
+        waitRoundTrip();
+
+        bool answer = false;
+        const uint32_t sentAt = signalMillis();
+        while (!answer && ((signalMillis() - sentAt) < SIGNAL_FANOUT_DEADLINE))
+        {
+            const int size = sequential.parsePacket();
+            if (size <= 0)
+            {
+                usleep(20);
+                continue;
+            }
+
+            uint8_t status[SIGNAL_MESSAGE_SIZE];
+            SignalMessage message;
+            answer = (size == SIGNAL_MESSAGE_SIZE) &&
+                (sequential.read(status, sizeof status) == SIGNAL_MESSAGE_SIZE) &&
+                decodeSignalMessage(status, size, message) &&
+                (message.type == SignalMessageStatus) && (sequential.remoteIP() == address);
+            sequential.flush();
+        }
+        answered += answer ? 1 : 0;
+    }
+    return answered;
+}
+
+static void BM_groupCommand(benchmark::State& state)
+{
+    const bool fanout = state.range(0) != 0;
+    const uint8_t count = static_cast<uint8_t>(state.range(1));
+    oneWay = static_cast<uint64_t>(state.range(2)) * 1000;
+
+    SignalStateListener listener;
+    for (uint8_t index = 0; index < count; index++)
+    {
+        listener.add(getNodeAddress(index), SignalNodeRoad);
+    }
+    commander.begin(&listener);
+
+    for (auto _ : state)
+    {
+        if ((fanout ? sendFanout() : sendSequential(count)) != count)
+        {
+            state.SkipWithError("A member didn't answer in time.");
+            break;
+        }
+    }
+    state.counters["perNode"] = benchmark::Counter(static_cast<double>(state.iterations()) * count,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_groupCommand)->ArgNames({ "fanout", "nodes", "oneWay" })
+    ->ArgsProduct({ { 0, 1 }, { 2, 4, 8, 16, 32 }, { 0, 5 } })
+    ->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    setenv("SIGNAL_HOST_PORT_OFFSET", "33000", 1);   // away from the loopback tests
+
+    pid_t nodes[FANOUT_NODES];
+    for (uint8_t index = 0; index < FANOUT_NODES; index++)
+    {
+        nodes[index] = spawnNode<RoadSignalHead>(getNodeAddress(index), gatewayAddress);
+    }
+
+    bool ready = true;
+    for (uint8_t index = 0; ready && (index < FANOUT_NODES); index++)
+    {
+        ready = waitForNode(getNodeAddress(index));
+    }
+
+    if (ready)
+    {
+        WiFi.config(commanderAddress, gatewayAddress, hostNodeNetmask);
+        sequential.begin(FANOUT_SEQUENTIAL_PORT);
+
+        benchmark::Initialize(&argc, argv);
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+    }
+    else
+    {
+        fprintf(stderr, "The nodes don't answer.\n");
+    }
+
+    for (const pid_t node : nodes)
+    {
+        stopNode(node);
+    }
+    return ready ? EXIT_SUCCESS : EXIT_FAILURE;
+}
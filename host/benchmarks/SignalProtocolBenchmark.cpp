@@ -0,0 +1,165 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Decode cost of the datagrams every node handles, see SignalProtocol.h, and the
+// status handling of the button (SignalStateListener), which replaced its parsing of
+// the heads' status strings. Run with --benchmark_format=json to keep the results of
+// a build, host/tools/compare_benchmarks.py compares two of them.
+
+#include <SignalBroadcast.h>
+#include <SignalProtocol.h>
+
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+
+////////////////////////////////////////////////
+
+static void encodeStatus(uint8_t* p)
+{
+    const SignalMessage message = { SignalMessageStatus, SignalNodeRoad, SignalStateGoing,
+        SignalCommandQuery, SIGNAL_FLAG_SYNCHRONIZED, 0, 12, 123456 };
+    encodeSignalMessage(p, message);
+}
+
+static void BM_calculateSignalCrc(benchmark::State& state)
+{
+    uint8_t frame[SIGNAL_MESSAGE_SIZE];
+    encodeStatus(frame);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame);
+        benchmark::DoNotOptimize(calculateSignalCrc(frame, SIGNAL_MESSAGE_SIZE - 2));
+    }
+}
+BENCHMARK(BM_calculateSignalCrc);
+
+static void BM_encodeSignalMessage(benchmark::State& state)
+{
+    const SignalMessage message = { SignalMessageCommand, SignalNodePedestrian, SignalStateStopped,
+        SignalCommandGo, 0, SIGNAL_CONDITION(SignalNodeRoad, SignalStateStopped), 500, 42 };
+    uint8_t frame[SIGNAL_MESSAGE_SIZE];
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(message);
+        encodeSignalMessage(frame, message);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_encodeSignalMessage);
+
+// Accepted frame: the full CRC and every field check.
+static void BM_decodeSignalMessage(benchmark::State& state)
+{
+    uint8_t frame[SIGNAL_MESSAGE_SIZE];
+    encodeStatus(frame);
+    SignalMessage message;
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame);
+        benchmark::DoNotOptimize(decodeSignalMessage(frame, sizeof frame, message));
+    }
+}
+BENCHMARK(BM_decodeSignalMessage);
+
+// Rejected by the CRC, the usual case for a corrupted datagram.
+static void BM_decodeSignalMessageCorrupted(benchmark::State& state)
+{
+    uint8_t frame[SIGNAL_MESSAGE_SIZE];
+    encodeStatus(frame);
+    frame[9] ^= 0x01;
+    SignalMessage message;
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame);
+        benchmark::DoNotOptimize(decodeSignalMessage(frame, sizeof frame, message));
+    }
+}
+BENCHMARK(BM_decodeSignalMessageCorrupted);
+
+// Rejected by the header, the usual case for a foreign datagram on the port.
+static void BM_decodeSignalMessageForeign(benchmark::State& state)
+{
+    uint8_t frame[SIGNAL_MESSAGE_SIZE] = { 0 };
+    SignalMessage message;
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame);
+        benchmark::DoNotOptimize(decodeSignalMessage(frame, sizeof frame, message));
+    }
+}
+BENCHMARK(BM_decodeSignalMessageForeign);
+
+// The text API form, copied first as parseSignalBatch modifies it.
+static void BM_parseSignalBatch(benchmark::State& state)
+{
+    static const char batch[] = "walk:road=stopped,stop:pedestrian=stopped,go";
+    SignalMessage commands[4];
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        char text[sizeof batch];
+        memcpy(text, batch, sizeof batch);
+        benchmark::DoNotOptimize(parseSignalBatch(text, 500, commands, 4));
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_parseSignalBatch);
+
+// A status heard from a known head, the button's per-datagram path.
+static void BM_listenerUpdate(benchmark::State& state)
+{
+    const SignalMessage message = { SignalMessageStatus, SignalNodeRoad, SignalStateGoing,
+        SignalCommandQuery, SIGNAL_FLAG_SYNCHRONIZED, 0, 12, 123456 };
+    const IPAddress address(192, 168, 4, 254);
+    SignalStateListener listener;
+    listener.update(address, message);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(listener.update(address, message));
+    }
+}
+BENCHMARK(BM_listenerUpdate);
+
+// The state of a group, what getRoadSignal() and getPedestrianSignal() ask.
+static void BM_listenerGetState(benchmark::State& state)
+{
+    const SignalMessage message = { SignalMessageStatus, SignalNodeRoad, SignalStateGoing,
+        SignalCommandQuery, SIGNAL_FLAG_SYNCHRONIZED, 0, 12, 123456 };
+    SignalStateListener listener;
+    listener.update(IPAddress(192, 168, 4, 254), message);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(listener);
+        benchmark::DoNotOptimize(listener.getState(SignalNodeRoad));
+    }
+}
+BENCHMARK(BM_listenerGetState);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,141 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host benchmarks - Google Benchmark measurements of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The cost of a SignalSequence step: one table read and one masked lamp write, against
+// the masked write alone. The table is PedestrianController's: WALK, a 14 step blink,
+// then STOP held. Lamps are written to the host pins without reporting them.
+
+#include <Arduino.h>
+#include <SignalSequence.h>
+
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+
+////////////////////////////////////////////////
+
+#define BENCHMARK_WALK 12
+#define BENCHMARK_STOP 13
+
+enum BenchmarkPhases : uint8_t
+{
+    PhaseDark,
+    PhaseStopped,
+    PhaseWalking,
+    PhaseTransitionOn,
+    PhaseTransitionOff
+};
+
+static constexpr SignalPhase benchmarkPhases[] PROGMEM =
+{
+    // lamps, duration, next, repeatTo, repeat, hook
+    { 0, 0, PhaseDark, 0, 0, 0 },
+    { SIGNAL_LAMP(BENCHMARK_STOP), 0, PhaseStopped, 0, 0, 1 },
+    { SIGNAL_LAMP(BENCHMARK_WALK), 15000, PhaseTransitionOn, 0, 0, 2 },
+    { SIGNAL_LAMP(BENCHMARK_STOP), 500, PhaseTransitionOff, 0, 0, 3 },
+    { 0, 500, PhaseStopped, PhaseTransitionOn, 13, 4 },
+};
+
+static constexpr uint32_t benchmarkLamps = SIGNAL_LAMP(BENCHMARK_WALK) | SIGNAL_LAMP(BENCHMARK_STOP);
+
+static void ignorePin(const uint8_t, const bool)
+{
+}
+
+static void countHook(void* pContext, const uint8_t)
+{
+    (*static_cast<uint32_t*>(pContext))++;
+}
+
+////////////////////////////////////////////////
+
+// The floor: the lamp write a step does.
+static void BM_writeSignalLamps(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    uint32_t lamps = SIGNAL_LAMP(BENCHMARK_WALK);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        lamps ^= benchmarkLamps;
+        benchmark::DoNotOptimize(lamps);
+        writeSignalLamps(benchmarkLamps, lamps);
+    }
+}
+BENCHMARK(BM_writeSignalLamps);
+
+// A step at the end of each duration, as the deadline scheduler drives it; the cycle
+// starts again from WALK once STOP holds.
+static void BM_step(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    SignalSequence sequence;
+    uint32_t hooks = 0;
+    sequence.begin(benchmarkPhases, benchmarkLamps, PhaseWalking,
+        state.range(0) ? countHook : nullptr, &hooks);
+    // Its own scope, so the counters below are not counted as allocations.
+    {
+        const AllocationCounter allocations(state);
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(sequence.isHolding() ? sequence.jump(PhaseWalking) : sequence.step());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    benchmark::DoNotOptimize(hooks);
+}
+BENCHMARK(BM_step)->ArgName("hook")->Arg(0)->Arg(1);
+
+// tick() with a 100msec Ticker: mostly a count down, a step every fifth call in the blink.
+static void BM_tick(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    SignalSequence sequence;
+    sequence.begin(benchmarkPhases, benchmarkLamps, PhaseWalking);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        if (sequence.isHolding())
+        {
+            sequence.jump(PhaseWalking);
+        }
+        sequence.tick(100);
+        benchmark::DoNotOptimize(sequence);
+    }
+}
+BENCHMARK(BM_tick);
+
+// From WALK, the longest walk of the table to the held STOP.
+static void BM_getRemainsToHold(benchmark::State& state)
+{
+    signalHostPinHandler = ignorePin;
+    SignalSequence sequence;
+    sequence.begin(benchmarkPhases, benchmarkLamps, PhaseWalking);
+    const AllocationCounter allocations(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(sequence.getRemainsToHold());
+    }
+}
+BENCHMARK(BM_getRemainsToHold);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,248 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+
+#include <SignalHal.h>
+
+// Only what the sketches and SignalCommon call, on top of the POSIX backend of SignalHal.h:
+// the clock and pins are the backend's, delay() lets the timer callbacks run as on ESP8266.
+
+////////////////////////////////////////////////
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define PROGMEM
+#define F(text) (text)
+
+static inline void* memcpy_P(void* pDestination, const void* pSource, const size_t size)
+{
+    return memcpy(pDestination, pSource, size);
+}
+
+static inline uint32_t millis()
+{
+    return signalMillis();
+}
+
+static inline uint32_t micros()
+{
+    return signalMicros();
+}
+
+// Releases the loop, so due timer callbacks run meanwhile. Under a virtual clock the
+// simulator's handler advances the time instead of sleeping.
+void delay(const uint32_t millisecond);
+void delayMicroseconds(const uint32_t microsecond);
+void yield();
+
+typedef void (*HostDelayHandler)(const uint64_t microsecond);
+extern HostDelayHandler hostDelayHandler;   // nullptr: real sleep
+
+// What the system does between loop() passes: the due timer callbacks and the deferred
+// network callbacks. Called by the host main, delay() and yield().
+void hostService();
+
+void pinMode(const uint8_t pin, const uint8_t mode);
+void digitalWrite(const uint8_t pin, const uint8_t value);
+int digitalRead(const uint8_t pin);
+
+// Level of an input pin, e.g. a button pressed by a test.
+void hostSetInput(const uint8_t pin, const bool on);
+
+////////////////////////////////////////////////
+
+class String
+{
+private:
+    std::string value;
+
+public:
+    String() = default;
+    String(const char* pText) : value((pText != nullptr) ? pText : "") {}
+    String(const std::string& text) : value(text) {}
+    explicit String(const char ch) : value(1, ch) {}
+    explicit String(const int number) : value(std::to_string(number)) {}
+    explicit String(const unsigned int number) : value(std::to_string(number)) {}
+    explicit String(const long number) : value(std::to_string(number)) {}
+    explicit String(const unsigned long number) : value(std::to_string(number)) {}
+
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return static_cast<unsigned int>(value.length()); }
+    bool isEmpty() const { return value.empty(); }
+    long toInt() const { return strtol(value.c_str(), nullptr, 10); }
+
+    String& operator+=(const String& rhs) { value += rhs.value; return *this; }
+    String& operator+=(const char* pText) { value += pText; return *this; }
+    String& operator+=(const char ch) { value += ch; return *this; }
+    String& operator+=(const int number) { value += std::to_string(number); return *this; }
+    String& operator+=(const unsigned int number) { value += std::to_string(number); return *this; }
+    String& operator+=(const long number) { value += std::to_string(number); return *this; }
+    String& operator+=(const unsigned long number) { value += std::to_string(number); return *this; }
+
+    bool operator==(const String& rhs) const { return value == rhs.value; }
+    bool operator==(const char* pText) const { return value == pText; }
+    bool operator!=(const String& rhs) const { return value != rhs.value; }
+
+    friend String operator+(String lhs, const String& rhs) { lhs += rhs; return lhs; }
+    friend String operator+(String lhs, const char* pText) { lhs += pText; return lhs; }
+};
+
+////////////////////////////////////////////////
+
+class Print;
+
+class Printable
+{
+public:
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(const uint8_t ch) = 0;
+
+    virtual size_t write(const uint8_t* pBuffer, const size_t size)
+    {
+        size_t written = 0;
+        while ((written < size) && (write(pBuffer[written]) == 1))
+        {
+            written++;
+        }
+        return written;
+    }
+
+    virtual int availableForWrite()
+    {
+        return 0;
+    }
+
+    virtual void flush()
+    {
+    }
+
+    size_t write(const char* pText)
+    {
+        return write(reinterpret_cast<const uint8_t*>(pText), strlen(pText));
+    }
+
+    size_t print(const char* pText) { return write(pText); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(const char ch) { return write(static_cast<uint8_t>(ch)); }
+    size_t print(const int number) { return print(String(number)); }
+    size_t print(const unsigned int number) { return print(String(number)); }
+    size_t print(const long number) { return print(String(number)); }
+    size_t print(const unsigned long number) { return print(String(number)); }
+    size_t print(const Printable& value) { return value.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+
+    template <typename T>
+    size_t println(const T& value)
+    {
+        const size_t size = print(value);
+        return size + println();
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+// Console: writes go to pHostSerialOutput, reads come from stdin without blocking.
+class HardwareSerial : public Stream
+{
+public:
+    void begin(const unsigned long baud);
+
+    size_t write(const uint8_t ch) override;
+    size_t write(const uint8_t* pBuffer, const size_t size) override;
+    using Print::write;
+
+    int availableForWrite() override;
+    void flush() override;
+
+    int available() override;
+    int read() override;
+};
+
+extern HardwareSerial Serial;
+extern FILE* pHostSerialOutput;   // stdout, nullptr: dropped
+
+////////////////////////////////////////////////
+
+#define RF_DEFAULT 0
+
+// Heap and stack queries answer from the SignalHal backend. RTC user memory is 512 bytes
+// in RAM, kept across a simulated deep sleep only within the process.
+class EspClass
+{
+public:
+    uint32_t getCycleCount() { return signalCycles(); }
+    uint32_t getCpuFreqMHz() { return signalCpuMHz(); }
+    uint32_t getFreeHeap() { return signalFreeHeap(); }
+    uint32_t getMaxFreeBlockSize() { return signalMaxFreeBlock(); }
+    uint8_t getHeapFragmentation() { return signalHeapFragmentation(); }
+    uint32_t getFreeContStack() { return signalFreeStack(); }
+
+    bool rtcUserMemoryRead(const uint32_t offset, uint32_t* pData, const size_t size);
+    bool rtcUserMemoryWrite(const uint32_t offset, uint32_t* pData, const size_t size);
+
+    uint64_t deepSleepMax() { return 3ULL * 3600 * 1000000; }
+    // Doesn't return: the chip resets when the sleep ends, or the process ends.
+    void deepSleep(const uint64_t microsecond, const int mode = RF_DEFAULT);
+    void restart();
+};
+
+extern EspClass ESP;
+
+// A simulator's handler starts the program again after the sleep, as the chip does,
+// with only the RTC and the RTC user memory kept.
+typedef void (*HostDeepSleepHandler)(const uint64_t microsecond);
+extern HostDeepSleepHandler hostDeepSleepHandler;   // nullptr: the process ends
+
+#endif
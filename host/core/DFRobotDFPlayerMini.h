@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_DFROBOT_DFPLAYER_MINI_H
+#define HOST_DFROBOT_DFPLAYER_MINI_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////
+
+// The sound player, each track played is a line on stderr.
+class DFRobotDFPlayerMini
+{
+public:
+    bool begin(Stream& stream)
+    {
+        (void)stream;
+        return true;
+    }
+
+    void volume(const uint8_t volume)
+    {
+        (void)volume;
+    }
+
+    void play(const int track)
+    {
+        fprintf(stderr, "%lu DFPlayer play %d\n", static_cast<unsigned long>(millis()), track);
+    }
+};
+
+#endif
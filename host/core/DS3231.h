@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_DS3231_H
+#define HOST_DS3231_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////
+
+// The date part of the DS3231 library (NorthernWidget), no time zone: the sketches keep
+// local time in the chip.
+class DateTime
+{
+private:
+    uint16_t y;
+    uint8_t m;
+    uint8_t d;
+    uint8_t hh;
+    uint8_t mm;
+    uint8_t ss;
+
+public:
+    DateTime(const uint32_t unixTime = 0);
+    DateTime(const uint16_t year, const uint8_t month, const uint8_t day,
+        const uint8_t hour = 0, const uint8_t minute = 0, const uint8_t second = 0);
+
+    uint16_t year() const { return y; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfTheWeek() const;   // 0: Sunday
+
+    uint32_t unixtime() const;
+};
+
+class RTClib
+{
+public:
+    static DateTime now();
+};
+
+////////////////////////////////////////////////
+
+// Emulated chip: counts from signalHostClock at 1 + drift ppm, starting at the local wall
+// clock. Writing the seconds restarts the second as the countdown chain reset does.
+class DS3231
+{
+public:
+    byte getSecond();
+
+    void setClockMode(const bool h12) { (void)h12; }
+    void setSecond(const byte second);
+    void setMinute(const byte minute);
+    void setHour(const byte hour);
+    void setDoW(const byte dayOfWeek) { (void)dayOfWeek; }
+    void setDate(const byte date);
+    void setMonth(const byte month);
+    void setYear(const byte year);
+
+    // Alarm 1 on day of month, hour, minute and second (AlarmBits 0, A1Dy false, 24h).
+    void setA1Time(const byte day, const byte hour, const byte minute, const byte second,
+        const byte alarmBits, const bool dayIsDayOfWeek, const bool h12, const bool pm);
+    void turnOnAlarm(const byte alarm);
+    void turnOffAlarm(const byte alarm);
+    // Returns and clears the flag.
+    bool checkIfAlarm(const byte alarm);
+};
+
+// Test hooks.
+void hostSetRtcTime(const uint32_t unixTime);
+void hostSetRtcDrift(const double ppm);
+uint64_t hostGetRtcMicros();   // chip time, usec since the unix epoch
+
+// The whole chip, kept across a simulated deep sleep.
+struct HostRtcState
+{
+    uint64_t micros;        // chip time
+    double driftPpm;
+    uint64_t alarmMicros;   // next alarm 1 match, 0 for none
+    bool alarmEnabled;      // would pull INT/SQW low
+    bool alarmFlag;
+};
+
+HostRtcState hostGetRtcState();
+void hostSetRtcState(const HostRtcState& state);   // from now on signalHostClock
+
+#endif
@@ -0,0 +1,111 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_ESP8266_WEB_SERVER_H
+#define HOST_ESP8266_WEB_SERVER_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_POST
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+// One request per handleClient() as the ESP8266 server does, each on its own connection
+// (Connection: close). Also as there, the server waits for the client to close after the
+// answer: until then, at most HTTP_MAX_CLOSE_WAIT, handleClient() takes no other client.
+// A handler keeping a copy of server.client() for a later answer stalls it that long.
+class ESP8266WebServer
+{
+public:
+    typedef std::function<void()> THandlerFunction;
+
+private:
+    struct Route
+    {
+        std::string path;
+        HTTPMethod method;
+        THandlerFunction handler;
+    };
+
+    uint16_t port;
+    int listenFd;
+    std::vector<Route> routes;
+    THandlerFunction notFoundHandler;
+
+    WiFiClient currentClient;
+    bool waitingClose;
+    uint32_t waitCloseSince;
+    std::string currentUri;
+    std::vector<std::pair<std::string, std::string>> currentArgs;
+    std::string responseHeaders;
+    size_t contentLength;
+    bool chunked;
+
+    bool readRequest(const int fd, std::string& request);
+    void parseQuery(const std::string& query);
+    bool sendRaw(const char* pData, const size_t size);
+    void reset();
+
+public:
+    explicit ESP8266WebServer(const uint16_t port = 80);
+    ~ESP8266WebServer();
+
+    void on(const char* pUri, const HTTPMethod method, const THandlerFunction& handler);
+    void on(const char* pUri, const THandlerFunction& handler) { on(pUri, HTTP_ANY, handler); }
+    void onNotFound(const THandlerFunction& handler) { notFoundHandler = handler; }
+
+    void begin();
+    void close();
+    void handleClient();
+
+    const String uri() const { return String(currentUri); }
+    String arg(const char* pName) const;
+    String arg(const String& name) const { return arg(name.c_str()); }
+    bool hasArg(const char* pName) const;
+    bool hasArg(const String& name) const { return hasArg(name.c_str()); }
+    int args() const { return static_cast<int>(currentArgs.size()); }
+
+    WiFiClient client() { return currentClient; }
+
+    void sendHeader(const String& name, const String& value, const bool first = false);
+    void setContentLength(const size_t length) { contentLength = length; }
+    void send(const int code, const char* pContentType, const String& content);
+    void send(const int code, const char* pContentType, const char* pContent) { send(code, pContentType, String(pContent)); }
+    void sendContent(const String& content);
+    void sendContent(const char* pContent) { sendContent(String(pContent)); }
+};
+
+#endif
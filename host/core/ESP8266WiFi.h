@@ -0,0 +1,157 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_ESP8266_WIFI_H
+#define HOST_ESP8266_WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <memory>
+
+#include "HostNetwork.h"
+
+////////////////////////////////////////////////
+
+enum WiFiMode
+{
+    WIFI_OFF,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA
+};
+
+enum wl_status_t
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+};
+
+// Association is immediate on real sockets, timed by the simulated network otherwise.
+class ESP8266WiFiClass
+{
+private:
+    WiFiMode currentMode;
+    bool started;
+    bool connected;
+    uint32_t associationMillisecond;
+    uint32_t startedAt;
+    bool staticAddress;
+    IPAddress local;
+    IPAddress gateway;
+    IPAddress subnet;
+    IPAddress dns;
+    uint8_t bssid[6];
+    uint8_t currentChannel;
+
+public:
+    ESP8266WiFiClass();
+
+    bool mode(const WiFiMode mode);
+    void persistent(const bool value) { (void)value; }
+    void setAutoReconnect(const bool value) { (void)value; }
+    void forceSleepWake() {}
+    void forceSleepBegin() {}
+
+    bool config(const IPAddress& local, const IPAddress& gateway, const IPAddress& subnet,
+        const IPAddress& dns = IPAddress());
+    wl_status_t begin(const char* pSsid, const char* pPassword,
+        const int32_t channel = 0, const uint8_t* pBssid = nullptr);
+    bool disconnect();
+    wl_status_t status();
+
+    IPAddress localIP() const { return local; }
+    IPAddress gatewayIP() const { return gateway; }
+    IPAddress subnetMask() const { return subnet; }
+    IPAddress dnsIP() const { return dns; }
+    IPAddress broadcastIP() const { return IPAddress(static_cast<uint32_t>(local) | ~static_cast<uint32_t>(subnet)); }
+    uint8_t* BSSID() { return bssid; }
+    int32_t channel() const { return currentChannel; }
+    int32_t RSSI() const { return -40; }
+
+    bool softAPConfig(const IPAddress& local, const IPAddress& gateway, const IPAddress& subnet);
+    bool softAP(const char* pSsid, const char* pPassword);
+    IPAddress softAPIP() const { return local; }
+
+    // Addresses are mapped to loopback, see HostNetwork.h.
+    bool isStaticAddress() const { return staticAddress; }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+////////////////////////////////////////////////
+
+// TCP connection, copies share it and it closes when the last one goes, as on ESP8266.
+class WiFiClient
+{
+private:
+    struct Connection
+    {
+        int fd;
+        ~Connection();
+    };
+
+    std::shared_ptr<Connection> pConnection;
+
+public:
+    WiFiClient() = default;
+    explicit WiFiClient(const int fd);
+
+    size_t write(const uint8_t* pBuffer, const size_t size);
+    int available();                                  // bytes received, not read yet
+    int read(uint8_t* pBuffer, const size_t size);    // without waiting, -1 if none
+    int read();
+    bool connected();
+    void stop();
+
+    explicit operator bool() const { return static_cast<bool>(pConnection); }
+    int getFd() const { return pConnection ? pConnection->fd : -1; }
+};
+
+// Listening socket on the mapped node address, as ESP8266WebServer's.
+class WiFiServer
+{
+private:
+    uint16_t port;
+    int listenFd;
+
+public:
+    explicit WiFiServer(const uint16_t port);
+    ~WiFiServer();
+
+    WiFiServer(const WiFiServer&) = delete;
+    WiFiServer& operator=(const WiFiServer&) = delete;
+
+    void begin();
+    void close();
+    void setNoDelay(const bool value) { (void)value; }   // always on
+
+    // The next connection, an empty client if none is waiting.
+    WiFiClient available();
+};
+
+#endif
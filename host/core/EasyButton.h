@@ -0,0 +1,68 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_EASY_BUTTON_H
+#define HOST_EASY_BUTTON_H
+
+#include <Arduino.h>
+
+#include <functional>
+
+////////////////////////////////////////////////
+
+// Active low with the pull-up, pressed by hostSetInput(pin, false); calls back on release.
+class EasyButton
+{
+private:
+    uint8_t pin;
+    bool pressed;
+    std::function<void()> pressedCallback;
+
+public:
+    explicit EasyButton(const uint8_t pin)
+        : pin(pin), pressed(false)
+    {
+    }
+
+    void begin()
+    {
+        pinMode(pin, INPUT_PULLUP);
+    }
+
+    void onPressed(const std::function<void()>& callback)
+    {
+        pressedCallback = callback;
+    }
+
+    bool read()
+    {
+        const bool now = (digitalRead(pin) == LOW);
+        if (pressed && !now && pressedCallback)
+        {
+            pressedCallback();
+        }
+        pressed = now;
+        return now;
+    }
+};
+
+#endif
@@ -0,0 +1,222 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "HostNetwork.h"
+
+////////////////////////////////////////////////
+
+HardwareSerial Serial;
+FILE* pHostSerialOutput = stdout;
+EspClass ESP;
+
+HostDelayHandler hostDelayHandler = nullptr;
+HostDeepSleepHandler hostDeepSleepHandler = nullptr;
+
+static uint32_t outputPins = 0;   // bit n: IOn is an output
+static uint32_t inputLevels = UINT32_MAX;   // inputs read high, as with the pull-ups
+
+static uint32_t rtcUserMemory[128];   // 512 bytes
+
+void hostService()
+{
+    hostRunDeferred();
+    signalHostRunTimers();
+}
+
+static void sleepMicroseconds(const uint64_t microsecond)
+{
+    const timespec span = { static_cast<time_t>(microsecond / 1000000), static_cast<long>((microsecond % 1000000) * 1000) };
+    nanosleep(&span, nullptr);
+}
+
+// Wakes for every due timer, and at least each msec for the network.
+static void wait(const uint64_t microsecond)
+{
+    if (hostDelayHandler != nullptr)
+    {
+        hostDelayHandler(microsecond);
+        return;
+    }
+
+    const uint64_t end = signalHostClock() + microsecond;
+    while (true)
+    {
+        hostService();
+
+        const uint64_t now = signalHostClock();
+        if (now >= end)
+        {
+            break;
+        }
+
+        uint64_t next = (end < (now + 1000)) ? end : (now + 1000);
+        const uint64_t due = SignalHostTimer::getNextDue();
+        next = (due < next) ? due : next;
+        if (next > now)
+        {
+            sleepMicroseconds(next - now);
+        }
+    }
+}
+
+void delay(const uint32_t millisecond)
+{
+    wait(static_cast<uint64_t>(millisecond) * 1000);
+}
+
+// Busy waits on the node, no timer runs meanwhile.
+void delayMicroseconds(const uint32_t microsecond)
+{
+    if (hostDelayHandler != nullptr)
+    {
+        hostDelayHandler(microsecond);
+        return;
+    }
+
+    sleepMicroseconds(microsecond);
+}
+
+void yield()
+{
+    hostService();
+}
+
+void pinMode(const uint8_t pin, const uint8_t mode)
+{
+    const uint32_t bit = 1UL << pin;
+    outputPins = (mode == OUTPUT) ? (outputPins | bit) : (outputPins & ~bit);
+    signalPinOutput(pin);
+}
+
+void digitalWrite(const uint8_t pin, const uint8_t value)
+{
+    signalWritePin(pin, value != LOW);
+}
+
+int digitalRead(const uint8_t pin)
+{
+    const uint32_t bit = 1UL << pin;
+    const uint32_t levels = ((outputPins & bit) != 0) ? signalHostPins : inputLevels;
+    return ((levels & bit) != 0) ? HIGH : LOW;
+}
+
+void hostSetInput(const uint8_t pin, const bool on)
+{
+    const uint32_t bit = 1UL << pin;
+    inputLevels = on ? (inputLevels | bit) : (inputLevels & ~bit);
+}
+
+////////////////////////////////////////////////
+
+void HardwareSerial::begin(const unsigned long baud)
+{
+    (void)baud;
+}
+
+size_t HardwareSerial::write(const uint8_t ch)
+{
+    return ((pHostSerialOutput == nullptr) || (fputc(ch, pHostSerialOutput) != EOF)) ? 1 : 0;
+}
+
+size_t HardwareSerial::write(const uint8_t* pBuffer, const size_t size)
+{
+    return (pHostSerialOutput != nullptr) ? fwrite(pBuffer, 1, size, pHostSerialOutput) : size;
+}
+
+// Never full, the host console takes it all.
+int HardwareSerial::availableForWrite()
+{
+    return 4096;
+}
+
+void HardwareSerial::flush()
+{
+    if (pHostSerialOutput != nullptr)
+    {
+        fflush(pHostSerialOutput);
+    }
+}
+
+int HardwareSerial::available()
+{
+    pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    return ((poll(&input, 1, 0) == 1) && ((input.revents & POLLIN) != 0)) ? 1 : 0;
+}
+
+int HardwareSerial::read()
+{
+    uint8_t ch;
+    return ((available() != 0) && (::read(STDIN_FILENO, &ch, 1) == 1)) ? ch : -1;
+}
+
+////////////////////////////////////////////////
+
+// offset in 4-byte blocks, as on ESP8266.
+bool EspClass::rtcUserMemoryRead(const uint32_t offset, uint32_t* pData, const size_t size)
+{
+    if ((offset * 4 + size) > sizeof rtcUserMemory)
+    {
+        return false;
+    }
+
+    memcpy(pData, reinterpret_cast<const uint8_t*>(rtcUserMemory) + offset * 4, size);
+    return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(const uint32_t offset, uint32_t* pData, const size_t size)
+{
+    if ((offset * 4 + size) > sizeof rtcUserMemory)
+    {
+        return false;
+    }
+
+    memcpy(reinterpret_cast<uint8_t*>(rtcUserMemory) + offset * 4, pData, size);
+    return true;
+}
+
+// The process ends unless a simulator's handler wakes it.
+void EspClass::deepSleep(const uint64_t microsecond, const int mode)
+{
+    (void)mode;
+    if (hostDeepSleepHandler != nullptr)
+    {
+        hostDeepSleepHandler(microsecond);
+    }
+
+    fprintf(stderr, "%lu deep sleep for %llu msec, exiting\n",
+        static_cast<unsigned long>(millis()), static_cast<unsigned long long>(microsecond / 1000));
+    fflush(stdout);
+    exit(0);
+}
+
+void EspClass::restart()
+{
+    fprintf(stderr, "%lu restart, exiting\n", static_cast<unsigned long>(millis()));
+    fflush(stdout);
+    exit(0);
+}
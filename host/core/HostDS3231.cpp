@@ -0,0 +1,273 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DS3231.h>
+#include <Wire.h>
+
+#include <time.h>
+
+////////////////////////////////////////////////
+
+TwoWire Wire;
+
+// Days since 1970-01-01 of a date (proleptic Gregorian).
+static int64_t toDays(const int64_t year, const uint8_t month, const uint8_t day)
+{
+    const int64_t y = year - ((month <= 2) ? 1 : 0);
+    const int64_t era = ((y >= 0) ? y : (y - 399)) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+DateTime::DateTime(const uint32_t unixTime)
+{
+    const int64_t days = unixTime / 86400;
+    const uint32_t seconds = unixTime % 86400;
+
+    const int64_t z = days + 719468;
+    const int64_t era = z / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+
+    d = static_cast<uint8_t>(doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast<uint8_t>((mp < 10) ? (mp + 3) : (mp - 9));
+    y = static_cast<uint16_t>(yoe + era * 400 + ((m <= 2) ? 1 : 0));
+    hh = static_cast<uint8_t>(seconds / 3600);
+    mm = static_cast<uint8_t>((seconds / 60) % 60);
+    ss = static_cast<uint8_t>(seconds % 60);
+}
+
+DateTime::DateTime(const uint16_t year, const uint8_t month, const uint8_t day,
+    const uint8_t hour, const uint8_t minute, const uint8_t second)
+    : y((year < 100) ? (year + 2000) : year), m(month), d(day), hh(hour), mm(minute), ss(second)
+{
+}
+
+uint8_t DateTime::dayOfTheWeek() const
+{
+    return static_cast<uint8_t>((toDays(y, m, d) + 4) % 7);   // 1970-01-01 was a Thursday
+}
+
+uint32_t DateTime::unixtime() const
+{
+    return static_cast<uint32_t>(toDays(y, m, d) * 86400 + hh * 3600 + mm * 60 + ss);
+}
+
+////////////////////////////////////////////////
+
+// Chip time = base + (clock - baseClock) * (1 + drift).
+static bool rtcStarted = false;
+static uint64_t rtcBaseMicros;     // usec since the epoch
+static uint64_t rtcBaseClock;      // signalHostClock
+static double rtcDriftPpm = 0;
+
+static bool alarmEnabled = false;   // INT/SQW pulled low on the flag, wakes a simulated sleep
+static bool alarmFlag = false;
+static uint64_t alarmMicros = 0;   // next match, usec since the epoch
+
+static void startRtc()
+{
+    if (!rtcStarted)
+    {
+        const time_t now = time(nullptr);
+        tm local;
+        localtime_r(&now, &local);
+        rtcBaseMicros = static_cast<uint64_t>(now + local.tm_gmtoff) * 1000000;
+        rtcBaseClock = signalHostClock();
+        rtcStarted = true;
+    }
+}
+
+uint64_t hostGetRtcMicros()
+{
+    startRtc();
+    const double elapsed = static_cast<double>(signalHostClock() - rtcBaseClock);
+    return rtcBaseMicros + static_cast<uint64_t>(elapsed * (1.0 + rtcDriftPpm / 1000000.0));
+}
+
+// Latches the alarm flag once the chip passed the match, enabled or not as on the chip.
+static uint64_t readRtc()
+{
+    const uint64_t now = hostGetRtcMicros();
+    if ((alarmMicros != 0) && (now >= alarmMicros))
+    {
+        alarmFlag = true;
+        alarmMicros = 0;
+    }
+    return now;
+}
+
+static void writeRtc(const uint64_t micros)
+{
+    readRtc();
+    rtcBaseMicros = micros;
+    rtcBaseClock = signalHostClock();
+}
+
+void hostSetRtcTime(const uint32_t unixTime)
+{
+    startRtc();
+    writeRtc(static_cast<uint64_t>(unixTime) * 1000000);
+}
+
+void hostSetRtcDrift(const double ppm)
+{
+    // Keeps the time read so far, only the rate from now on changes.
+    startRtc();
+    writeRtc(hostGetRtcMicros());
+    rtcDriftPpm = ppm;
+}
+
+HostRtcState hostGetRtcState()
+{
+    HostRtcState state;
+    state.micros = readRtc();
+    state.driftPpm = rtcDriftPpm;
+    state.alarmMicros = alarmMicros;
+    state.alarmEnabled = alarmEnabled;
+    state.alarmFlag = alarmFlag;
+    return state;
+}
+
+void hostSetRtcState(const HostRtcState& state)
+{
+    startRtc();
+    rtcBaseMicros = state.micros;
+    rtcBaseClock = signalHostClock();
+    rtcDriftPpm = state.driftPpm;
+    alarmMicros = state.alarmMicros;
+    alarmEnabled = state.alarmEnabled;
+    alarmFlag = state.alarmFlag;
+}
+
+DateTime RTClib::now()
+{
+    return DateTime(static_cast<uint32_t>(readRtc() / 1000000));
+}
+
+////////////////////////////////////////////////
+
+// A field written: the others and the running second stay.
+template <typename F>
+static void writeField(F update)
+{
+    const uint64_t now = readRtc();
+    const DateTime time(static_cast<uint32_t>(now / 1000000));
+    uint16_t fields[6] = { time.year(), time.month(), time.day(), time.hour(), time.minute(), time.second() };
+    update(fields);
+    const DateTime updated(fields[0], static_cast<uint8_t>(fields[1]), static_cast<uint8_t>(fields[2]),
+        static_cast<uint8_t>(fields[3]), static_cast<uint8_t>(fields[4]), static_cast<uint8_t>(fields[5]));
+    writeRtc(static_cast<uint64_t>(updated.unixtime()) * 1000000 + now % 1000000);
+}
+
+byte DS3231::getSecond()
+{
+    return RTClib::now().second();
+}
+
+void DS3231::setSecond(const byte second)
+{
+    writeField([second](uint16_t* pFields) { pFields[5] = second; });
+
+    // The countdown chain restarts: the new second begins now.
+    writeRtc(hostGetRtcMicros() / 1000000 * 1000000);
+}
+
+void DS3231::setMinute(const byte minute)
+{
+    writeField([minute](uint16_t* pFields) { pFields[4] = minute; });
+}
+
+void DS3231::setHour(const byte hour)
+{
+    writeField([hour](uint16_t* pFields) { pFields[3] = hour; });
+}
+
+void DS3231::setDate(const byte date)
+{
+    writeField([date](uint16_t* pFields) { pFields[2] = date; });
+}
+
+void DS3231::setMonth(const byte month)
+{
+    writeField([month](uint16_t* pFields) { pFields[1] = month; });
+}
+
+void DS3231::setYear(const byte year)
+{
+    writeField([year](uint16_t* pFields) { pFields[0] = 2000 + year; });
+}
+
+void DS3231::setA1Time(const byte day, const byte hour, const byte minute, const byte second,
+    const byte alarmBits, const bool dayIsDayOfWeek, const bool h12, const bool pm)
+{
+    (void)alarmBits;
+    (void)h12;
+    (void)pm;
+
+    // The next second matching the day, hour, minute and second, within two months.
+    // The day of week counts from Sunday as 0.
+    const uint32_t now = static_cast<uint32_t>(readRtc() / 1000000);
+    alarmMicros = 0;
+    for (uint32_t days = 0; days < 62; days++)
+    {
+        const DateTime date(now + days * 86400);
+        if ((dayIsDayOfWeek ? date.dayOfTheWeek() : date.day()) == day)
+        {
+            const uint32_t match = DateTime(date.year(), date.month(), date.day(), hour, minute, second).unixtime();
+            if (match > now)
+            {
+                alarmMicros = static_cast<uint64_t>(match) * 1000000;
+                break;
+            }
+        }
+    }
+}
+
+void DS3231::turnOnAlarm(const byte alarm)
+{
+    readRtc();
+    alarmEnabled = alarmEnabled || (alarm == 1);
+}
+
+void DS3231::turnOffAlarm(const byte alarm)
+{
+    readRtc();
+    alarmEnabled = alarmEnabled && (alarm != 1);
+}
+
+bool DS3231::checkIfAlarm(const byte alarm)
+{
+    readRtc();
+    if (alarm != 1)
+    {
+        return false;
+    }
+
+    const bool flag = alarmFlag;
+    alarmFlag = false;
+    return flag;
+}
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+
+#include <signal.h>
+#include <time.h>
+
+////////////////////////////////////////////////
+
+// main() of a sketch built natively: setup() once, then loop() with the system work
+// in between, until SIGINT/SIGTERM or SIGNAL_HOST_RUN_SECONDS (for smoke tests).
+
+void setup();
+void loop();
+
+#define HOST_LOOP_IDLE 200   // usec slept after each pass, the node spins instead
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(const int signal)
+{
+    (void)signal;
+    stopping = 1;
+}
+
+int main()
+{
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    const char* pRunSeconds = getenv("SIGNAL_HOST_RUN_SECONDS");
+    const uint64_t runMicrosecond = (pRunSeconds != nullptr) ? strtoull(pRunSeconds, nullptr, 10) * 1000000 : 0;
+
+    signalHostStartMicros();
+    setup();
+
+    const timespec idle = { 0, HOST_LOOP_IDLE * 1000 };
+    while (stopping == 0)
+    {
+        loop();
+        hostService();
+        if ((runMicrosecond != 0) && (signalHostClock() >= runMicrosecond))
+        {
+            break;
+        }
+        nanosleep(&idle, nullptr);
+    }
+
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,619 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
+#include <lwip/dhcp.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "HostNetwork.h"
+
+////////////////////////////////////////////////
+
+ESP8266WiFiClass WiFi;
+
+HostSimulatedNetwork* pHostSimulatedNetwork = nullptr;
+
+static struct dhcp hostDhcp = { 0 };
+static struct netif hostNetif = { nullptr };
+struct netif* netif_default = nullptr;
+
+static std::vector<std::function<void()>> deferred;
+static std::vector<WiFiUDP*> simulatedSockets;   // bound on the simulated network
+
+void hostDefer(const std::function<void()>& callback)
+{
+    deferred.push_back(callback);
+}
+
+void hostRunDeferred()
+{
+    // Taken first: a callback may defer the next one.
+    std::vector<std::function<void()>> callbacks;
+    callbacks.swap(deferred);
+    for (const auto& callback : callbacks)
+    {
+        callback();
+    }
+}
+
+static uint16_t getPortOffset()
+{
+    static const uint16_t offset = []()
+    {
+        const char* pText = getenv("SIGNAL_HOST_PORT_OFFSET");
+        return static_cast<uint16_t>((pText != nullptr) ? strtoul(pText, nullptr, 10) : 10000);
+    }();
+    return offset;
+}
+
+uint16_t hostGetPort(const uint16_t port)
+{
+    const uint32_t moved = static_cast<uint32_t>(port) + getPortOffset();
+    return (moved <= UINT16_MAX) ? static_cast<uint16_t>(moved) : port;
+}
+
+// A node of our own intersection: a static address on the configured subnet.
+static bool isMapped(const IPAddress& address)
+{
+    const uint32_t local = WiFi.localIP();
+    const uint32_t subnet = WiFi.subnetMask();
+    return WiFi.isStaticAddress() && (WiFi.localIP()[0] != 127) &&
+        ((static_cast<uint32_t>(address) & subnet) == (local & subnet));
+}
+
+uint32_t hostToSocketAddress(const IPAddress& address)
+{
+    return isMapped(address) ? static_cast<uint32_t>(IPAddress(127, 0, address[2], address[3])) : static_cast<uint32_t>(address);
+}
+
+IPAddress hostFromSocketAddress(const uint32_t address)
+{
+    const IPAddress socketAddress(address);
+    const IPAddress local = WiFi.localIP();
+    const IPAddress mapped(local[0], local[1], socketAddress[2], socketAddress[3]);
+    return ((socketAddress[0] == 127) && isMapped(mapped)) ? mapped : socketAddress;
+}
+
+IPAddress::IPAddress(const ip_addr* pAddress)
+    : address((pAddress != nullptr) ? pAddress->addr : 0)
+{
+}
+
+////////////////////////////////////////////////
+
+ESP8266WiFiClass::ESP8266WiFiClass()
+    : currentMode(WIFI_OFF), started(false), connected(false), associationMillisecond(0), startedAt(0)
+    , staticAddress(false), bssid { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }, currentChannel(1)
+{
+}
+
+bool ESP8266WiFiClass::mode(const WiFiMode mode)
+{
+    currentMode = mode;
+    if (mode == WIFI_OFF)
+    {
+        disconnect();
+    }
+    return true;
+}
+
+bool ESP8266WiFiClass::config(const IPAddress& local, const IPAddress& gateway, const IPAddress& subnet,
+    const IPAddress& dns)
+{
+    staticAddress = local.isSet();
+    this->local = local;
+    this->gateway = gateway;
+    this->subnet = subnet;
+    this->dns = dns.isSet() ? dns : gateway;
+    return true;
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char* pSsid, const char* pPassword,
+    const int32_t channel, const uint8_t* pBssid)
+{
+    (void)pSsid;
+    (void)pPassword;
+
+    const bool fast = (channel != 0) && (pBssid != nullptr);
+    if (fast)
+    {
+        currentChannel = static_cast<uint8_t>(channel);
+        memcpy(bssid, pBssid, sizeof bssid);
+    }
+
+    started = true;
+    connected = false;
+    startedAt = millis();
+    associationMillisecond = (pHostSimulatedNetwork != nullptr) ? pHostSimulatedNetwork->getAssociationMillisecond(fast) : 0;
+    return WL_DISCONNECTED;
+}
+
+bool ESP8266WiFiClass::disconnect()
+{
+    started = false;
+    connected = false;
+    netif_default = nullptr;
+    if (!staticAddress)
+    {
+        local = IPAddress();
+        gateway = IPAddress();
+        subnet = IPAddress();
+        dns = IPAddress();
+    }
+    return true;
+}
+
+// DHCP answers with the association: the real network runs on loopback.
+wl_status_t ESP8266WiFiClass::status()
+{
+    if (!started)
+    {
+        return WL_DISCONNECTED;
+    }
+
+    if (!connected)
+    {
+        if ((millis() - startedAt) < associationMillisecond)
+        {
+            return WL_DISCONNECTED;
+        }
+
+        connected = true;
+        netif_default = &hostNetif;
+        hostNetif.dhcp = nullptr;
+        if (!staticAddress)
+        {
+            if (pHostSimulatedNetwork != nullptr)
+            {
+                local = pHostSimulatedNetwork->getDhcpAddress();
+                gateway = IPAddress(local[0], local[1], local[2], 1);
+                subnet = IPAddress(255, 255, 255, 0);
+                hostDhcp.offered_t0_lease = pHostSimulatedNetwork->getDhcpLeaseSecond();
+            }
+            else
+            {
+                local = IPAddress(127, 0, 0, 1);
+                gateway = local;
+                subnet = IPAddress(255, 0, 0, 0);
+                hostDhcp.offered_t0_lease = 86400;
+            }
+            dns = gateway;
+            hostNetif.dhcp = &hostDhcp;
+        }
+    }
+    return WL_CONNECTED;
+}
+
+bool ESP8266WiFiClass::softAPConfig(const IPAddress& local, const IPAddress& gateway, const IPAddress& subnet)
+{
+    return config(local, gateway, subnet);
+}
+
+bool ESP8266WiFiClass::softAP(const char* pSsid, const char* pPassword)
+{
+    begin(pSsid, pPassword);
+    associationMillisecond = 0;
+    return true;
+}
+
+////////////////////////////////////////////////
+
+WiFiClient::Connection::~Connection()
+{
+    close(fd);
+}
+
+WiFiClient::WiFiClient(const int fd)
+    : pConnection(new Connection { fd })
+{
+}
+
+size_t WiFiClient::write(const uint8_t* pBuffer, const size_t size)
+{
+    if (!pConnection)
+    {
+        return 0;
+    }
+
+    size_t written = 0;
+    while (written < size)
+    {
+        const ssize_t sent = send(pConnection->fd, pBuffer + written, size - written, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            break;
+        }
+        written += static_cast<size_t>(sent);
+    }
+    return written;
+}
+
+int WiFiClient::available()
+{
+    int size = 0;
+    return (pConnection && (ioctl(pConnection->fd, FIONREAD, &size) == 0)) ? size : 0;
+}
+
+int WiFiClient::read(uint8_t* pBuffer, const size_t size)
+{
+    if (!pConnection)
+    {
+        return -1;
+    }
+
+    const ssize_t received = recv(pConnection->fd, pBuffer, size, MSG_DONTWAIT);
+    return (received > 0) ? static_cast<int>(received) : -1;
+}
+
+int WiFiClient::read()
+{
+    uint8_t ch;
+    return (read(&ch, 1) == 1) ? ch : -1;
+}
+
+bool WiFiClient::connected()
+{
+    if (!pConnection)
+    {
+        return false;
+    }
+
+    pollfd connection = { pConnection->fd, POLLIN | POLLRDHUP, 0 };
+    if (poll(&connection, 1, 0) < 0)
+    {
+        return false;
+    }
+    if ((connection.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL)) != 0)
+    {
+        return false;
+    }
+    if ((connection.revents & POLLIN) != 0)
+    {
+        uint8_t ch;
+        return recv(pConnection->fd, &ch, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
+    }
+    return true;
+}
+
+// Closes for every copy, as on ESP8266.
+void WiFiClient::stop()
+{
+    if (pConnection)
+    {
+        shutdown(pConnection->fd, SHUT_RDWR);
+        pConnection.reset();
+    }
+}
+
+////////////////////////////////////////////////
+
+WiFiServer::WiFiServer(const uint16_t port)
+    : port(port), listenFd(-1)
+{
+}
+
+WiFiServer::~WiFiServer()
+{
+    close();
+}
+
+void WiFiServer::begin()
+{
+    close();
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    const int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = (WiFi.localIP()[0] != 127) ? hostToSocketAddress(WiFi.localIP()) : htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(hostGetPort(port));
+    if ((bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) ||
+        (listen(listenFd, 16) != 0))
+    {
+        fprintf(stderr, "WiFiServer: can't listen on %s:%u: %s\n",
+            IPAddress(address.sin_addr.s_addr).toString().c_str(), hostGetPort(port), strerror(errno));
+        close();
+    }
+}
+
+void WiFiServer::close()
+{
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+        listenFd = -1;
+    }
+}
+
+WiFiClient WiFiServer::available()
+{
+    const int fd = (listenFd >= 0) ? accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC) : -1;
+    if (fd < 0)
+    {
+        return WiFiClient();
+    }
+
+    const int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    return WiFiClient(fd);
+}
+
+////////////////////////////////////////////////
+
+WiFiUDP::WiFiUDP()
+    : fd(-1), port(0), position(0), destinationPort(0)
+{
+}
+
+WiFiUDP::~WiFiUDP()
+{
+    stop();
+}
+
+uint8_t WiFiUDP::begin(const uint16_t port)
+{
+    stop();
+    this->port = port;
+
+    if (pHostSimulatedNetwork != nullptr)
+    {
+        simulatedSockets.push_back(this);
+        return 1;
+    }
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof on);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = isMapped(WiFi.localIP()) ? hostToSocketAddress(WiFi.localIP()) : htonl(INADDR_ANY);
+    address.sin_port = htons(hostGetPort(port));
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0)
+    {
+        fprintf(stderr, "WiFiUDP: can't bind %s:%u: %s\n",
+            hostFromSocketAddress(address.sin_addr.s_addr).toString().c_str(), hostGetPort(port), strerror(errno));
+        close(fd);
+        fd = -1;
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    simulatedSockets.erase(std::remove(simulatedSockets.begin(), simulatedSockets.end(), this), simulatedSockets.end());
+    queue.clear();
+    current.data.clear();
+    position = 0;
+}
+
+int WiFiUDP::beginPacket(const IPAddress& address, const uint16_t port)
+{
+    destination = address;
+    destinationPort = port;
+    outgoing.clear();
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* pBuffer, const size_t size)
+{
+    outgoing.insert(outgoing.end(), pBuffer, pBuffer + size);
+    return size;
+}
+
+void WiFiUDP::sendTo(const uint32_t address, const uint16_t toPort)
+{
+    sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = address;
+    to.sin_port = htons(toPort);
+    sendto(fd, outgoing.data(), outgoing.size(), 0, reinterpret_cast<const sockaddr*>(&to), sizeof to);
+}
+
+int WiFiUDP::endPacket()
+{
+    if (pHostSimulatedNetwork != nullptr)
+    {
+        pHostSimulatedNetwork->send(WiFi.localIP(), port, destination, destinationPort, outgoing.data(), outgoing.size());
+        return 1;
+    }
+
+    if (fd < 0)
+    {
+        // Not begun: from an ephemeral port, as lwIP does.
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        const int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof on);
+    }
+
+    if (!isMapped(destination))
+    {
+        sendTo(destination, destinationPort);
+    }
+    else if (destination == WiFi.broadcastIP())
+    {
+        // One by one to the hosts of the mapped subnet, our own left out.
+        const IPAddress local = WiFi.localIP();
+        for (uint8_t host = 1; host <= HOST_BROADCAST_HOSTS; host++)
+        {
+            if (host != local[3])
+            {
+                sendTo(IPAddress(127, 0, local[2], host), hostGetPort(destinationPort));
+            }
+        }
+    }
+    else
+    {
+        sendTo(hostToSocketAddress(destination), hostGetPort(destinationPort));
+    }
+    return 1;
+}
+
+// The rest of the current datagram is dropped, as on ESP8266.
+int WiFiUDP::parsePacket()
+{
+    current.data.clear();
+    position = 0;
+
+    if (pHostSimulatedNetwork != nullptr)
+    {
+        if (queue.empty())
+        {
+            return 0;
+        }
+        current = std::move(queue.front());
+        queue.pop_front();
+        return static_cast<int>(current.data.size());
+    }
+
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    uint8_t buffer[HOST_DATAGRAM_SIZE];
+    sockaddr_in from = {};
+    socklen_t fromSize = sizeof from;
+    const ssize_t size = recvfrom(fd, buffer, sizeof buffer, MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &fromSize);
+    if (size <= 0)
+    {
+        return 0;
+    }
+
+    current.from = hostFromSocketAddress(from.sin_addr.s_addr);
+    current.fromPort = ntohs(from.sin_port);
+    if (isMapped(current.from) && (current.fromPort >= getPortOffset()))
+    {
+        current.fromPort -= getPortOffset();
+    }
+    current.data.assign(buffer, buffer + size);
+    return static_cast<int>(size);
+}
+
+int WiFiUDP::read(uint8_t* pBuffer, const size_t size)
+{
+    const size_t count = std::min(size, current.data.size() - position);
+    memcpy(pBuffer, current.data.data() + position, count);
+    position += count;
+    return static_cast<int>(count);
+}
+
+int WiFiUDP::read()
+{
+    return (position < current.data.size()) ? current.data[position++] : -1;
+}
+
+void WiFiUDP::deliver(const IPAddress& from, const uint16_t fromPort, const uint8_t* pData, const size_t size)
+{
+    Datagram datagram;
+    datagram.from = from;
+    datagram.fromPort = fromPort;
+    datagram.data.assign(pData, pData + size);
+    queue.push_back(std::move(datagram));
+}
+
+bool hostDeliverDatagram(const IPAddress& from, const uint16_t fromPort,
+    const uint16_t toPort, const uint8_t* pData, const size_t size)
+{
+    for (WiFiUDP* pSocket : simulatedSockets)
+    {
+        if (pSocket->localPort() == toPort)
+        {
+            pSocket->deliver(from, fromPort, pData, size);
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////
+
+err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* callback_arg)
+{
+    if ((hostname == nullptr) || (addr == nullptr))
+    {
+        return ERR_ARG;
+    }
+
+    IPAddress address;
+    if (address.fromString(hostname))
+    {
+        addr->addr = address;
+        return ERR_OK;
+    }
+
+    bool resolved = false;
+    if (pHostSimulatedNetwork != nullptr)
+    {
+        resolved = pHostSimulatedNetwork->resolve(hostname, address);
+    }
+    else
+    {
+        // Blocking here, the answer still arrives later as from lwIP.
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* pResult = nullptr;
+        if ((getaddrinfo(hostname, nullptr, &hints, &pResult) == 0) && (pResult != nullptr))
+        {
+            address = IPAddress(static_cast<uint32_t>(reinterpret_cast<const sockaddr_in*>(pResult->ai_addr)->sin_addr.s_addr));
+            resolved = true;
+        }
+        if (pResult != nullptr)
+        {
+            freeaddrinfo(pResult);
+        }
+    }
+
+    const std::string name = hostname;
+    const uint32_t answer = address;
+    hostDefer([name, answer, resolved, found, callback_arg]()
+    {
+        const ip_addr_t result = { answer };
+        found(name.c_str(), resolved ? &result : nullptr, callback_arg);
+    });
+    return ERR_INPROGRESS;
+}
@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_NETWORK_H
+#define HOST_NETWORK_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <functional>
+
+// Networking of the native builds. By default it is real: UDP and TCP sockets on loopback.
+// A sketch with a static address a.b.c.d (WiFi.config(), softAPConfig()) runs on 127.0.c.d,
+// so the nodes of an intersection run side by side on one machine and find each other by
+// their configured addresses; a broadcast goes to 127.0.c.1 up to HOST_BROADCAST_HOSTS.
+// Every port is moved by the SIGNAL_HOST_PORT_OFFSET environment variable, which keeps
+// parallel test runs apart and the web servers off the privileged ports.
+// A simulator installs a HostSimulatedNetwork instead: no sockets, datagrams and lookups
+// go to it and it delivers the answers at the (virtual) time it chooses.
+
+////////////////////////////////////////////////
+
+#define HOST_BROADCAST_HOSTS 32
+#define HOST_DATAGRAM_SIZE 1472
+
+class HostSimulatedNetwork
+{
+public:
+    virtual ~HostSimulatedNetwork() = default;
+
+    // msec from WiFi.begin() to WL_CONNECTED; fast: joined with the cached BSSID and address.
+    virtual uint32_t getAssociationMillisecond(const bool fast) = 0;
+
+    // Address and lease handed out by DHCP.
+    virtual IPAddress getDhcpAddress() = 0;
+    virtual uint32_t getDhcpLeaseSecond() = 0;
+
+    // false: the lookup fails.
+    virtual bool resolve(const char* pName, IPAddress& address) = 0;
+
+    // A datagram from the sketch, answers come back by hostDeliverDatagram().
+    virtual void send(const IPAddress& from, const uint16_t fromPort,
+        const IPAddress& to, const uint16_t toPort, const uint8_t* pData, const size_t size) = 0;
+};
+
+extern HostSimulatedNetwork* pHostSimulatedNetwork;   // nullptr: real sockets
+
+// Run from the next hostService(), as lwIP calls back from the system task.
+void hostDefer(const std::function<void()>& callback);
+void hostRunDeferred();
+
+// Queue a datagram for the WiFiUDP bound to toPort, false if none is.
+bool hostDeliverDatagram(const IPAddress& from, const uint16_t fromPort,
+    const uint16_t toPort, const uint8_t* pData, const size_t size);
+
+// Port as bound on the host.
+uint16_t hostGetPort(const uint16_t port);
+
+// Loopback address of a configured address (network order), or the address itself
+// when the sketch got its address by DHCP and talks to the real network.
+uint32_t hostToSocketAddress(const IPAddress& address);
+IPAddress hostFromSocketAddress(const uint32_t address);
+
+#endif
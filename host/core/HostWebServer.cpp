@@ -0,0 +1,337 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <ESP8266WebServer.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "HostNetwork.h"
+
+////////////////////////////////////////////////
+
+#define HTTP_MAX_DATA_WAIT 5000      // msec, for the request head as on ESP8266
+#define HTTP_MAX_CLOSE_WAIT 2000     // msec, for the client to close after the answer, as on ESP8266
+#define HTTP_MAX_REQUEST_SIZE 4096
+
+static const char* getReason(const int code)
+{
+    switch (code)
+    {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "";
+    }
+}
+
+static int fromHex(const char ch)
+{
+    return ((ch >= '0') && (ch <= '9')) ? (ch - '0') :
+        ((ch >= 'a') && (ch <= 'f')) ? (ch - 'a' + 10) :
+        ((ch >= 'A') && (ch <= 'F')) ? (ch - 'A' + 10) : -1;
+}
+
+static std::string urlDecode(const std::string& text)
+{
+    std::string decoded;
+    for (size_t index = 0; index < text.size(); index++)
+    {
+        const char ch = text[index];
+        if ((ch == '%') && ((index + 2) < text.size()) &&
+            (fromHex(text[index + 1]) >= 0) && (fromHex(text[index + 2]) >= 0))
+        {
+            decoded += static_cast<char>(fromHex(text[index + 1]) * 16 + fromHex(text[index + 2]));
+            index += 2;
+        }
+        else
+        {
+            decoded += (ch == '+') ? ' ' : ch;
+        }
+    }
+    return decoded;
+}
+
+////////////////////////////////////////////////
+
+ESP8266WebServer::ESP8266WebServer(const uint16_t port)
+    : port(port), listenFd(-1), waitingClose(false), waitCloseSince(0), contentLength(CONTENT_LENGTH_NOT_SET), chunked(false)
+{
+}
+
+ESP8266WebServer::~ESP8266WebServer()
+{
+    close();
+}
+
+void ESP8266WebServer::on(const char* pUri, const HTTPMethod method, const THandlerFunction& handler)
+{
+    routes.push_back(Route { pUri, method, handler });
+}
+
+void ESP8266WebServer::begin()
+{
+    close();
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    const int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+
+    // On the mapped node address, so the nodes of an intersection share the port.
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = (WiFi.localIP()[0] != 127) ? hostToSocketAddress(WiFi.localIP()) : htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(hostGetPort(port));
+    if ((bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) ||
+        (listen(listenFd, 16) != 0))
+    {
+        fprintf(stderr, "ESP8266WebServer: can't listen on %s:%u: %s\n",
+            IPAddress(address.sin_addr.s_addr).toString().c_str(), hostGetPort(port), strerror(errno));
+        ::close(listenFd);
+        listenFd = -1;
+        return;
+    }
+
+    fprintf(stderr, "ESP8266WebServer: listening on %s:%u\n",
+        IPAddress(address.sin_addr.s_addr).toString().c_str(), hostGetPort(port));
+}
+
+void ESP8266WebServer::close()
+{
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+        listenFd = -1;
+    }
+}
+
+bool ESP8266WebServer::readRequest(const int fd, std::string& request)
+{
+    const timeval timeout = { HTTP_MAX_DATA_WAIT / 1000, (HTTP_MAX_DATA_WAIT % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+
+    char buffer[512];
+    while ((request.find("\r\n\r\n") == std::string::npos) && (request.size() < HTTP_MAX_REQUEST_SIZE))
+    {
+        const ssize_t size = recv(fd, buffer, sizeof buffer, 0);
+        if (size <= 0)
+        {
+            return false;
+        }
+        request.append(buffer, static_cast<size_t>(size));
+    }
+    return request.find("\r\n\r\n") != std::string::npos;
+}
+
+void ESP8266WebServer::parseQuery(const std::string& query)
+{
+    size_t start = 0;
+    while (start < query.size())
+    {
+        size_t end = query.find('&', start);
+        end = (end == std::string::npos) ? query.size() : end;
+        const std::string item = query.substr(start, end - start);
+        const size_t equal = item.find('=');
+        if (!item.empty())
+        {
+            currentArgs.emplace_back(urlDecode(item.substr(0, equal)),
+                (equal == std::string::npos) ? std::string() : urlDecode(item.substr(equal + 1)));
+        }
+        start = end + 1;
+    }
+}
+
+void ESP8266WebServer::handleClient()
+{
+    if (listenFd < 0)
+    {
+        return;
+    }
+
+    if (waitingClose)
+    {
+        if (currentClient.connected() && ((millis() - waitCloseSince) <= HTTP_MAX_CLOSE_WAIT))
+        {
+            return;
+        }
+        waitingClose = false;
+        currentClient = WiFiClient();
+    }
+
+    const int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    const int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+
+    currentClient = WiFiClient(fd);
+    bool answered = false;
+    std::string request;
+    if (readRequest(fd, request))
+    {
+        // "GET /path?query HTTP/1.1"
+        const size_t methodEnd = request.find(' ');
+        const size_t uriEnd = (methodEnd != std::string::npos) ? request.find(' ', methodEnd + 1) : std::string::npos;
+        if (uriEnd != std::string::npos)
+        {
+            const std::string method = request.substr(0, methodEnd);
+            const std::string target = request.substr(methodEnd + 1, uriEnd - methodEnd - 1);
+            const size_t question = target.find('?');
+            currentUri = urlDecode(target.substr(0, question));
+            if (question != std::string::npos)
+            {
+                parseQuery(target.substr(question + 1));
+            }
+
+            answered = true;
+            const HTTPMethod requestMethod = (method == "POST") ? HTTP_POST : HTTP_GET;
+            const Route* pRoute = nullptr;
+            for (const Route& route : routes)
+            {
+                if ((route.path == currentUri) && ((route.method == HTTP_ANY) || (route.method == requestMethod)))
+                {
+                    pRoute = &route;
+                    break;
+                }
+            }
+
+            if (pRoute != nullptr)
+            {
+                pRoute->handler();
+            }
+            else if (notFoundHandler)
+            {
+                notFoundHandler();
+            }
+            else
+            {
+                send(404, "text/plain", String("Not found: ") + currentUri.c_str());
+            }
+        }
+    }
+
+    // The answer is out, the client closes. Dropped at once if it already did.
+    reset();
+    waitingClose = answered && currentClient.connected();
+    waitCloseSince = millis();
+    if (!waitingClose)
+    {
+        currentClient = WiFiClient();
+    }
+}
+
+void ESP8266WebServer::reset()
+{
+    currentUri.clear();
+    currentArgs.clear();
+    responseHeaders.clear();
+    contentLength = CONTENT_LENGTH_NOT_SET;
+    chunked = false;
+}
+
+String ESP8266WebServer::arg(const char* pName) const
+{
+    for (const auto& item : currentArgs)
+    {
+        if (item.first == pName)
+        {
+            return String(item.second);
+        }
+    }
+    return String();
+}
+
+bool ESP8266WebServer::hasArg(const char* pName) const
+{
+    for (const auto& item : currentArgs)
+    {
+        if (item.first == pName)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ESP8266WebServer::sendRaw(const char* pData, const size_t size)
+{
+    return currentClient.write(reinterpret_cast<const uint8_t*>(pData), size) == size;
+}
+
+void ESP8266WebServer::sendHeader(const String& name, const String& value, const bool first)
+{
+    const std::string line = std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+    responseHeaders = first ? (line + responseHeaders) : (responseHeaders + line);
+}
+
+void ESP8266WebServer::send(const int code, const char* pContentType, const String& content)
+{
+    char head[256];
+    int length = snprintf(head, sizeof head, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n", code, getReason(code), pContentType);
+    chunked = (contentLength == CONTENT_LENGTH_UNKNOWN);
+    if (chunked)
+    {
+        length += snprintf(head + length, sizeof head - length, "Transfer-Encoding: chunked\r\n");
+    }
+    else
+    {
+        length += snprintf(head + length, sizeof head - length, "Content-Length: %lu\r\n",
+            static_cast<unsigned long>((contentLength != CONTENT_LENGTH_NOT_SET) ? contentLength : content.length()));
+    }
+    length += snprintf(head + length, sizeof head - length, "Connection: close\r\n");
+
+    const std::string response = std::string(head, static_cast<size_t>(length)) + responseHeaders + "\r\n";
+    responseHeaders.clear();
+    sendRaw(response.data(), response.size());
+
+    if (content.length() != 0)
+    {
+        sendContent(content);
+    }
+}
+
+// Chunked after setContentLength(CONTENT_LENGTH_UNKNOWN), "" ends the response.
+void ESP8266WebServer::sendContent(const String& content)
+{
+    if (!chunked)
+    {
+        sendRaw(content.c_str(), content.length());
+        return;
+    }
+
+    char size[16];
+    const int length = snprintf(size, sizeof size, "%x\r\n", content.length());
+    const std::string chunk = std::string(size, static_cast<size_t>(length)) + content.c_str() + "\r\n";
+    sendRaw(chunk.data(), chunk.size());
+    chunked = (content.length() != 0);
+}
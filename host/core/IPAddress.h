@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_IP_ADDRESS_H
+#define HOST_IP_ADDRESS_H
+
+#include <Arduino.h>
+
+struct ip_addr;
+
+////////////////////////////////////////////////
+
+// IPv4 only. As on ESP8266 the 32bit value is in network order: octet 0 is the low byte.
+class IPAddress : public Printable
+{
+private:
+    uint32_t address;
+
+public:
+    IPAddress() : address(0) {}
+    IPAddress(const uint8_t a, const uint8_t b, const uint8_t c, const uint8_t d)
+        : address(static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+            (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24)) {}
+    IPAddress(const uint32_t address) : address(address) {}
+    IPAddress(const ip_addr* pAddress);
+
+    operator uint32_t() const { return address; }
+
+    uint8_t operator[](const int index) const
+    {
+        return static_cast<uint8_t>(address >> (index * 8));
+    }
+
+    bool operator==(const IPAddress& rhs) const { return address == rhs.address; }
+    bool operator!=(const IPAddress& rhs) const { return address != rhs.address; }
+    bool operator==(const uint32_t rhs) const { return address == rhs; }
+
+    bool isSet() const { return address != 0; }
+
+    bool fromString(const char* pText)
+    {
+        unsigned int octets[4];
+        char tail;
+        if ((sscanf(pText, "%u.%u.%u.%u%c", &octets[0], &octets[1], &octets[2], &octets[3], &tail) != 4) ||
+            (octets[0] > 255) || (octets[1] > 255) || (octets[2] > 255) || (octets[3] > 255))
+        {
+            return false;
+        }
+
+        *this = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+        return true;
+    }
+
+    String toString() const
+    {
+        char text[16];
+        snprintf(text, sizeof text, "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(text);
+    }
+
+    size_t printTo(Print& p) const override
+    {
+        return p.print(toString());
+    }
+};
+
+#endif
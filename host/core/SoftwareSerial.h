@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SOFTWARE_SERIAL_H
+#define HOST_SOFTWARE_SERIAL_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////
+
+// Nothing attached: writes are dropped, nothing is ever received.
+class SoftwareSerial : public Stream
+{
+public:
+    SoftwareSerial(const uint8_t rxPin, const uint8_t txPin)
+    {
+        (void)rxPin;
+        (void)txPin;
+    }
+
+    void begin(const unsigned long baud)
+    {
+        (void)baud;
+    }
+
+    size_t write(const uint8_t ch) override
+    {
+        (void)ch;
+        return 1;
+    }
+    using Print::write;
+
+    int available() override
+    {
+        return 0;
+    }
+
+    int read() override
+    {
+        return -1;
+    }
+};
+
+#endif
@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_TICKER_H
+#define HOST_TICKER_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////
+
+// On the timer list of SignalHal.h, so the callbacks run between loop() passes as on ESP8266.
+class Ticker
+{
+private:
+    SignalHostTimer timer;
+
+public:
+    void attach(const float second, void (*pCallback)())
+    {
+        timer.attach(static_cast<uint32_t>(second * 1000000), true, pCallback);
+    }
+
+    void attach_ms(const uint32_t millisecond, void (*pCallback)())
+    {
+        timer.attach(millisecond * 1000, true, pCallback);
+    }
+
+    template <typename T>
+    void attach_ms(const uint32_t millisecond, void (*pCallback)(T*), T* pArgument)
+    {
+        timer.attach(millisecond * 1000, true, [pCallback, pArgument]() { pCallback(pArgument); });
+    }
+
+    void once_ms(const uint32_t millisecond, void (*pCallback)())
+    {
+        timer.attach(millisecond * 1000, false, pCallback);
+    }
+
+    void detach()
+    {
+        timer.detach();
+    }
+
+    bool active() const
+    {
+        return timer.isActive();
+    }
+};
+
+#endif
@@ -0,0 +1,90 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host core - The Arduino/ESP8266 APIs the sketches use, for native builds.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_WIFI_UDP_H
+#define HOST_WIFI_UDP_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <deque>
+#include <vector>
+
+#include "HostNetwork.h"
+
+////////////////////////////////////////////////
+
+class WiFiUDP
+{
+private:
+    struct Datagram
+    {
+        IPAddress from;
+        uint16_t fromPort;
+        std::vector<uint8_t> data;
+    };
+
+    int fd;                       // real sockets
+    std::deque<Datagram> queue;   // simulated network
+    uint16_t port;
+
+    Datagram current;             // parsed by parsePacket()
+    size_t position;
+
+    IPAddress destination;
+    uint16_t destinationPort;
+    std::vector<uint8_t> outgoing;
+
+    void sendTo(const uint32_t address, const uint16_t toPort);
+
+public:
+    WiFiUDP();
+    ~WiFiUDP();
+
+    WiFiUDP(const WiFiUDP&) = delete;
+    WiFiUDP& operator=(const WiFiUDP&) = delete;
+
+    uint8_t begin(const uint16_t port);
+    void stop();
+    uint16_t localPort() const { return port; }
+
+    int beginPacket(const IPAddress& address, const uint16_t port);
+    size_t write(const uint8_t* pBuffer, const size_t size);
+    size_t write(const uint8_t value) { return write(&value, 1); }
+    int endPacket();
+
+    // Size of the next datagram, 0 if there is none.
+    int parsePacket();
+    int available() const { return static_cast<int>(current.data.size() - position); }
+    int read(uint8_t* pBuffer, const size_t size);
+    int read(char* pBuffer, const size_t size) { return read(reinterpret_cast<uint8_t*>(pBuffer), size); }
+    int read();
+    void flush() { position = current.data.size(); }
+
+    IPAddress remoteIP() const { return current.from; }
+    uint16_t remotePort() const { return current.fromPort; }
+
+    // From hostDeliverDatagram().
+    void deliver(const IPAddress& from, const uint16_t fromPort, const uint8_t* pData, const size_t size);
+};
+
+#endif
@@ -0,0 +1,164 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host legacy - Replaced code kept as the reference of equivalence tests and benchmarks.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BASELINE_PEDESTRIAN_SIGNAL_H
+#define BASELINE_PEDESTRIAN_SIGNAL_H
+
+#include <Arduino.h>
+
+// PedestrianSignalController as first written, before the lamps were driven by
+// SignalSequence: tick() and the status switch verbatim, the request handlers without the
+// HTTP answer and the log. A request waits for the next tick, a later one replaces it.
+// Needs the PedestrianSignal Config.h pins.
+class BaselinePedestrianSignal
+{
+private:
+    volatile bool tickStatus;
+    volatile uint8_t blinkingRemains;
+
+    enum States
+    {
+        Stopped,
+        Walking,
+        BlinkOn,
+        BlinkOff
+    } volatile currentState;
+
+    enum RequestStates
+    {
+        None,
+        Stop,
+        Walk
+    } volatile requestState;
+
+public:
+    static const uint16_t TickInterval = TRANSITION_TIME;
+
+    BaselinePedestrianSignal()
+        : tickStatus(false)
+        , blinkingRemains(0), currentState(States::Stopped), requestState(RequestStates::None)
+    {
+    }
+
+    void begin()
+    {
+        pinMode(WALK, OUTPUT);
+        pinMode(STOP, OUTPUT);
+        pinMode(STATUS, OUTPUT);
+
+        digitalWrite(WALK, LOW);
+        digitalWrite(STOP, HIGH);
+        digitalWrite(STATUS, LOW);
+    }
+
+    String getStatusText() const
+    {
+        String result;
+        switch (currentState)
+        {
+            case States::Stopped:
+                result = "Stopped";
+                break;
+            case States::Walking:
+                result = "Walking";
+                break;
+            case States::BlinkOn:
+            case States::BlinkOff:
+                result = "Blinking ";
+                result += blinkingRemains;
+                break;
+        }
+
+        return result;
+    }
+
+    void requestGo()
+    {
+        requestState = RequestStates::Walk;
+    }
+
+    void requestStop()
+    {
+        requestState = RequestStates::Stop;
+    }
+
+    void tick()
+    {
+        switch (currentState)
+        {
+            case States::Stopped:
+                switch (requestState)
+                {
+                    case RequestStates::Stop:
+                        requestState = None;
+                        break;
+                    case RequestStates::Walk:
+                        digitalWrite(STOP, LOW);
+                        digitalWrite(WALK, HIGH);
+                        currentState = States::Walking;
+                        requestState = None;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case States::Walking:
+                switch (requestState)
+                {
+                    case RequestStates::Stop:
+                        digitalWrite(WALK, LOW);
+                        digitalWrite(STOP, HIGH);
+                        blinkingRemains = TRANSITION_COUNT;
+                        currentState = States::BlinkOff;
+                        requestState = None;
+                       break;
+                    case RequestStates::Walk:
+                        requestState = None;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case States::BlinkOff:
+                digitalWrite(STOP, LOW);
+                currentState = States::BlinkOn;
+                break;
+            case States::BlinkOn:
+                digitalWrite(STOP, HIGH);
+                blinkingRemains--;
+                if (blinkingRemains == 0)
+                {
+                    currentState = States::Stopped;
+                }
+                else
+                {
+                    currentState = States::BlinkOff;
+                }
+                break;
+        }
+
+        digitalWrite(STATUS, tickStatus ? HIGH : LOW);
+        tickStatus = !tickStatus;
+    }
+};
+
+#endif
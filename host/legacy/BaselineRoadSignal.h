@@ -0,0 +1,156 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host legacy - Replaced code kept as the reference of equivalence tests and benchmarks.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BASELINE_ROAD_SIGNAL_H
+#define BASELINE_ROAD_SIGNAL_H
+
+#include <Arduino.h>
+
+// RoadSignalController as first written, before the lamps were driven by SignalSequence:
+// tick() and the status switch verbatim, the request handlers without the HTTP answer and
+// the log. A request waits for the next tick, a later one replaces it. Needs the
+// RoadSignal Config.h pins.
+class BaselineRoadSignal
+{
+private:
+    volatile bool tickStatus;
+    volatile uint8_t stopRemains;
+
+    enum States
+    {
+        Stopped,
+        Going,
+        WillStop
+    } volatile currentState;
+
+    enum RequestStates
+    {
+        None,
+        Stop,
+        Go
+    } volatile requestState;
+
+public:
+    static const uint16_t TickInterval = 1000;
+
+    BaselineRoadSignal()
+        : tickStatus(false)
+        , stopRemains(0), currentState(States::Stopped), requestState(RequestStates::None)
+    {
+    }
+
+    void begin()
+    {
+        pinMode(GO, OUTPUT);
+        pinMode(WILLSTOP, OUTPUT);
+        pinMode(STOP, OUTPUT);
+        pinMode(STATUS, OUTPUT);
+
+        digitalWrite(GO, LOW);
+        digitalWrite(WILLSTOP, LOW);
+        digitalWrite(STOP, HIGH);
+        digitalWrite(STATUS, LOW);
+    }
+
+    String getStatusText() const
+    {
+        String result;
+        switch (currentState)
+        {
+            case States::Stopped:
+                result = "Stopped";
+                break;
+            case States::Going:
+                result = "Going";
+                break;
+            case States::WillStop:
+                result = "WillStop";
+                break;
+        }
+
+        return result;
+    }
+
+    void requestGo()
+    {
+        requestState = RequestStates::Go;
+    }
+
+    void requestStop()
+    {
+        requestState = RequestStates::Stop;
+    }
+
+    void tick()
+    {
+        switch (currentState)
+        {
+            case States::Stopped:
+                switch (requestState)
+                {
+                    case RequestStates::Stop:
+                        requestState = None;
+                        break;
+                    case RequestStates::Go:
+                        digitalWrite(STOP, LOW);
+                        digitalWrite(GO, HIGH);
+                        currentState = States::Going;
+                        requestState = None;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case States::Going:
+                switch (requestState)
+                {
+                    case RequestStates::Stop:
+                        digitalWrite(GO, LOW);
+                        digitalWrite(WILLSTOP, HIGH);
+                        stopRemains = TRANSITION_WILLSTOP;
+                        currentState = States::WillStop;
+                        requestState = None;
+                       break;
+                    case RequestStates::Go:
+                        requestState = None;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case States::WillStop:
+                stopRemains--;
+                if (stopRemains == 0)
+                {
+                    digitalWrite(WILLSTOP, LOW);
+                    digitalWrite(STOP, HIGH);
+                    currentState = States::Stopped;
+                }
+                break;
+        }
+
+        digitalWrite(STATUS, tickStatus ? HIGH : LOW);
+        tickStatus = !tickStatus;
+    }
+};
+
+#endif
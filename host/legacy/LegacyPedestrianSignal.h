@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host legacy - Replaced code kept as the reference of equivalence tests and benchmarks.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LEGACY_PEDESTRIAN_SIGNAL_H
+#define LEGACY_PEDESTRIAN_SIGNAL_H
+
+#include <SignalProtocol.h>
+#include <SignalSequence.h>
+
+// The state machine of the hand written PedestrianSignalController, as it was before
+// SignalNodeController generated it from PedestrianSignalHead: same phase table, the
+// status, state, remains and commands by switch. It already ran the lamps from a
+// SignalSequence, the switch logic from before that is BaselinePedestrianSignal.h.
+// Needs the PedestrianSignal Config.h pins.
+class LegacyPedestrianSignal
+{
+private:
+    // Phase indexes of the phases table.
+    enum States
+    {
+        Stopped,
+        Walking,
+        BlinkOn,
+        BlinkOff
+    };
+
+    static const SignalPhase phases[];
+
+    SignalSequence sequence;
+
+public:
+    static const uint16_t TickInterval = TRANSITION_TIME;
+
+    void begin()
+    {
+        sequence.begin(phases, SIGNAL_LAMP(WALK) | SIGNAL_LAMP(STOP), States::Stopped);
+    }
+
+    String getStatusText() const
+    {
+        String result;
+        switch (sequence.getPhase())
+        {
+            case States::Stopped:
+                result = "Stopped";
+                break;
+            case States::Walking:
+                result = "Walking";
+                break;
+            case States::BlinkOn:
+            case States::BlinkOff:
+                result = "Blinking ";
+                result += TRANSITION_COUNT - sequence.getRepeated();
+                break;
+        }
+
+        return result;
+    }
+
+    SignalStates getSignalState() const
+    {
+        switch (sequence.getPhase())
+        {
+            case States::Walking:
+                return SignalStateGoing;
+            case States::BlinkOn:
+            case States::BlinkOff:
+                return SignalStateTransition;
+            default:
+                return SignalStateStopped;
+        }
+    }
+
+    // Ticks until the state ends by itself.
+    uint16_t getRemainsTicks() const
+    {
+        // Each blink is one on and one off tick.
+        const uint16_t blinks = TRANSITION_COUNT - sequence.getRepeated();
+        switch (sequence.getPhase())
+        {
+            case States::BlinkOn:
+                return blinks * 2;
+            case States::BlinkOff:
+                return blinks * 2 - 1;
+            default:
+                return 0;
+        }
+    }
+
+    void apply(const uint8_t command)
+    {
+        switch (sequence.getPhase())
+        {
+            case States::Stopped:
+                if (command == SignalCommandGo)
+                {
+                    sequence.jump(States::Walking);
+                }
+                break;
+            case States::Walking:
+                if (command == SignalCommandStop)
+                {
+                    sequence.jump(States::BlinkOn);
+                }
+                break;
+        }
+    }
+
+    void tick()
+    {
+        sequence.tick(TRANSITION_TIME);
+    }
+
+    uint8_t getPhase() const
+    {
+        return sequence.getPhase();
+    }
+
+    bool isHolding() const
+    {
+        return sequence.isHolding();
+    }
+};
+
+const SignalPhase LegacyPedestrianSignal::phases[] PROGMEM =
+{
+    // lamps, duration, next, repeatTo, repeat, hook
+    { SIGNAL_LAMP(STOP), 0, LegacyPedestrianSignal::Stopped, 0, 0, 0 },
+    { SIGNAL_LAMP(WALK), 0, LegacyPedestrianSignal::Walking, 0, 0, 0 },
+    { SIGNAL_LAMP(STOP), TRANSITION_TIME, LegacyPedestrianSignal::BlinkOff, 0, 0, 0 },
+    { 0, TRANSITION_TIME, LegacyPedestrianSignal::Stopped,
+        LegacyPedestrianSignal::BlinkOn, TRANSITION_COUNT - 1, 0 },
+};
+
+#endif
@@ -0,0 +1,138 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host legacy - Replaced code kept as the reference of equivalence tests and benchmarks.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LEGACY_ROAD_SIGNAL_H
+#define LEGACY_ROAD_SIGNAL_H
+
+#include <SignalProtocol.h>
+#include <SignalSequence.h>
+
+// The state machine of the hand written RoadSignalController, as it was before
+// SignalNodeController generated it from RoadSignalHead: same phase table, the status,
+// state, remains and commands by switch. It already ran the lamps from a SignalSequence,
+// the switch logic from before that is BaselineRoadSignal.h. Needs the RoadSignal
+// Config.h pins.
+class LegacyRoadSignal
+{
+private:
+    // Phase indexes of the phases table.
+    enum States
+    {
+        Stopped,
+        Going,
+        WillStop
+    };
+
+    static const SignalPhase phases[];
+
+    SignalSequence sequence;
+
+public:
+    static const uint16_t TickInterval = 1000;
+
+    void begin()
+    {
+        sequence.begin(phases, SIGNAL_LAMP(GO) | SIGNAL_LAMP(WILLSTOP) | SIGNAL_LAMP(STOP), States::Stopped);
+    }
+
+    String getStatusText() const
+    {
+        String result;
+        switch (sequence.getPhase())
+        {
+            case States::Stopped:
+                result = "Stopped";
+                break;
+            case States::Going:
+                result = "Going";
+                break;
+            case States::WillStop:
+                result = "WillStop";
+                break;
+        }
+
+        return result;
+    }
+
+    SignalStates getSignalState() const
+    {
+        switch (sequence.getPhase())
+        {
+            case States::Going:
+                return SignalStateGoing;
+            case States::WillStop:
+                return SignalStateTransition;
+            default:
+                return SignalStateStopped;
+        }
+    }
+
+    // Ticks until the state ends by itself.
+    uint16_t getRemainsTicks() const
+    {
+        return (sequence.getRemains() + 999) / 1000;
+    }
+
+    void apply(const uint8_t command)
+    {
+        switch (sequence.getPhase())
+        {
+            case States::Stopped:
+                if (command == SignalCommandGo)
+                {
+                    sequence.jump(States::Going);
+                }
+                break;
+            case States::Going:
+                if (command == SignalCommandStop)
+                {
+                    sequence.jump(States::WillStop);
+                }
+                break;
+        }
+    }
+
+    void tick()
+    {
+        sequence.tick(1000);
+    }
+
+    uint8_t getPhase() const
+    {
+        return sequence.getPhase();
+    }
+
+    bool isHolding() const
+    {
+        return sequence.isHolding();
+    }
+};
+
+const SignalPhase LegacyRoadSignal::phases[] PROGMEM =
+{
+    // lamps, duration, next, repeatTo, repeat, hook
+    { SIGNAL_LAMP(STOP), 0, LegacyRoadSignal::Stopped, 0, 0, 0 },
+    { SIGNAL_LAMP(GO), 0, LegacyRoadSignal::Going, 0, 0, 0 },
+    { SIGNAL_LAMP(WILLSTOP), TRANSITION_WILLSTOP * 1000, LegacyRoadSignal::Stopped, 0, 0, 0 },
+};
+
+#endif
@@ -0,0 +1,644 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host simulator - PedestrianController on a virtual clock.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <DS3231.h>
+#include <HostNetwork.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "PedestrianControllerConfig.h"
+#include "NtpPacket.h"
+#include "Schedule.h"
+
+////////////////////////////////////////////////
+
+// Runs the PedestrianController sketch (Main.cpp, NtpClient.cpp, RtcController.cpp
+// unchanged) on a virtual clock: delay() moves the clock to the next due timer or
+// datagram instead of sleeping, so weeks pass in well under a second. The simulated
+// network answers DHCP, DNS and NTP with the true time; the DS3231 and the ESP8266
+// crystal drift against it. Every GPIO edge is printed with the true local time, and
+// the run is checked: walks only inside the schedule windows, a walk and an NTP sync
+// on every day, and the RTC within bounds at the end.
+//
+// ESP.deepSleep() saves the world to a file and starts the program again from it, so
+// the sketch comes back through setup() with fresh RAM and only the DS3231 and the
+// RTC user memory kept, as on the chip. The wake is the timer or the DS3231 alarm,
+// whichever comes first. No sleep may cover a window, an alarm wake must land at a
+// window start, and the modeled energy saved per night is reported.
+//
+//   PedestrianSimulator [--start YYYY-MM-DD] [--days N] [--rtc-drift PPM]
+//       [--crystal-drift PPM] [--quiet]
+
+void setup();
+void loop();
+
+#define SIMULATOR_START "2026-12-20"   // local date, crosses a month and a year end
+#define SIMULATOR_DAYS 28
+#define SIMULATOR_RTC_DRIFT 20          // ppm, the DS3231 is specified for +-2ppm, aged worse
+#define SIMULATOR_CRYSTAL_DRIFT -30     // ppm of the ESP8266 crystal, millis() runs slow
+#define SIMULATOR_RTC_START_ERROR 7     // sec the RTC is off at boot, NTP fixes it
+#define SIMULATOR_ONE_WAY 12000         // usec to the NTP servers, plus jitter
+#define SIMULATOR_JITTER 4000           // usec at most
+#define SIMULATOR_LOOP_PASS 100         // usec a loop() pass takes when it does not wait
+#define SIMULATOR_WALK_TOLERANCE 60     // sec a walk may be off the window edges by clock error
+#define SIMULATOR_RTC_TOLERANCE 100     // msec the RTC may be off after a sync, it drifts a day more at most
+#define SIMULATOR_SLEPT_SHARE 0.9       // of the hours off the windows, slept with DEEP_SLEEP_ENABLED
+
+////////////////////////////////////////////////
+
+static uint64_t clockMicros = 0;        // the node's signalHostClock
+static double crystalDriftPpm = SIMULATOR_CRYSTAL_DRIFT;
+static uint32_t startUnixTime;          // true UTC at clock 0
+
+static uint64_t getClockMicros()
+{
+    return clockMicros;
+}
+
+// True time of the node clock, usec since the epoch.
+static uint64_t getTrueMicros(const uint64_t clock)
+{
+    return static_cast<uint64_t>(startUnixTime) * 1000000 +
+        static_cast<uint64_t>(static_cast<double>(clock) / (1.0 + crystalDriftPpm / 1000000.0));
+}
+
+static uint32_t getTrueLocalTime()
+{
+    return static_cast<uint32_t>(getTrueMicros(clockMicros) / 1000000) + LOCAL_TIMEZONE_FROM_UTC * 3600;
+}
+
+////////////////////////////////////////////////
+
+#define SIMULATOR_MAX_DAYS 366
+
+struct DayReport
+{
+    uint32_t walks;
+    uint32_t ntpRequests;
+};
+
+static bool trace = true;
+static uint32_t edges = 0;
+static uint32_t walks = 0;
+static uint32_t walksOutside = 0;
+static uint32_t firstLocalDay;
+static DayReport days[SIMULATOR_MAX_DAYS];
+
+static const ScheduleWindow scheduleWindows[] = { SCHEDULE_WINDOWS };
+static const ScheduleHoliday scheduleHolidays[] = { SCHEDULE_HOLIDAYS };
+static WeeklySchedule<SCHEDULE_SLOT_MINUTES> expected;
+
+static uint32_t sleeps = 0;
+static uint32_t alarmWakes = 0;
+static uint32_t sleepsOverWindow = 0;
+static uint32_t wakesMisplaced = 0;
+static uint64_t sleptMicros = 0;          // true time
+static uint64_t wakeTrueMicros = 0;       // of the last alarm wake, 0 once it walked
+static uint64_t wakeToWalkMicros = 0;     // the longest
+
+static DayReport& getDay(const uint32_t localTime)
+{
+    const uint32_t index = localTime / 86400 - firstLocalDay;
+    return days[(index < SIMULATOR_MAX_DAYS) ? index : (SIMULATOR_MAX_DAYS - 1)];
+}
+
+////////////////////////////////////////////////
+
+struct Datagram
+{
+    uint64_t due;   // clock
+    IPAddress from;
+    uint16_t fromPort;
+    uint16_t toPort;
+    std::vector<uint8_t> data;
+};
+
+// DHCP, DNS and NTP servers, replying after the one way delay both ways.
+class SimulatedNetwork : public HostSimulatedNetwork
+{
+private:
+    std::deque<Datagram> pending;   // in due order
+    uint32_t random;
+
+    uint32_t getOneWay()
+    {
+        random = random * 1103515245 + 12345;
+        return SIMULATOR_ONE_WAY + (random >> 8) % SIMULATOR_JITTER;
+    }
+
+    static void writeTimestamp(uint8_t* p, const uint64_t trueMicros)
+    {
+        writeNtpWord(p, static_cast<uint32_t>(trueMicros / 1000000 + NTP_UNIX_EPOCH));
+        writeNtpWord(p + 4, static_cast<uint32_t>(((trueMicros % 1000000) << 32) / 1000000));
+    }
+
+public:
+    uint32_t requests = 0;
+
+    SimulatedNetwork() : random(1) {}
+
+    uint32_t getAssociationMillisecond(const bool fast) override
+    {
+        return fast ? 300 : 2500;
+    }
+
+    IPAddress getDhcpAddress() override
+    {
+        return IPAddress(192, 168, 1, 50);
+    }
+
+    uint32_t getDhcpLeaseSecond() override
+    {
+        return 3 * 86400;
+    }
+
+    // Each name gets its own server address.
+    bool resolve(const char* pName, IPAddress& address) override
+    {
+        uint8_t hash = 0;
+        for (const char* p = pName; *p != '\0'; p++)
+        {
+            hash = static_cast<uint8_t>(hash * 31 + *p);
+        }
+        address = IPAddress(10, 0, 0, static_cast<uint8_t>(1 + hash % 250));
+        return true;
+    }
+
+    void send(const IPAddress& from, const uint16_t fromPort,
+        const IPAddress& to, const uint16_t toPort, const uint8_t* pData, const size_t size) override
+    {
+        (void)from;
+        if ((toPort != 123) || (size < NTP_PACKET_SIZE))
+        {
+            return;
+        }
+
+        requests++;
+        getDay(getTrueLocalTime()).ntpRequests++;
+
+        // Stratum 1, the request transmit timestamp comes back as originate.
+        const uint64_t arrival = clockMicros + getOneWay();
+        Datagram reply = { arrival + getOneWay(), to, toPort, fromPort, std::vector<uint8_t>(NTP_PACKET_SIZE, 0) };
+        uint8_t* p = reply.data.data();
+        p[0] = 0x24;   // LI 0, version 4, mode 4 (server)
+        p[1] = 1;
+        p[2] = pData[2];
+        p[3] = 0xEC;
+        writeNtpWord(p + 8, 0x00000010);   // root dispersion 0.24msec
+        memcpy(p + 12, "GPS", 4);
+        memcpy(p + 24, pData + 40, 8);
+        writeTimestamp(p + 16, getTrueMicros(arrival) - 1000000);
+        writeTimestamp(p + 32, getTrueMicros(arrival));
+        writeTimestamp(p + 40, getTrueMicros(arrival) + 100);
+
+        auto position = pending.end();
+        while ((position != pending.begin()) && ((position - 1)->due > reply.due))
+        {
+            position--;
+        }
+        pending.insert(position, std::move(reply));
+    }
+
+    uint64_t getNextDue() const
+    {
+        return pending.empty() ? UINT64_MAX : pending.front().due;
+    }
+
+    void deliverDue()
+    {
+        while (!pending.empty() && (pending.front().due <= clockMicros))
+        {
+            const Datagram& datagram = pending.front();
+            hostDeliverDatagram(datagram.from, datagram.fromPort, datagram.toPort,
+                datagram.data.data(), datagram.data.size());
+            pending.pop_front();
+        }
+    }
+};
+
+static SimulatedNetwork network;
+
+// delay(): the clock jumps from event to event, running what is due at each.
+static void advance(const uint64_t microsecond)
+{
+    const uint64_t end = clockMicros + microsecond;
+    while (true)
+    {
+        const uint64_t timerDue = SignalHostTimer::getNextDue();
+        const uint64_t networkDue = network.getNextDue();
+        const uint64_t due = (timerDue < networkDue) ? timerDue : networkDue;
+        if (due > end)
+        {
+            break;
+        }
+
+        clockMicros = (due > clockMicros) ? due : clockMicros;
+        network.deliverDue();
+        hostService();
+    }
+
+    clockMicros = end;
+    network.deliverDue();
+    hostService();
+}
+
+////////////////////////////////////////////////
+
+static bool isExpectedOn(const uint32_t localTime)
+{
+    const DateTime time(localTime);
+    return !expected.isHoliday(time.month(), time.day()) && expected.isOn(localTime);
+}
+
+static void onPin(const uint8_t pin, const bool on)
+{
+    edges++;
+
+    const uint32_t localTime = getTrueLocalTime();
+    if ((pin == WALK) && on)
+    {
+        walks++;
+        getDay(localTime).walks++;
+        if (wakeTrueMicros != 0)
+        {
+            const uint64_t latency = getTrueMicros(clockMicros) - wakeTrueMicros;
+            wakeToWalkMicros = (latency > wakeToWalkMicros) ? latency : wakeToWalkMicros;
+            wakeTrueMicros = 0;
+        }
+        if (!isExpectedOn(localTime) &&
+            !isExpectedOn(localTime - SIMULATOR_WALK_TOLERANCE) &&
+            !isExpectedOn(localTime + SIMULATOR_WALK_TOLERANCE))
+        {
+            walksOutside++;
+        }
+    }
+
+    if (trace)
+    {
+        const DateTime time(localTime);
+        printf("%04u-%02u-%02u %02u:%02u:%02u.%03lu GPIO%u %s\n",
+            time.year(), time.month(), time.day(), time.hour(), time.minute(), time.second(),
+            static_cast<unsigned long>((getTrueMicros(clockMicros) / 1000) % 1000),
+            pin, on ? "HIGH" : "LOW");
+    }
+}
+
+////////////////////////////////////////////////
+
+// Everything outside the node, kept across a deep sleep.
+struct SimulatorWorld
+{
+    uint64_t clockMicros;     // at the wake
+    uint64_t sleepClockMicros;
+    uint64_t wallStart;       // monotonic, of the first run
+    uint32_t edges;
+    uint32_t walks;
+    uint32_t walksOutside;
+    uint32_t requests;
+    DayReport days[SIMULATOR_MAX_DAYS];
+    uint32_t sleeps;
+    uint32_t alarmWakes;
+    uint32_t sleepsOverWindow;
+    uint32_t wakesMisplaced;
+    uint64_t sleptMicros;
+    uint64_t wakeTrueMicros;
+    uint64_t wakeToWalkMicros;
+    HostRtcState rtc;
+    uint32_t rtcUserMemory[128];
+};
+
+static std::vector<char*> restartArguments;   // argv without --resume
+static std::string worldPath;
+static uint64_t wallStart;
+
+static bool saveWorld(const uint64_t wakeClock)
+{
+    SimulatorWorld world;
+    world.clockMicros = wakeClock;
+    world.sleepClockMicros = clockMicros;
+    world.wallStart = wallStart;
+    world.edges = edges;
+    world.walks = walks;
+    world.walksOutside = walksOutside;
+    world.requests = network.requests;
+    memcpy(world.days, days, sizeof days);
+    world.sleeps = sleeps;
+    world.alarmWakes = alarmWakes;
+    world.sleepsOverWindow = sleepsOverWindow;
+    world.wakesMisplaced = wakesMisplaced;
+    world.sleptMicros = sleptMicros;
+    world.wakeTrueMicros = wakeTrueMicros;
+    world.wakeToWalkMicros = wakeToWalkMicros;
+    world.rtc = hostGetRtcState();
+    ESP.rtcUserMemoryRead(0, world.rtcUserMemory, sizeof world.rtcUserMemory);
+
+    if (worldPath.empty())
+    {
+        char path[] = "/tmp/PedestrianSimulator.XXXXXX";
+        const int fd = mkstemp(path);
+        if (fd < 0)
+        {
+            return false;
+        }
+        close(fd);
+        worldPath = path;
+    }
+
+    FILE* pFile = fopen(worldPath.c_str(), "wb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+    const bool written = fwrite(&world, sizeof world, 1, pFile) == 1;
+    return (fclose(pFile) == 0) && written;
+}
+
+static bool loadWorld(const char* pPath)
+{
+    SimulatorWorld world;
+    FILE* pFile = fopen(pPath, "rb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+    const bool read = fread(&world, sizeof world, 1, pFile) == 1;
+    fclose(pFile);
+    if (!read)
+    {
+        return false;
+    }
+
+    worldPath = pPath;
+    wallStart = world.wallStart;
+    edges = world.edges;
+    walks = world.walks;
+    walksOutside = world.walksOutside;
+    network.requests = world.requests;
+    memcpy(days, world.days, sizeof days);
+    sleeps = world.sleeps;
+    alarmWakes = world.alarmWakes;
+    sleepsOverWindow = world.sleepsOverWindow;
+    wakesMisplaced = world.wakesMisplaced;
+    sleptMicros = world.sleptMicros;
+    wakeTrueMicros = world.wakeTrueMicros;
+    wakeToWalkMicros = world.wakeToWalkMicros;
+    // The DS3231 ran on through the sleep.
+    clockMicros = world.sleepClockMicros;
+    hostSetRtcState(world.rtc);
+    clockMicros = world.clockMicros;
+    ESP.rtcUserMemoryWrite(0, world.rtcUserMemory, sizeof world.rtcUserMemory);
+    return true;
+}
+
+// ESP.deepSleep(): the timer or the DS3231 alarm on RST ends it, then the chip resets.
+static void deepSleep(const uint64_t microsecond)
+{
+    uint64_t wakeClock = clockMicros + microsecond;
+    bool byAlarm = false;
+
+    const HostRtcState rtc = hostGetRtcState();
+    if (rtc.alarmEnabled && (rtc.alarmMicros > rtc.micros))
+    {
+        // The DS3231 counts on the node clock with its own drift.
+        const double rate = 1.0 + rtc.driftPpm / 1000000.0;
+        const uint64_t alarmClock = clockMicros +
+            static_cast<uint64_t>(ceil(static_cast<double>(rtc.alarmMicros - rtc.micros) / rate));
+        if (alarmClock <= wakeClock)
+        {
+            wakeClock = alarmClock;
+            byAlarm = true;
+        }
+    }
+
+    const uint32_t sleepLocalTime = getTrueLocalTime();
+    const uint32_t wakeLocalTime =
+        static_cast<uint32_t>(getTrueMicros(wakeClock) / 1000000) + LOCAL_TIMEZONE_FROM_UTC * 3600;
+
+    sleeps++;
+    sleptMicros += getTrueMicros(wakeClock) - getTrueMicros(clockMicros);
+    for (uint32_t time = sleepLocalTime + SIMULATOR_WALK_TOLERANCE;
+        (time + SIMULATOR_WALK_TOLERANCE) < wakeLocalTime; time += 60)
+    {
+        if (isExpectedOn(time))
+        {
+            sleepsOverWindow++;
+            break;
+        }
+    }
+    if (byAlarm)
+    {
+        alarmWakes++;
+        wakesMisplaced += isExpectedOn(wakeLocalTime + SIMULATOR_WALK_TOLERANCE) ? 0 : 1;
+        wakeTrueMicros = getTrueMicros(wakeClock);
+    }
+
+    if (trace)
+    {
+        const DateTime time(wakeLocalTime);
+        printf("%04u-%02u-%02u %02u:%02u:%02u deep sleep ends by the %s\n",
+            time.year(), time.month(), time.day(), time.hour(), time.minute(), time.second(),
+            byAlarm ? "RTC alarm" : "timer");
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    if (!saveWorld(wakeClock))
+    {
+        fprintf(stderr, "Cannot save the world for the deep sleep.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<char*> arguments(restartArguments);
+    arguments.push_back(const_cast<char*>("--resume"));
+    arguments.push_back(const_cast<char*>(worldPath.c_str()));
+    arguments.push_back(nullptr);
+    execv("/proc/self/exe", arguments.data());
+
+    perror("execv");
+    exit(EXIT_FAILURE);
+}
+
+////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    const char* pStart = SIMULATOR_START;
+    uint32_t dayCount = SIMULATOR_DAYS;
+    double rtcDriftPpm = SIMULATOR_RTC_DRIFT;
+    const char* pResume = nullptr;
+    for (int index = 1; index < argc; index++)
+    {
+        const bool hasValue = (index + 1) < argc;
+        if ((strcmp(argv[index], "--resume") == 0) && hasValue)
+        {
+            // Internal: the run again after a deep sleep.
+            pResume = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--start") == 0) && hasValue)
+        {
+            pStart = argv[++index];
+        }
+        else if ((strcmp(argv[index], "--days") == 0) && hasValue)
+        {
+            dayCount = strtoul(argv[++index], nullptr, 10);
+        }
+        else if ((strcmp(argv[index], "--rtc-drift") == 0) && hasValue)
+        {
+            rtcDriftPpm = strtod(argv[++index], nullptr);
+        }
+        else if ((strcmp(argv[index], "--crystal-drift") == 0) && hasValue)
+        {
+            crystalDriftPpm = strtod(argv[++index], nullptr);
+        }
+        else if (strcmp(argv[index], "--quiet") == 0)
+        {
+            trace = false;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--start YYYY-MM-DD] [--days N] [--rtc-drift PPM] [--crystal-drift PPM] [--quiet]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (int index = 0; index < argc; index++)
+    {
+        if (strcmp(argv[index], "--resume") == 0)
+        {
+            index++;
+            continue;
+        }
+        restartArguments.push_back(argv[index]);
+    }
+
+    unsigned int year, month, day;
+    if ((sscanf(pStart, "%u-%u-%u", &year, &month, &day) != 3) || (dayCount == 0) || (dayCount >= SIMULATOR_MAX_DAYS))
+    {
+        fprintf(stderr, "Invalid start date or day count.\n");
+        return 2;
+    }
+
+    const uint32_t startLocalTime = DateTime(year, month, day).unixtime();
+    startUnixTime = startLocalTime - LOCAL_TIMEZONE_FROM_UTC * 3600;
+    firstLocalDay = startLocalTime / 86400;
+    expected.build(
+        scheduleWindows, sizeof scheduleWindows / sizeof scheduleWindows[0],
+        scheduleHolidays, sizeof scheduleHolidays / sizeof scheduleHolidays[0]);
+
+    signalHostClock = getClockMicros;
+    hostDelayHandler = advance;
+    pHostSimulatedNetwork = &network;
+    signalHostPinHandler = onPin;
+    hostDeepSleepHandler = deepSleep;
+    if (!trace)
+    {
+        pHostSerialOutput = nullptr;
+    }
+
+    wallStart = signalHostMonotonicMicros();
+    if (pResume == nullptr)
+    {
+        // Both drift against the true time, the DS3231 emulation counts on the node clock.
+        hostSetRtcTime(startLocalTime + SIMULATOR_RTC_START_ERROR);
+        hostSetRtcDrift(((1.0 + rtcDriftPpm / 1000000.0) / (1.0 + crystalDriftPpm / 1000000.0) - 1.0) * 1000000.0);
+    }
+    else if (!loadWorld(pResume))
+    {
+        fprintf(stderr, "Cannot resume from %s.\n", pResume);
+        return 2;
+    }
+
+    const uint64_t endTrueMicros = (static_cast<uint64_t>(startUnixTime) + dayCount * 86400ULL) * 1000000;
+
+    setup();
+    while (getTrueMicros(clockMicros) < endTrueMicros)
+    {
+        const uint64_t before = clockMicros;
+        loop();
+        if (clockMicros == before)
+        {
+            advance(SIMULATOR_LOOP_PASS);
+        }
+    }
+
+    const double wallSecond = static_cast<double>(signalHostMonotonicMicros() - wallStart) / 1000000.0;
+    const double simulatedHours = dayCount * 24.0;
+
+    // The first day may start after its sync and windows, the last one is whole.
+    uint32_t daysWithoutWalk = 0;
+    uint32_t daysWithoutSync = 0;
+    for (uint32_t index = 1; index < dayCount; index++)
+    {
+        daysWithoutWalk += (days[index].walks == 0) ? 1 : 0;
+        daysWithoutSync += (days[index].ntpRequests == 0) ? 1 : 0;
+    }
+
+    const int64_t rtcErrorMillisecond = static_cast<int64_t>(hostGetRtcMicros() / 1000) -
+        static_cast<int64_t>(getTrueMicros(clockMicros) / 1000 + LOCAL_TIMEZONE_FROM_UTC * 3600000LL);
+
+    const int64_t rtcBound = SIMULATOR_RTC_TOLERANCE + static_cast<int64_t>(fabs(rtcDriftPpm) * 86.4);
+
+    uint32_t offMinutes = 0;
+    for (uint32_t time = startLocalTime; time < (startLocalTime + dayCount * 86400); time += 60)
+    {
+        offMinutes += isExpectedOn(time) ? 0 : 1;
+    }
+    const double sleptHours = static_cast<double>(sleptMicros) / 3600000000.0;
+    const double offHours = offMinutes / 60.0;
+    const double savedPerNight = sleptHours * (MODEL_IDLE_CURRENT - MODEL_DEEP_SLEEP_CURRENT) / 1000.0 / dayCount;
+
+    if (!worldPath.empty())
+    {
+        unlink(worldPath.c_str());
+    }
+
+    fprintf(stderr, "Simulated %u days from %s in %.3f sec: %.0f simulated hours/sec\n",
+        dayCount, pStart, wallSecond, simulatedHours / wallSecond);
+    fprintf(stderr, "GPIO edges=%lu, walks=%lu, outside windows=%lu, days without walk=%lu\n",
+        static_cast<unsigned long>(edges), static_cast<unsigned long>(walks),
+        static_cast<unsigned long>(walksOutside), static_cast<unsigned long>(daysWithoutWalk));
+    fprintf(stderr, "NTP requests=%lu, days without sync=%lu, RTC error at end=%lld msec (bound %lld)\n",
+        static_cast<unsigned long>(network.requests), static_cast<unsigned long>(daysWithoutSync),
+        static_cast<long long>(rtcErrorMillisecond), static_cast<long long>(rtcBound));
+    fprintf(stderr, "Deep sleeps=%lu, RTC alarm wakes=%lu, over a window=%lu, wakes off a window start=%lu\n",
+        static_cast<unsigned long>(sleeps), static_cast<unsigned long>(alarmWakes),
+        static_cast<unsigned long>(sleepsOverWindow), static_cast<unsigned long>(wakesMisplaced));
+    fprintf(stderr, "Slept %.1f of %.1f hours off the windows, modeled energy saved %.1f mAh per night, "
+        "longest wake to WALK %.0f msec\n",
+        sleptHours, offHours, savedPerNight, static_cast<double>(wakeToWalkMicros) / 1000.0);
+
+    bool passed = (walksOutside == 0) && (daysWithoutWalk == 0) && (daysWithoutSync == 0) &&
+        (rtcErrorMillisecond <= rtcBound) && (rtcErrorMillisecond >= -rtcBound) &&
+        (sleepsOverWindow == 0) && (wakesMisplaced == 0);
+#if DEEP_SLEEP_ENABLED
+    passed = passed && (sleptHours >= (offHours * SIMULATOR_SLEPT_SHARE));
+#endif
+#if DEEP_SLEEP_RTC_ALARM
+    passed = passed && (alarmWakes > 0);
+#endif
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,265 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HEAD_EQUIVALENCE_H
+#define HEAD_EQUIVALENCE_H
+
+#include <SignalHeadMachine.h>
+
+#include "HostTest.h"
+
+// Runs a table driven head and the hand written switch logic it replaced side by side,
+// the same ticks and commands to both, and checks that every step ends in the same phase,
+// status text, state, remaining ticks and lamps. That logic is host/legacy/Legacy*.h, on
+// SignalSequence already, BaselineEquivalence below checks the first controllers.
+
+static void ignorePin(const uint8_t, const bool)
+{
+}
+
+template <typename Head, typename Legacy>
+class HeadEquivalence
+{
+private:
+    SignalHeadMachine<Head> head;
+    Legacy legacy;
+    uint32_t headLamps;       // the lamps as each one wrote them, both use the same pins
+    uint32_t legacyLamps;
+    uint32_t randomState;
+    uint32_t transitions;
+
+    uint32_t nextRandom()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState;
+    }
+
+    template <typename Step>
+    void run(const Step& step)
+    {
+        const uint8_t phase = head.getPhase();
+
+        signalHostPins = headLamps;
+        step(head);
+        headLamps = signalHostPins;
+
+        signalHostPins = legacyLamps;
+        step(legacy);
+        legacyLamps = signalHostPins;
+
+        transitions += (head.getPhase() != phase) ? 1 : 0;
+    }
+
+    bool isEqual()
+    {
+        return (head.getPhase() == legacy.getPhase()) &&
+            (head.getStatusText() == legacy.getStatusText()) &&
+            (head.getSignalState() == legacy.getSignalState()) &&
+            (head.getRemainsTicks() == legacy.getRemainsTicks()) &&
+            (head.isHolding() == legacy.isHolding()) &&
+            (headLamps == legacyLamps);
+    }
+
+    void report(const char* pStep)
+    {
+        fprintf(stderr, "After %s: phase %u/%u, \"%s\"/\"%s\", state %d/%d, remains %u/%u, lamps %04lx/%04lx\n",
+            pStep, head.getPhase(), legacy.getPhase(), head.getStatusText().c_str(), legacy.getStatusText().c_str(),
+            head.getSignalState(), legacy.getSignalState(), head.getRemainsTicks(), legacy.getRemainsTicks(),
+            static_cast<unsigned long>(headLamps), static_cast<unsigned long>(legacyLamps));
+    }
+
+public:
+    HeadEquivalence()
+        : headLamps(0), legacyLamps(0), randomState(0x13579bdf), transitions(0)
+    {
+        signalHostPinHandler = ignorePin;
+        run([](auto& machine) { machine.begin(); });
+    }
+
+    // A full cycle step by step: go, stop, then ticks until holding again.
+    void checkCycle()
+    {
+        CHECK_EQUAL(Head::TickInterval, Legacy::TickInterval);
+        CHECK(isEqual());
+
+        static const uint8_t commands[] = { SignalCommandQuery, SignalCommandGo, SignalCommandQuery, SignalCommandStop };
+        for (const uint8_t command : commands)
+        {
+            run([command](auto& machine) { machine.apply(command); });
+            CHECK(isEqual());
+        }
+
+        uint32_t ticks = 0;
+        while (!head.isHolding() && (ticks < 1000))
+        {
+            run([](auto& machine) { machine.tick(); });
+            if (!isEqual())
+            {
+                report("tick");
+                hostTestFailures++;
+            }
+            ticks++;
+        }
+        CHECK(ticks > 0);
+        CHECK(ticks < 1000);
+    }
+
+    // Random ticks and commands, commands in every phase, not only the holding ones
+    // where the node applies them. Returns the phase changes seen.
+    uint32_t checkRandom(const uint32_t steps)
+    {
+        for (uint32_t index = 0; index < steps; index++)
+        {
+            const uint32_t choice = nextRandom() % 8;
+            if (choice < 5)
+            {
+                run([](auto& machine) { machine.tick(); });
+            }
+            else
+            {
+                const uint8_t command = static_cast<uint8_t>(choice - 5);
+                run([command](auto& machine) { machine.apply(command); });
+            }
+
+            if (!isEqual())
+            {
+                report((choice < 5) ? "tick" : "command");
+                hostTestFailures++;
+                break;
+            }
+        }
+        return transitions;
+    }
+};
+
+// The head as the node drives it against the first hand written controller, which took
+// one request at its next tick (a later one replaced it) and had no commands, state or
+// remains to compare. The head takes the request at a tick when it holds, as the node's
+// queue does. Checks the status text and the lamps, the status LED aside, at every step.
+template <typename Head, typename Baseline>
+class BaselineEquivalence
+{
+private:
+    static const uint32_t StatusMask = 1UL << Head::StatusPin;
+
+    SignalHeadMachine<Head> head;
+    Baseline baseline;
+    uint32_t headLamps;
+    uint32_t baselineLamps;
+    uint32_t randomState;
+    uint32_t transitions;
+    uint8_t pending;         // the head's request, SignalCommandQuery for none
+
+    uint32_t nextRandom()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState;
+    }
+
+    void tickHead()
+    {
+        if ((pending != SignalCommandQuery) && head.isHolding())
+        {
+            head.apply(pending);
+            pending = SignalCommandQuery;
+        }
+        else
+        {
+            head.tick();
+        }
+    }
+
+    template <typename HeadStep, typename BaselineStep>
+    void run(const HeadStep& headStep, const BaselineStep& baselineStep)
+    {
+        const uint8_t phase = head.getPhase();
+
+        signalHostPins = headLamps;
+        headStep();
+        headLamps = signalHostPins;
+
+        signalHostPins = baselineLamps;
+        baselineStep();
+        baselineLamps = signalHostPins;
+
+        transitions += (head.getPhase() != phase) ? 1 : 0;
+    }
+
+    bool isEqual() const
+    {
+        return (head.getStatusText() == baseline.getStatusText()) &&
+            ((headLamps & ~StatusMask) == (baselineLamps & ~StatusMask));
+    }
+
+    void report(const char* pStep)
+    {
+        fprintf(stderr, "After %s: \"%s\"/\"%s\", lamps %04lx/%04lx\n",
+            pStep, head.getStatusText().c_str(), baseline.getStatusText().c_str(),
+            static_cast<unsigned long>(headLamps & ~StatusMask), static_cast<unsigned long>(baselineLamps & ~StatusMask));
+    }
+
+public:
+    BaselineEquivalence()
+        : headLamps(0), baselineLamps(0), randomState(0x2468ace1), transitions(0), pending(SignalCommandQuery)
+    {
+        signalHostPinHandler = ignorePin;
+        run([this]() { head.begin(); }, [this]() { baseline.begin(); });
+    }
+
+    // Random ticks and go and stop requests in every phase. Returns the phase changes seen.
+    uint32_t checkRandom(const uint32_t steps)
+    {
+        CHECK_EQUAL(Head::TickInterval, Baseline::TickInterval);
+        CHECK(isEqual());
+
+        for (uint32_t index = 0; index < steps; index++)
+        {
+            const uint32_t choice = nextRandom() % 8;
+            if (choice == 5)
+            {
+                run([this]() { pending = SignalCommandGo; }, [this]() { baseline.requestGo(); });
+            }
+            else if (choice == 6)
+            {
+                run([this]() { pending = SignalCommandStop; }, [this]() { baseline.requestStop(); });
+            }
+            else
+            {
+                run([this]() { tickHead(); }, [this]() { baseline.tick(); });
+            }
+
+            if (!isEqual())
+            {
+                report(((choice == 5) || (choice == 6)) ? "request" : "tick");
+                hostTestFailures++;
+                break;
+            }
+        }
+        return transitions;
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_NODE_H
+#define HOST_NODE_H
+
+#include <ESP8266WebServer.h>
+#include <SignalNodeController.h>
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Signal nodes of a test on loopback. Each runs in a forked process as its sketch does,
+// on a static address a.b.c.d served at 127.0.c.d (see HostNetwork.h), and the test talks
+// HTTP to them with a plain socket client. Set SIGNAL_HOST_PORT_OFFSET before the first
+// node, the processes share it. The test defines the logger, as a sketch does.
+
+////////////////////////////////////////////////
+
+#define HOST_NODE_LOOP_IDLE 200     // usec slept after each pass, as core/HostMain.cpp
+#define HOST_NODE_START_LIMIT 5000  // msec for a node to answer
+
+static const IPAddress hostNodeNetmask(255, 255, 255, 0);
+
+static void ignoreNodePin(const uint8_t, const bool)
+{
+}
+
+// Runs the node of Head on address until the test process exits, returns its pid.
+// pinHandler gets the lamp and status writes in the node process.
+template <typename Head>
+static pid_t spawnNode(const IPAddress& address, const IPAddress& gateway,
+    const SignalHostPinHandler pinHandler = ignoreNodePin)
+{
+    const pid_t parent = getpid();
+    const pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    signalHostStartMicros();
+    pHostSerialOutput = nullptr;
+    signalHostPinHandler = pinHandler;
+    WiFi.config(address, gateway, hostNodeNetmask);
+
+    ESP8266WebServer server(80);
+    SignalNodeController<Head> controller;
+    controller.Init(&server, &Serial);
+    server.begin();
+
+    const timespec idle = { 0, HOST_NODE_LOOP_IDLE * 1000 };
+    while (getppid() == parent)
+    {
+        server.handleClient();
+        controller.handle();
+        logger.drain();
+        hostService();
+        nanosleep(&idle, nullptr);
+    }
+    _exit(0);
+}
+
+static void stopNode(const pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+////////////////////////////////////////////////
+
+struct HostHttpResponse
+{
+    int status;            // -1: no connection or no complete answer in time
+    std::string headers;
+    std::string body;
+};
+
+// Socket connected to a node's port, -1 on failure.
+static int connectNode(const IPAddress& address, const uint16_t port, const uint32_t timeoutMillisecond)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const timeval timeout = { static_cast<time_t>(timeoutMillisecond / 1000),
+        static_cast<suseconds_t>((timeoutMillisecond % 1000) * 1000) };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+
+    sockaddr_in socketAddress = {};
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_addr.s_addr = static_cast<uint32_t>(IPAddress(127, 0, address[2], address[3]));
+    socketAddress.sin_port = htons(hostGetPort(port));
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&socketAddress), sizeof socketAddress) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool sendRequest(const int fd, const char* pTarget)
+{
+    const std::string request = std::string("GET ") + pTarget + " HTTP/1.1\r\nHost: node\r\nConnection: close\r\n\r\n";
+    return send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size());
+}
+
+// True once text holds the whole answer: the head and Content-Length bytes, or the last
+// chunk. Without either the answer ends with the connection.
+static bool isResponseComplete(const std::string& text)
+{
+    const size_t headEnd = text.find("\r\n\r\n");
+    if (headEnd == std::string::npos)
+    {
+        return false;
+    }
+
+    const std::string head = text.substr(0, headEnd + 2);
+    const size_t length = head.find("Content-Length: ");
+    if (length != std::string::npos)
+    {
+        return text.size() >= (headEnd + 4 + strtoul(head.c_str() + length + 16, nullptr, 10));
+    }
+    if (head.find("Transfer-Encoding: chunked") != std::string::npos)
+    {
+        return (text.size() >= (headEnd + 9)) && (text.compare(text.size() - 5, 5, "0\r\n\r\n") == 0);
+    }
+    return false;
+}
+
+// Reads an answer, then closes as an HTTP client does: the node waits for that.
+static HostHttpResponse readResponse(const int fd)
+{
+    HostHttpResponse response = { -1, std::string(), std::string() };
+    std::string text;
+    char buffer[1024];
+    ssize_t size = 0;
+    while (!isResponseComplete(text) && ((size = recv(fd, buffer, sizeof buffer, 0)) > 0))
+    {
+        text.append(buffer, static_cast<size_t>(size));
+    }
+    const size_t headEnd = text.find("\r\n\r\n");
+    if ((size < 0) || (headEnd == std::string::npos) || (text.compare(0, 9, "HTTP/1.1 ") != 0))
+    {
+        return response;
+    }
+
+    response.status = atoi(text.c_str() + 9);
+    response.headers = text.substr(0, headEnd + 2);
+    response.body = text.substr(headEnd + 4);
+    return response;
+}
+
+static HostHttpResponse httpGet(const IPAddress& address, const char* pTarget,
+    const uint32_t timeoutMillisecond = 5000, const uint16_t port = 80)
+{
+    const int fd = connectNode(address, port, timeoutMillisecond);
+    if ((fd < 0) || !sendRequest(fd, pTarget))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return HostHttpResponse { -1, std::string(), std::string() };
+    }
+
+    const HostHttpResponse response = readResponse(fd);
+    close(fd);
+    return response;
+}
+
+// Waits until the node answers its status, false if it doesn't in time.
+static bool waitForNode(const IPAddress& address)
+{
+    const uint64_t end = signalHostMonotonicMicros() + HOST_NODE_START_LIMIT * 1000ULL;
+    while (signalHostMonotonicMicros() < end)
+    {
+        if (httpGet(address, "/api/status", 500).status == 200)
+        {
+            return true;
+        }
+        usleep(20000);
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Minimal checks: a failure prints where and what, and the test exits non-zero at the end.
+
+static int hostTestFailures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+    do \
+    { \
+        const auto expectedValue = (expected); \
+        const auto actualValue = (actual); \
+        if (!(expectedValue == actualValue)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK_EQUAL(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, \
+                #expected, #actual, static_cast<long long>(expectedValue), static_cast<long long>(actualValue)); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+static inline int hostTestResult(const char* pName)
+{
+    fprintf(stderr, "%s: %s\n", pName, (hostTestFailures == 0) ? "passed" : "FAILED");
+    return (hostTestFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,133 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "NtpPacket.h"
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+// Server replies against the cookie check, and the clock filter over servers of which
+// one is wrong (a falseticker) and would win on distance alone.
+
+static const int64_t unixMillisecond = 1700000000000LL;   // server clock at T2
+
+// Unix msec to a 64bit timestamp, rounded up so decodeNtpTimestamp() gives it back.
+static void writeTimestamp(uint8_t* p, const int64_t millisecond)
+{
+    writeNtpWord(p, static_cast<uint32_t>(millisecond / 1000 + NTP_UNIX_EPOCH));
+    writeNtpWord(p + 4, static_cast<uint32_t>(((static_cast<uint64_t>(millisecond % 1000) << 32) + 999) / 1000));
+}
+
+// The reply to a request with this cookie, T2 and T3 on the server clock.
+static void makeResponse(uint8_t* pPacket, const uint32_t cookieHigh, const uint32_t cookieLow,
+    const int64_t t2, const int64_t t3)
+{
+    encodeNtpRequest(pPacket, 0, 0);
+    pPacket[0] = 0b00100100;   // no leap, version 4, server
+    pPacket[1] = 2;
+    writeNtpWord(pPacket + 24, cookieHigh);
+    writeNtpWord(pPacket + 28, cookieLow);
+    writeTimestamp(pPacket + 32, t2);
+    writeTimestamp(pPacket + 40, t3);
+}
+
+static NtpSample makeSample(const int64_t offset, const uint32_t delay, const uint32_t distance)
+{
+    NtpSample sample = NtpSample();
+    sample.offsetMillisecond = offset;
+    sample.delayMillisecond = delay;
+    sample.distanceMillisecond = distance;
+    sample.stratum = 2;
+    return sample;
+}
+
+static void testDecode()
+{
+    // Sent at local 1000, received at 1100, the server held it 20 msec.
+    uint8_t packet[NTP_PACKET_SIZE];
+    makeResponse(packet, 1000, 0x0102, unixMillisecond, unixMillisecond + 20);
+
+    NtpSample sample;
+    CHECK(decodeNtpResponse(packet, 1000, 0x0102, 1000, 1100, sample));
+    CHECK_EQUAL(80u, sample.delayMillisecond);
+    CHECK_EQUAL(unixMillisecond + 10 - 1050, sample.offsetMillisecond);
+    CHECK_EQUAL(41u, sample.distanceMillisecond);   // delay / 2 + 1, no root delay or dispersion
+
+    // Another T1, server or round: a stale or forged reply.
+    CHECK(!decodeNtpResponse(packet, 999, 0x0102, 999, 1100, sample));
+    CHECK(!decodeNtpResponse(packet, 1000, 0x0202, 1000, 1100, sample));
+    CHECK(!decodeNtpResponse(packet, 1000, 0x0103, 1000, 1100, sample));
+
+    // Not synchronized.
+    packet[0] = 0b11100100;
+    CHECK(!decodeNtpResponse(packet, 1000, 0x0102, 1000, 1100, sample));
+}
+
+static void testFilterKeepsLeastDelay()
+{
+    NtpClockFilter<2> filter;
+    NtpSample result;
+    CHECK(!filter.select(result));
+
+    filter.add(0, makeSample(500, 40, 21));
+    filter.add(0, makeSample(900, 60, 31));
+    filter.add(0, makeSample(700, 20, 11));
+    CHECK_EQUAL(1, filter.getCount());
+    CHECK(filter.select(result));
+    CHECK_EQUAL(700, result.offsetMillisecond);
+
+    filter.clear();
+    CHECK_EQUAL(0, filter.getCount());
+}
+
+static void testFilterRejectsFalseticker()
+{
+    // Three servers agree on about 1000 msec, the fourth is 5 seconds off with the
+    // smallest distance of all.
+    NtpClockFilter<4> filter;
+    filter.add(0, makeSample(1000, 40, 25));
+    filter.add(1, makeSample(1010, 30, 20));
+    filter.add(2, makeSample(995, 50, 30));
+    filter.add(3, makeSample(6000, 4, 3));
+
+    NtpSample result;
+    CHECK(filter.select(result));
+    CHECK_EQUAL(4, filter.getCount());
+    CHECK_EQUAL(1010, result.offsetMillisecond);
+    CHECK_EQUAL(20u, result.distanceMillisecond);
+
+    // Two servers can't outvote each other, the closer one is taken.
+    NtpClockFilter<4> pair;
+    pair.add(0, makeSample(1000, 40, 25));
+    pair.add(3, makeSample(6000, 4, 3));
+    CHECK(pair.select(result));
+    CHECK_EQUAL(6000, result.offsetMillisecond);
+}
+
+int main()
+{
+    testDecode();
+    testFilterKeepsLeastDelay();
+    testFilterRejectsFalseticker();
+    return hostTestResult("NtpPacketTest");
+}
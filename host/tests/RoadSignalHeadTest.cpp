@@ -0,0 +1,43 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// RoadSignalHead against the hand written controller it replaced, and against the
+// first one, from before the lamps were driven by SignalSequence.
+
+#include "RoadSignalHead.h"
+
+#include <BaselineRoadSignal.h>
+#include <LegacyRoadSignal.h>
+
+#include "HeadEquivalence.h"
+
+int main()
+{
+    HeadEquivalence<RoadSignalHead, LegacyRoadSignal> equivalence;
+    equivalence.checkCycle();
+    CHECK(equivalence.checkRandom(1000000) > 1000);
+
+    BaselineEquivalence<RoadSignalHead, BaselineRoadSignal> baseline;
+    CHECK(baseline.checkRandom(1000000) > 1000);
+
+    return hostTestResult("RoadSignalHeadTest");
+}
@@ -0,0 +1,362 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "Schedule.h"
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+// WeeklySchedule over month, year and leap day ends and wall clock (DST) jumps,
+// against a reference computed by the C library from the window table.
+
+typedef WeeklySchedule<15> Schedule;
+
+static uint32_t at(const int year, const int month, const int day, const int hour, const int minute, const int second = 0)
+{
+    tm time = {};
+    time.tm_year = year - 1900;
+    time.tm_mon = month - 1;
+    time.tm_mday = day;
+    time.tm_hour = hour;
+    time.tm_min = minute;
+    time.tm_sec = second;
+    return static_cast<uint32_t>(timegm(&time));
+}
+
+// The windows evaluated directly on the calendar fields.
+static bool referenceIsOn(const ScheduleWindow* pWindows, const uint8_t windowCount,
+    const ScheduleHoliday* pHolidays, const uint8_t holidayCount, const uint32_t localUnixTime)
+{
+    const time_t value = localUnixTime;
+    tm time;
+    gmtime_r(&value, &time);
+
+    for (uint8_t index = 0; index < holidayCount; index++)
+    {
+        if ((pHolidays[index].month == (time.tm_mon + 1)) && (pHolidays[index].day == time.tm_mday))
+        {
+            return false;
+        }
+    }
+
+    const int minute = time.tm_hour * 60 + time.tm_min;
+    const int yesterday = (time.tm_wday + 6) % 7;
+    for (uint8_t index = 0; index < windowCount; index++)
+    {
+        const ScheduleWindow& window = pWindows[index];
+        const int on = window.onHour * 60 + window.onMinute;
+        const int off = window.offHour * 60 + window.offMinute;
+        const bool today = (window.days & (1 << time.tm_wday)) != 0;
+        if (off > on)
+        {
+            if (today && (minute >= on) && (minute < off))
+            {
+                return true;
+            }
+        }
+        else if ((off < on) && ((today && (minute >= on)) || (((window.days & (1 << yesterday)) != 0) && (minute < off))))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////
+
+static const ScheduleWindow nightWindows[] =
+{
+    { SCHEDULE_EVERYDAY, 21, 0, 2, 0 }
+};
+
+static const ScheduleWindow officeWindows[] =
+{
+    { SCHEDULE_WEEKDAYS, 7, 0, 9, 0 },
+    { SCHEDULE_WEEKDAYS, 17, 30, 19, 0 },
+    { SCHEDULE_SATURDAY, 22, 0, 1, 15 },
+};
+
+static const ScheduleHoliday newYear[] =
+{
+    { 1, 1 },
+    { 2, 29 },
+};
+
+static void testMidnightWindow()
+{
+    Schedule schedule;
+    schedule.build(nightWindows, 1, nullptr, 0);
+
+    CHECK(!schedule.isOn(at(2027, 3, 10, 20, 59, 59)));
+    CHECK(schedule.isOn(at(2027, 3, 10, 21, 0)));
+    CHECK(schedule.isOn(at(2027, 3, 11, 1, 59, 59)));
+    CHECK(!schedule.isOn(at(2027, 3, 11, 2, 0)));
+
+    CHECK_EQUAL(0u, schedule.getRemainsMillisecond(at(2027, 3, 10, 23, 0)));
+    CHECK_EQUAL(3600000u, schedule.getRemainsMillisecond(at(2027, 3, 10, 20, 0)));
+    CHECK_EQUAL(1000u, schedule.getRemainsMillisecond(at(2027, 3, 10, 20, 59, 59)));
+}
+
+// The old next-wake calculation built the next date with day() + 1.
+static void testMonthAndYearEnds()
+{
+    Schedule schedule;
+    schedule.build(nightWindows, 1, nullptr, 0);
+
+    // Into the next month and year while on.
+    CHECK(schedule.isOn(at(2027, 1, 31, 23, 30)));
+    CHECK(schedule.isOn(at(2027, 2, 1, 1, 30)));
+    CHECK(schedule.isOn(at(2026, 12, 31, 23, 59, 59)));
+    CHECK(schedule.isOn(at(2027, 1, 1, 0, 0)));
+    CHECK(!schedule.isOn(at(2027, 1, 1, 2, 0)));
+
+    // Off after the window, on again the evening of the next month.
+    CHECK_EQUAL(19u * 3600000, schedule.getRemainsMillisecond(at(2027, 4, 30, 2, 0)));
+    CHECK_EQUAL(19u * 3600000, schedule.getRemainsMillisecond(at(2026, 12, 31, 2, 0)));
+
+    // Leap day: February 28th to 29th to March 1st.
+    CHECK(schedule.isOn(at(2028, 2, 29, 0, 30)));
+    CHECK(schedule.isOn(at(2028, 3, 1, 0, 30)));
+    CHECK_EQUAL(19u * 3600000, schedule.getRemainsMillisecond(at(2028, 2, 29, 2, 0)));
+}
+
+static void testWeekdays()
+{
+    Schedule schedule;
+    schedule.build(officeWindows, 3, nullptr, 0);
+
+    // 2027/1/1 is a Friday: the Saturday night window runs into Sunday, then Monday morning.
+    CHECK(schedule.isOn(at(2027, 1, 1, 8, 0)));
+    CHECK(!schedule.isOn(at(2027, 1, 2, 8, 0)));
+    CHECK(schedule.isOn(at(2027, 1, 3, 1, 0)));
+    CHECK_EQUAL((12u * 3600 + 45 * 60) * 1000, schedule.getRemainsMillisecond(at(2027, 1, 2, 9, 15)));
+    CHECK_EQUAL((29u * 3600 + 45 * 60) * 1000, schedule.getRemainsMillisecond(at(2027, 1, 3, 1, 15)));
+
+    // Over the year end, Thursday evening to Friday morning.
+    CHECK_EQUAL(12u * 3600000, schedule.getRemainsMillisecond(at(2026, 12, 31, 19, 0)));
+}
+
+static void testHolidays()
+{
+    Schedule schedule;
+    schedule.build(nightWindows, 1, newYear, 2);
+
+    // New Year's Eve runs into the holiday until midnight, then it stays off the whole day.
+    CHECK_EQUAL(0u, schedule.getRemainsMillisecond(at(2026, 12, 31, 23, 59, 59)));
+    CHECK_EQUAL(86400000u, schedule.getRemainsMillisecond(at(2027, 1, 1, 0, 0)));
+    CHECK_EQUAL(10u * 3600000, schedule.getRemainsMillisecond(at(2027, 1, 1, 14, 0)));
+    CHECK_EQUAL(0u, schedule.getRemainsMillisecond(at(2027, 1, 2, 0, 30)));
+    CHECK_EQUAL(18u * 3600000, schedule.getRemainsMillisecond(at(2027, 1, 2, 3, 0)));
+
+    // Leap day only in leap years.
+    CHECK_EQUAL(3600000u, schedule.getRemainsMillisecond(at(2027, 2, 28, 20, 0)));
+    CHECK_EQUAL(0u, schedule.getRemainsMillisecond(at(2027, 3, 1, 0, 30)));
+    CHECK_EQUAL(4u * 3600000, schedule.getRemainsMillisecond(at(2028, 2, 29, 20, 0)));
+
+    // Turning on at a holiday: wake at its midnight instead, and from there the next one.
+    static const ScheduleWindow earlyWindows[] = { { SCHEDULE_EVERYDAY, 0, 30, 5, 0 } };
+    schedule.build(earlyWindows, 1, newYear, 2);
+    CHECK_EQUAL(14u * 3600000, schedule.getRemainsMillisecond(at(2026, 12, 31, 10, 0)));
+    CHECK_EQUAL(86400000u, schedule.getRemainsMillisecond(at(2027, 1, 1, 0, 0)));
+    CHECK_EQUAL(1800000u, schedule.getRemainsMillisecond(at(2027, 1, 2, 0, 0)));
+}
+
+// The same on and off time is an empty window, not one of a whole day.
+static void testEmptyWindow()
+{
+    static const ScheduleWindow emptyWindows[] = { { SCHEDULE_EVERYDAY, 8, 0, 8, 0 } };
+    Schedule schedule;
+    CHECK(schedule.build(emptyWindows, 1, nullptr, 0));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 7, 59)));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 8, 0)));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 20, 0)));
+    CHECK_EQUAL(0u, schedule.getNextChangeSecond(at(2027, 3, 10, 8, 0)));
+    CHECK_EQUAL(16u * 3600000, schedule.getRemainsMillisecond(at(2027, 3, 10, 8, 0)));
+
+    // Next to another window it changes nothing.
+    static const ScheduleWindow nightAndEmptyWindows[] =
+    {
+        { SCHEDULE_EVERYDAY, 21, 0, 2, 0 },
+        { SCHEDULE_WEEKDAYS, 23, 0, 23, 0 },
+        { SCHEDULE_WEEKDAYS, 12, 0, 12, 0 },
+    };
+    CHECK(schedule.build(nightAndEmptyWindows, 3, nullptr, 0));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 12, 0)));
+    CHECK(schedule.isOn(at(2027, 3, 10, 23, 0)));
+    CHECK_EQUAL(3600000u, schedule.getRemainsMillisecond(at(2027, 3, 10, 20, 0)));
+}
+
+// Times off the slot grid or the clock are refused, not rounded down to a slot.
+static void testInvalidWindows()
+{
+    static constexpr ScheduleWindow offGridWindows[] =
+    {
+        { SCHEDULE_EVERYDAY, 21, 0, 2, 0 },
+        { SCHEDULE_EVERYDAY, 8, 10, 9, 0 },
+    };
+    static constexpr ScheduleWindow offClockWindows[] = { { SCHEDULE_EVERYDAY, 24, 0, 2, 0 } };
+    static_assert(Schedule::isValid(offGridWindows, 1), "Slot aligned windows are valid.");
+    static_assert(!Schedule::isValid(offGridWindows, 2), "8:10 is not on a 15 minute slot.");
+    static_assert(!Schedule::isValid(offClockWindows, 1), "24:00 is not a time of day.");
+
+    Schedule schedule;
+    CHECK(!schedule.build(offGridWindows, 2, nullptr, 0));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 8, 10)));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 8, 30)));
+    CHECK(schedule.isOn(at(2027, 3, 10, 21, 0)));
+
+    CHECK(!schedule.build(offClockWindows, 1, nullptr, 0));
+    CHECK(!schedule.isOn(at(2027, 3, 10, 1, 0)));
+}
+
+// Every 7 minutes over two years, leap year included: on exactly when the reference
+// says so, and off until the remains run out with the first on at or after that.
+static void testAgainstReference(const ScheduleWindow* pWindows, const uint8_t windowCount,
+    const ScheduleHoliday* pHolidays, const uint8_t holidayCount)
+{
+    Schedule schedule;
+    schedule.build(pWindows, windowCount, pHolidays, holidayCount);
+
+    uint32_t failures = 0;
+    for (uint32_t time = at(2027, 1, 1, 0, 3); (time < at(2029, 1, 1, 0, 0)) && (failures < 10); time += 7 * 60)
+    {
+        const bool on = referenceIsOn(pWindows, windowCount, pHolidays, holidayCount, time);
+        const uint32_t remains = schedule.getRemainsMillisecond(time) / 1000;
+        bool valid = (remains == 0) == on;
+        if (valid && (remains != 0))
+        {
+            // Off in between: the windows change on slot boundaries only. Waking at a
+            // midnight (holiday, nothing on) only re-evaluates, otherwise it is on then.
+            for (uint32_t step = time - time % Schedule::SlotSeconds + Schedule::SlotSeconds;
+                step < (time + remains); step += Schedule::SlotSeconds)
+            {
+                valid = valid && !referenceIsOn(pWindows, windowCount, pHolidays, holidayCount, step);
+            }
+            valid = valid && (referenceIsOn(pWindows, windowCount, pHolidays, holidayCount, time + remains) ||
+                (((time + remains) % 86400) == 0));
+        }
+
+        if (!valid)
+        {
+            const time_t value = time;
+            fprintf(stderr, "reference mismatch at %s  remains=%lu\n", asctime(gmtime(&value)),
+                static_cast<unsigned long>(remains));
+            failures++;
+        }
+    }
+    CHECK_EQUAL(0u, failures);
+}
+
+////////////////////////////////////////////////
+
+// A wall clock following DST (US Eastern) fed by the true time, as the node gets from
+// the RTC once NTP set it in local time. The controller re-evaluates at each 45sec
+// cycle while on, and sleeps at most 10min while off (sequenceTask), so a jump of the
+// wall clock is picked up within 10min and the signal is never on outside a window.
+static uint32_t getWallTime(const time_t utc)
+{
+    tm local;
+    localtime_r(&utc, &local);
+    return static_cast<uint32_t>(utc + local.tm_gmtoff);
+}
+
+static void testDstJumps(const ScheduleWindow* pWindows, const uint8_t windowCount, const time_t start)
+{
+    Schedule schedule;
+    schedule.build(pWindows, windowCount, nullptr, 0);
+
+    const uint32_t maxSleep = 10 * 60;
+    const uint32_t cycle = 45;
+
+    time_t utc = start;
+    time_t onSince = 0;   // utc the reference turned on, 0 while off
+    uint32_t worstLate = 0;
+    uint32_t onOutside = 0;
+    time_t nextEvaluation = utc;
+    bool signalOn = false;
+    while (utc < (start + 3 * 86400))
+    {
+        const bool reference = referenceIsOn(pWindows, windowCount, nullptr, 0, getWallTime(utc));
+        if (reference && (onSince == 0))
+        {
+            onSince = utc;
+        }
+        else if (!reference)
+        {
+            onSince = 0;
+        }
+
+        if (utc == nextEvaluation)
+        {
+            const uint32_t remains = schedule.getRemainsMillisecond(getWallTime(utc)) / 1000;
+            signalOn = (remains == 0);
+            onOutside += (signalOn && !reference) ? 1 : 0;
+            if (signalOn && (onSince != 0))
+            {
+                const uint32_t late = static_cast<uint32_t>(utc - onSince);
+                worstLate = (late > worstLate) ? late : worstLate;
+                onSince = utc;   // measured once per window
+            }
+            nextEvaluation = utc + (signalOn ? cycle : ((remains < maxSleep) ? remains : maxSleep));
+        }
+
+        // The reference changes on slot boundaries only, the zone offset is whole hours.
+        const time_t boundary = utc - utc % Schedule::SlotSeconds + Schedule::SlotSeconds;
+        utc = (nextEvaluation < boundary) ? nextEvaluation : boundary;
+    }
+
+    CHECK_EQUAL(0u, onOutside);
+    CHECK(worstLate <= maxSleep);
+}
+
+int main()
+{
+    testMidnightWindow();
+    testMonthAndYearEnds();
+    testWeekdays();
+    testHolidays();
+    testEmptyWindow();
+    testInvalidWindows();
+
+    testAgainstReference(nightWindows, 1, nullptr, 0);
+    testAgainstReference(officeWindows, 3, nullptr, 0);
+    testAgainstReference(nightWindows, 1, newYear, 2);
+    testAgainstReference(officeWindows, 3, newYear, 2);
+
+    // POSIX rule, no tz database needed: 2027/3/14 2:00 -> 3:00, 2027/11/7 2:00 -> 1:00.
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    tzset();
+    static const ScheduleWindow dstWindows[] =
+    {
+        { SCHEDULE_EVERYDAY, 2, 30, 4, 0 },   // skipped into on spring forward
+        { SCHEDULE_EVERYDAY, 21, 0, 1, 30 },  // repeated in part on fall back
+    };
+    testDstJumps(dstWindows, 2, at(2027, 3, 13, 5, 0));
+    testDstJumps(dstWindows, 2, at(2027, 11, 6, 5, 0));
+    testDstJumps(nightWindows, 1, at(2027, 3, 13, 5, 0));
+
+    return hostTestResult("ScheduleTest");
+}
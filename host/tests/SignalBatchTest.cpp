@@ -0,0 +1,90 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// /api/batch of a RoadSignal node on loopback: a batch is queued whole or refused, also
+// when its text is longer than the old 96 byte buffer, which cut it and dropped conditions.
+
+#include <stdlib.h>
+
+#include <SignalLogger.h>
+
+#include "Config.h"
+#include "RoadSignalHead.h"
+
+#include "HostNode.h"
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+SignalLogger logger;
+
+static const IPAddress nodeAddress(192, 168, 78, 2);
+static const IPAddress gatewayAddress(192, 168, 78, 1);
+
+static std::string repeat(const char* pText, const int count)
+{
+    std::string text;
+    for (int index = 0; index < count; index++)
+    {
+        text += pText;
+    }
+    return text;
+}
+
+static HostHttpResponse batch(const std::string& steps)
+{
+    return httpGet(nodeAddress, ("/api/batch?steps=" + steps).c_str());
+}
+
+int main()
+{
+    setenv("SIGNAL_HOST_PORT_OFFSET", "29000", 1);   // away from the other loopback tests
+
+    const pid_t node = spawnNode<RoadSignalHead>(nodeAddress, gatewayAddress);
+    CHECK(waitForNode(nodeAddress));
+
+    // 108 characters. The node is stopped: the queries and the last stop wait for a state
+    // it isn't in and are skipped, only the two gos apply. Cut at 95, the stop lost its
+    // condition and ran.
+    const std::string longSteps = repeat("query:road=going,", 5) + "go,go,stop:road=stopped";
+    CHECK(longSteps.size() > 95);
+    const HostHttpResponse longBatch = batch(longSteps);
+    CHECK_EQUAL(200, longBatch.status);
+    CHECK(longBatch.body == "Going\n1-8 done=2 skipped=6");
+
+    // The longest steps the limit is sized for.
+    const std::string longestSteps = repeat("query:pedestrian=transition,", SIGNAL_BATCH_MAX_COUNT - 1) +
+        "query:pedestrian=transition";
+    CHECK_EQUAL(static_cast<size_t>(SIGNAL_BATCH_TEXT_SIZE - 1), longestSteps.size());
+    const HostHttpResponse longestBatch = batch(longestSteps);
+    CHECK_EQUAL(200, longestBatch.status);
+    CHECK(longestBatch.body == "Going\n9-16 done=0 skipped=8");
+
+    // Longer than any valid batch: refused, nothing queued.
+    const std::string status = httpGet(nodeAddress, "/api/status").body;
+    CHECK_EQUAL(400, batch("stop" + repeat(",", SIGNAL_BATCH_TEXT_SIZE)).status);
+    CHECK_EQUAL(400, batch(longestSteps + ",stop").status);
+    CHECK(httpGet(nodeAddress, "/api/status").body == status);
+
+    stopNode(node);
+    return hostTestResult("SignalBatchTest");
+}
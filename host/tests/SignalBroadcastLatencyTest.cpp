@@ -0,0 +1,194 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - the shared code, built natively and checked without a board.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Transition to reaction latency on loopback: from the lamp write in a RoadSignal node
+// process to SignalStateListener::poll() seeing the new state in the test process, as the
+// button reacts. The same transitions are also polled on /api/status once per tick, as the
+// button did before. CLOCK_MONOTONIC is shared by the processes, so the times compare.
+
+#include <SignalBroadcast.h>
+#include <SignalLogger.h>
+
+#include <fcntl.h>
+
+#include "Config.h"
+#include "RoadSignalHead.h"
+
+#include "HostNode.h"
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+#define LATENCY_CYCLES 3
+#define LATENCY_LIMIT 50             // msec from the lamps to the pushed reaction, at most
+#define LATENCY_POLL_INTERVAL 1000   // msec between the status polls, the button's tick
+#define LATENCY_STATE_LIMIT 10000    // msec for a state to be seen both ways
+
+SignalLogger logger;
+
+static const IPAddress nodeAddress(192, 168, 81, 2);
+static const IPAddress listenerAddress(192, 168, 81, 10);
+static const IPAddress gatewayAddress(192, 168, 81, 1);
+
+static int edges[2];   // pipe of lamp write times, node to test
+
+// In the node process, the status blink left out.
+static void sendEdge(const uint8_t pin, const bool)
+{
+    if (pin != STATUS)
+    {
+        const uint64_t now = signalHostMonotonicMicros();
+        if (write(edges[1], &now, sizeof now) != sizeof now)
+        {
+            _exit(1);
+        }
+    }
+}
+
+////////////////////////////////////////////////
+
+struct Latency
+{
+    uint32_t count;
+    uint64_t total;   // usec
+    uint64_t worst;
+
+    void add(const uint64_t micros)
+    {
+        count++;
+        total += micros;
+        worst = (micros > worst) ? micros : worst;
+    }
+
+    double getMean() const
+    {
+        return (count == 0) ? 0.0 : static_cast<double>(total) / count / 1000.0;
+    }
+};
+
+static SignalStateListener listener;
+static Latency pushed = {};
+static Latency polled = {};
+static uint64_t lastEdge = 0;
+static uint64_t nextPoll = 0;
+
+static void readEdges()
+{
+    uint64_t edge;
+    while (read(edges[0], &edge, sizeof edge) == sizeof edge)
+    {
+        lastEdge = edge;
+    }
+}
+
+// Sends a command without waiting for its answer, which comes after the lamps changed.
+static int sendCommand(const char* pTarget)
+{
+    const int fd = connectNode(nodeAddress, 80, 5000);
+    CHECK(fd >= 0);
+    CHECK(sendRequest(fd, pTarget));
+    return fd;
+}
+
+// Waits until the listener and the poll have both seen the state, adding their latencies.
+// The poll waits for the command's answer: until its client closes the node takes no other.
+// The button's tick has its own phase to the node's, so each wait polls at another one.
+static bool waitState(const SignalStates state, const char* pText, int command = -1)
+{
+    static uint32_t waits = 0;
+    nextPoll = signalHostMonotonicMicros() + ((++waits * 379) % LATENCY_POLL_INTERVAL) * 1000ULL;
+
+    bool pushSeen = false;
+    bool pollSeen = false;
+    const uint64_t end = signalHostMonotonicMicros() + LATENCY_STATE_LIMIT * 1000ULL;
+    while (!(pushSeen && pollSeen) && (signalHostMonotonicMicros() < end))
+    {
+        listener.poll();
+        readEdges();
+        if (!pushSeen && listener.isAlive(SignalNodeRoad) && (listener.getState(SignalNodeRoad) == state))
+        {
+            pushSeen = true;
+            pushed.add(signalHostMonotonicMicros() - lastEdge);
+        }
+
+        if (pushSeen && (command >= 0))
+        {
+            CHECK_EQUAL(200, readResponse(command).status);
+            close(command);
+            command = -1;
+        }
+
+        const uint64_t now = signalHostMonotonicMicros();
+        if (!pollSeen && (command < 0) && (now >= nextPoll))
+        {
+            // On the tick, the ones passed meanwhile skipped.
+            nextPoll += ((now - nextPoll) / (LATENCY_POLL_INTERVAL * 1000ULL) + 1) * LATENCY_POLL_INTERVAL * 1000ULL;
+            if (httpGet(nodeAddress, "/api/status").body == pText)
+            {
+                pollSeen = true;
+                polled.add(signalHostMonotonicMicros() - lastEdge);
+            }
+        }
+        usleep(100);
+    }
+    if (command >= 0)
+    {
+        close(command);
+    }
+    return pushSeen && pollSeen;
+}
+
+int main()
+{
+    setenv("SIGNAL_HOST_PORT_OFFSET", "31000", 1);   // away from the other loopback tests
+
+    CHECK(pipe2(edges, O_CLOEXEC) == 0);
+    const pid_t node = spawnNode<RoadSignalHead>(nodeAddress, gatewayAddress, sendEdge);
+    close(edges[1]);
+    fcntl(edges[0], F_SETFL, O_NONBLOCK);
+    CHECK(waitForNode(nodeAddress));
+
+    WiFi.config(listenerAddress, gatewayAddress, hostNodeNetmask);
+    listener.add(nodeAddress, SignalNodeRoad);
+    listener.begin();
+    CHECK(waitState(SignalStateStopped, "Stopped"));
+    pushed = Latency();
+    polled = Latency();
+
+    for (int cycle = 0; cycle < LATENCY_CYCLES; cycle++)
+    {
+        CHECK(waitState(SignalStateGoing, "Going", sendCommand("/api/go")));
+        CHECK(waitState(SignalStateTransition, "WillStop", sendCommand("/api/stop")));
+        CHECK(waitState(SignalStateStopped, "Stopped"));
+    }
+
+    fprintf(stderr, "Transition to reaction over %lu transitions: pushed mean=%.1f max=%.1f msec, "
+        "polled per tick mean=%.1f max=%.1f msec\n",
+        static_cast<unsigned long>(pushed.count), pushed.getMean(), pushed.worst / 1000.0,
+        polled.getMean(), polled.worst / 1000.0);
+    CHECK_EQUAL(LATENCY_CYCLES * 3, static_cast<int>(pushed.count));
+    CHECK(pushed.worst < LATENCY_LIMIT * 1000ULL);
+    CHECK(pushed.getMean() < polled.getMean());
+
+    stopNode(node);
+    return hostTestResult("SignalBroadcastLatencyTest");
+}
@@ -0,0 +1,259 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SignalClockMaster and two SignalClockFollower in their own processes on loopback, each
+// process with its own clock origin. CLOCK_MONOTONIC is shared, so the true offsets are
+// known and the followers' estimates can be checked: the skew stays under
+// LOOPBACK_MAX_SKEW, also after the master restarts with another clock.
+
+#include <SignalClock.h>
+
+#include <functional>
+
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+#define LOOPBACK_FOLLOWERS 2
+#define LOOPBACK_MAX_SKEW 10          // msec between any two clocks, master included
+#define LOOPBACK_SYNC_LIMIT 5000      // msec to synchronize
+#define LOOPBACK_MEASURE 1000         // msec of reports checked
+#define LOOPBACK_REPORT 50            // msec between the follower reports
+
+static const IPAddress masterAddress(192, 168, 77, 1);
+static const IPAddress netmask(255, 255, 255, 0);
+
+static uint64_t processStart = 0;
+
+static uint64_t getProcessMicros()
+{
+    return signalHostMonotonicMicros() - processStart;
+}
+
+// Sent by a follower over the pipe, one write each, so the reports don't interleave.
+struct Report
+{
+    uint8_t follower;
+    uint8_t synchronized;
+    uint16_t resets;
+    int32_t offset;
+    uint32_t delay;
+};
+
+static void runMaster(const uint64_t start)
+{
+    processStart = start;
+    signalHostClock = getProcessMicros;
+    WiFi.softAPConfig(masterAddress, masterAddress, netmask);
+
+    SignalClockMaster master;
+    master.begin();
+    while (getppid() != 1)
+    {
+        master.handle();
+        delay(1);
+    }
+    _exit(0);
+}
+
+static void runFollower(const uint8_t index, const uint64_t start, const int fd)
+{
+    processStart = start;
+    signalHostClock = getProcessMicros;
+    WiFi.config(IPAddress(192, 168, 77, 2 + index), masterAddress, netmask);
+
+    SignalClockFollower follower;
+    follower.begin(masterAddress);
+    uint32_t reportedAt = 0;
+    while (getppid() != 1)
+    {
+        follower.handle();
+        if ((millis() - reportedAt) >= LOOPBACK_REPORT)
+        {
+            reportedAt = millis();
+            const Report report = { index, follower.isSynchronized(), follower.getResets(),
+                follower.getOffset(), follower.getDelay() };
+            if (write(fd, &report, sizeof report) != sizeof report)
+            {
+                break;
+            }
+        }
+        delay(1);
+    }
+    _exit(0);
+}
+
+static pid_t spawn(const std::function<void()>& body)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        body();
+        _exit(0);
+    }
+    return pid;
+}
+
+////////////////////////////////////////////////
+
+static int reports = -1;
+static int64_t followerStarts[LOOPBACK_FOLLOWERS];
+static Report latest[LOOPBACK_FOLLOWERS];
+static bool received[LOOPBACK_FOLLOWERS];
+
+// Master clock - follower clock in msec, what a perfect follower reports.
+static int32_t getTrueOffset(const uint8_t follower, const int64_t masterStart)
+{
+    return static_cast<int32_t>((followerStarts[follower] - masterStart) / 1000);
+}
+
+// Reads the reports for millisecond, calling check() on each.
+static void collect(const uint32_t millisecond, const std::function<bool(const Report&)>& check)
+{
+    const uint64_t end = signalHostMonotonicMicros() + millisecond * 1000ULL;
+    while (signalHostMonotonicMicros() < end)
+    {
+        pollfd entry = { reports, POLLIN, 0 };
+        if (poll(&entry, 1, 10) <= 0)
+        {
+            continue;
+        }
+
+        Report report;
+        if ((read(reports, &report, sizeof report) != sizeof report) || (report.follower >= LOOPBACK_FOLLOWERS))
+        {
+            fprintf(stderr, "Broken report.\n");
+            hostTestFailures++;
+            return;
+        }
+        latest[report.follower] = report;
+        received[report.follower] = true;
+        if (!check(report))
+        {
+            return;
+        }
+    }
+}
+
+// Waits until every follower reports the offset to this master, returns false on timeout.
+static bool waitSynchronized(const int64_t masterStart)
+{
+    bool synchronized[LOOPBACK_FOLLOWERS] = {};
+    uint8_t count = 0;
+    collect(LOOPBACK_SYNC_LIMIT, [&](const Report& report)
+    {
+        const int32_t error = report.offset - getTrueOffset(report.follower, masterStart);
+        if (report.synchronized && (abs(error) <= LOOPBACK_MAX_SKEW / 2) && !synchronized[report.follower])
+        {
+            synchronized[report.follower] = true;
+            count++;
+        }
+        return count < LOOPBACK_FOLLOWERS;
+    });
+    return count == LOOPBACK_FOLLOWERS;
+}
+
+// Every report for a while: synchronized, each follower within half the skew of the master,
+// so any two within the skew. Returns the largest error seen.
+static int32_t measure(const int64_t masterStart)
+{
+    int32_t worst = 0;
+    collect(LOOPBACK_MEASURE, [&](const Report& report)
+    {
+        const int32_t error = report.offset - getTrueOffset(report.follower, masterStart);
+        CHECK(report.synchronized);
+        CHECK(abs(error) <= LOOPBACK_MAX_SKEW / 2);
+        worst = (abs(error) > worst) ? abs(error) : worst;
+
+        int32_t errors[LOOPBACK_FOLLOWERS];
+        for (uint8_t index = 0; index < LOOPBACK_FOLLOWERS; index++)
+        {
+            errors[index] = latest[index].offset - getTrueOffset(index, masterStart);
+        }
+        CHECK(abs(errors[0] - errors[1]) < LOOPBACK_MAX_SKEW);
+        return true;
+    });
+    return worst;
+}
+
+int main()
+{
+    // Away from the nodes of a manual run, see README.md.
+    setenv("SIGNAL_HOST_PORT_OFFSET", "27000", 0);
+
+    int pipes[2];
+    if (pipe(pipes) != 0)
+    {
+        perror("pipe");
+        return EXIT_FAILURE;
+    }
+    reports = pipes[0];
+
+    // Clock origins in whole msec apart, so the true offsets are exact.
+    const int64_t base = static_cast<int64_t>(signalHostMonotonicMicros());
+    const int64_t masterStart = base - 1000000000LL;
+    followerStarts[0] = base - 5000000LL;
+    followerStarts[1] = base - 250500000LL;
+
+    pid_t masterPid = spawn([&]() { runMaster(masterStart); });
+    pid_t followerPids[LOOPBACK_FOLLOWERS];
+    for (uint8_t index = 0; index < LOOPBACK_FOLLOWERS; index++)
+    {
+        followerPids[index] = spawn([&]() { runFollower(index, followerStarts[index], pipes[1]); });
+    }
+
+    CHECK(waitSynchronized(masterStart));
+    const int32_t worst = measure(masterStart);
+    fprintf(stderr, "Synchronized, largest error %ldmsec.\n", static_cast<long>(worst));
+
+    // A restarted master has another clock: the followers drop their samples and follow it.
+    kill(masterPid, SIGKILL);
+    waitpid(masterPid, nullptr, 0);
+    const int64_t restartedStart = base - 42000000LL;
+    masterPid = spawn([&]() { runMaster(restartedStart); });
+
+    CHECK(waitSynchronized(restartedStart));
+    const int32_t worstRestarted = measure(restartedStart);
+    fprintf(stderr, "Synchronized to the restarted master, largest error %ldmsec.\n",
+        static_cast<long>(worstRestarted));
+    for (uint8_t index = 0; index < LOOPBACK_FOLLOWERS; index++)
+    {
+        CHECK(received[index]);
+        CHECK(latest[index].resets >= 1);
+    }
+
+    kill(masterPid, SIGKILL);
+    waitpid(masterPid, nullptr, 0);
+    for (uint8_t index = 0; index < LOOPBACK_FOLLOWERS; index++)
+    {
+        kill(followerPids[index], SIGKILL);
+        waitpid(followerPids[index], nullptr, 0);
+    }
+
+    return hostTestResult("SignalClockLoopbackTest");
+}
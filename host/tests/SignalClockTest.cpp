@@ -0,0 +1,256 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SignalClockFollower against a simulated master on a virtual clock: it synchronizes,
+// and stops counting as synchronized when the master goes silent, its replies get too
+// slow to use, or its clock jumps.
+
+#include <SignalClock.h>
+#include <HostNetwork.h>
+
+#include <deque>
+#include <vector>
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+static uint64_t virtualMicros = 0;
+
+static uint64_t getVirtualMicros()
+{
+    return virtualMicros;
+}
+
+static uint32_t getVirtualMillis()
+{
+    return static_cast<uint32_t>(virtualMicros / 1000);
+}
+
+// The master answers after oneWay msec each way, on a clock offset msec ahead.
+class SimulatedMaster : public HostSimulatedNetwork
+{
+private:
+    struct Datagram
+    {
+        uint32_t dueAt;
+        uint16_t toPort;
+        std::vector<uint8_t> data;
+    };
+
+    std::deque<Datagram> pending;
+
+public:
+    bool running = true;
+    int32_t offset = 0;
+    uint32_t oneWay = 1;
+    uint32_t requests = 0;
+
+    uint32_t getAssociationMillisecond(const bool) override
+    {
+        return 0;
+    }
+
+    IPAddress getDhcpAddress() override
+    {
+        return IPAddress(192, 168, 4, 2);
+    }
+
+    uint32_t getDhcpLeaseSecond() override
+    {
+        return 86400;
+    }
+
+    bool resolve(const char*, IPAddress&) override
+    {
+        return false;
+    }
+
+    void send(const IPAddress&, const uint16_t fromPort,
+        const IPAddress&, const uint16_t toPort, const uint8_t* pData, const size_t size) override
+    {
+        SignalClockPacket packet;
+        if ((toPort != SIGNAL_CLOCK_PORT) || !decodeSignalClockPacket(pData, size, packet))
+        {
+            return;
+        }
+        requests++;
+        if (!running)
+        {
+            return;
+        }
+
+        const uint32_t now = getVirtualMillis();
+        packet.type = SignalClockReply;
+        packet.received = now + oneWay + static_cast<uint32_t>(offset);
+        packet.transmit = packet.received;
+
+        Datagram reply = { now + 2 * oneWay, fromPort, std::vector<uint8_t>(SIGNAL_CLOCK_PACKET_SIZE) };
+        encodeSignalClockPacket(reply.data.data(), packet);
+        pending.push_back(reply);
+    }
+
+    void deliver()
+    {
+        while (!pending.empty() && (static_cast<int32_t>(getVirtualMillis() - pending.front().dueAt) >= 0))
+        {
+            const Datagram& reply = pending.front();
+            hostDeliverDatagram(IPAddress(192, 168, 4, 1), SIGNAL_CLOCK_PORT, reply.toPort,
+                reply.data.data(), reply.data.size());
+            pending.pop_front();
+        }
+    }
+};
+
+static SimulatedMaster master;
+static SignalClockFollower follower;
+
+// Runs the follower's loop() every msec.
+static void run(const uint32_t millisecond)
+{
+    for (uint32_t index = 0; index < millisecond; index++)
+    {
+        virtualMicros += 1000;
+        master.deliver();
+        follower.handle();
+    }
+}
+
+// Runs until synchronized or the limit, returns the msec it took.
+static uint32_t runUntilSynchronized(const uint32_t limit)
+{
+    uint32_t elapsed = 0;
+    while (!follower.isSynchronized() && (elapsed < limit))
+    {
+        run(1);
+        elapsed++;
+    }
+    return elapsed;
+}
+
+static uint32_t runUntilUnsynchronized(const uint32_t limit)
+{
+    uint32_t elapsed = 0;
+    while (follower.isSynchronized() && (elapsed < limit))
+    {
+        run(1);
+        elapsed++;
+    }
+    return elapsed;
+}
+
+////////////////////////////////////////////////
+
+static void testSynchronize()
+{
+    master.offset = 123456;
+    master.oneWay = 2;
+    CHECK(!follower.isSynchronized());
+
+    // The first reply of the burst is enough.
+    CHECK(runUntilSynchronized(1000) <= SIGNAL_CLOCK_BURST + 10);
+    CHECK_EQUAL(123456, follower.getOffset());
+    CHECK_EQUAL(4u, follower.getDelay());
+
+    // Stays synchronized while the master answers.
+    run(60000);
+    CHECK(follower.isSynchronized());
+    CHECK_EQUAL(123456, follower.getOffset());
+    CHECK_EQUAL(0, follower.getResets());
+}
+
+// A master that stops answering: unsynchronized after SIGNAL_CLOCK_MAX_MISSED requests.
+static void testMissedReplies()
+{
+    master.running = false;
+
+    const uint32_t elapsed = runUntilUnsynchronized(60000);
+    CHECK(elapsed >= (SIGNAL_CLOCK_MAX_MISSED - 1) * SIGNAL_CLOCK_INTERVAL);
+    CHECK(elapsed <= (SIGNAL_CLOCK_MAX_MISSED + 1) * SIGNAL_CLOCK_INTERVAL);
+    CHECK_EQUAL(1, follower.getResets());
+
+    // Back to the burst, synchronized again soon after the master is.
+    run(5000);
+    CHECK(!follower.isSynchronized());
+    master.running = true;
+    CHECK(runUntilSynchronized(5000) <= SIGNAL_CLOCK_BURST + 10);
+    CHECK_EQUAL(123456, follower.getOffset());
+}
+
+// Replies that arrive but are too slow to use: the samples age out.
+static void testAging()
+{
+    run(20000);
+    const uint32_t requests = master.requests;
+    master.oneWay = SIGNAL_CLOCK_MAX_DELAY;
+
+    const uint32_t elapsed = runUntilUnsynchronized(60000);
+    CHECK(elapsed >= SIGNAL_CLOCK_MAX_AGE - SIGNAL_CLOCK_SAMPLES * SIGNAL_CLOCK_INTERVAL);
+    CHECK(elapsed <= SIGNAL_CLOCK_MAX_AGE);
+    CHECK_EQUAL(2, follower.getResets());
+    // Each request was answered, it's the age that counted.
+    CHECK(master.requests > requests);
+
+    master.oneWay = 2;
+    CHECK(runUntilSynchronized(5000) <= SIGNAL_CLOCK_BURST + 10);
+}
+
+// The master restarted: its clock jumps, and the old samples with their better delay
+// must not outvote the new ones.
+static void testJump()
+{
+    run(20000);
+    CHECK_EQUAL(2, follower.getResets());
+
+    master.offset -= 100000;
+    master.oneWay = 10;
+    run(SIGNAL_CLOCK_INTERVAL + 2 * 10 + 1);
+    CHECK(follower.isSynchronized());
+    CHECK_EQUAL(123456 - 100000, follower.getOffset());
+    CHECK_EQUAL(3, follower.getResets());
+
+    run(60000);
+    CHECK_EQUAL(123456 - 100000, follower.getOffset());
+    CHECK_EQUAL(3, follower.getResets());
+
+    // Jitter within the delays is no jump.
+    master.oneWay = 2;
+    run(20000);
+    CHECK_EQUAL(123456 - 100000, follower.getOffset());
+    CHECK_EQUAL(4u, follower.getDelay());
+    CHECK_EQUAL(3, follower.getResets());
+}
+
+int main()
+{
+    signalHostClock = getVirtualMicros;
+    pHostSimulatedNetwork = &master;
+
+    follower.begin(IPAddress(192, 168, 4, 1));
+
+    testSynchronize();
+    testMissedReplies();
+    testAging();
+    testJump();
+
+    return hostTestResult("SignalClockTest");
+}
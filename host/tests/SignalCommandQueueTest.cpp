@@ -0,0 +1,227 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stress of SignalCommandQueue: millions of commands, none lost, none reordered.
+// First the way the nodes use it, producer and both consumers (tick and drainNow()) on one
+// thread with the tick between passes, then producer and consumer on two threads.
+
+#include <SignalCommandQueue.h>
+
+#include <thread>
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+static uint64_t virtualMicros = 0;
+
+static uint64_t getVirtualMicros()
+{
+    return virtualMicros;
+}
+
+static uint32_t randomState = 0x2468ace1;
+
+static uint32_t nextRandom()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// The command and condition bytes carry the sequence, so a lost or reordered entry shows.
+static uint8_t getCommand(const uint32_t sequence)
+{
+    return static_cast<uint8_t>(sequence);
+}
+
+static uint8_t getCondition(const uint32_t sequence)
+{
+    return static_cast<uint8_t>(sequence >> 8);
+}
+
+////////////////////////////////////////////////
+
+typedef SignalCommandQueue<8> Queue;
+
+struct Consumer
+{
+    Queue* pQueue;
+    uint32_t expected;        // next sequence to come out
+    uint32_t outcomes;        // bit n: expected - 1 - n was skipped
+    uint32_t consumed;
+    uint32_t errors;
+
+    // Takes up to count commands, skipping some of them.
+    void take(const uint32_t count)
+    {
+        SignalCommand command;
+        for (uint32_t index = 0; (index < count) && pQueue->peek(command); index++)
+        {
+            if ((command.sequence != expected) ||
+                (command.command != getCommand(expected)) || (command.condition != getCondition(expected)))
+            {
+                errors++;
+            }
+
+            const bool applied = (nextRandom() % 4) != 0;
+            pQueue->complete(applied);
+            outcomes = (outcomes << 1) | (applied ? 0 : 1);
+            expected++;
+            consumed++;
+        }
+    }
+};
+
+static void tickHandler(Consumer* pConsumer)
+{
+    pConsumer->take(1 + nextRandom() % 3);
+}
+
+static void testLoopAndTick(const uint32_t total)
+{
+    signalHostClock = getVirtualMicros;
+
+    Queue queue;
+    Consumer consumer = { &queue, 1, 0, 0, 0 };
+    SignalTimer ticker;
+    ticker.attach(10, tickHandler, &consumer);
+
+    uint32_t pushed = 0;
+    uint32_t rejected = 0;
+    while (pushed < total)
+    {
+        // loop(): a batch of all or nothing, as runBatch() does.
+        const uint32_t size = 1 + nextRandom() % 8;
+        const uint8_t count = static_cast<uint8_t>((size < (total - pushed)) ? size : (total - pushed));
+        if (queue.getFree() >= count)
+        {
+            for (uint8_t index = 0; index < count; index++)
+            {
+                const uint32_t sequence = queue.getLastSequence() + 1;
+                CHECK_EQUAL(sequence, queue.push(getCommand(sequence), getCondition(sequence)));
+                pushed++;
+            }
+        }
+
+        // A full queue refuses without using up a sequence.
+        if (queue.getFree() == 0)
+        {
+            const uint32_t last = queue.getLastSequence();
+            CHECK_EQUAL(0u, queue.push(0));
+            CHECK_EQUAL(last, queue.getLastSequence());
+            rejected++;
+        }
+
+        // drainNow() from loop() after some pushes.
+        if ((nextRandom() % 3) == 0)
+        {
+            consumer.take(nextRandom() % 4);
+        }
+
+        // What the producer sees of the consumer is exact between passes.
+        CHECK_EQUAL(consumer.expected - 1, queue.getCompletedSequence());
+        CHECK_EQUAL(queue.getLastSequence() - queue.getCompletedSequence(), queue.getPending());
+        const uint32_t back = nextRandom() % SIGNAL_COMMAND_HISTORY;
+        if (back < queue.getCompletedSequence())
+        {
+            const uint32_t sequence = queue.getCompletedSequence() - back;
+            const bool skipped = ((consumer.outcomes >> back) & 1) != 0;
+            CHECK_EQUAL(skipped, queue.isSkipped(sequence));
+            CHECK_EQUAL(!skipped, queue.isApplied(sequence));
+        }
+
+        // The tick runs between loop() passes.
+        virtualMicros += nextRandom() % 8000;
+        signalHostRunTimers();
+    }
+
+    while (queue.getPending() != 0)
+    {
+        virtualMicros += 10000;
+        signalHostRunTimers();
+    }
+    ticker.detach();
+
+    CHECK_EQUAL(total, consumer.consumed);
+    CHECK_EQUAL(0u, consumer.errors);
+    CHECK_EQUAL(total, queue.getCompletedSequence());
+    CHECK(rejected > 0);
+}
+
+////////////////////////////////////////////////
+
+// The lock free claim itself: the consumer spins on its own thread. Relies on barrier()
+// being enough, which holds for x86 (stores and loads stay in program order).
+// Each side yields when it can't go on, so a single core machine gets through as well.
+static void testThreads(const uint32_t total)
+{
+    signalHostClock = signalHostMonotonicMicros;
+
+    Queue queue;
+    Consumer consumer = { &queue, 1, 0, 0, 0 };
+
+    std::thread consumerThread([&queue, &consumer, total]()
+    {
+        while (consumer.consumed < total)
+        {
+            if (queue.getPending() == 0)
+            {
+                std::this_thread::yield();
+            }
+            consumer.take(8);
+        }
+    });
+
+    uint32_t pushed = 0;
+    while (pushed < total)
+    {
+        const uint32_t sequence = pushed + 1;
+        if (queue.push(getCommand(sequence), getCondition(sequence)) != 0)
+        {
+            pushed++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    consumerThread.join();
+
+    CHECK_EQUAL(total, consumer.consumed);
+    CHECK_EQUAL(0u, consumer.errors);
+    CHECK(queue.isCompleted(total));
+    CHECK_EQUAL(0, queue.getPending());
+}
+
+int main(int argc, char* argv[])
+{
+    const uint32_t total = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 4000000;
+
+    testLoopAndTick(total);
+#if defined(__x86_64__) || defined(__i386__)
+    testThreads(total);
+#endif
+
+    return hostTestResult("SignalCommandQueueTest");
+}
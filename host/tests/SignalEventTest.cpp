@@ -0,0 +1,159 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Long-polls and event streams of a RoadSignal node on loopback. They wait on the event
+// port, so the web server keeps answering: the host server waits for each client to close
+// as ESP8266WebServer does, and a held client would stall it for 2 seconds.
+
+#include <stdlib.h>
+
+#include <SignalLogger.h>
+
+#include "Config.h"
+#include "RoadSignalHead.h"
+
+#include "HostNode.h"
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+#define EVENT_TEST_ANSWER_LIMIT 500   // msec for an answer while clients wait
+
+SignalLogger logger;
+
+static const IPAddress nodeAddress(192, 168, 79, 2);
+static const IPAddress gatewayAddress(192, 168, 79, 1);
+
+static uint32_t nowMillisecond()
+{
+    return static_cast<uint32_t>(signalHostMonotonicMicros() / 1000);
+}
+
+static unsigned long getSequence(const HostHttpResponse& response)
+{
+    const size_t position = response.headers.find("X-Signal-Sequence: ");
+    return (position == std::string::npos) ? 0 : strtoul(response.headers.c_str() + position + 19, nullptr, 10);
+}
+
+// A client that waits on the event port, -1 if it can't connect.
+static int openWatcher(const std::string& target)
+{
+    const int fd = connectNode(nodeAddress, SIGNAL_EVENT_PORT, 5000);
+    if ((fd >= 0) && !sendRequest(fd, target.c_str()))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads a stream until it holds text, false if it ends or times out first.
+static bool readUntil(const int fd, std::string& stream, const char* pText)
+{
+    char buffer[256];
+    ssize_t size;
+    while ((stream.find(pText) == std::string::npos) && ((size = recv(fd, buffer, sizeof buffer, 0)) > 0))
+    {
+        stream.append(buffer, static_cast<size_t>(size));
+    }
+    return stream.find(pText) != std::string::npos;
+}
+
+int main()
+{
+    setenv("SIGNAL_HOST_PORT_OFFSET", "30000", 1);   // away from the other loopback tests
+
+    const pid_t node = spawnNode<RoadSignalHead>(nodeAddress, gatewayAddress);
+    CHECK(waitForNode(nodeAddress));
+
+    // A since the status has moved past is answered at once, with the current sequence.
+    const HostHttpResponse current = httpGet(nodeAddress, "/api/status?since=4000000000");
+    CHECK_EQUAL(200, current.status);
+    CHECK(current.body == "Stopped");
+    const unsigned long sequence = getSequence(current);
+    CHECK(sequence != 0);
+    const std::string since = "/api/status?since=" + std::to_string(sequence);
+
+    // Waiting ones go to the event port.
+    const HostHttpResponse redirected = httpGet(nodeAddress, since.c_str());
+    CHECK_EQUAL(307, redirected.status);
+    CHECK(redirected.headers.find(":81" + since + "&wait=30000\r\n") != std::string::npos);
+    const HostHttpResponse eventsRedirected = httpGet(nodeAddress, "/api/events");
+    CHECK_EQUAL(307, eventsRedirected.status);
+    CHECK(eventsRedirected.headers.find(":81/api/events\r\n") != std::string::npos);
+
+    // Malformed numbers are refused on both ports.
+    CHECK_EQUAL(400, httpGet(nodeAddress, "/api/status?since=12x").status);
+    CHECK_EQUAL(400, httpGet(nodeAddress, "/api/status?since=").status);
+    CHECK_EQUAL(400, httpGet(nodeAddress, (since + "&wait=-").c_str()).status);
+    CHECK_EQUAL(400, httpGet(nodeAddress, "/api/status?since=99999999999").status);
+    CHECK_EQUAL(400, httpGet(nodeAddress, "/api/status?since=1x", 5000, SIGNAL_EVENT_PORT).status);
+    CHECK_EQUAL(404, httpGet(nodeAddress, "/api/go", 5000, SIGNAL_EVENT_PORT).status);
+
+    // Two long-polls and a stream wait on the event port.
+    const int poll1 = openWatcher(since + "&wait=20000");
+    const int poll2 = openWatcher(since);
+    const int stream = openWatcher("/api/events");
+    CHECK((poll1 >= 0) && (poll2 >= 0) && (stream >= 0));
+    std::string events;
+    CHECK(readUntil(stream, events, "data: Stopped\n\n"));
+
+    // The web server answers meanwhile, each time without the close wait.
+    for (int index = 0; index < 5; index++)
+    {
+        const uint32_t start = nowMillisecond();
+        CHECK_EQUAL(200, httpGet(nodeAddress, "/api/status").status);
+        CHECK((nowMillisecond() - start) < EVENT_TEST_ANSWER_LIMIT);
+    }
+
+    // The hub is full.
+    const int poll3 = openWatcher(since);
+    CHECK(poll3 >= 0);
+    CHECK_EQUAL(503, httpGet(nodeAddress, since.c_str(), 5000, SIGNAL_EVENT_PORT).status);
+
+    // Go answers all of them.
+    CHECK_EQUAL(200, httpGet(nodeAddress, "/api/go").status);
+    const HostHttpResponse answer1 = readResponse(poll1);
+    const HostHttpResponse answer2 = readResponse(poll2);
+    const HostHttpResponse answer3 = readResponse(poll3);
+    CHECK_EQUAL(200, answer1.status);
+    CHECK(answer1.body == "Going");
+    CHECK(answer2.body == "Going");
+    CHECK(answer3.body == "Going");
+    CHECK(getSequence(answer1) > sequence);
+    CHECK(readUntil(stream, events, "data: Going\n\n"));
+    close(poll1);
+    close(poll2);
+    close(poll3);
+    close(stream);
+
+    // A long-poll without a change is answered when its wait runs out.
+    const std::string moved = "/api/status?since=" + std::to_string(getSequence(answer1));
+    const uint32_t start = nowMillisecond();
+    const HostHttpResponse expired = httpGet(nodeAddress, (moved + "&wait=200").c_str(), 5000, SIGNAL_EVENT_PORT);
+    CHECK_EQUAL(200, expired.status);
+    CHECK(getSequence(expired) == getSequence(answer1));
+    CHECK((nowMillisecond() - start) >= 190);   // both processes round to msec
+
+    stopNode(node);
+    return hostTestResult("SignalEventTest");
+}
@@ -0,0 +1,197 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Every SignalCommon header builds on the POSIX backend.
+#include <SignalBenchmark.h>
+#include <SignalBroadcast.h>
+#include <SignalClock.h>
+#include <SignalCommandQueue.h>
+#include <SignalEventHub.h>
+#include <SignalFanout.h>
+#include <SignalHal.h>
+#include <SignalHeadMachine.h>
+#include <SignalLogger.h>
+#include <SignalLoopHistogram.h>
+#include <SignalMetrics.h>
+#include <SignalNodeController.h>
+#include <SignalPlan.h>
+#include <SignalProtocol.h>
+#include <SignalRouteStatistics.h>
+#include <SignalSequence.h>
+#include <SignalTrace.h>
+#include <Ticker.h>
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+static uint64_t virtualMicros = 0;
+
+static uint64_t getVirtualMicros()
+{
+    return virtualMicros;
+}
+
+// Moves the virtual clock, running the timers at their due times.
+static void advance(const uint64_t microsecond)
+{
+    const uint64_t end = virtualMicros + microsecond;
+    while (true)
+    {
+        const uint64_t due = SignalHostTimer::getNextDue();
+        if (due > end)
+        {
+            break;
+        }
+        virtualMicros = (due > virtualMicros) ? due : virtualMicros;
+        signalHostRunTimers();
+    }
+    virtualMicros = end;
+}
+
+static uint32_t pinChanges = 0;
+static uint8_t lastPin = 0xff;
+static bool lastOn = false;
+
+static void recordPin(const uint8_t pin, const bool on)
+{
+    pinChanges++;
+    lastPin = pin;
+    lastOn = on;
+}
+
+struct Counter
+{
+    uint32_t count;
+    SignalTimer* pTimer;
+};
+
+static void countTick(Counter* pCounter)
+{
+    pCounter->count++;
+}
+
+static void detachAtThree(Counter* pCounter)
+{
+    if (++pCounter->count == 3)
+    {
+        pCounter->pTimer->detach();
+    }
+}
+
+static uint32_t onceCount = 0;
+
+static void countOnce()
+{
+    onceCount++;
+}
+
+static void testClock()
+{
+    virtualMicros = 1234567;
+    CHECK_EQUAL(1234u, signalMillis());
+    CHECK_EQUAL(1234567u, signalMicros());
+    CHECK_EQUAL(1234u, millis());
+}
+
+static void testPins()
+{
+    signalHostPinHandler = recordPin;
+    pinChanges = 0;
+
+    signalWritePin(12, true);
+    CHECK_EQUAL(1u, pinChanges);
+    CHECK_EQUAL(12, lastPin);
+    CHECK(lastOn);
+
+    // Unchanged: not reported again.
+    signalWritePin(12, true);
+    CHECK_EQUAL(1u, pinChanges);
+
+    // Set 13, clear 12, 14 stays low.
+    signalWritePins((1UL << 12) | (1UL << 13) | (1UL << 14), 1UL << 13);
+    CHECK_EQUAL(3u, pinChanges);
+    CHECK_EQUAL((1UL << 13), signalHostPins & ((1UL << 12) | (1UL << 13) | (1UL << 14)));
+
+    pinMode(4, OUTPUT);
+    digitalWrite(4, HIGH);
+    CHECK_EQUAL(HIGH, digitalRead(4));
+    pinMode(5, INPUT_PULLUP);
+    CHECK_EQUAL(HIGH, digitalRead(5));
+    hostSetInput(5, false);
+    CHECK_EQUAL(LOW, digitalRead(5));
+
+    signalHostPinHandler = signalHostLogPin;
+}
+
+static void testTimers()
+{
+    virtualMicros = 0;
+
+    SignalTimer timer;
+    Counter counter = { 0, &timer };
+    timer.attach(10, countTick, &counter);
+
+    advance(9999);
+    CHECK_EQUAL(0u, counter.count);
+    advance(1);
+    CHECK_EQUAL(1u, counter.count);
+    advance(95000);
+    CHECK_EQUAL(10u, counter.count);
+
+    // A late runner is not caught up in a burst.
+    virtualMicros += 55000;
+    signalHostRunTimers();
+    CHECK_EQUAL(11u, counter.count);
+    advance(10000);
+    CHECK_EQUAL(12u, counter.count);
+
+    timer.detach();
+    advance(100000);
+    CHECK_EQUAL(12u, counter.count);
+
+    // Detaching itself from the callback.
+    SignalTimer selfDetaching;
+    Counter detaching = { 0, &selfDetaching };
+    selfDetaching.attach(5, detachAtThree, &detaching);
+    advance(100000);
+    CHECK_EQUAL(3u, detaching.count);
+    CHECK_EQUAL(UINT64_MAX, SignalHostTimer::getNextDue());
+
+    Ticker ticker;
+    ticker.once_ms(20, countOnce);
+    CHECK(ticker.active());
+    advance(100000);
+    CHECK_EQUAL(1u, onceCount);
+    CHECK(!ticker.active());
+}
+
+int main()
+{
+    signalHostClock = getVirtualMicros;
+
+    testClock();
+    testPins();
+    testTimers();
+
+    return hostTestResult("SignalHalTest");
+}
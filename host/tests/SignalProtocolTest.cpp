@@ -0,0 +1,375 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tests - Checks of the shared code, built natively.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Round trip, corruption and random input checks of SignalProtocol.h.
+// The random counts can be raised for a longer fuzz run: SignalProtocolTest <buffers>
+
+#include <SignalProtocol.h>
+
+#include <stdlib.h>
+
+#include "HostTest.h"
+
+////////////////////////////////////////////////
+
+// xorshift32, fixed seed so a failure repeats.
+static uint32_t randomState = 0x12345678;
+
+static uint32_t nextRandom()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static bool isValidCondition(const uint8_t condition)
+{
+    return (condition == 0) ||
+        (((condition & 0x80) != 0) &&
+         (SIGNAL_CONDITION_NODE(condition) < SignalNodeCount) &&
+         (SIGNAL_CONDITION_STATE(condition) < SignalStateCount));
+}
+
+// What decodeSignalMessage promises for anything it accepts.
+static bool isInRange(const SignalMessage& message)
+{
+    return (message.type < SignalMessageTypeCount) && (message.node < SignalNodeCount) &&
+        (message.state < SignalStateCount) && (message.command < SignalCommandCount) &&
+        ((message.flags & ~SIGNAL_FLAG_MASK) == 0) && isValidCondition(message.condition);
+}
+
+static bool isEqual(const SignalMessage& expected, const SignalMessage& actual)
+{
+    return (expected.type == actual.type) && (expected.node == actual.node) &&
+        (expected.state == actual.state) && (expected.command == actual.command) &&
+        (expected.flags == actual.flags) && (expected.condition == actual.condition) &&
+        (expected.remains == actual.remains) && (expected.sequence == actual.sequence);
+}
+
+////////////////////////////////////////////////
+
+static void testCrc()
+{
+    // CRC-16/CCITT-FALSE check value.
+    const char* pCheck = "123456789";
+    CHECK_EQUAL(0x29b1, calculateSignalCrc(reinterpret_cast<const uint8_t*>(pCheck), 9));
+}
+
+// Every combination of the enumerated fields, random remains and sequence.
+static void testRoundTrip()
+{
+    static const uint8_t conditions[] =
+    {
+        0,
+        SIGNAL_CONDITION(SignalNodeRoad, SignalStateStopped),
+        SIGNAL_CONDITION(SignalNodeRoad, SignalStateGoing),
+        SIGNAL_CONDITION(SignalNodeRoad, SignalStateTransition),
+        SIGNAL_CONDITION(SignalNodePedestrian, SignalStateStopped),
+        SIGNAL_CONDITION(SignalNodePedestrian, SignalStateGoing),
+        SIGNAL_CONDITION(SignalNodePedestrian, SignalStateTransition),
+    };
+
+    uint32_t count = 0;
+    for (uint8_t type = 0; type < SignalMessageTypeCount; type++)
+    for (uint8_t node = 0; node < SignalNodeCount; node++)
+    for (uint8_t state = 0; state < SignalStateCount; state++)
+    for (uint8_t command = 0; command < SignalCommandCount; command++)
+    for (uint8_t flags = 0; flags <= SIGNAL_FLAG_MASK; flags++)
+    for (const uint8_t condition : conditions)
+    {
+        const SignalMessage message =
+        {
+            type, node, state, command, flags, condition,
+            static_cast<uint16_t>(nextRandom()), nextRandom()
+        };
+
+        uint8_t frame[SIGNAL_MESSAGE_SIZE];
+        encodeSignalMessage(frame, message);
+
+        SignalMessage decoded;
+        CHECK(decodeSignalMessage(frame, sizeof frame, decoded));
+        CHECK(isEqual(message, decoded));
+
+        uint8_t again[SIGNAL_MESSAGE_SIZE];
+        encodeSignalMessage(again, decoded);
+        CHECK(memcmp(frame, again, sizeof frame) == 0);
+
+        // A frame of any other size is rejected, even with the right bytes in front.
+        uint8_t longer[SIGNAL_MESSAGE_SIZE + 1] = { 0 };
+        memcpy(longer, frame, sizeof frame);
+        CHECK(!decodeSignalMessage(longer, sizeof longer, decoded));
+        CHECK(!decodeSignalMessage(frame, sizeof frame - 1, decoded));
+        count++;
+    }
+    CHECK_EQUAL(3u * 2 * 3 * 3 * 4 * 7, count);
+
+    // The extremes of the numeric fields.
+    const SignalMessage extremes = { SignalMessagePlan, SignalNodePedestrian, SignalStateTransition,
+        SignalCommandGo, SIGNAL_FLAG_MASK, SIGNAL_CONDITION(SignalNodePedestrian, SignalStateTransition),
+        UINT16_MAX, UINT32_MAX };
+    uint8_t frame[SIGNAL_MESSAGE_SIZE];
+    encodeSignalMessage(frame, extremes);
+    SignalMessage decoded;
+    CHECK(decodeSignalMessage(frame, sizeof frame, decoded));
+    CHECK(isEqual(extremes, decoded));
+}
+
+// The CRC has a Hamming distance of 4 at this length: every 1 and 2 bit error is caught.
+static void testBitFlips()
+{
+    for (uint8_t round = 0; round < 16; round++)
+    {
+        const SignalMessage message =
+        {
+            static_cast<uint8_t>(nextRandom() % SignalMessageTypeCount),
+            static_cast<uint8_t>(nextRandom() % SignalNodeCount),
+            static_cast<uint8_t>(nextRandom() % SignalStateCount),
+            static_cast<uint8_t>(nextRandom() % SignalCommandCount),
+            static_cast<uint8_t>(nextRandom() & SIGNAL_FLAG_MASK),
+            0,
+            static_cast<uint16_t>(nextRandom()), nextRandom()
+        };
+        uint8_t frame[SIGNAL_MESSAGE_SIZE];
+        encodeSignalMessage(frame, message);
+
+        const uint32_t bits = SIGNAL_MESSAGE_SIZE * 8;
+        for (uint32_t first = 0; first < bits; first++)
+        {
+            uint8_t corrupted[SIGNAL_MESSAGE_SIZE];
+            memcpy(corrupted, frame, sizeof frame);
+            corrupted[first / 8] ^= static_cast<uint8_t>(1 << (first % 8));
+
+            SignalMessage decoded;
+            CHECK(!decodeSignalMessage(corrupted, sizeof corrupted, decoded));
+
+            for (uint32_t second = first + 1; second < bits; second++)
+            {
+                corrupted[second / 8] ^= static_cast<uint8_t>(1 << (second % 8));
+                CHECK(!decodeSignalMessage(corrupted, sizeof corrupted, decoded));
+                corrupted[second / 8] ^= static_cast<uint8_t>(1 << (second % 8));
+            }
+        }
+    }
+}
+
+// Fields out of range with a correct CRC are rejected as well.
+static void testOutOfRange()
+{
+    const SignalMessage message = { SignalMessageCommand, SignalNodeRoad, SignalStateStopped,
+        SignalCommandGo, 0, 0, 500, 1 };
+
+    for (uint8_t index = 2; index <= 7; index++)
+    {
+        for (uint16_t value = 0; value <= 0xff; value++)
+        {
+            uint8_t frame[SIGNAL_MESSAGE_SIZE];
+            encodeSignalMessage(frame, message);
+            frame[index] = static_cast<uint8_t>(value);
+            const uint16_t crc = calculateSignalCrc(frame, SIGNAL_MESSAGE_SIZE - 2);
+            frame[14] = static_cast<uint8_t>(crc >> 8);
+            frame[15] = static_cast<uint8_t>(crc);
+
+            bool valid = true;
+            switch (index)
+            {
+            case 2: valid = value < SignalMessageTypeCount; break;
+            case 3: valid = value < SignalNodeCount; break;
+            case 4: valid = value < SignalStateCount; break;
+            case 5: valid = value < SignalCommandCount; break;
+            case 6: valid = (value & ~SIGNAL_FLAG_MASK) == 0; break;
+            case 7: valid = isValidCondition(static_cast<uint8_t>(value)); break;
+            }
+
+            SignalMessage decoded;
+            CHECK_EQUAL(valid, decodeSignalMessage(frame, sizeof frame, decoded));
+        }
+    }
+
+    // A version 1 frame is dropped.
+    uint8_t frame[SIGNAL_MESSAGE_SIZE];
+    encodeSignalMessage(frame, message);
+    frame[1] = 1;
+    const uint16_t crc = calculateSignalCrc(frame, SIGNAL_MESSAGE_SIZE - 2);
+    frame[14] = static_cast<uint8_t>(crc >> 8);
+    frame[15] = static_cast<uint8_t>(crc);
+    SignalMessage decoded;
+    CHECK(!decodeSignalMessage(frame, sizeof frame, decoded));
+}
+
+// Random buffers: mostly noise, some with a valid header, CRC and near range fields, so
+// the field checks get exercised. Anything accepted is in range and encodes back to the same bytes.
+static void testRandomBuffers(const uint32_t buffers)
+{
+    uint32_t accepted = 0;
+    for (uint32_t index = 0; index < buffers; index++)
+    {
+        const size_t size = nextRandom() % 33;
+        uint8_t* pBuffer = static_cast<uint8_t*>(malloc((size > 0) ? size : 1));
+        for (size_t offset = 0; offset < size; offset++)
+        {
+            pBuffer[offset] = static_cast<uint8_t>(nextRandom());
+        }
+        if ((size == SIGNAL_MESSAGE_SIZE) && ((index & 1) == 0))
+        {
+            pBuffer[0] = SIGNAL_PROTOCOL_MAGIC;
+            pBuffer[1] = SIGNAL_PROTOCOL_VERSION;
+            for (size_t offset = 2; offset <= 6; offset++)
+            {
+                pBuffer[offset] &= 0x03;
+            }
+            pBuffer[7] &= 0xbf;
+            const uint16_t crc = calculateSignalCrc(pBuffer, SIGNAL_MESSAGE_SIZE - 2);
+            pBuffer[14] = static_cast<uint8_t>(crc >> 8);
+            pBuffer[15] = static_cast<uint8_t>(crc);
+        }
+
+        SignalMessage decoded;
+        if (decodeSignalMessage(pBuffer, size, decoded))
+        {
+            accepted++;
+            CHECK(isInRange(decoded));
+
+            uint8_t again[SIGNAL_MESSAGE_SIZE];
+            encodeSignalMessage(again, decoded);
+            CHECK(memcmp(pBuffer, again, SIGNAL_MESSAGE_SIZE) == 0);
+        }
+        free(pBuffer);
+    }
+
+    // Some valid frames come out of the forced headers, or the checks above prove nothing.
+    CHECK(accepted > 0);
+}
+
+////////////////////////////////////////////////
+
+// Text built from the batch tokens, so the random strings are near misses, not just noise.
+static void testRandomBatches(const uint32_t batches)
+{
+    static const char* const tokens[] =
+    {
+        "walk", "go", "stop", "query", "road", "pedestrian", "stopped", "going", "walking",
+        "transition", ",", ":", "=", "", "x", "Walk", " ",
+    };
+    const uint32_t tokenCount = sizeof tokens / sizeof tokens[0];
+
+    for (uint32_t index = 0; index < batches; index++)
+    {
+        char text[128] = "";
+        const uint32_t length = nextRandom() % 12;
+        for (uint32_t token = 0; token < length; token++)
+        {
+            strcat(text, tokens[nextRandom() % tokenCount]);
+        }
+
+        const uint8_t maxCount = static_cast<uint8_t>(1 + nextRandom() % 8);
+        const uint16_t wait = static_cast<uint16_t>(nextRandom());
+        SignalMessage commands[8 + 1];
+        memset(commands, 0xa5, sizeof commands);
+
+        const uint8_t count = parseSignalBatch(text, wait, commands, maxCount);
+        CHECK(count <= maxCount);
+        for (uint8_t command = 0; command < count; command++)
+        {
+            CHECK(isInRange(commands[command]));
+            CHECK_EQUAL(SignalMessageCommand, commands[command].type);
+            CHECK_EQUAL(wait, commands[command].remains);
+        }
+
+        // Nothing past maxCount is written.
+        const uint8_t* pGuard = reinterpret_cast<const uint8_t*>(&commands[maxCount]);
+        bool untouched = true;
+        for (size_t offset = 0; offset < sizeof(SignalMessage); offset++)
+        {
+            untouched = untouched && (pGuard[offset] == 0xa5);
+        }
+        CHECK(untouched);
+    }
+}
+
+// Valid batches built from random commands parse back to the same commands.
+static void testBatchRoundTrip()
+{
+    static const char* const commandNames[] = { "query", "stop", "walk" };
+    static const char* const nodeNames[] = { "road", "pedestrian" };
+    static const char* const stateNames[] = { "stopped", "walking", "transition" };
+
+    for (uint32_t round = 0; round < 10000; round++)
+    {
+        SignalMessage expected[8];
+        const uint8_t count = static_cast<uint8_t>(1 + nextRandom() % 8);
+        const uint16_t wait = static_cast<uint16_t>(nextRandom() % 65536);
+
+        char text[256] = "";
+        for (uint8_t index = 0; index < count; index++)
+        {
+            SignalMessage& command = expected[index];
+            memset(&command, 0, sizeof command);
+            command.type = SignalMessageCommand;
+            command.command = static_cast<uint8_t>(nextRandom() % SignalCommandCount);
+            command.remains = wait;
+
+            if (index > 0)
+            {
+                strcat(text, ",");
+            }
+            strcat(text, commandNames[command.command]);
+            if ((nextRandom() & 1) != 0)
+            {
+                const uint8_t node = static_cast<uint8_t>(nextRandom() % SignalNodeCount);
+                const uint8_t state = static_cast<uint8_t>(nextRandom() % SignalStateCount);
+                command.condition = SIGNAL_CONDITION(node, state);
+                strcat(text, ":");
+                strcat(text, nodeNames[node]);
+                strcat(text, "=");
+                strcat(text, stateNames[state]);
+            }
+        }
+
+        SignalMessage commands[8];
+        CHECK_EQUAL(count, parseSignalBatch(text, wait, commands, 8));
+        for (uint8_t index = 0; index < count; index++)
+        {
+            CHECK(isEqual(expected[index], commands[index]));
+        }
+    }
+
+    // One over the limit is rejected as a whole.
+    char text[] = "stop,walk,stop";
+    SignalMessage commands[2];
+    CHECK_EQUAL(0, parseSignalBatch(text, 0, commands, 2));
+}
+
+int main(int argc, char* argv[])
+{
+    const uint32_t buffers = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 1000000;
+
+    testCrc();
+    testRoundTrip();
+    testBitFlips();
+    testOutOfRange();
+    testRandomBuffers(buffers);
+    testRandomBatches(buffers / 4);
+    testBatchRoundTrip();
+
+    return hostTestResult("SignalProtocolTest");
+}
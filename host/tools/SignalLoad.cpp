@@ -0,0 +1,450 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// Host tools - Load generator for the HTTP API of the signal nodes.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Runs clients in parallel against a node, each one request at a time on a new connection
+// (the node closes every connection), the paths in turn. Reports per path the throughput,
+// p50/p99/p999 latency and the error rate, as text or as JSON to keep across versions.
+// The node's own /api/stats of the run is added to the JSON.
+//
+//   SignalLoad [--host 127.0.4.2] [--port 10080] [--concurrency 4] [--seconds 5]
+//              [--paths /api/status,/api/go,/api/stop] [--wait 0] [--json]
+//              [--max-error-rate <ratio>]
+//
+// Exits non-zero when a request failed below HTTP (refused, reset, timed out), or when
+// --max-error-rate is given and more requests than that failed or answered other than 200.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////
+
+#define LOAD_TIMEOUT 5000          // msec for a whole request
+#define LOAD_RESPONSE_SIZE 65536   // larger answers are cut, they still count
+
+struct Options
+{
+    std::string host = "127.0.4.2";
+    uint16_t port = 10080;
+    uint32_t concurrency = 4;
+    double seconds = 5;
+    std::vector<std::string> paths = { "/api/status", "/api/go", "/api/stop" };
+    double waitSeconds = 0;
+    bool json = false;
+    double maxErrorRate = -1;
+};
+
+struct Result
+{
+    int status;                 // HTTP status, 0 when the request failed below HTTP
+    std::string body;
+};
+
+// Per path, each client has its own so nothing is shared while running.
+struct Counters
+{
+    std::vector<uint32_t> latencies;    // usec of the requests answered
+    uint32_t errors = 0;                // answered other than 200
+    uint32_t failures = 0;              // not answered
+};
+
+static uint64_t getMonotonicMicros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + static_cast<uint64_t>(now.tv_nsec / 1000);
+}
+
+static std::vector<std::string> split(const std::string& text, const char separator)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        const size_t end = std::min(text.find(separator, start), text.size());
+        if (end > start)
+        {
+            parts.push_back(text.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return parts;
+}
+
+////////////////////////////////////////////////
+
+// Waits for the socket until the deadline, false on timeout.
+static bool waitFor(const int fd, const short events, const uint64_t deadline)
+{
+    const uint64_t now = getMonotonicMicros();
+    if (now >= deadline)
+    {
+        return false;
+    }
+    pollfd entry = { fd, events, 0 };
+    return poll(&entry, 1, static_cast<int>((deadline - now + 999) / 1000)) > 0;
+}
+
+// True once text holds the whole answer: the head and Content-Length bytes, or the last
+// chunk. Without either the answer ends with the connection.
+static bool isComplete(const std::string& text)
+{
+    const size_t headEnd = text.find("\r\n\r\n");
+    if (headEnd == std::string::npos)
+    {
+        return false;
+    }
+
+    const std::string head = text.substr(0, headEnd + 2);
+    const size_t length = head.find("Content-Length: ");
+    if (length != std::string::npos)
+    {
+        return text.size() >= (headEnd + 4 + strtoul(head.c_str() + length + 16, nullptr, 10));
+    }
+    if (head.find("Transfer-Encoding: chunked") != std::string::npos)
+    {
+        return (text.size() >= (headEnd + 9)) && (text.compare(text.size() - 5, 5, "0\r\n\r\n") == 0);
+    }
+    return false;
+}
+
+// One GET on a new connection, read to the end of the answer, then closed by us as
+// browsers and curl do: the ESP8266 server waits for the client to close.
+static Result get(const sockaddr_in& address, const std::string& host, const std::string& path)
+{
+    Result result = { 0, std::string() };
+    const uint64_t deadline = getMonotonicMicros() + LOAD_TIMEOUT * 1000ULL;
+
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        return result;
+    }
+    const int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+
+    if ((connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) && (errno != EINPROGRESS))
+    {
+        close(fd);
+        return result;
+    }
+    if (!waitFor(fd, POLLOUT, deadline))
+    {
+        close(fd);
+        return result;
+    }
+    int error = 0;
+    socklen_t errorSize = sizeof error;
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorSize);
+    if (error != 0)
+    {
+        close(fd);
+        return result;
+    }
+
+    const std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+    size_t sent = 0;
+    while (sent < request.size())
+    {
+        const ssize_t size = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (size > 0)
+        {
+            sent += static_cast<size_t>(size);
+        }
+        else if ((size < 0) && (errno == EAGAIN) && waitFor(fd, POLLOUT, deadline))
+        {
+            continue;
+        }
+        else
+        {
+            close(fd);
+            return result;
+        }
+    }
+
+    std::string response;
+    char buffer[4096];
+    while (!isComplete(response))
+    {
+        const ssize_t size = recv(fd, buffer, sizeof buffer, 0);
+        if (size > 0)
+        {
+            if (response.size() < LOAD_RESPONSE_SIZE)
+            {
+                response.append(buffer, static_cast<size_t>(size));
+            }
+        }
+        else if (size == 0)
+        {
+            break;
+        }
+        else if ((errno != EAGAIN) || !waitFor(fd, POLLIN, deadline))
+        {
+            close(fd);
+            return result;
+        }
+    }
+    close(fd);
+
+    // "HTTP/1.1 200 OK"
+    int status = 0;
+    if ((sscanf(response.c_str(), "HTTP/%*d.%*d %d", &status) != 1) || (status <= 0))
+    {
+        return result;
+    }
+    result.status = status;
+
+    const size_t head = response.find("\r\n\r\n");
+    result.body = (head != std::string::npos) ? response.substr(head + 4) : std::string();
+    return result;
+}
+
+////////////////////////////////////////////////
+
+static uint32_t getPercentile(std::vector<uint32_t>& sorted, const uint32_t perMille)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    const size_t rank = (sorted.size() * perMille + 999) / 1000;
+    return sorted[(rank > 0) ? (rank - 1) : 0];
+}
+
+static bool parseOptions(const int argc, char* argv[], Options& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        const std::string name = argv[index];
+        const char* pValue = ((index + 1) < argc) ? argv[index + 1] : nullptr;
+        if (name == "--json")
+        {
+            options.json = true;
+            continue;
+        }
+        if (pValue == nullptr)
+        {
+            return false;
+        }
+        index++;
+
+        if (name == "--host")
+        {
+            options.host = pValue;
+        }
+        else if (name == "--port")
+        {
+            options.port = static_cast<uint16_t>(strtoul(pValue, nullptr, 10));
+        }
+        else if (name == "--concurrency")
+        {
+            options.concurrency = static_cast<uint32_t>(strtoul(pValue, nullptr, 10));
+        }
+        else if (name == "--seconds")
+        {
+            options.seconds = strtod(pValue, nullptr);
+        }
+        else if (name == "--paths")
+        {
+            options.paths = split(pValue, ',');
+        }
+        else if (name == "--wait")
+        {
+            options.waitSeconds = strtod(pValue, nullptr);
+        }
+        else if (name == "--max-error-rate")
+        {
+            options.maxErrorRate = strtod(pValue, nullptr);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return (options.port != 0) && (options.concurrency != 0) && (options.seconds > 0) && !options.paths.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [--host address] [--port port] [--concurrency clients] [--seconds seconds]\n"
+            "    [--paths path,...] [--wait seconds] [--json] [--max-error-rate ratio]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid host %s.\n", options.host.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // A node just started may not listen yet.
+    const uint64_t waitUntil = getMonotonicMicros() + static_cast<uint64_t>(options.waitSeconds * 1000000);
+    Result stats = get(address, options.host, "/api/stats?reset");
+    while ((stats.status == 0) && (getMonotonicMicros() < waitUntil))
+    {
+        usleep(100000);
+        stats = get(address, options.host, "/api/stats?reset");
+    }
+    if (stats.status == 0)
+    {
+        fprintf(stderr, "No answer from %s:%u.\n", options.host.c_str(), options.port);
+        return EXIT_FAILURE;
+    }
+
+    const size_t pathCount = options.paths.size();
+    std::vector<std::vector<Counters>> clients(options.concurrency, std::vector<Counters>(pathCount));
+    std::atomic<bool> running(true);
+
+    const uint64_t startedAt = getMonotonicMicros();
+    std::vector<std::thread> threads;
+    for (uint32_t client = 0; client < options.concurrency; client++)
+    {
+        threads.emplace_back([&, client]()
+        {
+            // Each client starts on another path, so the mix is even from the start.
+            size_t path = client % pathCount;
+            while (running.load(std::memory_order_relaxed))
+            {
+                Counters& counters = clients[client][path];
+                const uint64_t requestedAt = getMonotonicMicros();
+                const Result result = get(address, options.host, options.paths[path]);
+                if (result.status == 0)
+                {
+                    counters.failures++;
+                }
+                else
+                {
+                    counters.latencies.push_back(static_cast<uint32_t>(getMonotonicMicros() - requestedAt));
+                    counters.errors += (result.status != 200) ? 1 : 0;
+                }
+                path = (path + 1) % pathCount;
+            }
+        });
+    }
+
+    usleep(static_cast<useconds_t>(options.seconds * 1000000));
+    running = false;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const double elapsed = static_cast<double>(getMonotonicMicros() - startedAt) / 1000000;
+
+    stats = get(address, options.host, "/api/stats");
+    const bool hasStats = (stats.status == 200) && !stats.body.empty() && (stats.body[0] == '{');
+
+    // Merged per path, then the totals.
+    uint64_t totalCount = 0;
+    uint64_t totalErrors = 0;
+    uint64_t totalFailures = 0;
+    std::string routes;
+    std::string text;
+    for (size_t path = 0; path < pathCount; path++)
+    {
+        Counters merged;
+        for (const auto& client : clients)
+        {
+            merged.latencies.insert(merged.latencies.end(), client[path].latencies.begin(), client[path].latencies.end());
+            merged.errors += client[path].errors;
+            merged.failures += client[path].failures;
+        }
+        std::sort(merged.latencies.begin(), merged.latencies.end());
+
+        const uint64_t count = merged.latencies.size() + merged.failures;
+        const uint32_t errors = merged.errors + merged.failures;
+        const double errorRate = (count != 0) ? static_cast<double>(errors) / count : 0;
+        const double throughput = count / elapsed;
+        const uint32_t p50 = getPercentile(merged.latencies, 500);
+        const uint32_t p99 = getPercentile(merged.latencies, 990);
+        const uint32_t p999 = getPercentile(merged.latencies, 999);
+        const uint32_t max = merged.latencies.empty() ? 0 : merged.latencies.back();
+        totalCount += count;
+        totalErrors += errors;
+        totalFailures += merged.failures;
+
+        char line[512];
+        snprintf(line, sizeof line,
+            "%s{\"path\":\"%s\",\"count\":%llu,\"errors\":%u,\"failures\":%u,\"errorRate\":%.6f,"
+            "\"throughput\":%.1f,\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}",
+            (path == 0) ? "" : ",", options.paths[path].c_str(), static_cast<unsigned long long>(count),
+            errors, merged.failures, errorRate, throughput, p50, p99, p999, max);
+        routes += line;
+
+        snprintf(line, sizeof line,
+            "%-16s %8llu req %9.1f req/s  errors %6.2f%% (%u failed)  p50 %7uus  p99 %7uus  p999 %7uus  max %7uus\n",
+            options.paths[path].c_str(), static_cast<unsigned long long>(count), throughput,
+            errorRate * 100, merged.failures, p50, p99, p999, max);
+        text += line;
+    }
+    const double totalErrorRate = (totalCount != 0) ? static_cast<double>(totalErrors) / totalCount : 0;
+
+    if (options.json)
+    {
+        printf("{\"host\":\"%s\",\"port\":%u,\"concurrency\":%u,\"elapsed\":%.3f,\"count\":%llu,\"errors\":%llu,"
+            "\"failures\":%llu,\"errorRate\":%.6f,\"throughput\":%.1f,\"routes\":[%s],\"node\":%s}\n",
+            options.host.c_str(), options.port, options.concurrency, elapsed,
+            static_cast<unsigned long long>(totalCount), static_cast<unsigned long long>(totalErrors),
+            static_cast<unsigned long long>(totalFailures), totalErrorRate, totalCount / elapsed,
+            routes.c_str(), hasStats ? stats.body.c_str() : "null");
+    }
+    else
+    {
+        printf("%s:%u, %u clients, %.1f sec: %llu requests, %.1f req/s, errors %.2f%%\n%s",
+            options.host.c_str(), options.port, options.concurrency, elapsed,
+            static_cast<unsigned long long>(totalCount), totalCount / elapsed, totalErrorRate * 100, text.c_str());
+        if (hasStats)
+        {
+            printf("node: %s\n", stats.body.c_str());
+        }
+    }
+
+    if (totalFailures != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if ((options.maxErrorRate >= 0) && (totalErrorRate > options.maxErrorRate))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
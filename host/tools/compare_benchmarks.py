@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+# Cost per call and allocations per call of two benchmark runs, matched by name.
+# Takes either kind of result, the same kind on both sides:
+#   host:   Google Benchmark --benchmark_format=json (or --benchmark_out) of build/host/benchmarks/*,
+#           time per call and the allocs/allocBytes counters of AllocationCounter.h.
+#   device: the serial log of a BENCHMARK_ON_BOOT build, one JSON line per result
+#           (SignalBenchmark.h), other lines are skipped. Heap is the free heap lost per call.
+# Exits with 1 if a call got slower than --threshold percent or allocates more.
+#   compare_benchmarks.py <baseline> <candidate> [--threshold <percent>] [--json]
+
+import argparse
+import json
+import sys
+
+TIME_UNITS = {'ns': 1.0, 'us': 1e3, 'ms': 1e6, 's': 1e9}
+
+
+def load_host(document):
+    benchmarks = document['benchmarks']
+    # With --benchmark_repetitions the median stands for the run.
+    medians = {benchmark['run_name'] for benchmark in benchmarks if benchmark.get('aggregate_name') == 'median'}
+    results = {}
+    for benchmark in benchmarks:
+        name = benchmark.get('run_name', benchmark['name'])
+        if name in medians:
+            if benchmark.get('aggregate_name') != 'median':
+                continue
+        elif benchmark.get('run_type') == 'aggregate':
+            continue
+        results[name] = {
+            'nsec': benchmark['cpu_time'] * TIME_UNITS[benchmark['time_unit']],
+            'allocs': benchmark.get('allocs'),
+            'bytes': benchmark.get('allocBytes'),
+        }
+    return results
+
+
+def load_device(lines):
+    results = {}
+    for line in lines:
+        line = line.strip()
+        if not line.startswith('{'):
+            continue
+        try:
+            result = json.loads(line)
+        except ValueError:
+            continue
+        if 'suite' not in result or 'name' not in result:
+            continue
+        # The fastest of repeated boots, as SignalBenchmark keeps the fastest batch.
+        name = result['suite'] + '/' + result['name']
+        if name in results and results[name]['nsec'] <= result['nsec']:
+            continue
+        results[name] = {'nsec': float(result['nsec']), 'allocs': None, 'bytes': float(result['heap'])}
+    return results
+
+
+def load(path):
+    with open(path) as file:
+        text = file.read()
+    try:
+        document = json.loads(text)
+    except ValueError:
+        document = None
+    if isinstance(document, dict) and 'benchmarks' in document:
+        return 'host', load_host(document)
+    results = load_device(text.splitlines())
+    if not results:
+        sys.exit(f'{path}: neither Google Benchmark JSON nor SignalBenchmark lines.')
+    return 'device', results
+
+
+def change(old, new):
+    if old is None or new is None:
+        return None
+    if old == 0:
+        return 0.0 if new == 0 else float('inf')
+    return (new - old) * 100.0 / old
+
+
+def number(value, digits=1):
+    return '-' if value is None else f'{value:.{digits}f}'
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('baseline')
+    parser.add_argument('candidate')
+    parser.add_argument('--threshold', type=float, default=10.0, help='slowdown in percent to fail on')
+    parser.add_argument('--json', action='store_true')
+    options = parser.parse_args()
+
+    baseKind, base = load(options.baseline)
+    kind, candidate = load(options.candidate)
+    if baseKind != kind:
+        sys.exit(f'{options.baseline} is a {baseKind} run, {options.candidate} a {kind} run.')
+
+    rows = []
+    failed = False
+    for name in sorted(set(base) | set(candidate)):
+        old = base.get(name)
+        new = candidate.get(name)
+        row = {'name': name}
+        if old is not None:
+            row['baseline'] = old
+        if new is not None:
+            row['candidate'] = new
+        if old is not None and new is not None:
+            row['change'] = change(old['nsec'], new['nsec'])
+            # Below a nanosecond the host timing is noise, only allocations count there.
+            slower = (row['change'] > options.threshold) and (new['nsec'] - old['nsec'] >= 1.0)
+            allocates = any((new[key] or 0) > (old[key] or 0) + 1e-6 for key in ('allocs', 'bytes'))
+            row['regressed'] = slower or allocates
+            failed = failed or row['regressed']
+        rows.append(row)
+
+    if options.json:
+        print(json.dumps({'kind': kind, 'threshold': options.threshold, 'regressed': failed, 'results': rows}))
+        return 1 if failed else 0
+
+    bytesName = 'allocBytes' if kind == 'host' else 'heap'
+    print(f'{kind} run, {options.baseline} -> {options.candidate}, nsec and {bytesName} per call')
+    width = max([len(row['name']) for row in rows] + [4])
+    print(f'{"name":<{width}}{"nsec":>22}{"change":>10}{"allocs":>14}{bytesName:>18}')
+    for row in rows:
+        old = row.get('baseline', {})
+        new = row.get('candidate', {})
+        nsec = f'{number(old.get("nsec"))} -> {number(new.get("nsec"))}'
+        allocs = f'{number(old.get("allocs"), 2)} -> {number(new.get("allocs"), 2)}'
+        bytes = f'{number(old.get("bytes"), 0)} -> {number(new.get("bytes"), 0)}'
+        percent = '' if row.get('change') is None else f'{row["change"]:+.1f}%'
+        mark = '  <<' if row.get('regressed') else ''
+        print(f'{row["name"]:<{width}}{nsec:>22}{percent:>10}{allocs:>14}{bytes:>18}{mark}')
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+# Code and data size of the table driven signal heads against the hand written controllers.
+# Objects built natively with -Os, two rows per head:
+#   machine: the state machine only, SignalHeadMachine<Head> against host/legacy.
+#   sketch:  Main.cpp and the head tables now against the Main.cpp before
+#            SignalNodeController.h and its library (from git), which includes what the
+#            nodes gained since, e.g. trace and metrics.
+# text is code and constants (flash on the node), data + bss is RAM. The numbers are x86-64,
+# the Arduino IDE prints the node's own after a build.
+#   compare_sizes.py [--revision <commit>] [--json]
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+HEADS = {
+    'RoadSignal': 'LegacyRoadSignal',
+    'PedestrianSignal': 'LegacyPedestrianSignal',
+}
+
+MACHINE = '''
+#include <{include}>
+{declaration}
+Machine machine;
+extern "C" void headBegin() {{ machine.begin(); }}
+extern "C" void headApply(const uint8_t command) {{ machine.apply(command); }}
+extern "C" void headTick() {{ machine.tick(); }}
+extern "C" String headStatusText() {{ return machine.getStatusText(); }}
+extern "C" int headState() {{ return machine.getSignalState(); }}
+extern "C" uint16_t headRemainsTicks() {{ return machine.getRemainsTicks(); }}
+'''
+
+
+def compile_size(source, include_dirs, work):
+    obj = os.path.join(work, 'object.o')
+    command = [os.environ.get('CXX', 'c++'), '-std=c++17', '-Os', '-DSIGNAL_HAL_POSIX', '-c', source, '-o', obj]
+    for directory in include_dirs:
+        command += ['-I', directory]
+    subprocess.run(command, check=True)
+    output = subprocess.run(['size', obj], check=True, capture_output=True, text=True).stdout
+    text, data, bss = (int(value) for value in output.splitlines()[1].split()[:3])
+    return {'text': text, 'data': data, 'bss': bss}
+
+
+def total_size(sources, include_dirs, work):
+    sizes = [compile_size(source, include_dirs, work) for source in sources]
+    return {key: sum(size[key] for size in sizes) for key in ('text', 'data', 'bss')}
+
+
+def default_revision():
+    added = subprocess.run(
+        ['git', 'log', '--diff-filter=A', '--format=%H', '--', 'libraries/SignalCommon/SignalNodeController.h'],
+        cwd=ROOT, check=True, capture_output=True, text=True).stdout.split()
+    if not added:
+        sys.exit('SignalNodeController.h has no history, give --revision.')
+    return added[-1] + '^'
+
+
+def git_show(revision, path):
+    return subprocess.run(['git', 'show', f'{revision}:{path}'], cwd=ROOT, check=True,
+                          capture_output=True, text=True).stdout
+
+
+def git_export(revision, path, directory):
+    archive = subprocess.run(['git', 'archive', revision, path], cwd=ROOT, check=True, capture_output=True).stdout
+    subprocess.run(['tar', '-x', '-C', directory], input=archive, check=True)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--revision', help='commit with the hand written controllers')
+    parser.add_argument('--json', action='store_true')
+    options = parser.parse_args()
+    revision = options.revision or default_revision()
+
+    core = [os.path.join(ROOT, 'host', 'core'), os.path.join(ROOT, 'libraries', 'SignalCommon')]
+    legacy = os.path.join(ROOT, 'host', 'legacy')
+    results = []
+    with tempfile.TemporaryDirectory() as work:
+        # The old sketches build on the library of their own revision, with today's
+        # SignalHal.h: the host backend came later.
+        git_export(revision, 'libraries/SignalCommon', work)
+        old_library = os.path.join(work, 'libraries', 'SignalCommon')
+        shutil.copy(os.path.join(core[1], 'SignalHal.h'), old_library)
+        old_core = [core[0], old_library]
+        for sketch, legacy_class in HEADS.items():
+            sketch_dir = os.path.join(ROOT, 'MatrixSignalController', sketch)
+
+            # The head's tables are in its own source file.
+            head_source = os.path.join(sketch_dir, f'{sketch}Head.cpp')
+            variants = {
+                'generated': (f'{sketch}Head.h', f'typedef SignalHeadMachine<{sketch}Head> Machine;', [head_source]),
+                'legacy': (f'{legacy_class}.h', f'typedef {legacy_class} Machine;', []),
+            }
+            sizes = {}
+            for variant, (include, declaration, sources) in variants.items():
+                source = os.path.join(work, f'{variant}.cpp')
+                with open(source, 'w') as file:
+                    # Config.h first, the legacy headers take their pins from it.
+                    file.write('#include <Arduino.h>\n#include "Config.h"\n')
+                    file.write(MACHINE.format(include=include, declaration=declaration))
+                sizes[variant] = total_size([source] + sources, core + [sketch_dir, legacy], work)
+            results.append({'head': sketch, 'part': 'machine', **sizes})
+
+            old_dir = os.path.join(work, 'old', sketch)
+            os.makedirs(old_dir)
+            for name in ('Main.cpp', 'Config.h'):
+                with open(os.path.join(old_dir, name), 'w') as file:
+                    file.write(git_show(revision, f'MatrixSignalController/{sketch}/{name}'))
+            results.append({
+                'head': sketch,
+                'part': 'sketch',
+                'generated': total_size([os.path.join(sketch_dir, 'Main.cpp'), head_source], core + [sketch_dir], work),
+                'legacy': compile_size(os.path.join(old_dir, 'Main.cpp'), old_core + [old_dir], work),
+            })
+
+    if options.json:
+        print(json.dumps({'revision': revision, 'results': results}))
+        return
+
+    print(f'legacy: {revision}, x86-64 -Os objects, text = flash, data + bss = RAM')
+    print(f'{"head":<18}{"part":<9}{"text":>22}{"data":>18}{"bss":>20}')
+    for result in results:
+        columns = []
+        for key in ('text', 'data', 'bss'):
+            old, new = result['legacy'][key], result['generated'][key]
+            columns.append(f'{old}->{new} ({new - old:+d})')
+        print(f'{result["head"]:<18}{result["part"]:<9}{columns[0]:>22}{columns[1]:>18}{columns[2]:>20}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Smoke test of the load generator: RoadSignal on loopback, then SignalLoad against it.
+#   load_smoke.sh <RoadSignal> <SignalLoad>
+set -e
+
+ROAD_SIGNAL=$1
+SIGNAL_LOAD=$2
+OFFSET=28000    # away from a manual run on the default offset
+
+SIGNAL_HOST_PORT_OFFSET=$OFFSET SIGNAL_HOST_RUN_SECONDS=30 "$ROAD_SIGNAL" >/dev/null 2>&1 &
+NODE=$!
+trap 'kill $NODE 2>/dev/null' EXIT
+
+"$SIGNAL_LOAD" --host 127.0.4.2 --port $((OFFSET + 80)) --wait 5 --concurrency 4 --seconds 1 \
+    --paths /api/status --max-error-rate 0
+"$SIGNAL_LOAD" --host 127.0.4.2 --port $((OFFSET + 80)) --concurrency 8 --seconds 2 --json
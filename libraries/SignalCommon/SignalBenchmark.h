@@ -0,0 +1,99 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_BENCHMARK_H
+#define SIGNAL_BENCHMARK_H
+
+#include <Arduino.h>
+
+#include "SignalHal.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_BENCHMARK_ROUNDS 5   // batches per function, the fastest one is reported
+
+// On-device microbenchmarks of the control path, run once from setup() when enabled.
+// Each function is called once to warm the flash cache, then in batches timed by the
+// CPU cycle counter. The fastest batch counts, so an interrupt or a cache miss in one
+// batch doesn't. Heap is the free heap lost per call over all batches: nonzero when
+// a call keeps or leaks memory. Each result is one JSON line:
+//   {"suite":"RoadSignal","name":"getStatusText","calls":1000,"cycles":412,"nsec":5150,"heap":0}
+// host/tools/compare_benchmarks.py compares the serial logs of two builds.
+class SignalBenchmark
+{
+private:
+    Print* pOutput;
+    const char* pSuite;
+
+public:
+    SignalBenchmark(Print* pOutput, const char* pSuite)
+        : pOutput(pOutput), pSuite(pSuite)
+    {
+    }
+
+    // Keep a result alive, so the call producing it isn't optimized away.
+    template <typename T>
+    static void keep(const T& value)
+    {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    // A batch must stay well below the cycle counter wrap (53sec at 80MHz).
+    template <typename Body>
+    void run(const char* pName, const uint16_t calls, Body body)
+    {
+        body();
+
+        const uint32_t heapBefore = signalFreeHeap();
+        uint32_t best = UINT32_MAX;
+        for (uint8_t round = 0; round < SIGNAL_BENCHMARK_ROUNDS; round++)
+        {
+            const uint32_t start = signalCycles();
+            for (uint16_t call = 0; call < calls; call++)
+            {
+                body();
+            }
+            const uint32_t elapsed = signalCycles() - start;
+            if (elapsed < best)
+            {
+                best = elapsed;
+            }
+
+            signalYield();
+        }
+        const int32_t heap = static_cast<int32_t>(heapBefore - signalFreeHeap()) /
+            (static_cast<int32_t>(calls) * SIGNAL_BENCHMARK_ROUNDS);
+
+        const uint32_t cycles = best / calls;
+        const uint32_t nsec = static_cast<uint32_t>(
+            static_cast<uint64_t>(best) * 1000 / (static_cast<uint64_t>(signalCpuMHz()) * calls));
+
+        char line[160];
+        snprintf(line, sizeof line,
+            "{\"suite\":\"%s\",\"name\":\"%s\",\"calls\":%u,\"cycles\":%lu,\"nsec\":%lu,\"heap\":%ld}",
+            pSuite, pName, static_cast<unsigned int>(calls),
+            static_cast<unsigned long>(cycles), static_cast<unsigned long>(nsec), static_cast<long>(heap));
+        pOutput->println(line);
+    }
+};
+
+#endif
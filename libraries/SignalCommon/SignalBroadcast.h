@@ -0,0 +1,384 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_BROADCAST_H
+#define SIGNAL_BROADCAST_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "SignalHal.h"
+#include "SignalProtocol.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_BROADCAST_PORT 4210        // UDP port on the AP subnet, status messages
+#define SIGNAL_COMMAND_PORT 4211          // UDP port of each node, command messages
+#define SIGNAL_BROADCAST_HEARTBEAT 1000   // msec, resend the current state when nothing changed
+#define SIGNAL_BROADCAST_TIMEOUT 3500     // msec without status before a node is polled again
+#define SIGNAL_REGISTRY_SIZE 32           // signal heads known to a listener
+
+////////////////////////////////////////////////
+
+// Signal node side: broadcasts every state change at once and a heartbeat otherwise,
+// and takes command datagrams on its own port, each answered with a status to the sender.
+// Call from loop(), not from a Ticker callback, the network stack isn't reentrant.
+class SignalStateBroadcaster
+{
+private:
+    WiFiUDP udp;
+    SignalMessage status;
+    uint8_t synchronized;     // SIGNAL_FLAG_SYNCHRONIZED or 0
+    uint32_t lastSent;
+
+    void send(const IPAddress& address, const uint16_t port)
+    {
+        uint8_t packet[SIGNAL_MESSAGE_SIZE];
+        encodeSignalMessage(packet, status);
+
+        udp.beginPacket(address, port);
+        udp.write(packet, sizeof packet);
+        udp.endPacket();
+    }
+
+    void broadcast()
+    {
+        send(WiFi.broadcastIP(), SIGNAL_BROADCAST_PORT);
+        lastSent = signalMillis();
+    }
+
+public:
+    SignalStateBroadcaster()
+        : synchronized(0), lastSent(0)
+    {
+        memset(&status, 0, sizeof status);
+    }
+
+    void begin(const SignalNodes node, const SignalStates state)
+    {
+        status.type = SignalMessageStatus;
+        status.node = node;
+        status.state = state;
+        udp.begin(SIGNAL_COMMAND_PORT);
+        broadcast();
+    }
+
+    // Told to the listeners by every following status.
+    void setSynchronized(const bool value)
+    {
+        synchronized = value ? SIGNAL_FLAG_SYNCHRONIZED : 0;
+    }
+
+    void update(const SignalStates state, const uint16_t remains)
+    {
+        status.remains = remains;
+        if (state != status.state)
+        {
+            status.state = state;
+            status.flags = SIGNAL_FLAG_TRANSITION | synchronized;
+            status.sequence++;
+            broadcast();
+        }
+        else if ((signalMillis() - lastSent) >= SIGNAL_BROADCAST_HEARTBEAT)
+        {
+            status.flags = synchronized;
+            broadcast();
+        }
+    }
+
+    // Next queued datagram of command or plan messages, returns their count or 0 if there is none.
+    // A datagram is taken whole or not at all, so a batch is never applied partially,
+    // and all its messages have the type of the first one.
+    uint8_t receive(SignalMessage* pCommands, const uint8_t maxCount)
+    {
+        while (true)
+        {
+            const int size = udp.parsePacket();
+            if (size <= 0)
+            {
+                return 0;
+            }
+
+            const uint8_t count = static_cast<uint8_t>(size / SIGNAL_MESSAGE_SIZE);
+            bool valid = ((size % SIGNAL_MESSAGE_SIZE) == 0) && (count >= 1) && (count <= maxCount);
+            for (uint8_t index = 0; valid && (index < count); index++)
+            {
+                uint8_t packet[SIGNAL_MESSAGE_SIZE];
+                SignalMessage& command = pCommands[index];
+                valid = (udp.read(packet, sizeof packet) == SIGNAL_MESSAGE_SIZE) &&
+                    decodeSignalMessage(packet, sizeof packet, command) &&
+                    ((command.type == SignalMessageCommand) || (command.type == SignalMessagePlan)) &&
+                    (command.type == pCommands[0].type) && (command.node == status.node);
+            }
+            if (valid)
+            {
+                return count;
+            }
+            udp.flush();
+        }
+    }
+
+    // Answer the last received command with the given state.
+    void reply(const SignalStates state, const uint16_t remains)
+    {
+        update(state, remains);
+        status.flags = synchronized;
+        send(udp.remoteIP(), udp.remotePort());
+    }
+};
+
+// Registry of the signal heads by address, each in a group (SignalNodes).
+// The static table comes from add(), every status heard also announces its sender,
+// so heads can join without being listed. A group is seen as the combination of its
+// members: alive while all are, in a state only when all agree on it.
+class SignalStateListener
+{
+private:
+    struct NodeState
+    {
+        uint32_t address;
+        uint8_t group;
+        uint8_t state;
+        uint8_t flags;
+        uint16_t remains;
+        uint32_t sequence;
+        uint32_t receivedAt;
+        bool valid;
+    };
+
+    WiFiUDP udp;
+    NodeState nodes[SIGNAL_REGISTRY_SIZE];
+    uint8_t nodeCount;
+
+    int find(const uint32_t address) const
+    {
+        for (uint8_t index = 0; index < nodeCount; index++)
+        {
+            if (nodes[index].address == address)
+            {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    bool isAlive(const NodeState& node) const
+    {
+        return node.valid && ((signalMillis() - node.receivedAt) < SIGNAL_BROADCAST_TIMEOUT);
+    }
+
+    // Alive flag and combined state of every group, to tell what poll() changed.
+    uint8_t getSummary(const SignalNodes group) const
+    {
+        return isAlive(group) ? (0x80 | getState(group)) : 0;
+    }
+
+public:
+    SignalStateListener()
+        : nodeCount(0)
+    {
+        memset(nodes, 0, sizeof nodes);
+    }
+
+    void begin()
+    {
+        udp.begin(SIGNAL_BROADCAST_PORT);
+    }
+
+    // Registers a head of the static table, false if the registry is full.
+    bool add(const IPAddress& address, const SignalNodes group)
+    {
+        const int index = find(static_cast<uint32_t>(address));
+        if (index >= 0)
+        {
+            nodes[index].group = group;
+            return true;
+        }
+        if (nodeCount >= SIGNAL_REGISTRY_SIZE)
+        {
+            return false;
+        }
+
+        NodeState& node = nodes[nodeCount++];
+        memset(&node, 0, sizeof node);
+        node.address = static_cast<uint32_t>(address);
+        node.group = group;
+        return true;
+    }
+
+    // Takes a status from the broadcast or an answer to a command, false if the registry is full.
+    bool update(const IPAddress& address, const SignalMessage& message)
+    {
+        int index = find(static_cast<uint32_t>(address));
+        if (index < 0)
+        {
+            if (!add(address, static_cast<SignalNodes>(message.node)))
+            {
+                return false;
+            }
+            index = nodeCount - 1;
+        }
+
+        // Older sequences are reordered datagrams, unless the node went silent (rebooted).
+        NodeState& node = nodes[index];
+        if (isAlive(node) && (static_cast<int32_t>(message.sequence - node.sequence) < 0))
+        {
+            return true;
+        }
+
+        node.group = message.node;
+        node.state = message.state;
+        node.flags = message.flags;
+        node.remains = message.remains;
+        node.sequence = message.sequence;
+        node.receivedAt = signalMillis();
+        node.valid = true;
+        return true;
+    }
+
+    // Read all queued status messages, true if any group changed its state.
+    bool poll()
+    {
+        uint8_t before[SignalNodeCount];
+        for (uint8_t group = 0; group < SignalNodeCount; group++)
+        {
+            before[group] = getSummary(static_cast<SignalNodes>(group));
+        }
+
+        while (true)
+        {
+            const int size = udp.parsePacket();
+            if (size <= 0)
+            {
+                break;
+            }
+
+            uint8_t packet[SIGNAL_MESSAGE_SIZE];
+            SignalMessage message;
+            if ((size != SIGNAL_MESSAGE_SIZE) ||
+                (udp.read(packet, sizeof packet) != SIGNAL_MESSAGE_SIZE) ||
+                !decodeSignalMessage(packet, size, message) ||
+                (message.type != SignalMessageStatus))
+            {
+                udp.flush();
+                continue;
+            }
+
+            update(udp.remoteIP(), message);
+        }
+
+        bool changed = false;
+        for (uint8_t group = 0; group < SignalNodeCount; group++)
+        {
+            changed |= (before[group] != getSummary(static_cast<SignalNodes>(group)));
+        }
+        return changed;
+    }
+
+    // All members heard within the heartbeat timeout, so getState() can replace polling.
+    bool isAlive(const SignalNodes group) const
+    {
+        uint8_t members = 0;
+        for (uint8_t index = 0; index < nodeCount; index++)
+        {
+            if (nodes[index].group == group)
+            {
+                if (!isAlive(nodes[index]))
+                {
+                    return false;
+                }
+                members++;
+            }
+        }
+        return members != 0;
+    }
+
+    // All members follow the master clock, so the group can run a plan.
+    bool isSynchronized(const SignalNodes group) const
+    {
+        for (uint8_t index = 0; index < nodeCount; index++)
+        {
+            if ((nodes[index].group == group) && ((nodes[index].flags & SIGNAL_FLAG_SYNCHRONIZED) == 0))
+            {
+                return false;
+            }
+        }
+        return isAlive(group);
+    }
+
+    // The state all members agree on, otherwise a transition.
+    SignalStates getState(const SignalNodes group) const
+    {
+        int state = -1;
+        for (uint8_t index = 0; index < nodeCount; index++)
+        {
+            if (nodes[index].group != group)
+            {
+                continue;
+            }
+            if ((state >= 0) && (state != nodes[index].state))
+            {
+                return SignalStateTransition;
+            }
+            state = nodes[index].state;
+        }
+        return (state >= 0) ? static_cast<SignalStates>(state) : SignalStateStopped;
+    }
+
+    // Ticks until the last member ends its state.
+    uint16_t getRemains(const SignalNodes group) const
+    {
+        uint16_t remains = 0;
+        for (uint8_t index = 0; index < nodeCount; index++)
+        {
+            if ((nodes[index].group == group) && (nodes[index].remains > remains))
+            {
+                remains = nodes[index].remains;
+            }
+        }
+        return remains;
+    }
+
+    // Registry entries, in the order they were added.
+    uint8_t getNodeCount() const
+    {
+        return nodeCount;
+    }
+
+    IPAddress getAddress(const uint8_t index) const
+    {
+        return IPAddress(nodes[index].address);
+    }
+
+    SignalNodes getGroup(const uint8_t index) const
+    {
+        return static_cast<SignalNodes>(nodes[index].group);
+    }
+
+    int getIndex(const IPAddress& address) const
+    {
+        return find(static_cast<uint32_t>(address));
+    }
+};
+
+#endif
@@ -0,0 +1,397 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_CLOCK_H
+#define SIGNAL_CLOCK_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "SignalHal.h"
+#include "SignalBroadcast.h"
+
+// Master clock shared by the nodes, so a plan of commands at absolute times changes
+// the lamps of different boxes together. NTP-style: the follower stamps a request (t1),
+// the master stamps its receive (t2) and transmit (t3), the follower its receive (t4).
+//   offset = ((t2 - t1) + (t3 - t4)) / 2,  delay = (t4 - t1) - (t3 - t2)
+// The offset error is at most half the delay, so the sample with the smallest delay of
+// the last few is used and slow ones are dropped; that keeps jitter out of the clock.
+// The follower only counts as synchronized while it hears the master: samples age out,
+// unanswered requests clear them, and an offset no sample can explain (the master
+// restarted) starts the window over.
+//
+//   0  magic 'T'    1  version    2  type    3  reserved
+//   4  t1 (32bit)   8  t2 (32bit)   12  t3 (32bit)   16  CRC-16/CCITT of bytes 0-15
+
+////////////////////////////////////////////////
+
+#define SIGNAL_CLOCK_PORT 4212          // UDP port of the master
+#define SIGNAL_CLOCK_MAGIC 0x54         // 'T'
+#define SIGNAL_CLOCK_PACKET_SIZE 18
+#define SIGNAL_CLOCK_INTERVAL 2000      // msec between samples once synchronized
+#define SIGNAL_CLOCK_BURST 250          // msec between the first samples
+#define SIGNAL_CLOCK_SAMPLES 8          // best of the last samples by delay
+#define SIGNAL_CLOCK_MAX_DELAY 50       // msec, slower round trips say nothing about the offset
+#define SIGNAL_CLOCK_MAX_AGE 30000      // msec a sample is used, the crystals drift apart meanwhile
+#define SIGNAL_CLOCK_MAX_MISSED 3       // requests in a row without a reply until unsynchronized
+#define SIGNAL_CLOCK_JUMP_MARGIN 10     // msec beyond the delays of two samples that is a jump
+
+enum SignalClockTypes
+{
+    SignalClockRequest,
+    SignalClockReply
+};
+
+struct SignalClockPacket
+{
+    uint8_t type;
+    uint32_t origin;       // t1, follower signalMillis()
+    uint32_t received;     // t2, master signalMillis()
+    uint32_t transmit;     // t3, master signalMillis()
+};
+
+static inline void encodeSignalClockPacket(uint8_t* p, const SignalClockPacket& packet)
+{
+    const uint32_t times[3] = { packet.origin, packet.received, packet.transmit };
+
+    p[0] = SIGNAL_CLOCK_MAGIC;
+    p[1] = SIGNAL_PROTOCOL_VERSION;
+    p[2] = packet.type;
+    p[3] = 0;
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        uint8_t* pTime = p + 4 + (index * 4);
+        pTime[0] = static_cast<uint8_t>(times[index] >> 24);
+        pTime[1] = static_cast<uint8_t>(times[index] >> 16);
+        pTime[2] = static_cast<uint8_t>(times[index] >> 8);
+        pTime[3] = static_cast<uint8_t>(times[index]);
+    }
+
+    const uint16_t crc = calculateSignalCrc(p, SIGNAL_CLOCK_PACKET_SIZE - 2);
+    p[16] = static_cast<uint8_t>(crc >> 8);
+    p[17] = static_cast<uint8_t>(crc);
+}
+
+static inline bool decodeSignalClockPacket(const uint8_t* p, const size_t size, SignalClockPacket& packet)
+{
+    if ((size != SIGNAL_CLOCK_PACKET_SIZE) ||
+        (p[0] != SIGNAL_CLOCK_MAGIC) || (p[1] != SIGNAL_PROTOCOL_VERSION) || (p[2] > SignalClockReply) || (p[3] != 0))
+    {
+        return false;
+    }
+    if (calculateSignalCrc(p, SIGNAL_CLOCK_PACKET_SIZE - 2) != ((static_cast<uint16_t>(p[16]) << 8) | p[17]))
+    {
+        return false;
+    }
+
+    uint32_t times[3];
+    for (uint8_t index = 0; index < 3; index++)
+    {
+        const uint8_t* pTime = p + 4 + (index * 4);
+        times[index] = (static_cast<uint32_t>(pTime[0]) << 24) | (static_cast<uint32_t>(pTime[1]) << 16) |
+            (static_cast<uint32_t>(pTime[2]) << 8) | static_cast<uint32_t>(pTime[3]);
+    }
+
+    packet.type = p[2];
+    packet.origin = times[0];
+    packet.received = times[1];
+    packet.transmit = times[2];
+    return true;
+}
+
+////////////////////////////////////////////////
+
+// Button side: its signalMillis() is the master clock. Answers the followers' requests
+// and sends plans, datagrams of plan messages stamped with master clock times.
+// Call from loop().
+class SignalClockMaster
+{
+private:
+    WiFiUDP udp;
+
+public:
+    void begin()
+    {
+        udp.begin(SIGNAL_CLOCK_PORT);
+    }
+
+    uint32_t getTime() const
+    {
+        return signalMillis();
+    }
+
+    void handle()
+    {
+        while (true)
+        {
+            const int size = udp.parsePacket();
+            if (size <= 0)
+            {
+                break;
+            }
+
+            // Stamped as early as possible, a late stamp only shows up as a longer delay.
+            const uint32_t received = signalMillis();
+
+            // Status answers to sent plans arrive here too, they don't decode.
+            uint8_t buffer[SIGNAL_CLOCK_PACKET_SIZE];
+            SignalClockPacket packet;
+            if ((size != SIGNAL_CLOCK_PACKET_SIZE) ||
+                (udp.read(buffer, sizeof buffer) != SIGNAL_CLOCK_PACKET_SIZE) ||
+                !decodeSignalClockPacket(buffer, size, packet) ||
+                (packet.type != SignalClockRequest))
+            {
+                udp.flush();
+                continue;
+            }
+
+            packet.type = SignalClockReply;
+            packet.received = received;
+            packet.transmit = signalMillis();
+            encodeSignalClockPacket(buffer, packet);
+
+            udp.beginPacket(udp.remoteIP(), udp.remotePort());
+            udp.write(buffer, sizeof buffer);
+            udp.endPacket();
+        }
+    }
+
+    // Plan messages for one node as a single datagram, taken whole or not at all.
+    void sendPlan(const IPAddress& address, const SignalMessage* pSteps, const uint8_t count)
+    {
+        uint8_t packet[SIGNAL_MESSAGE_SIZE * 8];
+        const uint8_t steps = (count < 8) ? count : 8;
+        for (uint8_t index = 0; index < steps; index++)
+        {
+            encodeSignalMessage(packet + (index * SIGNAL_MESSAGE_SIZE), pSteps[index]);
+        }
+
+        udp.beginPacket(address, SIGNAL_COMMAND_PORT);
+        udp.write(packet, steps * SIGNAL_MESSAGE_SIZE);
+        udp.endPacket();
+    }
+};
+
+// Node side: follows the master clock.
+// Call from loop(), the network stack isn't reentrant.
+class SignalClockFollower
+{
+private:
+    struct Sample
+    {
+        int32_t offset;
+        uint32_t delay;
+        uint32_t takenAt;     // signalMillis()
+    };
+
+    WiFiUDP udp;
+    IPAddress master;
+    uint32_t requestedAt;     // t1 of the outstanding request
+    bool waiting;
+    uint8_t missed;           // requests in a row without a reply
+
+    Sample samples[SIGNAL_CLOCK_SAMPLES];
+    uint8_t sampleCount;
+    uint8_t nextSample;
+
+    bool synchronized;
+    int32_t offset;           // master clock - signalMillis(), kept when unsynchronized
+    uint32_t delay;
+    uint16_t resets;          // times the window was dropped
+
+    void send(const uint32_t now)
+    {
+        SignalClockPacket packet;
+        packet.type = SignalClockRequest;
+        packet.origin = now;
+        packet.received = 0;
+        packet.transmit = 0;
+
+        uint8_t buffer[SIGNAL_CLOCK_PACKET_SIZE];
+        encodeSignalClockPacket(buffer, packet);
+
+        udp.beginPacket(master, SIGNAL_CLOCK_PORT);
+        udp.write(buffer, sizeof buffer);
+        udp.endPacket();
+
+        requestedAt = now;
+        waiting = true;
+    }
+
+    // Back to the burst of samples, unsynchronized until the first one.
+    void clear()
+    {
+        if (sampleCount != 0)
+        {
+            resets++;
+        }
+        sampleCount = 0;
+        nextSample = 0;
+        synchronized = false;
+    }
+
+    // The best sample young enough, the window is cleared when none is.
+    void select(const uint32_t now)
+    {
+        int8_t best = -1;
+        for (uint8_t index = 0; index < sampleCount; index++)
+        {
+            if ((now - samples[index].takenAt) > SIGNAL_CLOCK_MAX_AGE)
+            {
+                continue;
+            }
+            if ((best < 0) || (samples[index].delay < samples[best].delay))
+            {
+                best = static_cast<int8_t>(index);
+            }
+        }
+
+        if (best < 0)
+        {
+            clear();
+            return;
+        }
+        synchronized = true;
+        offset = samples[best].offset;
+        delay = samples[best].delay;
+    }
+
+    void addSample(const int32_t sampleOffset, const uint32_t sampleDelay, const uint32_t now)
+    {
+        // Both offsets are within half their delay of the truth, so they can't be further
+        // apart than that: the master clock jumped, the older samples describe another clock.
+        const uint32_t difference = static_cast<uint32_t>(abs(sampleOffset - offset));
+        if (synchronized && (difference > ((sampleDelay + delay) / 2 + SIGNAL_CLOCK_JUMP_MARGIN)))
+        {
+            clear();
+        }
+
+        samples[nextSample].offset = sampleOffset;
+        samples[nextSample].delay = sampleDelay;
+        samples[nextSample].takenAt = now;
+        nextSample = (nextSample + 1) % SIGNAL_CLOCK_SAMPLES;
+        if (sampleCount < SIGNAL_CLOCK_SAMPLES)
+        {
+            sampleCount++;
+        }
+
+        select(now);
+    }
+
+public:
+    SignalClockFollower()
+        : requestedAt(0), waiting(false), missed(0), sampleCount(0), nextSample(0)
+        , synchronized(false), offset(0), delay(0), resets(0)
+    {
+    }
+
+    void begin(const IPAddress& master)
+    {
+        this->master = master;
+        udp.begin(SIGNAL_CLOCK_PORT);
+    }
+
+    void handle()
+    {
+        const uint32_t now = signalMillis();
+        const uint32_t interval = (sampleCount < SIGNAL_CLOCK_SAMPLES) ? SIGNAL_CLOCK_BURST : SIGNAL_CLOCK_INTERVAL;
+        if ((now - requestedAt) >= interval)
+        {
+            if (waiting && (++missed >= SIGNAL_CLOCK_MAX_MISSED))
+            {
+                missed = 0;
+                clear();
+            }
+            send(now);
+        }
+        select(now);
+
+        while (true)
+        {
+            const int size = udp.parsePacket();
+            if (size <= 0)
+            {
+                break;
+            }
+
+            const uint32_t received = signalMillis();
+
+            uint8_t buffer[SIGNAL_CLOCK_PACKET_SIZE];
+            SignalClockPacket packet;
+            if ((size != SIGNAL_CLOCK_PACKET_SIZE) ||
+                (udp.read(buffer, sizeof buffer) != SIGNAL_CLOCK_PACKET_SIZE) ||
+                !decodeSignalClockPacket(buffer, size, packet) ||
+                (packet.type != SignalClockReply) || !waiting || (packet.origin != requestedAt))
+            {
+                udp.flush();
+                continue;
+            }
+            waiting = false;
+            missed = 0;
+
+            const uint32_t sampleDelay = (received - packet.origin) - (packet.transmit - packet.received);
+            if (sampleDelay > SIGNAL_CLOCK_MAX_DELAY)
+            {
+                continue;
+            }
+
+            addSample((static_cast<int32_t>(packet.received - packet.origin) +
+                static_cast<int32_t>(packet.transmit - received)) / 2, sampleDelay, received);
+        }
+    }
+
+    bool isSynchronized() const
+    {
+        return synchronized;
+    }
+
+    // signalMillis() at which the master clock shows masterTime.
+    uint32_t toLocal(const uint32_t masterTime) const
+    {
+        return masterTime - static_cast<uint32_t>(offset);
+    }
+
+    uint32_t getTime() const
+    {
+        return signalMillis() + static_cast<uint32_t>(offset);
+    }
+
+    int32_t getOffset() const
+    {
+        return offset;
+    }
+
+    // Round trip of the sample in use, the offset is off by at most half of it.
+    uint32_t getDelay() const
+    {
+        return delay;
+    }
+
+    // Times the samples were dropped: aged out, master silent or its clock jumped.
+    uint16_t getResets() const
+    {
+        return resets;
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_COMMAND_QUEUE_H
+#define SIGNAL_COMMAND_QUEUE_H
+
+#include "SignalHal.h"
+
+////////////////////////////////////////////////
+
+struct SignalCommand
+{
+    uint32_t sequence;     // issued by push(), starts at 1
+    uint32_t queuedAt;     // signalMillis()
+    uint32_t waitUntil;    // signalMillis() up to which an unmet condition is waited for
+    uint8_t command;       // SignalCommands
+    uint8_t condition;     // SIGNAL_CONDITION() or 0
+};
+
+#define SIGNAL_COMMAND_HISTORY 32
+
+// Commands from the web/UDP handlers (producer, loop()) to the Ticker tick (consumer).
+// Single producer / single consumer ring without locks: each side only writes its own index,
+// and an entry is published by the index store that follows it.
+// The consumer is not only the tick: SignalNodeController::drainNow() consumes from loop()
+// too, right after a push. That is one consumer only because a Ticker callback never
+// preempts loop(), it runs between two loop() passes or inside delay()/yield(), so the two
+// consumer call sites never overlap. A tick that could interrupt loop() (a hardware timer
+// ISR, another task) would race drainNow() on tail and needs a lock or a single consumer.
+// barrier() only stops the compiler reordering, enough for one core and for x86 threads.
+// The consumer completes commands in order, so every sequence up to the completed one is done.
+// A completed command was either applied or skipped, the outcome is kept for the last
+// SIGNAL_COMMAND_HISTORY sequences.
+template <uint8_t Size>   // must be power of 2
+class SignalCommandQueue
+{
+    static_assert(Size <= SIGNAL_COMMAND_HISTORY, "A full queue must complete within the history.");
+
+private:
+    SignalCommand entries[Size];
+    volatile uint8_t head;     // written by push()
+    volatile uint8_t tail;     // written by complete()
+
+    uint32_t lastSequence;                  // producer side
+    volatile uint32_t completedSequence;    // consumer side
+    volatile uint32_t skippedHistory;       // bit n: completedSequence - n was skipped
+    volatile uint32_t appliedAt;
+    volatile uint32_t appliedLatency;
+
+    static void barrier()
+    {
+        __asm__ __volatile__("" ::: "memory");
+    }
+
+public:
+    SignalCommandQueue()
+        : head(0), tail(0), lastSequence(0), completedSequence(0), skippedHistory(0), appliedAt(0), appliedLatency(0)
+    {
+    }
+
+    // Producer: queue a command, returns its sequence or 0 if the queue is full.
+    uint32_t push(const uint8_t command, const uint8_t condition = 0, const uint16_t waitMillisecond = 0)
+    {
+        const uint8_t current = head;
+        if (static_cast<uint8_t>(current - tail) >= Size)
+        {
+            return 0;
+        }
+
+        SignalCommand& entry = entries[current & (Size - 1)];
+        entry.sequence = ++lastSequence;
+        entry.queuedAt = signalMillis();
+        entry.waitUntil = entry.queuedAt + waitMillisecond;
+        entry.command = command;
+        entry.condition = condition;
+
+        barrier();
+        head = current + 1;
+
+        return entry.sequence;
+    }
+
+    // Consumer: the oldest command not applied yet.
+    bool peek(SignalCommand& command) const
+    {
+        const uint8_t current = tail;
+        if (current == head)
+        {
+            return false;
+        }
+
+        barrier();
+        command = entries[current & (Size - 1)];
+        return true;
+    }
+
+    // Consumer: the peeked command has been applied, or skipped when its condition never held.
+    void complete(const bool applied = true)
+    {
+        const uint8_t current = tail;
+        const SignalCommand& entry = entries[current & (Size - 1)];
+
+        skippedHistory = (skippedHistory << 1) | (applied ? 0 : 1);
+        completedSequence = entry.sequence;
+        if (applied)
+        {
+            const uint32_t now = signalMillis();
+            appliedAt = now;
+            appliedLatency = now - entry.queuedAt;
+        }
+
+        barrier();
+        tail = current + 1;
+    }
+
+    // Producer side queries.
+    uint32_t getLastSequence() const
+    {
+        return lastSequence;
+    }
+
+    uint8_t getPending() const
+    {
+        return static_cast<uint8_t>(head - tail);
+    }
+
+    // Producer: a batch of up to this many commands can be pushed without failing.
+    uint8_t getFree() const
+    {
+        return Size - getPending();
+    }
+
+    bool isCompleted(const uint32_t sequence) const
+    {
+        return static_cast<int32_t>(completedSequence - sequence) >= 0;
+    }
+
+    // Completed recently enough that its outcome is still known.
+    bool isRemembered(const uint32_t sequence) const
+    {
+        return isCompleted(sequence) && ((completedSequence - sequence) < SIGNAL_COMMAND_HISTORY);
+    }
+
+    bool isApplied(const uint32_t sequence) const
+    {
+        return isRemembered(sequence) && ((skippedHistory & (1UL << (completedSequence - sequence))) == 0);
+    }
+
+    bool isSkipped(const uint32_t sequence) const
+    {
+        return isRemembered(sequence) && ((skippedHistory & (1UL << (completedSequence - sequence))) != 0);
+    }
+
+    uint32_t getCompletedSequence() const
+    {
+        return completedSequence;
+    }
+
+    uint32_t getAppliedAt() const
+    {
+        return appliedAt;
+    }
+
+    // msec from push() to complete() of the last applied (not skipped) command.
+    uint32_t getAppliedLatency() const
+    {
+        return appliedLatency;
+    }
+};
+
+#endif
@@ -0,0 +1,376 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_EVENT_HUB_H
+#define SIGNAL_EVENT_HUB_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "SignalHal.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_EVENT_PORT 81                 // long-polls and event streams
+#define SIGNAL_EVENT_MAX_WAIT 30000          // msec, longest long-poll
+#define SIGNAL_EVENT_KEEP_ALIVE 15000        // msec, comment line on idle event streams
+#define SIGNAL_EVENT_REQUEST_WAIT 2000       // msec for the request head of a client
+
+// Status change notices over HTTP without blocking ESP8266WebServer.
+// ESP8266WebServer waits up to 2 seconds for a client to close after each request and
+// takes no other client meanwhile, so a client it handed to a handler can't be kept open
+// for a later answer. The hub has its own WiFiServer on SIGNAL_EVENT_PORT for the clients
+// that wait: GET /api/status?since=<sequence>&wait=<msec> and GET /api/events. step()
+// reads their requests and publish() answers every parked long-poll and writes an event
+// to every stream, all from loop() without waiting.
+class SignalEventHub
+{
+public:
+    static const uint8_t MaxClients = 4;
+    static const uint8_t MaxTextSize = 32;
+    static const uint8_t MaxRequestSize = 96;   // request line, the other header lines are skipped
+
+private:
+    enum WatcherState
+    {
+        WatcherFree,
+        WatcherReading,
+        WatcherPolling,
+        WatcherStreaming
+    };
+
+    struct Watcher
+    {
+        WiFiClient client;
+        WatcherState state;
+        uint32_t deadline;
+        uint32_t lastWritten;
+        uint8_t requestSize;
+        uint8_t lines;           // header lines read, an empty one ends the head
+        bool lineEmpty;
+        char request[MaxRequestSize];
+    };
+
+    WiFiServer server;
+    Watcher watchers[MaxClients];
+    uint32_t sequence;
+    char text[MaxTextSize];
+
+    static bool isReached(const uint32_t deadline, const uint32_t now)
+    {
+        return static_cast<int32_t>(now - deadline) >= 0;
+    }
+
+    Watcher* allocate()
+    {
+        for (uint8_t index = 0; index < MaxClients; index++)
+        {
+            if (watchers[index].state == WatcherFree)
+            {
+                return &watchers[index];
+            }
+        }
+        return nullptr;
+    }
+
+    void release(Watcher& watcher)
+    {
+        watcher.client.stop();
+        watcher.client = WiFiClient();
+        watcher.state = WatcherFree;
+    }
+
+    static void write(WiFiClient& client, const int statusCode, const char* pReason, const char* pBody)
+    {
+        char buffer[192];
+        const int length = snprintf(buffer, sizeof buffer,
+            "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %u\r\n"
+            "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n%s",
+            statusCode, pReason, static_cast<unsigned>(strlen(pBody)), pBody);
+        client.write(reinterpret_cast<const uint8_t*>(buffer), length);
+    }
+
+    void fail(Watcher& watcher, const int statusCode, const char* pReason, const char* pBody)
+    {
+        write(watcher.client, statusCode, pReason, pBody);
+        release(watcher);
+    }
+
+    void respond(Watcher& watcher)
+    {
+        char buffer[192];
+        const int length = snprintf(buffer, sizeof buffer,
+            "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %u\r\n"
+            "X-Signal-Sequence: %lu\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n%s",
+            static_cast<unsigned>(strlen(text)), static_cast<unsigned long>(sequence), text);
+        watcher.client.write(reinterpret_cast<const uint8_t*>(buffer), length);
+        release(watcher);
+    }
+
+    bool writeEvent(Watcher& watcher)
+    {
+        char buffer[64];
+        const int length = snprintf(buffer, sizeof buffer,
+            "id: %lu\ndata: %s\n\n", static_cast<unsigned long>(sequence), text);
+        watcher.lastWritten = signalMillis();
+        return watcher.client.write(reinterpret_cast<const uint8_t*>(buffer), length) == static_cast<size_t>(length);
+    }
+
+    void accept(const uint32_t now)
+    {
+        WiFiClient client = server.available();
+        if (!client)
+        {
+            return;
+        }
+
+        Watcher* pWatcher = allocate();
+        if (pWatcher == nullptr)
+        {
+            write(client, 503, "Service Unavailable", "Too many watchers.");
+            client.stop();
+            return;
+        }
+
+        pWatcher->client = client;
+        pWatcher->state = WatcherReading;
+        pWatcher->deadline = now + SIGNAL_EVENT_REQUEST_WAIT;
+        pWatcher->requestSize = 0;
+        pWatcher->lines = 0;
+        pWatcher->lineEmpty = true;
+    }
+
+    // Takes what arrived of the request head, true once it is complete.
+    static bool read(Watcher& watcher)
+    {
+        int ch;
+        while ((ch = watcher.client.read()) >= 0)
+        {
+            if (ch == '\r')
+            {
+                continue;
+            }
+            if (ch == '\n')
+            {
+                if (watcher.lineEmpty && (watcher.lines != 0))
+                {
+                    return true;
+                }
+                watcher.lines++;
+                watcher.lineEmpty = true;
+                continue;
+            }
+
+            // Only the request line is kept, too long a line fails to parse.
+            watcher.lineEmpty = false;
+            if ((watcher.lines == 0) && (watcher.requestSize < (MaxRequestSize - 1)))
+            {
+                watcher.request[watcher.requestSize++] = static_cast<char>(ch);
+            }
+        }
+        return false;
+    }
+
+    // Value of name in the query, false if it is there but not a number.
+    static bool getNumber(const char* pQuery, const char* pName, uint32_t& value)
+    {
+        const size_t nameSize = strlen(pName);
+        for (const char* pItem = pQuery; pItem != nullptr; pItem = strchr(pItem, '&'))
+        {
+            pItem += (*pItem == '&') ? 1 : 0;
+            if ((strncmp(pItem, pName, nameSize) != 0) || (pItem[nameSize] != '='))
+            {
+                continue;
+            }
+
+            char* pEnd = nullptr;
+            const unsigned long number = strtoul(pItem + nameSize + 1, &pEnd, 10);
+            if ((pEnd == pItem + nameSize + 1) || ((*pEnd != '\0') && (*pEnd != '&')) || (number > UINT32_MAX))
+            {
+                return false;
+            }
+            value = static_cast<uint32_t>(number);
+        }
+        return true;
+    }
+
+    // "GET <path>[?<query>] HTTP/1.1"
+    void dispatch(Watcher& watcher, const uint32_t now)
+    {
+        watcher.request[watcher.requestSize] = '\0';
+        char* pPath = strchr(watcher.request, ' ');
+        char* pVersion = (pPath != nullptr) ? strchr(pPath + 1, ' ') : nullptr;
+        if ((strncmp(watcher.request, "GET ", 4) != 0) || (pVersion == nullptr))
+        {
+            fail(watcher, 400, "Bad Request", "Invalid request.");
+            return;
+        }
+        *pVersion = '\0';
+        pPath++;
+        char* pQuery = strchr(pPath, '?');
+        if (pQuery != nullptr)
+        {
+            *pQuery++ = '\0';
+        }
+
+        if (strcmp(pPath, "/api/events") == 0)
+        {
+            startStream(watcher);
+            return;
+        }
+        if (strcmp(pPath, "/api/status") != 0)
+        {
+            fail(watcher, 404, "Not Found", "Invalid resource path.");
+            return;
+        }
+
+        uint32_t since = sequence;
+        uint32_t wait = SIGNAL_EVENT_MAX_WAIT;
+        if ((pQuery != nullptr) && (!getNumber(pQuery, "since", since) || !getNumber(pQuery, "wait", wait)))
+        {
+            fail(watcher, 400, "Bad Request", "Invalid since or wait.");
+            return;
+        }
+        if (since != sequence)
+        {
+            respond(watcher);
+            return;
+        }
+
+        watcher.state = WatcherPolling;
+        watcher.deadline = now + ((wait < SIGNAL_EVENT_MAX_WAIT) ? wait : SIGNAL_EVENT_MAX_WAIT);
+    }
+
+    // Server-sent events: the current status, then one event per publish().
+    void startStream(Watcher& watcher)
+    {
+        watcher.state = WatcherStreaming;
+
+        static const char header[] =
+            "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+            "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\n";
+        watcher.client.write(reinterpret_cast<const uint8_t*>(header), sizeof header - 1);
+        if (!writeEvent(watcher))
+        {
+            release(watcher);
+        }
+    }
+
+public:
+    SignalEventHub()
+        : server(SIGNAL_EVENT_PORT), sequence(0)
+    {
+        text[0] = '\0';
+        for (uint8_t index = 0; index < MaxClients; index++)
+        {
+            watchers[index].state = WatcherFree;
+        }
+    }
+
+    // After WiFi is up.
+    void begin()
+    {
+        server.begin();
+        server.setNoDelay(true);
+    }
+
+    uint32_t getSequence() const
+    {
+        return sequence;
+    }
+
+    const char* getText() const
+    {
+        return text;
+    }
+
+    // New status text: answers all long-polls and streams it.
+    void publish(const char* pText)
+    {
+        strncpy(text, pText, sizeof text - 1);
+        text[sizeof text - 1] = '\0';
+        sequence++;
+
+        for (uint8_t index = 0; index < MaxClients; index++)
+        {
+            Watcher& watcher = watchers[index];
+            if (watcher.state == WatcherPolling)
+            {
+                respond(watcher);
+            }
+            else if ((watcher.state == WatcherStreaming) && !writeEvent(watcher))
+            {
+                release(watcher);
+            }
+        }
+    }
+
+    // From loop(): take new clients and their requests, answer expired long-polls,
+    // drop closed streams and keep idle ones alive.
+    void step()
+    {
+        const uint32_t now = signalMillis();
+        accept(now);
+
+        for (uint8_t index = 0; index < MaxClients; index++)
+        {
+            Watcher& watcher = watchers[index];
+            if (watcher.state == WatcherFree)
+            {
+                continue;
+            }
+
+            if (watcher.state == WatcherReading)
+            {
+                if (read(watcher))
+                {
+                    dispatch(watcher, now);
+                }
+                else if (isReached(watcher.deadline, now) || !watcher.client.connected())
+                {
+                    release(watcher);
+                }
+            }
+            else if (!watcher.client.connected())
+            {
+                release(watcher);
+            }
+            else if (watcher.state == WatcherPolling)
+            {
+                if (isReached(watcher.deadline, now))
+                {
+                    respond(watcher);
+                }
+            }
+            else if ((now - watcher.lastWritten) >= SIGNAL_EVENT_KEEP_ALIVE)
+            {
+                watcher.lastWritten = now;
+                if (watcher.client.write(reinterpret_cast<const uint8_t*>(":\n\n"), 3) != 3)
+                {
+                    release(watcher);
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,271 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_FANOUT_H
+#define SIGNAL_FANOUT_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "SignalHal.h"
+#include "SignalLogger.h"
+#include "SignalBroadcast.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_FANOUT_PORT 4213        // UDP port of the commander, answers to group commands
+#define SIGNAL_FANOUT_DEADLINE 300     // msec for all members to answer
+#define SIGNAL_FANOUT_ROUNDS 4         // group commands in flight
+
+struct SignalFanoutResult
+{
+    SignalNodes group;
+    SignalCommands command;
+    uint8_t answered;
+    uint8_t expected;              // members of the group when sent
+    uint32_t elapsedMillisecond;   // to the last answer, or the deadline
+};
+
+// Called once per group command, when all members answered or the deadline passed.
+typedef void (*SignalFanoutHandler)(void* pContext, const SignalFanoutResult& result);
+
+// Sends a command to every member of a group in the listener's registry at once and
+// gathers the answers with a deadline, so a group command costs one round trip, not one
+// per member. Members still silent at half the deadline get the command once more;
+// commands are idempotent for the phases, a duplicate changes nothing.
+// Answers are statuses and go into the listener. Call handle() from loop().
+class SignalGroupCommander
+{
+private:
+    struct Round
+    {
+        SignalMessage command;
+        SignalFanoutHandler pHandler;
+        void* pContext;
+        uint32_t pending;      // bit per registry index
+        uint32_t sentAt;
+        uint8_t expected;
+        bool resent;
+        bool active;
+    };
+
+    struct Statistics
+    {
+        uint32_t rounds;
+        uint32_t partial;
+        uint32_t resent;
+        uint32_t totalMillisecond;
+        uint32_t maxMillisecond;
+    };
+
+    WiFiUDP udp;
+    SignalStateListener* pListener;
+    Round rounds[SIGNAL_FANOUT_ROUNDS];
+    Statistics statistics;
+
+    void send(const Round& round)
+    {
+        uint8_t packet[SIGNAL_MESSAGE_SIZE];
+        encodeSignalMessage(packet, round.command);
+
+        for (uint8_t index = 0; index < pListener->getNodeCount(); index++)
+        {
+            if ((round.pending & (1UL << index)) != 0)
+            {
+                udp.beginPacket(pListener->getAddress(index), SIGNAL_COMMAND_PORT);
+                udp.write(packet, sizeof packet);
+                udp.endPacket();
+            }
+        }
+    }
+
+    void finish(Round& round, const uint32_t now)
+    {
+        SignalFanoutResult result;
+        result.group = static_cast<SignalNodes>(round.command.node);
+        result.command = static_cast<SignalCommands>(round.command.command);
+        result.expected = round.expected;
+        result.answered = round.expected;
+        for (uint32_t pending = round.pending; pending != 0; pending &= pending - 1)
+        {
+            result.answered--;
+        }
+        result.elapsedMillisecond = now - round.sentAt;
+
+        statistics.rounds++;
+        statistics.partial += (result.answered != result.expected) ? 1 : 0;
+        statistics.totalMillisecond += result.elapsedMillisecond;
+        if (result.elapsedMillisecond > statistics.maxMillisecond)
+        {
+            statistics.maxMillisecond = result.elapsedMillisecond;
+        }
+
+        round.active = false;
+        if (round.pHandler != nullptr)
+        {
+            round.pHandler(round.pContext, result);
+        }
+    }
+
+public:
+    SignalGroupCommander()
+        : pListener(nullptr)
+    {
+        memset(rounds, 0, sizeof rounds);
+        memset(&statistics, 0, sizeof statistics);
+    }
+
+    void begin(SignalStateListener* pListener)
+    {
+        this->pListener = pListener;
+        udp.begin(SIGNAL_FANOUT_PORT);
+    }
+
+    // A command of the group is in flight.
+    bool isBusy(const SignalNodes group) const
+    {
+        for (uint8_t index = 0; index < SIGNAL_FANOUT_ROUNDS; index++)
+        {
+            if (rounds[index].active && (rounds[index].command.node == group))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // false if all rounds are in flight. A group without members finishes at the next handle().
+    bool send(const SignalNodes group, const SignalCommands command, SignalFanoutHandler pHandler, void* pContext)
+    {
+        Round* pRound = nullptr;
+        for (uint8_t index = 0; (pRound == nullptr) && (index < SIGNAL_FANOUT_ROUNDS); index++)
+        {
+            pRound = rounds[index].active ? nullptr : &rounds[index];
+        }
+        if (pRound == nullptr)
+        {
+            return false;
+        }
+
+        memset(&pRound->command, 0, sizeof pRound->command);
+        pRound->command.type = SignalMessageCommand;
+        pRound->command.node = group;
+        pRound->command.command = command;
+        pRound->pHandler = pHandler;
+        pRound->pContext = pContext;
+        pRound->pending = 0;
+        pRound->expected = 0;
+        for (uint8_t index = 0; index < pListener->getNodeCount(); index++)
+        {
+            if (pListener->getGroup(index) == group)
+            {
+                pRound->pending |= 1UL << index;
+                pRound->expected++;
+            }
+        }
+        pRound->sentAt = signalMillis();
+        pRound->resent = false;
+        pRound->active = true;
+
+        send(*pRound);
+        return true;
+    }
+
+    void handle()
+    {
+        while (true)
+        {
+            const int size = udp.parsePacket();
+            if (size <= 0)
+            {
+                break;
+            }
+
+            uint8_t packet[SIGNAL_MESSAGE_SIZE];
+            SignalMessage message;
+            if ((size != SIGNAL_MESSAGE_SIZE) ||
+                (udp.read(packet, sizeof packet) != SIGNAL_MESSAGE_SIZE) ||
+                !decodeSignalMessage(packet, size, message) ||
+                (message.type != SignalMessageStatus))
+            {
+                udp.flush();
+                continue;
+            }
+
+            const IPAddress address = udp.remoteIP();
+            pListener->update(address, message);
+
+            // Answers the oldest round still waiting for this member.
+            const int index = pListener->getIndex(address);
+            Round* pRound = nullptr;
+            for (uint8_t round = 0; (index >= 0) && (round < SIGNAL_FANOUT_ROUNDS); round++)
+            {
+                Round& candidate = rounds[round];
+                if (candidate.active && ((candidate.pending & (1UL << index)) != 0) &&
+                    ((pRound == nullptr) || (static_cast<int32_t>(candidate.sentAt - pRound->sentAt) < 0)))
+                {
+                    pRound = &candidate;
+                }
+            }
+            if (pRound != nullptr)
+            {
+                pRound->pending &= ~(1UL << index);
+            }
+        }
+
+        const uint32_t now = signalMillis();
+        for (uint8_t index = 0; index < SIGNAL_FANOUT_ROUNDS; index++)
+        {
+            Round& round = rounds[index];
+            if (!round.active)
+            {
+                continue;
+            }
+
+            const uint32_t elapsed = now - round.sentAt;
+            if ((round.pending == 0) || (elapsed >= SIGNAL_FANOUT_DEADLINE))
+            {
+                finish(round, now);
+            }
+            else if (!round.resent && (elapsed >= (SIGNAL_FANOUT_DEADLINE / 2)))
+            {
+                round.resent = true;
+                statistics.resent++;
+                send(round);
+            }
+        }
+    }
+
+    void printStatistics(const char* pName) const
+    {
+        logger.info("%s: rounds=%lu, partial=%lu, resent=%lu, average=%lumsec, max=%lumsec",
+            pName,
+            static_cast<unsigned long>(statistics.rounds),
+            static_cast<unsigned long>(statistics.partial),
+            static_cast<unsigned long>(statistics.resent),
+            static_cast<unsigned long>((statistics.rounds != 0) ? (statistics.totalMillisecond / statistics.rounds) : 0),
+            static_cast<unsigned long>(statistics.maxMillisecond));
+    }
+};
+
+#endif
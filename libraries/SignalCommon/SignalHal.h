@@ -0,0 +1,426 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_HAL_H
+#define SIGNAL_HAL_H
+
+// Thin hardware layer under the shared control code: outputs, the monotonic clock and
+// the periodic timer. Sequences, queues, plans and the clock sync only use these names,
+// so another backend running them elsewhere defines the same set under its own #elif.
+// Networking, the web server and serial stay on the core's classes.
+
+#if defined(ESP8266)
+
+#include <Arduino.h>
+#include <Ticker.h>
+
+////////////////////////////////////////////////
+
+// Monotonic, wraps around; compare with subtraction.
+static inline uint32_t signalMillis()
+{
+    return millis();
+}
+
+static inline uint32_t signalMicros()
+{
+    return micros();
+}
+
+// CPU cycles, wraps around in under a minute; for measuring short spans only.
+static inline uint32_t signalCycles()
+{
+    return ESP.getCycleCount();
+}
+
+static inline uint32_t signalCpuMHz()
+{
+    return ESP.getCpuFreqMHz();
+}
+
+static inline uint32_t signalFreeHeap()
+{
+    return ESP.getFreeHeap();
+}
+
+static inline uint32_t signalMaxFreeBlock()
+{
+    return ESP.getMaxFreeBlockSize();
+}
+
+// 0: all free heap in one block, 100: all in small pieces.
+static inline uint8_t signalHeapFragmentation()
+{
+    return ESP.getHeapFragmentation();
+}
+
+// Least free stack of loop() seen so far, the high-water mark from the other side.
+static inline uint32_t signalFreeStack()
+{
+    return ESP.getFreeContStack();
+}
+
+// Let the system tasks and the watchdog run during a long computation.
+static inline void signalYield()
+{
+    yield();
+}
+
+static inline void signalPinOutput(const uint8_t pin)
+{
+    pinMode(pin, OUTPUT);
+}
+
+static inline void signalWritePin(const uint8_t pin, const bool on)
+{
+    digitalWrite(pin, on ? HIGH : LOW);
+}
+
+// Bit n is IOn (IO0-IO15): pins are set, the rest of allPins cleared,
+// by the W1TC/W1TS registers so no other pin is touched.
+static inline void signalWritePins(const uint32_t allPins, const uint32_t pins)
+{
+    GPOC = allPins & ~pins;
+    GPOS = pins;
+}
+
+// Periodic timer. The callback runs between loop() passes, never inside one.
+class SignalTimer
+{
+private:
+    Ticker ticker;
+
+public:
+    // Restarts the period if already attached.
+    template <typename T>
+    void attach(const uint32_t intervalMillisecond, void (*pCallback)(T*), T* pArgument)
+    {
+        ticker.attach_ms(intervalMillisecond, pCallback, pArgument);
+    }
+
+    void detach()
+    {
+        ticker.detach();
+    }
+};
+
+#elif defined(SIGNAL_HAL_POSIX)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <functional>
+#include <thread>
+
+// Host backend: the same control code built natively (host/CMakeLists.txt) for the tests,
+// benchmarks and the simulator. The clock is CLOCK_MONOTONIC unless a simulator installs
+// a virtual one. Outputs are kept per pin and every change goes to signalHostPinHandler,
+// by default a line on stderr. Single threaded like the node: SignalTimer callbacks run
+// from signalHostRunTimers(), which the host main calls between loop() passes and delay()
+// calls while it waits, so they never run inside a loop() pass.
+
+////////////////////////////////////////////////
+
+typedef uint64_t (*SignalHostClock)();                         // usec, monotonic
+typedef void (*SignalHostPinHandler)(const uint8_t pin, const bool on);
+
+inline uint64_t signalHostMonotonicMicros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + static_cast<uint64_t>(now.tv_nsec / 1000);
+}
+
+// inline, not static: one start for all translation units.
+inline uint64_t signalHostStartMicros()
+{
+    static const uint64_t start = signalHostMonotonicMicros();
+    return start;
+}
+
+// From the first call, as millis() counts from boot.
+inline uint64_t signalHostRealMicros()
+{
+    return signalHostMonotonicMicros() - signalHostStartMicros();
+}
+
+inline SignalHostClock signalHostClock = signalHostRealMicros;
+
+inline void signalHostLogPin(const uint8_t pin, const bool on)
+{
+    fprintf(stderr, "%llu GPIO%u %s\n",
+        static_cast<unsigned long long>(signalHostClock() / 1000), pin, on ? "HIGH" : "LOW");
+}
+
+inline SignalHostPinHandler signalHostPinHandler = signalHostLogPin;
+inline uint32_t signalHostPins = 0;                  // bit n: IOn is high
+
+// Monotonic, wraps around; compare with subtraction.
+static inline uint32_t signalMillis()
+{
+    return static_cast<uint32_t>(signalHostClock() / 1000);
+}
+
+static inline uint32_t signalMicros()
+{
+    return static_cast<uint32_t>(signalHostClock());
+}
+
+// Always real time in nsec, so benchmarks measure the host even under a virtual clock.
+static inline uint32_t signalCycles()
+{
+    return static_cast<uint32_t>(signalHostMonotonicMicros() * 1000);
+}
+
+// One "cycle" per nsec, see signalCycles().
+static inline uint32_t signalCpuMHz()
+{
+    return 1000;
+}
+
+// Allocated bytes taken from a nominal 1GB, so a leak shows as lost heap as on the node.
+static inline uint32_t signalFreeHeap()
+{
+#if defined(__GLIBC__)
+    return static_cast<uint32_t>((1UL << 30) - mallinfo2().uordblks);
+#else
+    return 1UL << 30;
+#endif
+}
+
+static inline uint32_t signalMaxFreeBlock()
+{
+    return signalFreeHeap();
+}
+
+static inline uint8_t signalHeapFragmentation()
+{
+    return 0;
+}
+
+// Not measured on the host.
+static inline uint32_t signalFreeStack()
+{
+    return 0;
+}
+
+static inline void signalYield()
+{
+    std::this_thread::yield();
+}
+
+static inline void signalPinOutput(const uint8_t pin)
+{
+    (void)pin;
+}
+
+static inline void signalWritePin(const uint8_t pin, const bool on)
+{
+    const uint32_t bit = 1UL << pin;
+    const bool was = (signalHostPins & bit) != 0;
+    signalHostPins = on ? (signalHostPins | bit) : (signalHostPins & ~bit);
+    if (was != on)
+    {
+        signalHostPinHandler(pin, on);
+    }
+}
+
+// Bit n is IOn: pins are set, the rest of allPins cleared, as by W1TC/W1TS.
+static inline void signalWritePins(const uint32_t allPins, const uint32_t pins)
+{
+    for (uint8_t pin = 0; pin < 16; pin++)
+    {
+        const uint32_t bit = 1UL << pin;
+        if ((allPins & bit) != 0)
+        {
+            signalWritePin(pin, (pins & bit) != 0);
+        }
+    }
+}
+
+////////////////////////////////////////////////
+
+// Entry of the timer list, shared by SignalTimer and the host Ticker.
+class SignalHostTimer
+{
+private:
+    static SignalHostTimer*& getFirst()
+    {
+        static SignalHostTimer* pFirst = nullptr;
+        return pFirst;
+    }
+
+    SignalHostTimer* pNext;
+    std::function<void()> callback;
+    uint64_t due;              // usec of signalHostClock
+    uint32_t intervalMicrosecond;
+    bool repeat;
+    bool listed;
+
+    void unlink()
+    {
+        for (SignalHostTimer** pp = &getFirst(); *pp != nullptr; pp = &(*pp)->pNext)
+        {
+            if (*pp == this)
+            {
+                *pp = pNext;
+                break;
+            }
+        }
+        listed = false;
+    }
+
+public:
+    SignalHostTimer()
+        : pNext(nullptr), due(0), intervalMicrosecond(0), repeat(false), listed(false)
+    {
+    }
+
+    ~SignalHostTimer()
+    {
+        detach();
+    }
+
+    SignalHostTimer(const SignalHostTimer&) = delete;
+    SignalHostTimer& operator=(const SignalHostTimer&) = delete;
+
+    // Restarts the period if already attached.
+    void attach(const uint32_t intervalMicrosecond, const bool repeat, const std::function<void()>& callback)
+    {
+        if (listed)
+        {
+            unlink();
+        }
+
+        this->callback = callback;
+        this->intervalMicrosecond = (intervalMicrosecond != 0) ? intervalMicrosecond : 1;
+        this->repeat = repeat;
+        due = signalHostClock() + this->intervalMicrosecond;
+
+        pNext = getFirst();
+        getFirst() = this;
+        listed = true;
+    }
+
+    void detach()
+    {
+        if (listed)
+        {
+            unlink();
+        }
+    }
+
+    bool isActive() const
+    {
+        return listed;
+    }
+
+    // Clock of the earliest attached timer, UINT64_MAX if none.
+    static uint64_t getNextDue()
+    {
+        uint64_t next = UINT64_MAX;
+        for (const SignalHostTimer* p = getFirst(); p != nullptr; p = p->pNext)
+        {
+            next = (p->due < next) ? p->due : next;
+        }
+        return next;
+    }
+
+    // Calls every timer due at the clock, earliest first, returns how many ran.
+    // A callback may attach or detach timers, its own included.
+    static uint32_t runDue()
+    {
+        uint32_t count = 0;
+        while (true)
+        {
+            const uint64_t now = signalHostClock();
+            SignalHostTimer* pDue = nullptr;
+            for (SignalHostTimer* p = getFirst(); p != nullptr; p = p->pNext)
+            {
+                if ((p->due <= now) && ((pDue == nullptr) || (p->due < pDue->due)))
+                {
+                    pDue = p;
+                }
+            }
+            if (pDue == nullptr)
+            {
+                return count;
+            }
+
+            // A copy: the callback may detach or re-attach its own timer.
+            const std::function<void()> callback = pDue->callback;
+            if (pDue->repeat)
+            {
+                // Late runs are not caught up in a burst, as on ESP8266.
+                pDue->due += pDue->intervalMicrosecond;
+                if (pDue->due <= now)
+                {
+                    pDue->due = now + pDue->intervalMicrosecond;
+                }
+            }
+            else
+            {
+                pDue->unlink();
+            }
+
+            callback();
+            count++;
+        }
+    }
+};
+
+// Run the due timer callbacks as the loop does, see the backend notes above.
+static inline uint32_t signalHostRunTimers()
+{
+    return SignalHostTimer::runDue();
+}
+
+// Periodic timer. The callback runs between loop() passes, never inside one.
+class SignalTimer
+{
+private:
+    SignalHostTimer timer;
+
+public:
+    // Restarts the period if already attached.
+    template <typename T>
+    void attach(const uint32_t intervalMillisecond, void (*pCallback)(T*), T* pArgument)
+    {
+        timer.attach(intervalMillisecond * 1000, true, [pCallback, pArgument]() { pCallback(pArgument); });
+    }
+
+    void detach()
+    {
+        timer.detach();
+    }
+};
+
+#else
+#error "SignalHal.h: no backend for this target."
+#endif
+
+#endif
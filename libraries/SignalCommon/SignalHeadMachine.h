@@ -0,0 +1,152 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_HEAD_MACHINE_H
+#define SIGNAL_HEAD_MACHINE_H
+
+#include <Arduino.h>
+
+#include "SignalHal.h"
+#include "SignalProtocol.h"
+#include "SignalSequence.h"
+#include "SignalTrace.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_STAY 0xff   // SignalPhaseRule::next: the command doesn't change the phase
+
+// How one phase of a head's SignalPhase table looks from outside and takes commands.
+// Rules stay in RAM, they are read on every command and status.
+struct SignalPhaseRule
+{
+    const char* pName;                  // status text
+    uint8_t state;                      // SignalStates told to the other nodes
+    uint8_t countdown;                  // !0: the text counts the repeats down from it, e.g. "Blinking 14"
+    uint8_t next[SignalCommandCount];   // phase to jump to per command, or SIGNAL_STAY
+};
+
+// The state machine of a head, see SignalNodeController for the Head description:
+// its phase table stepped by the tick, its rule table for the commands, the status text
+// and the state. Nothing but the lamps is touched, so a head also runs on its own.
+template <typename Head>
+class SignalHeadMachine
+{
+private:
+    SignalSequence sequence;
+    uint32_t remainsToHold;   // msec, walked through the table on a jump, counted down by the ticks
+
+    void enter()
+    {
+        remainsToHold = sequence.getRemainsToHold();
+    }
+
+public:
+    SignalHeadMachine()
+        : remainsToHold(0)
+    {
+    }
+
+    static uint32_t getAllLamps()
+    {
+        uint32_t allLamps = 0;
+        for (uint8_t index = 0; index < Head::LampCount; index++)
+        {
+            allLamps |= SIGNAL_LAMP(Head::lampPins[index]);
+        }
+        return allLamps;
+    }
+
+    // Enters phase 0, phase entries and lamp writes go to the trace if given.
+    void begin(SignalTrace* pTrace = nullptr)
+    {
+        sequence.setTrace(pTrace);
+        sequence.begin(Head::phases, getAllLamps(), 0);
+        enter();
+    }
+
+    const SignalPhaseRule& getRule() const
+    {
+        return Head::rules[sequence.getPhase()];
+    }
+
+    String getStatusText() const
+    {
+        const SignalPhaseRule& rule = getRule();
+        String result = rule.pName;
+        if (rule.countdown != 0)
+        {
+            result += ' ';
+            result += rule.countdown - sequence.getRepeated();
+        }
+
+        return result;
+    }
+
+    SignalStates getSignalState() const
+    {
+        return static_cast<SignalStates>(getRule().state);
+    }
+
+    // Ticks until the state ends by itself. Asked on every loop() pass, so no table walk.
+    uint16_t getRemainsTicks() const
+    {
+        return static_cast<uint16_t>((remainsToHold + Head::TickInterval - 1) / Head::TickInterval);
+    }
+
+    // One lookup in the rule table, commands not listed for the phase change nothing.
+    void apply(const uint8_t command)
+    {
+        const uint8_t next = getRule().next[command];
+        if (next != SIGNAL_STAY)
+        {
+            sequence.jump(next);
+            enter();
+        }
+    }
+
+    // One tick interval has elapsed, holding phases don't expire. The tick uses up the
+    // interval, or what was left of the phase when it steps to the next one.
+    void tick()
+    {
+        const uint16_t remains = sequence.getRemains();
+        sequence.tick(Head::TickInterval);
+        remainsToHold = sequence.isHolding() ? 0 :
+            (remainsToHold - ((remains < Head::TickInterval) ? remains : Head::TickInterval));
+    }
+
+    uint8_t getPhase() const
+    {
+        return sequence.getPhase();
+    }
+
+    uint8_t getRepeated() const
+    {
+        return sequence.getRepeated();
+    }
+
+    bool isHolding() const
+    {
+        return sequence.isHolding();
+    }
+};
+
+#endif
@@ -0,0 +1,236 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_LOGGER_H
+#define SIGNAL_LOGGER_H
+
+#include <Arduino.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "SignalHal.h"
+
+////////////////////////////////////////////////
+
+enum LogLevels
+{
+    LogDebug,
+    LogInfo,
+    LogWarning,
+    LogError
+};
+
+// Leveled logger without heap allocation.
+// A record is formatted into a stack buffer and copied into a ring buffer,
+// which drain() writes to the UART only as far as its FIFO accepts without blocking.
+// Single producer / single consumer: Ticker callbacks run between loop() yields on ESP8266,
+// so log() calls never preempt each other.
+class SignalLogger
+{
+public:
+    static const uint16_t RecordSize = 128;
+    static const uint16_t BufferSize = 2048;   // must be power of 2
+
+private:
+    char buffer[BufferSize];
+    volatile uint16_t head;   // written by log()
+    volatile uint16_t tail;   // written by drain()
+
+    HardwareSerial* pSerial;
+    LogLevels minimumLevel;
+
+    uint32_t droppedCount;
+    uint32_t worstMicrosecond;
+
+    static char getLevelChar(const LogLevels level)
+    {
+        switch (level)
+        {
+            case LogDebug:
+                return 'D';
+            case LogInfo:
+                return 'I';
+            case LogWarning:
+                return 'W';
+            default:
+                return 'E';
+        }
+    }
+
+    void push(const char* pRecord, const uint16_t length)
+    {
+        const uint16_t currentHead = head;
+        const uint16_t freeSize = BufferSize - 1 - static_cast<uint16_t>((currentHead - tail) & (BufferSize - 1));
+        if (length > freeSize)
+        {
+            droppedCount++;
+            return;
+        }
+
+        for (uint16_t index = 0; index < length; index++)
+        {
+            buffer[(currentHead + index) & (BufferSize - 1)] = pRecord[index];
+        }
+
+        // Publish the record only after its bytes are written.
+        __sync_synchronize();
+        head = (currentHead + length) & (BufferSize - 1);
+    }
+
+public:
+    SignalLogger()
+        : head(0), tail(0), pSerial(nullptr), minimumLevel(LogInfo)
+        , droppedCount(0), worstMicrosecond(0)
+    {
+    }
+
+    void begin(HardwareSerial* pSerial, const LogLevels minimumLevel)
+    {
+        this->pSerial = pSerial;
+        this->minimumLevel = minimumLevel;
+    }
+
+    void vlog(const LogLevels level, const char* pFormat, va_list args)
+    {
+        if (level < minimumLevel)
+        {
+            return;
+        }
+
+        const uint32_t start = signalMicros();
+
+        char record[RecordSize];
+        int length = snprintf(record, RecordSize, "%lu %c ",
+            static_cast<unsigned long>(signalMillis()), getLevelChar(level));
+        const int messageLength = vsnprintf(record + length, RecordSize - length, pFormat, args);
+        if (messageLength > 0)
+        {
+            length += messageLength;
+        }
+        if (length > (RecordSize - 3))
+        {
+            length = RecordSize - 3;
+        }
+        record[length++] = '\r';
+        record[length++] = '\n';
+
+        push(record, static_cast<uint16_t>(length));
+
+        const uint32_t elapsed = signalMicros() - start;
+        if (elapsed > worstMicrosecond)
+        {
+            worstMicrosecond = elapsed;
+        }
+    }
+
+    void log(const LogLevels level, const char* pFormat, ...)
+    {
+        va_list args;
+        va_start(args, pFormat);
+        vlog(level, pFormat, args);
+        va_end(args);
+    }
+
+    void debug(const char* pFormat, ...)
+    {
+        va_list args;
+        va_start(args, pFormat);
+        vlog(LogDebug, pFormat, args);
+        va_end(args);
+    }
+
+    void info(const char* pFormat, ...)
+    {
+        va_list args;
+        va_start(args, pFormat);
+        vlog(LogInfo, pFormat, args);
+        va_end(args);
+    }
+
+    void warning(const char* pFormat, ...)
+    {
+        va_list args;
+        va_start(args, pFormat);
+        vlog(LogWarning, pFormat, args);
+        va_end(args);
+    }
+
+    void error(const char* pFormat, ...)
+    {
+        va_list args;
+        va_start(args, pFormat);
+        vlog(LogError, pFormat, args);
+        va_end(args);
+    }
+
+    // Write queued records to the UART without blocking, call it while idle.
+    void drain()
+    {
+        if (pSerial == nullptr)
+        {
+            return;
+        }
+
+        uint16_t currentTail = tail;
+        const uint16_t currentHead = head;
+
+        int writable = pSerial->availableForWrite();
+        while ((currentTail != currentHead) && (writable > 0))
+        {
+            const uint16_t end = (currentHead >= currentTail) ? currentHead : BufferSize;
+            uint16_t size = end - currentTail;
+            if (size > static_cast<uint16_t>(writable))
+            {
+                size = static_cast<uint16_t>(writable);
+            }
+
+            pSerial->write(reinterpret_cast<const uint8_t*>(buffer + currentTail), size);
+
+            currentTail = (currentTail + size) & (BufferSize - 1);
+            writable -= size;
+        }
+
+        tail = currentTail;
+    }
+
+    bool isEmpty() const
+    {
+        return head == tail;
+    }
+
+    uint32_t getDroppedCount() const
+    {
+        return droppedCount;
+    }
+
+    // Worst time spent in one log() call.
+    uint32_t getWorstMicrosecond() const
+    {
+        return worstMicrosecond;
+    }
+};
+
+// Define one instance in each sketch.
+extern SignalLogger logger;
+
+#endif
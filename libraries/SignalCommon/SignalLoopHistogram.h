@@ -0,0 +1,121 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_LOOP_HISTOGRAM_H
+#define SIGNAL_LOOP_HISTOGRAM_H
+
+#include <Arduino.h>
+
+#include "SignalHal.h"
+#include "SignalLogger.h"
+
+////////////////////////////////////////////////
+
+// Distribution of loop() iteration times in power of two msec buckets:
+// <1, <2, <4, <8, <16, <32, <64 and 64 msec or more.
+class SignalLoopHistogram
+{
+public:
+    static const uint8_t BucketCount = 8;
+
+private:
+    uint32_t buckets[BucketCount];
+    uint32_t lastMicrosecond;
+    uint32_t maxMicrosecond;
+    uint64_t totalMicrosecond;
+    bool started;
+
+public:
+    SignalLoopHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        memset(buckets, 0, sizeof buckets);
+        maxMicrosecond = 0;
+        totalMicrosecond = 0;
+        started = false;
+    }
+
+    // Call once at the top of every loop().
+    void mark()
+    {
+        const uint32_t now = signalMicros();
+        if (started)
+        {
+            record(now - lastMicrosecond);
+        }
+
+        lastMicrosecond = now;
+        started = true;
+    }
+
+    // One iteration measured by the owner, e.g. only the busy part of a sleeping loop.
+    void record(const uint32_t elapsedMicrosecond)
+    {
+        if (elapsedMicrosecond > maxMicrosecond)
+        {
+            maxMicrosecond = elapsedMicrosecond;
+        }
+        totalMicrosecond += elapsedMicrosecond;
+
+        uint32_t millisecond = elapsedMicrosecond / 1000;
+        uint8_t index = 0;
+        while ((millisecond != 0) && (index < (BucketCount - 1)))
+        {
+            millisecond >>= 1;
+            index++;
+        }
+        buckets[index]++;
+    }
+
+    uint32_t getMaxMicrosecond() const
+    {
+        return maxMicrosecond;
+    }
+
+    uint64_t getTotalMicrosecond() const
+    {
+        return totalMicrosecond;
+    }
+
+    // Iterations in bucket index, below (1 << index) msec except the last one.
+    uint32_t getBucket(const uint8_t index) const
+    {
+        return buckets[index];
+    }
+
+    void print(const char* pName) const
+    {
+        logger.info("%s loop: <1ms=%lu, <2=%lu, <4=%lu, <8=%lu, <16=%lu, <32=%lu, <64=%lu, more=%lu, max=%luusec",
+            pName,
+            static_cast<unsigned long>(buckets[0]), static_cast<unsigned long>(buckets[1]),
+            static_cast<unsigned long>(buckets[2]), static_cast<unsigned long>(buckets[3]),
+            static_cast<unsigned long>(buckets[4]), static_cast<unsigned long>(buckets[5]),
+            static_cast<unsigned long>(buckets[6]), static_cast<unsigned long>(buckets[7]),
+            static_cast<unsigned long>(maxMicrosecond));
+    }
+};
+
+#endif
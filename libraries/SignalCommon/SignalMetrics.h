@@ -0,0 +1,243 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_METRICS_H
+#define SIGNAL_METRICS_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "SignalHal.h"
+#include "SignalLogger.h"
+#include "SignalLoopHistogram.h"
+#include "SignalRouteStatistics.h"
+
+////////////////////////////////////////////////
+
+// Formats text lines into a stack buffer and hands it on in pieces of at most 512 bytes,
+// so a long answer is streamed (chunked HTTP, serial) without building a String.
+class SignalMetricsWriter
+{
+public:
+    typedef void (*WriteHandler)(void* pContext, const char* pText);
+
+private:
+    WriteHandler pWrite;
+    void* pContext;
+    char buffer[512];
+    size_t length;
+
+public:
+    SignalMetricsWriter(const WriteHandler pWrite, void* pContext)
+        : pWrite(pWrite), pContext(pContext), length(0)
+    {
+        buffer[0] = '\0';
+    }
+
+    // One line of at most 159 characters, the newline is added.
+    void line(const char* pFormat, ...)
+    {
+        char text[160];
+        va_list args;
+        va_start(args, pFormat);
+        vsnprintf(text, sizeof text - 1, pFormat, args);
+        va_end(args);
+        strcat(text, "\n");
+
+        const size_t textLength = strlen(text);
+        if ((length + textLength) >= sizeof buffer)
+        {
+            flush();
+        }
+        memcpy(buffer + length, text, textLength + 1);
+        length += textLength;
+    }
+
+    void flush()
+    {
+        if (length != 0)
+        {
+            pWrite(pContext, buffer);
+            length = 0;
+        }
+    }
+};
+
+// Health of an unattended node: heap, stack, loop() iteration times, WiFi and timer overruns,
+// plus the per route statistics of a web server, in the Prometheus text format.
+// Counting is a few increments in loop() context, cheap enough to stay on.
+class SignalMetrics
+{
+private:
+    SignalLoopHistogram loopHistogram;
+    uint32_t reconnectCount;   // connections regained after the first one
+    bool connected;
+    bool everConnected;
+
+    // usec as seconds, e.g. "0.000064".
+    static void formatSeconds(char* pBuffer, const size_t size, const uint64_t microsecond)
+    {
+        snprintf(pBuffer, size, "%lu.%06lu",
+            static_cast<unsigned long>(microsecond / 1000000), static_cast<unsigned long>(microsecond % 1000000));
+    }
+
+    static void writeSum(SignalMetricsWriter& writer, const char* pName, const char* pLabels, const uint64_t microsecond)
+    {
+        char seconds[24];
+        formatSeconds(seconds, sizeof seconds, microsecond);
+        writer.line("%s_sum%s %s", pName, pLabels, seconds);
+    }
+
+    void checkConnection()
+    {
+        const bool now = (WiFi.status() == WL_CONNECTED);
+        if (now && !connected)
+        {
+            reconnectCount += everConnected ? 1 : 0;
+            everConnected = true;
+        }
+        connected = now;
+    }
+
+public:
+    SignalMetrics()
+        : reconnectCount(0), connected(false), everConnected(false)
+    {
+    }
+
+    // Call once at the top of every loop() that doesn't sleep.
+    void mark()
+    {
+        loopHistogram.mark();
+        checkConnection();
+    }
+
+    // For a loop() that sleeps: only the busy part of the iteration.
+    void record(const uint32_t elapsedMicrosecond)
+    {
+        loopHistogram.record(elapsedMicrosecond);
+        checkConnection();
+    }
+
+    uint32_t getReconnectCount() const
+    {
+        return reconnectCount;
+    }
+
+    // Heap, stack, WiFi, loop() histogram and the given timer overruns.
+    void writePrometheus(SignalMetricsWriter& writer, const uint32_t overrunCount) const
+    {
+        writer.line("# TYPE signal_heap_free_bytes gauge");
+        writer.line("signal_heap_free_bytes %lu", static_cast<unsigned long>(signalFreeHeap()));
+        writer.line("# TYPE signal_heap_max_block_bytes gauge");
+        writer.line("signal_heap_max_block_bytes %lu", static_cast<unsigned long>(signalMaxFreeBlock()));
+        writer.line("# TYPE signal_heap_fragmentation_percent gauge");
+        writer.line("signal_heap_fragmentation_percent %u", signalHeapFragmentation());
+        writer.line("# TYPE signal_stack_free_min_bytes gauge");
+        writer.line("signal_stack_free_min_bytes %lu", static_cast<unsigned long>(signalFreeStack()));
+        writer.line("# TYPE signal_wifi_rssi_dbm gauge");
+        writer.line("signal_wifi_rssi_dbm %ld", static_cast<long>(connected ? WiFi.RSSI() : 0));
+        writer.line("# TYPE signal_wifi_reconnects_total counter");
+        writer.line("signal_wifi_reconnects_total %lu", static_cast<unsigned long>(reconnectCount));
+        writer.line("# TYPE signal_tick_overruns_total counter");
+        writer.line("signal_tick_overruns_total %lu", static_cast<unsigned long>(overrunCount));
+
+        writer.line("# TYPE signal_loop_duration_seconds histogram");
+        uint32_t count = 0;
+        for (uint8_t index = 0; index < (SignalLoopHistogram::BucketCount - 1); index++)
+        {
+            count += loopHistogram.getBucket(index);
+            char seconds[24];
+            formatSeconds(seconds, sizeof seconds, (1UL << index) * 1000);
+            writer.line("signal_loop_duration_seconds_bucket{le=\"%s\"} %lu", seconds, static_cast<unsigned long>(count));
+        }
+        count += loopHistogram.getBucket(SignalLoopHistogram::BucketCount - 1);
+        writer.line("signal_loop_duration_seconds_bucket{le=\"+Inf\"} %lu", static_cast<unsigned long>(count));
+        writeSum(writer, "signal_loop_duration_seconds", "", loopHistogram.getTotalMicrosecond());
+        writer.line("signal_loop_duration_seconds_count %lu", static_cast<unsigned long>(count));
+    }
+
+    // Requests, errors and latency histogram per route.
+    template <uint8_t Size>
+    static void writePrometheus(SignalMetricsWriter& writer, const SignalRouteStatistics<Size>& routes)
+    {
+        writer.line("# TYPE signal_http_requests_total counter");
+        for (uint8_t route = 0; route < routes.getRouteCount(); route++)
+        {
+            writer.line("signal_http_requests_total{path=\"%s\"} %lu",
+                routes.getPath(route), static_cast<unsigned long>(routes.getCount(route)));
+        }
+        writer.line("# TYPE signal_http_errors_total counter");
+        for (uint8_t route = 0; route < routes.getRouteCount(); route++)
+        {
+            writer.line("signal_http_errors_total{path=\"%s\"} %lu",
+                routes.getPath(route), static_cast<unsigned long>(routes.getErrors(route)));
+        }
+
+        writer.line("# TYPE signal_http_request_duration_seconds histogram");
+        for (uint8_t route = 0; route < routes.getRouteCount(); route++)
+        {
+            const char* pPath = routes.getPath(route);
+            uint32_t count = 0;
+            for (uint8_t index = 0; index < (SIGNAL_ROUTE_BUCKETS - 1); index++)
+            {
+                count += routes.getBucket(route, index);
+                char seconds[24];
+                formatSeconds(seconds, sizeof seconds, 2UL << index);
+                writer.line("signal_http_request_duration_seconds_bucket{path=\"%s\",le=\"%s\"} %lu",
+                    pPath, seconds, static_cast<unsigned long>(count));
+            }
+            count += routes.getBucket(route, SIGNAL_ROUTE_BUCKETS - 1);
+            writer.line("signal_http_request_duration_seconds_bucket{path=\"%s\",le=\"+Inf\"} %lu",
+                pPath, static_cast<unsigned long>(count));
+
+            char labels[48];
+            snprintf(labels, sizeof labels, "{path=\"%s\"}", pPath);
+            writeSum(writer, "signal_http_request_duration_seconds", labels, routes.getTotalMicrosecond(route));
+            writer.line("signal_http_request_duration_seconds_count%s %lu", labels, static_cast<unsigned long>(count));
+        }
+    }
+
+    // The same over the logger, for nodes without a web server.
+    void print(const char* pName, const uint32_t overrunCount) const
+    {
+        logger.info("%s heap: free=%lu, block=%lu, fragmentation=%u%%, stack=%lu",
+            pName,
+            static_cast<unsigned long>(signalFreeHeap()), static_cast<unsigned long>(signalMaxFreeBlock()),
+            signalHeapFragmentation(), static_cast<unsigned long>(signalFreeStack()));
+        logger.info("%s WiFi: rssi=%lddBm, reconnects=%lu, overruns=%lu",
+            pName, static_cast<long>(connected ? WiFi.RSSI() : 0),
+            static_cast<unsigned long>(reconnectCount), static_cast<unsigned long>(overrunCount));
+        loopHistogram.print(pName);
+    }
+
+    // Starts a new loop() histogram, counters keep running.
+    void resetLoop()
+    {
+        loopHistogram.reset();
+    }
+};
+
+#endif
@@ -0,0 +1,618 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_NODE_CONTROLLER_H
+#define SIGNAL_NODE_CONTROLLER_H
+
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+
+#include <functional>
+
+#include "SignalHal.h"
+#include "SignalLogger.h"
+#include "SignalHeadMachine.h"
+#include "SignalBroadcast.h"
+#include "SignalCommandQueue.h"
+#include "SignalEventHub.h"
+#include "SignalClock.h"
+#include "SignalPlan.h"
+#include "SignalRouteStatistics.h"
+#include "SignalBenchmark.h"
+#include "SignalTrace.h"
+#include "SignalMetrics.h"
+
+////////////////////////////////////////////////
+
+// Controller of a signal node, generated from a head description:
+//
+//   struct Head
+//   {
+//       static const SignalNodes Node;                    // group told to the other nodes
+//       static const uint16_t TickInterval;               // msec, the shortest phase duration
+//       static const uint8_t StatusPin;                   // toggled every tick
+//       static const uint8_t LampCount;
+//       static const uint8_t lampPins[LampCount];
+//       static const SignalPhase phases[];                // PROGMEM, phase 0 is the initial one
+//       static const SignalPhaseRule rules[];             // one per phase
+//       static const char* getGoPath();                   // e.g. "/api/walk"
+//       static const char* getGoName();                   // e.g. "Walk"
+//   };
+//
+// A new head type, a bicycle signal or an arrow, is a Head with its tables.
+// The phases and rules run in SignalHeadMachine, this class adds the network around it.
+template <typename Head>
+class SignalNodeController
+{
+private:
+    ESP8266WebServer* pServer;
+    HardwareSerial* pSerial;
+
+    SignalTimer ticker;
+
+    volatile bool tickStatus;
+
+    SignalHeadMachine<Head> head;
+    SignalStateBroadcaster broadcaster;
+    SignalStateListener listener;
+    SignalCommandQueue<8> commands;
+    SignalEventHub events;
+    uint16_t publishedPhase;
+    SignalClockFollower clock;
+    SignalPlan<8> plan;
+    int32_t planLateness;     // msec, last plan step applied after its time
+    SignalRouteStatistics<12> routeStatistics;
+    int lastStatusCode;       // of the running handler, 0 if it didn't answer
+    SignalTrace trace;
+    SignalMetrics metrics;
+    volatile uint32_t tickOverruns;   // ticks later than half an interval
+    uint32_t lastTickAt;
+
+    void send(const int statusCode, const String& text)
+    {
+        lastStatusCode = statusCode;
+        pServer->send(statusCode, "text/plain", text);
+    }
+
+    // Handlers run through here, so each one's latency and answer are recorded.
+    void measure(const int route, const std::function<void()>& handler)
+    {
+        lastStatusCode = 0;
+        trace.record(SignalTraceRequest, static_cast<uint8_t>(route));
+        const uint32_t startedAt = signalMicros();
+        handler();
+        routeStatistics.record(route, signalMicros() - startedAt, lastStatusCode);
+        trace.record(SignalTraceResponse, static_cast<uint8_t>(route), static_cast<uint16_t>(lastStatusCode));
+    }
+
+    void on(const char* pPath, const std::function<void()>& handler)
+    {
+        const int route = routeStatistics.add(pPath);
+        pServer->on(pPath, HTTP_GET, [this, route, handler]() { measure(route, handler); });
+    }
+
+    // JSON of the routes since the last ?reset, for comparing load runs across versions.
+    // Not measured itself, so polling it doesn't disturb a run.
+    void requestStatistics()
+    {
+        pServer->send(200, "application/json", routeStatistics.toJson());
+        if (pServer->hasArg("reset"))
+        {
+            routeStatistics.reset();
+        }
+    }
+
+    static void writeToServer(void* pContext, const char* pText)
+    {
+        static_cast<ESP8266WebServer*>(pContext)->sendContent(pText);
+    }
+
+    static void writeToSerial(void* pContext, const char* pText)
+    {
+        static_cast<HardwareSerial*>(pContext)->print(pText);
+    }
+
+    // Prometheus text of the node health and the routes, streamed in chunks.
+    // Not measured itself, so scraping it doesn't disturb a run.
+    void requestMetrics()
+    {
+        pServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
+        pServer->send(200, "text/plain; version=0.0.4", "");
+        SignalMetricsWriter writer(writeToServer, pServer);
+        metrics.writePrometheus(writer, tickOverruns);
+        SignalMetrics::writePrometheus(writer, routeStatistics);
+        writer.flush();
+        pServer->sendContent("");
+    }
+
+    // Chrome trace-event JSON of the last events, route numbers are in the /api/stats order.
+    // Not measured itself, the trace would only show its own export.
+    void requestTrace()
+    {
+        pServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
+        pServer->send(200, "application/json", "");
+        trace.toChromeJson(Head::Node, writeToServer, pServer);
+        pServer->sendContent("");
+    }
+
+    // Decimal argument, false if it has no digits, trailing text or doesn't fit.
+    bool getNumberArg(const char* pName, uint32_t& value)
+    {
+        const String text = pServer->arg(pName);
+        char* pEnd = nullptr;
+        const unsigned long number = strtoul(text.c_str(), &pEnd, 10);
+        if ((pEnd == text.c_str()) || (*pEnd != '\0') || (number > UINT32_MAX))
+        {
+            return false;
+        }
+        value = static_cast<uint32_t>(number);
+        return true;
+    }
+
+    // Clients that wait are served by the event hub on its own port, ESP8266WebServer
+    // would take no other client while one is held open.
+    void redirectToEvents(const String& target)
+    {
+        pServer->sendHeader("Location",
+            "http://" + WiFi.localIP().toString() + ":" + String(SIGNAL_EVENT_PORT) + target);
+        send(307, "Served on the event port.");
+    }
+
+    // With ?since=<sequence>&wait=<msec> the answer waits until the status moves past since:
+    // at once if it already has, otherwise redirected to the event hub.
+    void requestStatus()
+    {
+        if (pServer->hasArg("since"))
+        {
+            uint32_t since = 0;
+            uint32_t wait = SIGNAL_EVENT_MAX_WAIT;
+            if (!getNumberArg("since", since) || (pServer->hasArg("wait") && !getNumberArg("wait", wait)))
+            {
+                send(400, "Invalid since or wait.");
+                return;
+            }
+            if (since == events.getSequence())
+            {
+                redirectToEvents("/api/status?since=" + String(static_cast<unsigned long>(since)) +
+                    "&wait=" + String(static_cast<unsigned long>(wait)));
+                return;
+            }
+            pServer->sendHeader("X-Signal-Sequence", String(static_cast<unsigned long>(events.getSequence())));
+        }
+
+        send(200, head.getStatusText());
+    }
+
+    // Queue a command for the next tick, returns its sequence or 0 if the queue is full.
+    uint32_t enqueue(const SignalCommands command, const char* pName, const char* pFrom)
+    {
+        const uint32_t id = commands.push(command);
+        trace.record(SignalTraceEnqueue, command, static_cast<uint16_t>(id));
+        if (id == 0)
+        {
+            logger.warning("%s from %s rejected, queue full.", pName, pFrom);
+        }
+        else
+        {
+            logger.info("%s requested %lu from %s.", pName, static_cast<unsigned long>(id), pFrom);
+        }
+        return id;
+    }
+
+    // Answers with the command sequence, /api/command?sequence= tells when it's applied.
+    void requestCommand(const SignalCommands command, const char* pName)
+    {
+        const uint32_t id = enqueue(command, pName, "HTTP");
+        if (id == 0)
+        {
+            send(503, "Busy.");
+            return;
+        }
+
+        char result[32];
+        snprintf(result, sizeof result, "%s requested %lu.", pName, static_cast<unsigned long>(id));
+        send(200, result);
+    }
+
+    void requestCompletion()
+    {
+        const uint32_t id = strtoul(pServer->arg("sequence").c_str(), nullptr, 10);
+        if ((id == 0) || (static_cast<int32_t>(commands.getLastSequence() - id) < 0))
+        {
+            send(404, "Unknown command.");
+            return;
+        }
+
+        if (!commands.isCompleted(id))
+        {
+            send(200, "Pending");
+        }
+        else if (!commands.isRemembered(id))
+        {
+            send(200, "Expired");   // completed too long ago, the outcome is gone
+        }
+        else
+        {
+            send(200, commands.isSkipped(id) ? "Skipped" : "Applied");
+        }
+    }
+
+    void requestNotFound()
+    {
+        send(404, "Invalid resource path.");
+    }
+
+    // Own state, or the other node's as last broadcast.
+    bool isConditionMet(const uint8_t condition) const
+    {
+        if (condition == 0)
+        {
+            return true;
+        }
+
+        const SignalNodes conditionNode = static_cast<SignalNodes>(SIGNAL_CONDITION_NODE(condition));
+        const uint8_t conditionState = SIGNAL_CONDITION_STATE(condition);
+        if (conditionNode == Head::Node)
+        {
+            return head.getSignalState() == conditionState;
+        }
+
+        return listener.isAlive(conditionNode) && (listener.getState(conditionNode) == conditionState);
+    }
+
+    // Apply queued commands in order while no transition runs, returns how many changed the phase.
+    // A command whose condition doesn't hold waits for it until its deadline, then is skipped.
+    uint8_t drain()
+    {
+        uint8_t applied = 0;
+        SignalCommand command;
+        while (head.isHolding() && commands.peek(command))
+        {
+            if (!isConditionMet(command.condition))
+            {
+                if (static_cast<int32_t>(signalMillis() - command.waitUntil) < 0)
+                {
+                    break;
+                }
+                logger.info("Command %lu skipped, condition not met.", static_cast<unsigned long>(command.sequence));
+                commands.complete(false);
+                continue;
+            }
+
+            const uint8_t phase = head.getPhase();
+            head.apply(command.command);
+            applied += (head.getPhase() != phase) ? 1 : 0;
+            commands.complete();
+        }
+
+        return applied;
+    }
+
+    // Apply what can be applied outside the tick, then restart the tick from the new phase
+    // so its duration stays whole. Consumes the queue from loop(), safe as the tick never
+    // runs in the middle of it, see SignalCommandQueue.
+    void drainNow()
+    {
+        if (drain() != 0)
+        {
+            ticker.attach(Head::TickInterval, tickHandler, this);
+        }
+    }
+
+    // Queue all commands or none, then apply what can be applied right away.
+    // Returns the sequence of the first command, 0 if the queue can't take them all.
+    uint32_t runBatch(const SignalMessage* pCommands, const uint8_t count, const char* pFrom)
+    {
+        if (commands.getFree() < count)
+        {
+            logger.warning("Batch of %u from %s rejected, queue full.", count, pFrom);
+            return 0;
+        }
+
+        uint32_t first = 0;
+        for (uint8_t index = 0; index < count; index++)
+        {
+            const uint32_t id = commands.push(pCommands[index].command, pCommands[index].condition, pCommands[index].remains);
+            trace.record(SignalTraceEnqueue, pCommands[index].command, static_cast<uint16_t>(id));
+            first = (first == 0) ? id : first;
+        }
+        logger.info("Batch %lu-%lu from %s.", static_cast<unsigned long>(first),
+            static_cast<unsigned long>(first + count - 1), pFrom);
+
+        drainNow();
+
+        return first;
+    }
+
+    // steps=<command>[:<node>=<state>],...&wait=<msec>, answers the resulting status
+    // and the command sequences, e.g. "Stopped\n12-13 done=1 skipped=1".
+    void requestBatch()
+    {
+        // Room for the longest steps, a longer text is refused rather than cut.
+        const String stepsText = pServer->arg("steps");
+        char steps[SIGNAL_BATCH_TEXT_SIZE];
+        if (stepsText.length() >= sizeof steps)
+        {
+            send(400, "Invalid steps.");
+            return;
+        }
+        memcpy(steps, stepsText.c_str(), stepsText.length() + 1);
+        // wait travels as the 16bit remains field, larger values are refused rather than wrapped.
+        const String waitText = pServer->arg("wait");
+        char* pEnd = nullptr;
+        const unsigned long waitValue = strtoul(waitText.c_str(), &pEnd, 10);
+        if ((*pEnd != '\0') || (waitValue > UINT16_MAX))
+        {
+            send(400, "Invalid wait.");
+            return;
+        }
+        const uint16_t wait = static_cast<uint16_t>(waitValue);
+
+        SignalMessage batch[SIGNAL_BATCH_MAX_COUNT];
+        const uint8_t count = parseSignalBatch(steps, wait, batch, SIGNAL_BATCH_MAX_COUNT);
+        if (count == 0)
+        {
+            send(400, "Invalid steps.");
+            return;
+        }
+
+        const uint32_t first = runBatch(batch, count, "HTTP");
+        if (first == 0)
+        {
+            send(503, "Busy.");
+            return;
+        }
+
+        const uint32_t last = first + count - 1;
+        uint8_t done = 0;
+        uint8_t skipped = 0;
+        for (uint32_t id = first; id <= last; id++)
+        {
+            done += commands.isApplied(id) ? 1 : 0;
+            skipped += commands.isSkipped(id) ? 1 : 0;
+        }
+
+        String result = head.getStatusText();
+        char line[48];
+        snprintf(line, sizeof line, "\n%lu-%lu done=%u skipped=%u",
+            static_cast<unsigned long>(first), static_cast<unsigned long>(last), done, skipped);
+        result += line;
+
+        send(200, result);
+    }
+
+    // Plan steps run at their master clock time on the local clock,
+    // so the lamps of all nodes change together.
+    void schedule(const SignalMessage* pSteps, const uint8_t count)
+    {
+        if (!clock.isSynchronized())
+        {
+            logger.warning("Plan of %u rejected, clock not synchronized.", count);
+            return;
+        }
+
+        for (uint8_t index = 0; index < count; index++)
+        {
+            SignalPlanStep step;
+            step.at = clock.toLocal(pSteps[index].sequence);
+            step.wait = pSteps[index].remains;
+            step.command = pSteps[index].command;
+            step.condition = pSteps[index].condition;
+            if (!plan.add(step))
+            {
+                logger.warning("Plan step rejected, %u pending.", plan.getCount());
+            }
+        }
+    }
+
+    void runPlan()
+    {
+        SignalPlanStep step;
+        while (plan.take(signalMillis(), step))
+        {
+            const uint32_t id = commands.push(step.command, step.condition, step.wait);
+            trace.record(SignalTraceEnqueue, step.command, static_cast<uint16_t>(id));
+            if (id == 0)
+            {
+                logger.warning("Plan step rejected, queue full.");
+                continue;
+            }
+
+            drainNow();
+            planLateness = static_cast<int32_t>(signalMillis() - step.at);
+            logger.info("Plan step %u applied %ldmsec late.", step.command, static_cast<long>(planLateness));
+        }
+    }
+
+    // Clock offset and delay to the master, the skew to the other nodes is at most
+    // half the delay plus the plan lateness. resets counts the dropped sample windows.
+    void requestClock()
+    {
+        char result[96];
+        snprintf(result, sizeof result, "offset=%ld delay=%lu late=%ld resets=%u%s",
+            static_cast<long>(clock.getOffset()), static_cast<unsigned long>(clock.getDelay()),
+            static_cast<long>(planLateness), clock.getResets(), clock.isSynchronized() ? "" : " unsynchronized");
+        send(200, result);
+    }
+
+    void tick()
+    {
+        trace.record(SignalTraceTick);
+
+        // The Ticker waits while loop() runs, a long handler delays the phases.
+        const uint32_t now = signalMillis();
+        if ((lastTickAt != 0) && ((now - lastTickAt) > (Head::TickInterval + Head::TickInterval / 2)))
+        {
+            tickOverruns++;
+        }
+        lastTickAt = now;
+
+        // Commands wait while a transition runs, then apply in order.
+        if (head.isHolding())
+        {
+            drain();
+        }
+        else
+        {
+            head.tick();
+        }
+
+        signalWritePin(Head::StatusPin, tickStatus);
+        tickStatus = !tickStatus;
+    }
+
+    static void tickHandler(SignalNodeController* pThis)
+    {
+        pThis->tick();
+    }
+
+public:
+    SignalNodeController()
+        : pServer(nullptr), pSerial(nullptr), tickStatus(false), publishedPhase(0xffff), planLateness(0), lastStatusCode(0)
+        , tickOverruns(0), lastTickAt(0)
+    {
+    }
+
+    void Init(ESP8266WebServer* pServer, HardwareSerial* pSerial)
+    {
+        this->pServer = pServer;
+        this->pSerial = pSerial;
+
+        for (uint8_t index = 0; index < Head::LampCount; index++)
+        {
+            signalPinOutput(Head::lampPins[index]);
+        }
+        signalPinOutput(Head::StatusPin);
+
+        delay(100);
+
+        head.begin(&trace);
+        signalWritePin(Head::StatusPin, false);
+
+        on("/api/status", [&]() { requestStatus(); });
+        on(Head::getGoPath(), [&]() { requestCommand(SignalCommandGo, Head::getGoName()); });
+        on("/api/stop", [&]() { requestCommand(SignalCommandStop, "Stop"); });
+        on("/api/command", [&]() { requestCompletion(); });
+        on("/api/batch", [&]() { requestBatch(); });
+        on("/api/events", [&]() { redirectToEvents("/api/events"); });
+        on("/api/clock", [&]() { requestClock(); });
+        pServer->on("/api/stats", HTTP_GET, [&]() { requestStatistics(); });
+        pServer->on("/api/trace", HTTP_GET, [&]() { requestTrace(); });
+        pServer->on("/api/metrics", HTTP_GET, [&]() { requestMetrics(); });
+
+        const int notFoundRoute = routeStatistics.add("*");
+        pServer->onNotFound([this, notFoundRoute]() { measure(notFoundRoute, [&]() { requestNotFound(); }); });
+        routeStatistics.reset();
+
+        events.begin();
+        listener.begin();
+        clock.begin(WiFi.gatewayIP());   // the button serves the AP and the master clock
+        broadcaster.begin(Head::Node, head.getSignalState());
+
+        ticker.attach(Head::TickInterval, tickHandler, this);
+    }
+
+    // Status text, rule lookup and the message codec, the per-command path of a node
+    // and the button's status parsing. Call after Init(), it doesn't change the phase.
+    void benchmark(SignalBenchmark& benchmark)
+    {
+        benchmark.run("getStatusText", 1000, [&]() { SignalBenchmark::keep(head.getStatusText()); });
+        benchmark.run("applyQuery", 1000, [&]() { head.apply(SignalCommandQuery); });
+        benchmark.run("traceRecord", 1000, [&]() { trace.record(SignalTraceTick); });
+        trace.clear();
+
+        SignalMessage message;
+        memset(&message, 0, sizeof message);
+        message.type = SignalMessageStatus;
+        message.node = Head::Node;
+        message.state = head.getSignalState();
+        uint8_t packet[SIGNAL_MESSAGE_SIZE];
+        benchmark.run("encodeSignalMessage", 1000, [&]()
+        {
+            encodeSignalMessage(packet, message);
+            SignalBenchmark::keep(packet);
+        });
+        benchmark.run("decodeSignalMessage", 1000, [&]()
+        {
+            SignalBenchmark::keep(decodeSignalMessage(packet, sizeof packet, message));
+        });
+
+        // A registry of its own, the node's one keeps only real senders.
+        SignalStateListener registry;
+        const IPAddress address(192, 168, 4, 254);
+        registry.update(address, message);
+        benchmark.run("listenerUpdate", 1000, [&]() { registry.update(address, message); });
+        benchmark.run("listenerGetState", 1000, [&]()
+        {
+            SignalBenchmark::keep(registry.getState(Head::Node));
+        });
+    }
+
+    void handle()
+    {
+        metrics.mark();
+        clock.handle();
+        broadcaster.setSynchronized(clock.isSynchronized());
+        runPlan();
+
+        // A waiting condition may just have been met.
+        if (listener.poll())
+        {
+            drainNow();
+        }
+
+        SignalMessage batch[8];
+        uint8_t count;
+        while ((count = broadcaster.receive(batch, 8)) != 0)
+        {
+            if (batch[0].type == SignalMessagePlan)
+            {
+                schedule(batch, count);
+            }
+            else
+            {
+                runBatch(batch, count, "UDP");
+            }
+            broadcaster.reply(head.getSignalState(), head.getRemainsTicks());
+        }
+
+        broadcaster.update(head.getSignalState(), head.getRemainsTicks());
+
+        // The tick changes phases, waiting HTTP clients are answered from here.
+        const uint16_t phase = (head.getPhase() << 8) | head.getRepeated();
+        if (phase != publishedPhase)
+        {
+            publishedPhase = phase;
+            events.publish(head.getStatusText().c_str());
+        }
+        events.step();
+
+        // 't' on the console dumps the trace as /api/trace does.
+        if ((pSerial->available() > 0) && (pSerial->read() == 't'))
+        {
+            trace.toChromeJson(Head::Node, writeToSerial, pSerial);
+            pSerial->println();
+        }
+    }
+};
+
+#endif
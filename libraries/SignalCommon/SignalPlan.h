@@ -0,0 +1,105 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_PLAN_H
+#define SIGNAL_PLAN_H
+
+#include <stdint.h>
+#include <string.h>
+
+////////////////////////////////////////////////
+
+struct SignalPlanStep
+{
+    uint32_t at;           // local millis(), converted from the master clock
+    uint16_t wait;         // msec it may wait for its condition
+    uint8_t command;       // SignalCommands
+    uint8_t condition;     // SIGNAL_CONDITION() or 0
+};
+
+// Pending steps of a distributed phase plan in time order. Used only from loop().
+// Plans are sent more than once over UDP, so a step equal to a pending one is dropped.
+template <uint8_t Size>
+class SignalPlan
+{
+private:
+    SignalPlanStep steps[Size];
+    uint8_t count;
+
+    static bool isEqual(const SignalPlanStep& lhs, const SignalPlanStep& rhs)
+    {
+        return (lhs.at == rhs.at) && (lhs.wait == rhs.wait) &&
+            (lhs.command == rhs.command) && (lhs.condition == rhs.condition);
+    }
+
+public:
+    SignalPlan()
+        : count(0)
+    {
+    }
+
+    // false if the plan is full.
+    bool add(const SignalPlanStep& step)
+    {
+        for (uint8_t index = 0; index < count; index++)
+        {
+            if (isEqual(steps[index], step))
+            {
+                return true;
+            }
+        }
+        if (count >= Size)
+        {
+            return false;
+        }
+
+        uint8_t index = count++;
+        while ((index > 0) && (static_cast<int32_t>(steps[index - 1].at - step.at) > 0))
+        {
+            steps[index] = steps[index - 1];
+            index--;
+        }
+        steps[index] = step;
+        return true;
+    }
+
+    // The first step if it is due at now.
+    bool take(const uint32_t now, SignalPlanStep& step)
+    {
+        if ((count == 0) || (static_cast<int32_t>(now - steps[0].at) < 0))
+        {
+            return false;
+        }
+
+        step = steps[0];
+        count--;
+        memmove(steps, steps + 1, count * sizeof steps[0]);
+        return true;
+    }
+
+    uint8_t getCount() const
+    {
+        return count;
+    }
+};
+
+#endif
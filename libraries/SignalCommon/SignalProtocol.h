@@ -0,0 +1,283 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_PROTOCOL_H
+#define SIGNAL_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Binary status and command messages exchanged by the signal nodes.
+// Fixed size, big endian, CRC protected. Pure calculation without Arduino APIs.
+// A datagram may carry several command messages back to back, applied as one batch.
+//
+//   0  magic 'S'          1  version           2  type        3  node
+//   4  state              5  command           6  flags       7  condition (0: none)
+//   8  remains (16bit)   10  sequence (32bit)  14  CRC-16/CCITT of bytes 0-13
+//
+// Version 2 gave byte 7 and the command remains their meaning (version 1 ignored both),
+// so version 1 nodes drop the frames instead of applying conditional commands at once.
+// Unknown flag bits are rejected as well: a new one comes with a new version.
+
+////////////////////////////////////////////////
+
+#define SIGNAL_PROTOCOL_MAGIC 0x53   // 'S'
+#define SIGNAL_PROTOCOL_VERSION 2
+#define SIGNAL_MESSAGE_SIZE 16
+
+enum SignalMessageTypes
+{
+    SignalMessageStatus,      // node to any: current state
+    SignalMessageCommand,     // any to node: request, answered by a status
+    SignalMessagePlan,        // time master to node: command applied at a master clock time
+    SignalMessageTypeCount
+};
+
+// Group of a node, several signal heads may share one.
+enum SignalNodes
+{
+    SignalNodeRoad,
+    SignalNodePedestrian,
+    SignalNodeCount
+};
+
+// State as seen from the other nodes, independent of each node's phase table.
+enum SignalStates
+{
+    SignalStateStopped,
+    SignalStateGoing,         // road going, pedestrian walking
+    SignalStateTransition,    // road will stop, pedestrian blinking
+    SignalStateCount
+};
+
+enum SignalCommands
+{
+    SignalCommandQuery,       // only answer the status
+    SignalCommandStop,
+    SignalCommandGo,          // road go, pedestrian walk
+    SignalCommandCount
+};
+
+#define SIGNAL_FLAG_TRANSITION 0x01     // status sent because the state just changed
+#define SIGNAL_FLAG_SYNCHRONIZED 0x02   // node follows the master clock, plans can be sent
+#define SIGNAL_FLAG_MASK (SIGNAL_FLAG_TRANSITION | SIGNAL_FLAG_SYNCHRONIZED)
+
+// Command applies only while the node is in the state, see SignalCommandQueue.
+#define SIGNAL_CONDITION(node, state) static_cast<uint8_t>(0x80 | ((node) << 4) | (state))
+#define SIGNAL_CONDITION_NODE(condition) (((condition) >> 4) & 0x07)
+#define SIGNAL_CONDITION_STATE(condition) ((condition) & 0x0f)
+
+struct SignalMessage
+{
+    uint8_t type;
+    uint8_t node;
+    uint8_t state;
+    uint8_t command;
+    uint8_t flags;
+    uint8_t condition;    // command: SIGNAL_CONDITION() or 0
+    uint16_t remains;     // status: ticks until the state ends by itself, 0 if it holds
+                          // command, plan: msec it may wait for its condition, 0 checks once
+    uint32_t sequence;    // status: increments on every transition, command: chosen by the sender
+                          // plan: master clock msec to apply at, see SignalClock
+};
+
+static inline uint16_t calculateSignalCrc(const uint8_t* p, const size_t size)
+{
+    uint16_t crc = 0xffff;
+    for (size_t index = 0; index < size; index++)
+    {
+        crc ^= static_cast<uint16_t>(p[index]) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline void encodeSignalMessage(uint8_t* p, const SignalMessage& message)
+{
+    p[0] = SIGNAL_PROTOCOL_MAGIC;
+    p[1] = SIGNAL_PROTOCOL_VERSION;
+    p[2] = message.type;
+    p[3] = message.node;
+    p[4] = message.state;
+    p[5] = message.command;
+    p[6] = message.flags;
+    p[7] = message.condition;
+    p[8] = static_cast<uint8_t>(message.remains >> 8);
+    p[9] = static_cast<uint8_t>(message.remains);
+    p[10] = static_cast<uint8_t>(message.sequence >> 24);
+    p[11] = static_cast<uint8_t>(message.sequence >> 16);
+    p[12] = static_cast<uint8_t>(message.sequence >> 8);
+    p[13] = static_cast<uint8_t>(message.sequence);
+
+    const uint16_t crc = calculateSignalCrc(p, SIGNAL_MESSAGE_SIZE - 2);
+    p[14] = static_cast<uint8_t>(crc >> 8);
+    p[15] = static_cast<uint8_t>(crc);
+}
+
+// Rejects anything malformed, so the fields are always in range afterwards.
+static inline bool decodeSignalMessage(const uint8_t* p, const size_t size, SignalMessage& message)
+{
+    if ((size != SIGNAL_MESSAGE_SIZE) ||
+        (p[0] != SIGNAL_PROTOCOL_MAGIC) || (p[1] != SIGNAL_PROTOCOL_VERSION))
+    {
+        return false;
+    }
+    if (calculateSignalCrc(p, SIGNAL_MESSAGE_SIZE - 2) != ((static_cast<uint16_t>(p[14]) << 8) | p[15]))
+    {
+        return false;
+    }
+    if ((p[2] >= SignalMessageTypeCount) || (p[3] >= SignalNodeCount) ||
+        (p[4] >= SignalStateCount) || (p[5] >= SignalCommandCount) || ((p[6] & ~SIGNAL_FLAG_MASK) != 0))
+    {
+        return false;
+    }
+    if ((p[7] != 0) && (((p[7] & 0x80) == 0) ||
+        (SIGNAL_CONDITION_NODE(p[7]) >= SignalNodeCount) || (SIGNAL_CONDITION_STATE(p[7]) >= SignalStateCount)))
+    {
+        return false;
+    }
+
+    message.type = p[2];
+    message.node = p[3];
+    message.state = p[4];
+    message.command = p[5];
+    message.flags = p[6];
+    message.condition = p[7];
+    message.remains = static_cast<uint16_t>((p[8] << 8) | p[9]);
+    message.sequence = (static_cast<uint32_t>(p[10]) << 24) | (static_cast<uint32_t>(p[11]) << 16) |
+        (static_cast<uint32_t>(p[12]) << 8) | static_cast<uint32_t>(p[13]);
+
+    return true;
+}
+
+////////////////////////////////////////////////
+
+// Names used by the text API, -1 if unknown.
+
+static inline int parseSignalNode(const char* pName)
+{
+    if (strcmp(pName, "road") == 0)
+    {
+        return SignalNodeRoad;
+    }
+    if (strcmp(pName, "pedestrian") == 0)
+    {
+        return SignalNodePedestrian;
+    }
+    return -1;
+}
+
+static inline int parseSignalState(const char* pName)
+{
+    if (strcmp(pName, "stopped") == 0)
+    {
+        return SignalStateStopped;
+    }
+    if ((strcmp(pName, "going") == 0) || (strcmp(pName, "walking") == 0))
+    {
+        return SignalStateGoing;
+    }
+    if (strcmp(pName, "transition") == 0)
+    {
+        return SignalStateTransition;
+    }
+    return -1;
+}
+
+static inline int parseSignalCommand(const char* pName)
+{
+    if (strcmp(pName, "query") == 0)
+    {
+        return SignalCommandQuery;
+    }
+    if (strcmp(pName, "stop") == 0)
+    {
+        return SignalCommandStop;
+    }
+    if ((strcmp(pName, "go") == 0) || (strcmp(pName, "walk") == 0))
+    {
+        return SignalCommandGo;
+    }
+    return -1;
+}
+
+#define SIGNAL_BATCH_MAX_COUNT 8    // commands of one batch
+#define SIGNAL_BATCH_STEP_SIZE 28   // "query:pedestrian=transition," the longest step and its comma
+#define SIGNAL_BATCH_TEXT_SIZE (SIGNAL_BATCH_MAX_COUNT * SIGNAL_BATCH_STEP_SIZE)   // with the NUL
+
+// Batch in text form, modified in place: <command>[:<node>=<state>],...
+// e.g. "walk:road=stopped". Each command may wait waitMillisecond for its condition.
+// Returns the count of commands, 0 if the text is malformed or has more than maxCount.
+static inline uint8_t parseSignalBatch(char* pText, const uint16_t waitMillisecond,
+    SignalMessage* pCommands, const uint8_t maxCount)
+{
+    uint8_t count = 0;
+    char* pSave = nullptr;
+    for (char* pStep = strtok_r(pText, ",", &pSave); pStep != nullptr; pStep = strtok_r(nullptr, ",", &pSave))
+    {
+        if (count >= maxCount)
+        {
+            return 0;
+        }
+
+        SignalMessage& command = pCommands[count++];
+        memset(&command, 0, sizeof command);
+        command.type = SignalMessageCommand;
+        command.remains = waitMillisecond;
+
+        char* pCondition = strchr(pStep, ':');
+        if (pCondition != nullptr)
+        {
+            *pCondition++ = '\0';
+
+            char* pState = strchr(pCondition, '=');
+            if (pState == nullptr)
+            {
+                return 0;
+            }
+            *pState++ = '\0';
+
+            const int node = parseSignalNode(pCondition);
+            const int state = parseSignalState(pState);
+            if ((node < 0) || (state < 0))
+            {
+                return 0;
+            }
+            command.condition = SIGNAL_CONDITION(node, state);
+        }
+
+        const int value = parseSignalCommand(pStep);
+        if (value < 0)
+        {
+            return 0;
+        }
+        command.command = static_cast<uint8_t>(value);
+    }
+
+    return count;
+}
+
+#endif
@@ -0,0 +1,191 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_ROUTE_STATISTICS_H
+#define SIGNAL_ROUTE_STATISTICS_H
+
+#include "SignalHal.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_ROUTE_BUCKETS 16   // power of 2 usec, the last one takes everything slower
+
+// Requests, errors and handler latency per route of an ESP8266WebServer, as JSON so runs
+// under load can be compared across versions. Latency is taken on the node from the handler
+// call to its return, so it leaves out the network and the client. Percentiles are the upper
+// bound of the histogram bucket they fall in, capped at the maximum.
+template <uint8_t Size>
+class SignalRouteStatistics
+{
+private:
+    struct Route
+    {
+        const char* pPath;
+        uint32_t count;
+        uint32_t errors;                        // answered 400 or above
+        uint32_t maxMicrosecond;
+        uint64_t totalMicrosecond;
+        uint32_t buckets[SIGNAL_ROUTE_BUCKETS];
+    };
+
+    Route routes[Size];
+    uint8_t routeCount;
+    uint32_t startedAt;
+
+    static uint32_t getPercentile(const Route& route, const uint16_t permille)
+    {
+        if (route.count == 0)
+        {
+            return 0;
+        }
+
+        const uint32_t rank = static_cast<uint32_t>((static_cast<uint64_t>(route.count) * permille + 999) / 1000);
+        uint32_t seen = 0;
+        for (uint8_t index = 0; index < SIGNAL_ROUTE_BUCKETS; index++)
+        {
+            seen += route.buckets[index];
+            if (seen >= rank)
+            {
+                const uint32_t bound = 1UL << (index + 1);
+                return (bound < route.maxMicrosecond) ? bound : route.maxMicrosecond;
+            }
+        }
+        return route.maxMicrosecond;
+    }
+
+public:
+    SignalRouteStatistics()
+        : routeCount(0), startedAt(0)
+    {
+        memset(routes, 0, sizeof routes);
+    }
+
+    // Index for record(), -1 if full. pPath is kept, not copied.
+    int add(const char* pPath)
+    {
+        if (routeCount >= Size)
+        {
+            return -1;
+        }
+
+        routes[routeCount].pPath = pPath;
+        return routeCount++;
+    }
+
+    void record(const int route, const uint32_t elapsedMicrosecond, const int statusCode)
+    {
+        if ((route < 0) || (route >= routeCount))
+        {
+            return;
+        }
+
+        Route& entry = routes[route];
+        uint8_t bucket = 0;
+        while ((bucket < (SIGNAL_ROUTE_BUCKETS - 1)) && ((elapsedMicrosecond >> (bucket + 1)) != 0))
+        {
+            bucket++;
+        }
+
+        entry.count++;
+        entry.errors += (statusCode >= 400) ? 1 : 0;
+        entry.buckets[bucket]++;
+        entry.totalMicrosecond += elapsedMicrosecond;
+        if (elapsedMicrosecond > entry.maxMicrosecond)
+        {
+            entry.maxMicrosecond = elapsedMicrosecond;
+        }
+    }
+
+    // Routes in the order they were added, for other export formats.
+    uint8_t getRouteCount() const
+    {
+        return routeCount;
+    }
+
+    const char* getPath(const uint8_t route) const
+    {
+        return routes[route].pPath;
+    }
+
+    uint32_t getCount(const uint8_t route) const
+    {
+        return routes[route].count;
+    }
+
+    uint32_t getErrors(const uint8_t route) const
+    {
+        return routes[route].errors;
+    }
+
+    uint64_t getTotalMicrosecond(const uint8_t route) const
+    {
+        return routes[route].totalMicrosecond;
+    }
+
+    // Requests in bucket index, below (2 << index) usec except the last one.
+    uint32_t getBucket(const uint8_t route, const uint8_t index) const
+    {
+        return routes[route].buckets[index];
+    }
+
+    // Starts a new run, e.g. before a load test.
+    void reset()
+    {
+        for (uint8_t index = 0; index < routeCount; index++)
+        {
+            const char* pPath = routes[index].pPath;
+            memset(&routes[index], 0, sizeof routes[index]);
+            routes[index].pPath = pPath;
+        }
+        startedAt = signalMillis();
+    }
+
+    // {"elapsed":msec,"routes":[{"path":..,"count":..,"errors":..,"p50":usec,"p99":..,"p999":..,"max":..},..]}
+    // Throughput is count / elapsed.
+    String toJson() const
+    {
+        String result;
+        char buffer[160];
+        snprintf(buffer, sizeof buffer, "{\"elapsed\":%lu,\"routes\":[",
+            static_cast<unsigned long>(signalMillis() - startedAt));
+        result += buffer;
+
+        for (uint8_t index = 0; index < routeCount; index++)
+        {
+            const Route& route = routes[index];
+            snprintf(buffer, sizeof buffer,
+                "%s{\"path\":\"%s\",\"count\":%lu,\"errors\":%lu,\"p50\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu}",
+                (index == 0) ? "" : ",", route.pPath,
+                static_cast<unsigned long>(route.count), static_cast<unsigned long>(route.errors),
+                static_cast<unsigned long>(getPercentile(route, 500)),
+                static_cast<unsigned long>(getPercentile(route, 990)),
+                static_cast<unsigned long>(getPercentile(route, 999)),
+                static_cast<unsigned long>(route.maxMicrosecond));
+            result += buffer;
+        }
+
+        result += "]}";
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,215 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_SEQUENCE_H
+#define SIGNAL_SEQUENCE_H
+
+#include "SignalHal.h"
+#include "SignalTrace.h"
+
+////////////////////////////////////////////////
+
+// One phase of a signal sequence. Tables of these live in flash (PROGMEM).
+struct SignalPhase
+{
+    uint32_t lamps;      // GPIO bit mask of the lamps lit in this phase (IO0-IO15)
+    uint16_t duration;   // msec, 0: hold until jump()
+    uint8_t next;        // phase after the duration
+    uint8_t repeatTo;    // phase to go back to while repeating
+    uint8_t repeat;      // times to go back to repeatTo before going to next
+    uint8_t hook;        // passed to the hook on entry, 0: none
+};
+
+#define SIGNAL_LAMP(pin) (1UL << (pin))
+
+// Light exactly the given lamps in one masked write.
+inline void writeSignalLamps(const uint32_t allLamps, const uint32_t lamps)
+{
+    signalWritePins(allLamps, lamps);
+}
+
+// Table driven phase sequencer shared by the signal firmwares.
+// Entering a phase costs one table read and one masked GPIO write.
+// Time is supplied by the owner: either step() at the end of each duration
+// (deadline scheduler), or tick() with the elapsed msec (periodic Ticker).
+class SignalSequence
+{
+public:
+    typedef void (*HookHandler)(void* pContext, const uint8_t hook);
+
+private:
+    const SignalPhase* pPhases;
+    uint32_t allLamps;
+    HookHandler pHook;
+    void* pContext;
+    SignalTrace* pTrace;
+
+    SignalPhase phase;   // copy of the current entry
+    uint8_t current;
+    uint8_t repeated;
+    uint16_t remains;
+
+    uint16_t enter(const uint8_t index)
+    {
+        memcpy_P(&phase, &pPhases[index], sizeof phase);
+        current = index;
+        remains = phase.duration;
+
+        if (pTrace != nullptr)
+        {
+            pTrace->record(SignalTracePhase, index, repeated);
+        }
+        writeSignalLamps(allLamps, phase.lamps);
+        if (pTrace != nullptr)
+        {
+            pTrace->record(SignalTraceLamps, 0, static_cast<uint16_t>(phase.lamps));
+        }
+
+        if ((phase.hook != 0) && (pHook != nullptr))
+        {
+            pHook(pContext, phase.hook);
+        }
+
+        return phase.duration;
+    }
+
+public:
+    SignalSequence()
+        : pPhases(nullptr), allLamps(0), pHook(nullptr), pContext(nullptr), pTrace(nullptr)
+        , current(0), repeated(0), remains(0)
+    {
+        memset(&phase, 0, sizeof phase);
+    }
+
+    uint16_t begin(const SignalPhase* pPhases, const uint32_t allLamps, const uint8_t initial,
+        const HookHandler pHook = nullptr, void* pContext = nullptr)
+    {
+        this->pPhases = pPhases;
+        this->allLamps = allLamps;
+        this->pHook = pHook;
+        this->pContext = pContext;
+
+        return jump(initial);
+    }
+
+    // Phase entries and lamp writes go to the trace from now on, nullptr to stop.
+    void setTrace(SignalTrace* pTrace)
+    {
+        this->pTrace = pTrace;
+    }
+
+    // Enter a phase now, returns its duration.
+    uint16_t jump(const uint8_t index)
+    {
+        repeated = 0;
+        return enter(index);
+    }
+
+    // The current phase duration has elapsed: enter the following one, returns its duration.
+    uint16_t step()
+    {
+        if (phase.repeat == 0)
+        {
+            return enter(phase.next);
+        }
+
+        if (repeated < phase.repeat)
+        {
+            repeated++;
+            return enter(phase.repeatTo);
+        }
+
+        repeated = 0;
+        return enter(phase.next);
+    }
+
+    // Count down the current phase by the elapsed time, hold phases don't expire.
+    void tick(const uint16_t elapsed)
+    {
+        if (phase.duration == 0)
+        {
+            return;
+        }
+
+        if (remains > elapsed)
+        {
+            remains -= elapsed;
+        }
+        else
+        {
+            step();
+        }
+    }
+
+    uint8_t getPhase() const
+    {
+        return current;
+    }
+
+    // Times already gone back by the repeating phase.
+    uint8_t getRepeated() const
+    {
+        return repeated;
+    }
+
+    // msec left in the current phase, 0 while holding.
+    uint16_t getRemains() const
+    {
+        return (phase.duration == 0) ? 0 : remains;
+    }
+
+    bool isHolding() const
+    {
+        return phase.duration == 0;
+    }
+
+    // msec until a holding phase is entered, following the table and the repeats still to go.
+    uint32_t getRemainsToHold() const
+    {
+        uint32_t total = getRemains();
+        SignalPhase following = phase;
+        uint8_t followingRepeated = repeated;
+        for (uint16_t guard = 0; (following.duration != 0) && (guard < 1024); guard++)
+        {
+            uint8_t index = following.next;
+            if (following.repeat != 0)
+            {
+                if (followingRepeated < following.repeat)
+                {
+                    followingRepeated++;
+                    index = following.repeatTo;
+                }
+                else
+                {
+                    followingRepeated = 0;
+                }
+            }
+
+            memcpy_P(&following, &pPhases[index], sizeof following);
+            total += following.duration;
+        }
+
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PedestrianController - American pedestrian signal controller on ESP8266
+// Copyright (c) 2017-2018 Kouji Matsui (@kozy_kekyo)
+//
+// SignalCommon - Shared code for PedestrianController and MatrixSignalController.
+// This is part of PedestrianController.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIGNAL_TRACE_H
+#define SIGNAL_TRACE_H
+
+#include "SignalHal.h"
+
+////////////////////////////////////////////////
+
+#define SIGNAL_TRACE_SIZE 256   // events kept, must be power of 2 (8 bytes each)
+
+enum SignalTraceKinds
+{
+    SignalTraceRequest,       // handler called, arg: route
+    SignalTraceResponse,      // handler returned, arg: route, value: status code
+    SignalTraceEnqueue,       // arg: command, value: sequence (low 16 bits), 0 if rejected
+    SignalTraceTick,          // Ticker callback entered
+    SignalTracePhase,         // arg: phase entered, value: times repeated
+    SignalTraceLamps,         // masked lamp write done, value: pins lit (IO0-IO15)
+    SignalTraceKindCount
+};
+
+struct SignalTraceEvent
+{
+    uint32_t at;      // usec, signalMicros()
+    uint8_t kind;
+    uint8_t arg;
+    uint16_t value;
+};
+
+// Where the time of a command went: fixed ring of binary events with usec timestamps,
+// the oldest overwritten. record() is a store of 8 bytes and the clock read, so it can
+// stay enabled; its cost is in the node benchmarks (BENCHMARK_ON_BOOT).
+// Single producer: Ticker callbacks run between loop() yields and never preempt it.
+class SignalTrace
+{
+public:
+    typedef void (*WriteHandler)(void* pContext, const char* pText);
+
+private:
+    SignalTraceEvent events[SIGNAL_TRACE_SIZE];
+    uint32_t head;            // events recorded so far, wraps around
+    uint32_t dropped;         // while exporting
+    bool exporting;
+
+    static const char* getName(const uint8_t kind)
+    {
+        switch (kind)
+        {
+            case SignalTraceRequest:
+            case SignalTraceResponse:
+                return "request";
+            case SignalTraceEnqueue:
+                return "enqueue";
+            case SignalTraceTick:
+                return "tick";
+            case SignalTracePhase:
+                return "phase";
+            default:
+                return "lamps";
+        }
+    }
+
+    static void formatArgs(const SignalTraceEvent& event, char* pBuffer, const size_t size)
+    {
+        switch (event.kind)
+        {
+            case SignalTraceRequest:
+                snprintf(pBuffer, size, "{\"route\":%u}", event.arg);
+                break;
+            case SignalTraceResponse:
+                snprintf(pBuffer, size, "{\"route\":%u,\"status\":%u}", event.arg, event.value);
+                break;
+            case SignalTraceEnqueue:
+                snprintf(pBuffer, size, "{\"command\":%u,\"sequence\":%u}", event.arg, event.value);
+                break;
+            case SignalTracePhase:
+                snprintf(pBuffer, size, "{\"phase\":%u,\"repeated\":%u}", event.arg, event.value);
+                break;
+            case SignalTraceLamps:
+                snprintf(pBuffer, size, "{\"pins\":\"0x%04x\"}", event.value);
+                break;
+            default:
+                snprintf(pBuffer, size, "{}");
+                break;
+        }
+    }
+
+public:
+    SignalTrace()
+        : head(0), dropped(0), exporting(false)
+    {
+        memset(events, 0, sizeof events);
+    }
+
+    void record(const SignalTraceKinds kind, const uint8_t arg = 0, const uint16_t value = 0)
+    {
+        if (exporting)
+        {
+            dropped++;
+            return;
+        }
+
+        SignalTraceEvent& event = events[head & (SIGNAL_TRACE_SIZE - 1)];
+        event.at = signalMicros();
+        event.kind = kind;
+        event.arg = arg;
+        event.value = value;
+        head++;
+    }
+
+    void clear()
+    {
+        head = 0;
+        dropped = 0;
+    }
+
+    uint16_t getCount() const
+    {
+        return (head < SIGNAL_TRACE_SIZE) ? head : SIGNAL_TRACE_SIZE;
+    }
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto), oldest first, in pieces of
+    // at most 512 bytes. Requests are duration events, the rest instants; timestamps are
+    // usec from the oldest event. Recording pauses meanwhile, the writer may yield.
+    void toChromeJson(const uint8_t pid, const WriteHandler pWrite, void* pContext)
+    {
+        exporting = true;
+
+        char buffer[512];
+        size_t length = snprintf(buffer, sizeof buffer, "{\"traceEvents\":[");
+
+        const uint16_t count = getCount();
+        const uint32_t first = head - count;
+        const uint32_t origin = events[first & (SIGNAL_TRACE_SIZE - 1)].at;
+        for (uint16_t index = 0; index < count; index++)
+        {
+            const SignalTraceEvent& event = events[(first + index) & (SIGNAL_TRACE_SIZE - 1)];
+
+            char args[48];
+            formatArgs(event, args, sizeof args);
+
+            const char phase = (event.kind == SignalTraceRequest) ? 'B' :
+                (event.kind == SignalTraceResponse) ? 'E' : 'i';
+            char line[128];
+            snprintf(line, sizeof line,
+                "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lu,\"pid\":%u,\"tid\":1,%s\"args\":%s}",
+                (index == 0) ? "" : ",", getName(event.kind), phase,
+                static_cast<unsigned long>(event.at - origin), pid, (phase == 'i') ? "\"s\":\"t\"," : "", args);
+
+            const size_t lineLength = strlen(line);
+            if ((length + lineLength) >= sizeof buffer)
+            {
+                pWrite(pContext, buffer);
+                length = 0;
+            }
+            memcpy(buffer + length, line, lineLength + 1);
+            length += lineLength;
+        }
+
+        char footer[64];
+        snprintf(footer, sizeof footer, "],\"otherData\":{\"dropped\":%lu}}", static_cast<unsigned long>(dropped));
+        if ((length + strlen(footer)) >= sizeof buffer)
+        {
+            pWrite(pContext, buffer);
+            length = 0;
+        }
+        strcpy(buffer + length, footer);
+        pWrite(pContext, buffer);
+
+        exporting = false;
+    }
+};
+
+#endif